@@ -0,0 +1,1026 @@
+// Headless benchmark harness: renders scripted camera paths without a window
+// and reports per-frame timings for each scene.
+#include <SDL2/SDL.h>
+#include "capture.h"
+#include "jobs.h"
+#include "light.h"
+#include "map.h"
+#include "mem.h"
+#include "minimap.h"
+#include "nav.h"
+#include "raycast.h"
+#include "render.h"
+#include "rooms.h"
+#include "sprite.h"
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct BenchOpts {
+    const char *scene;
+    const char *mapPath;
+    int mapSize;
+    int w, h;
+    int frames;
+    int entities;
+    int arenaSize;
+    int rays;
+    int paths;
+    int threads;
+    int edits;
+    bool interlace;
+    unsigned int seed;
+} BenchOpts;
+
+typedef struct BenchTimer {
+    double total, min, max;
+    int frames;
+} BenchTimer;
+
+static double now_ms(void) {
+    return (double)SDL_GetPerformanceCounter() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static void timer_add(BenchTimer *t, double ms) {
+    if (t->frames == 0 || ms < t->min) t->min = ms;
+    if (t->frames == 0 || ms > t->max) t->max = ms;
+    t->total += ms;
+    t->frames++;
+}
+
+static void timer_report(const char *scene, const BenchOpts *o, const BenchTimer *t, const char *extra) {
+    double avg = t->frames ? t->total / t->frames : 0.0;
+    printf("%-10s %4dx%-4d frames=%d avg=%.3fms min=%.3fms max=%.3fms fps=%.1f%s%s\n",
+        scene, o->w, o->h, t->frames, avg, t->min, t->max, avg > 0.0 ? 1000.0 / avg : 0.0,
+        extra ? " " : "", extra ? extra : "");
+}
+
+// deterministic camera: start in an open cell and sweep a full turn over the run
+typedef struct BenchCam { double posX, posY, dirX, dirY, planeX, planeY; } BenchCam;
+
+static BenchCam bench_camera(int frame, int frames) {
+    BenchCam c = { 1.5, 1.5, -1.0, 0.0, 0.0, 0.84 };
+    int cx = mapW / 2, cy = mapH / 2;
+    for (int r = 0; r < (mapW > mapH ? mapW : mapH); r++) {
+        bool found = false;
+        for (int y = cy - r; y <= cy + r && !found; y++) for (int x = cx - r; x <= cx + r && !found; x++) {
+            if (x > 0 && y > 0 && x < mapW - 1 && y < mapH - 1 && MAP_AT(x, y) == 0) { c.posX = x + 0.5; c.posY = y + 0.5; found = true; }
+        }
+        if (found) break;
+    }
+    double a = 2.0 * M_PI * frame / (frames > 0 ? frames : 1);
+    c.dirX = cos(a); c.dirY = sin(a);
+    c.planeX = -c.dirY * 0.84; c.planeY = c.dirX * 0.84;
+    return c;
+}
+
+static bool bench_load_map(const BenchOpts *o) {
+    if (o->mapPath) {
+        if (!load_map_file(o->mapPath)) { fprintf(stderr, "failed to load %s\n", o->mapPath); return false; }
+    } else {
+        srand(o->seed);
+        mapW = o->mapSize;
+        mapH = o->mapSize;
+        load_default_map();
+    }
+    light_bake();
+    return true;
+}
+
+static void scene_world(const BenchOpts *o, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    BenchTimer t = {0};
+    for (int f = 0; f < o->frames; f++) {
+        BenchCam c = bench_camera(f, o->frames);
+        double t0 = now_ms();
+        render_world(pixels, o->w, o->h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, zbuffer);
+        timer_add(&t, now_ms() - t0);
+    }
+    timer_report("world", o, &t, NULL);
+    if (!o->interlace) return;
+
+    // same path through the interlaced mode; every other frame also strafes
+    // half a cell so both the reprojected and the interpolated fills are timed
+    BenchTimer ti = {0};
+    RenderCache rc = {0};
+    rc.interlace = true;
+    long long reprojected = 0, interpolated = 0;
+    for (int f = 0; f < o->frames; f++) {
+        BenchCam c = bench_camera(f, o->frames);
+        if ((f / 2) & 1) {
+            double nx = c.posX + c.planeX * 0.6, ny = c.posY + c.planeY * 0.6;
+            if (nx > 0.0 && ny > 0.0 && nx < mapW && ny < mapH && MAP_AT((int)nx, (int)ny) == 0) { c.posX = nx; c.posY = ny; }
+        }
+        double t0 = now_ms();
+        render_world_cached(&rc, 0, pixels, o->w, o->h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, zbuffer);
+        timer_add(&ti, now_ms() - t0);
+        reprojected += rc.reprojected;
+        interpolated += rc.interpolated;
+    }
+    char extra[96];
+    snprintf(extra, sizeof(extra), "reprojected/frame=%lld interpolated/frame=%lld",
+        o->frames ? reprojected / o->frames : 0, o->frames ? interpolated / o->frames : 0);
+    timer_report("world-il", o, &ti, extra);
+    render_cache_free(&rc);
+}
+
+// four-way split screen: each quadrant drawn by its own render_world() into a
+// scratch buffer and copied in, against one render_views() call for all four
+static void scene_views(const BenchOpts *o, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    int qw = o->w / 2, qh = o->h / 2;
+    Uint32 *scratch = malloc(sizeof(Uint32) * (size_t)qw * qh);
+    Uint32 *check = malloc(sizeof(Uint32) * (size_t)o->w * o->h);
+    float *zviews = malloc(sizeof(float) * (size_t)qw * 4);
+    if (!scratch || !check || !zviews || qw <= 0 || qh <= 0) {
+        fprintf(stderr, "views: failed to allocate quadrant buffers\n");
+        free(scratch); free(check); free(zviews);
+        return;
+    }
+    RenderView views[4];
+    BenchTimer ts = {0}, tb = {0};
+    long mismatched = 0;
+    for (int f = 0; f < o->frames; f++) {
+        for (int v = 0; v < 4; v++) {
+            // the same sweep a quarter turn apart
+            BenchCam c = bench_camera(f + v * o->frames / 4, o->frames);
+            views[v] = (RenderView){ pixels, o->w, (v & 1) * qw, (v >> 1) * qh, qw, qh,
+                c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, zviews + v * qw };
+        }
+        double t0 = now_ms();
+        for (int v = 0; v < 4; v++) {
+            const RenderView *rv = &views[v];
+            render_world(scratch, qw, qh, rv->posX, rv->posY, rv->dirX, rv->dirY, rv->planeX, rv->planeY, textures, zbuffer);
+            for (int y = 0; y < qh; y++) memcpy(check + (size_t)(rv->y + y) * o->w + rv->x, scratch + (size_t)y * qw, sizeof(Uint32) * qw);
+        }
+        timer_add(&ts, now_ms() - t0);
+        t0 = now_ms();
+        render_views(views, 4, textures);
+        timer_add(&tb, now_ms() - t0);
+        for (int y = 0; y < qh * 2; y++) {
+            if (memcmp(check + (size_t)y * o->w, pixels + (size_t)y * o->w, sizeof(Uint32) * qw * 2) != 0) mismatched++;
+        }
+    }
+    timer_report("views-seq", o, &ts, NULL);
+    char extra[64];
+    snprintf(extra, sizeof(extra), "mismatched-rows=%ld", mismatched);
+    timer_report("views", o, &tb, extra);
+    free(scratch);
+    free(check);
+    free(zviews);
+
+    // minimap: a full build against the incremental redraw after a few cells
+    // change; the map is restored afterwards for the scenes that follow
+    int *saved = malloc(sizeof(int) * (size_t)mapW * mapH);
+    if (!saved) { fprintf(stderr, "views: failed to save the map\n"); return; }
+    memcpy(saved, worldMap, sizeof(int) * (size_t)mapW * mapH);
+    Minimap mm = {0};
+    BenchTimer tf = {0}, ti = {0};
+    long long redrawn = 0;
+    for (int f = 0; f < o->frames; f++) {
+        double t0 = now_ms();
+        minimap_free(&mm);
+        minimap_update(&mm, 4);
+        timer_add(&tf, now_ms() - t0);
+    }
+    for (int f = 0; f < o->frames; f++) {
+        // toggle a handful of interior cells between wall and floor
+        for (int i = 0; i < 4; i++) {
+            int x = 1 + rand() % (mapW - 2), y = 1 + rand() % (mapH - 2);
+            MAP_AT(x, y) = MAP_AT(x, y) ? 0 : 1;
+        }
+        map_rebuild_occupancy();
+        double t0 = now_ms();
+        minimap_update(&mm, 4);
+        timer_add(&ti, now_ms() - t0);
+        redrawn += mm.redrawn;
+    }
+    timer_report("mini-full", o, &tf, NULL);
+    snprintf(extra, sizeof(extra), "redrawn/frame=%lld", o->frames ? redrawn / o->frames : 0);
+    timer_report("mini-inc", o, &ti, extra);
+    minimap_free(&mm);
+    memcpy(worldMap, saved, sizeof(int) * (size_t)mapW * mapH);
+    free(saved);
+    map_rebuild_occupancy();
+}
+
+static Uint32 frame_hash(const Uint32 *px, size_t n) {
+    Uint32 h = 2166136261u;
+    for (size_t i = 0; i < n; i++) h = (h ^ px[i]) * 16777619u;
+    return h;
+}
+
+// the world path with every frame handed to the capture encoder: once as the
+// game does (drops when behind), once keeping every frame, then decoded back
+static void scene_capture(const BenchOpts *o, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    const char *path = "game90_bench.g90v";
+    size_t n = (size_t)o->w * o->h;
+    Uint32 *hashes = malloc(sizeof(Uint32) * (size_t)o->frames);
+    if (!hashes) return;
+    for (int pass = 0; pass < 2; pass++) {
+        int flags = pass ? CAPTURE_WAIT : 0;
+        Capture *cap = capture_start(path, o->w, o->h);
+        if (!cap) break;
+        BenchTimer t = {0};
+        for (int f = 0; f < o->frames; f++) {
+            BenchCam c = bench_camera(f, o->frames);
+            render_world(pixels, o->w, o->h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, zbuffer);
+            hashes[f] = frame_hash(pixels, n);
+            double t0 = now_ms();
+            capture_frame(cap, pixels, o->w, flags);
+            timer_add(&t, now_ms() - t0);
+        }
+        CaptureStats cs;
+        capture_stop(cap, &cs);
+        char extra[128];
+        snprintf(extra, sizeof(extra), "written=%u dropped=%u ratio=%.1f%% encode=%.3fms",
+            (unsigned)cs.written, (unsigned)cs.dropped, n && cs.written ? 100.0 * cs.bytes / ((double)n * 4 * cs.written) : 0.0,
+            cs.written ? cs.encodeMs / cs.written : 0.0);
+        timer_report(pass ? "capture-all" : "capture", o, &t, extra);
+    }
+    // every frame of the last pass must decode to exactly what was rendered
+    CaptureReader r;
+    if (capture_open(&r, path)) {
+        int decoded = 0, bad = 0;
+        while (capture_next(&r)) {
+            if (r.frame >= (Uint32)o->frames || frame_hash(r.pixels, n) != hashes[r.frame]) bad++;
+            decoded++;
+        }
+        printf("capture    decoded=%d mismatched=%d\n", decoded, bad);
+        capture_close(&r);
+    }
+    remove(path);
+    free(hashes);
+}
+
+// open hall with a pillar every 8 cells, big enough to hold tens of thousands of entities
+static void bench_arena(int size) {
+    int *m = mem_alloc(MEM_MAP, sizeof(int) * size * size, MEM_CACHE_LINE);
+    if (!m) return;
+    for (int y = 0; y < size; y++) for (int x = 0; x < size; x++) {
+        bool border = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+        bool pillar = (x % 8 == 4) && (y % 8 == 4);
+        m[x + size * y] = border ? 1 : (pillar ? 2 + ((x / 8 + y / 8) & 1) : 0);
+    }
+    mem_free(worldMap);
+    worldMap = m;
+    mapW = mapH = size;
+    map_rebuild_occupancy();
+    mapLightCount = 0;
+    mapAmbient = MAP_LIGHT_MAX;
+    light_bake();
+}
+
+// Sprites crowded in front of the camera, drawn in one sprite_render call
+// and, as the reference, one at a time from far to near over copies of the
+// same world frame. Orbs cover a short span low in their edge columns, so
+// nearer sprites often leave gaps a farther one has to show through. Returns
+// the frames that differ.
+#define SPRITE_CHECK_COUNT 48
+static int sprite_overlap_check(const BenchOpts *o, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H], int frames) {
+    Uint32 *world = malloc(sizeof(Uint32) * (size_t)o->w * o->h);
+    Uint32 *ref = malloc(sizeof(Uint32) * (size_t)o->w * o->h);
+    if (!world || !ref) { free(world); free(ref); return -1; }
+    int bad = 0;
+    for (int f = 0; f < frames; f++) {
+        BenchCam c = bench_camera(f, frames);
+        render_world(world, o->w, o->h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, zbuffer);
+        double sx[SPRITE_CHECK_COUNT], sy[SPRITE_CHECK_COUNT], depth[SPRITE_CHECK_COUNT];
+        int tex[SPRITE_CHECK_COUNT], order[SPRITE_CHECK_COUNT];
+        sprite_reset();
+        for (int i = 0; i < SPRITE_CHECK_COUNT; i++) {
+            // at least 0.04 apart, so the draw order is never a tie
+            depth[i] = 0.6 + i * 0.08 + (rand() % 500) / 500.0 * 0.04;
+            double side = ((rand() % 1000) / 500.0 - 1.0) * 0.8 * depth[i];
+            sx[i] = c.posX + c.dirX * depth[i] + c.planeX / 0.84 * side;
+            sy[i] = c.posY + c.dirY * depth[i] + c.planeY / 0.84 * side;
+            tex[i] = rand() % 4 == 0;
+            order[i] = i;
+            sprite_spawn(sx[i], sy[i], tex[i]);
+        }
+        memcpy(pixels, world, sizeof(Uint32) * (size_t)o->w * o->h);
+        sprite_render(pixels, o->w, o->h, zbuffer, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, NULL);
+        for (int i = 1; i < SPRITE_CHECK_COUNT; i++) for (int j = i; j > 0 && depth[order[j]] > depth[order[j - 1]]; j--) {
+            int t = order[j]; order[j] = order[j - 1]; order[j - 1] = t;
+        }
+        memcpy(ref, world, sizeof(Uint32) * (size_t)o->w * o->h);
+        for (int i = 0; i < SPRITE_CHECK_COUNT; i++) {
+            sprite_reset();
+            sprite_spawn(sx[order[i]], sy[order[i]], tex[order[i]]);
+            sprite_render(ref, o->w, o->h, zbuffer, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, NULL);
+        }
+        if (memcmp(ref, pixels, sizeof(Uint32) * (size_t)o->w * o->h) != 0) bad++;
+    }
+    sprite_reset();
+    free(world);
+    free(ref);
+    return bad;
+}
+
+static void scene_sprites(const BenchOpts *o, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    // scatter live entities over open cells; they drift every frame to exercise re-binning
+    if (!o->mapPath) bench_arena(o->arenaSize);
+    sprite_reset();
+    int n = 0;
+    float *vel = malloc(sizeof(float) * 2 * (size_t)o->entities);
+    double *ex = malloc(sizeof(double) * 2 * (size_t)o->entities);
+    int *ids = malloc(sizeof(int) * (size_t)o->entities);
+    if (!vel || !ex || !ids) { free(vel); free(ex); free(ids); return; }
+    srand(o->seed);
+    for (int tries = 0; n < o->entities && tries < o->entities * 64; tries++) {
+        int x = rand() % mapW, y = rand() % mapH;
+        if (MAP_AT(x, y) != 0) continue;
+        ex[2 * n] = x + (rand() % 1000) / 1000.0;
+        ex[2 * n + 1] = y + (rand() % 1000) / 1000.0;
+        vel[2 * n] = ((rand() % 200) - 100) / 5000.0f;
+        vel[2 * n + 1] = ((rand() % 200) - 100) / 5000.0f;
+        ids[n] = sprite_spawn(ex[2 * n], ex[2 * n + 1], n & 1);
+        n++;
+    }
+    BenchTimer t = {0}, tw = {0};
+    SpriteStats st = {0};
+    long long drawn = 0, tested = 0;
+    for (int f = 0; f < o->frames; f++) {
+        for (int i = 0; i < n; i++) {
+            double nx = ex[2 * i] + vel[2 * i], ny = ex[2 * i + 1] + vel[2 * i + 1];
+            int cx = (int)nx, cy = (int)ny;
+            if (cx < 0 || cy < 0 || cx >= mapW || cy >= mapH || MAP_AT(cx, cy) != 0) { vel[2 * i] = -vel[2 * i]; vel[2 * i + 1] = -vel[2 * i + 1]; continue; }
+            ex[2 * i] = nx; ex[2 * i + 1] = ny;
+            sprite_move(ids[i], nx, ny);
+        }
+        BenchCam c = bench_camera(f, o->frames);
+        double t0 = now_ms();
+        render_world(pixels, o->w, o->h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, zbuffer);
+        double t1 = now_ms();
+        sprite_render(pixels, o->w, o->h, zbuffer, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, &st);
+        double t2 = now_ms();
+        timer_add(&tw, t1 - t0);
+        timer_add(&t, t2 - t1);
+        drawn += st.drawn;
+        tested += st.tested;
+    }
+    free(vel); free(ex); free(ids);
+    int overlapBad = sprite_overlap_check(o, pixels, zbuffer, textures, 32);
+    char extra[192];
+    snprintf(extra, sizeof(extra), "entities=%d tested/frame=%lld drawn/frame=%lld (world avg=%.3fms) overlap-mismatches=%d/32",
+        n, o->frames ? tested / o->frames : 0, o->frames ? drawn / o->frames : 0, tw.frames ? tw.total / tw.frames : 0.0, overlapBad);
+    timer_report("sprites", o, &t, extra);
+}
+
+// hitscan and line-of-sight throughput: scalar, SSE2 packets, then packets on all workers
+static void scene_rays(const BenchOpts *o) {
+    int n = o->rays;
+    size_t fl = sizeof(float) * (size_t)n;
+    float *ox = malloc(fl), *oy = malloc(fl), *dx = malloc(fl), *dy = malloc(fl), *md = malloc(fl);
+    float *bx = malloc(fl), *by = malloc(fl), *dist = malloc(fl), *u = malloc(fl);
+    int *cx = malloc(sizeof(int) * (size_t)n), *cy = malloc(sizeof(int) * (size_t)n);
+    Sint8 *side = malloc((size_t)n);
+    Uint8 *vis = malloc((size_t)n);
+    if (!ox || !oy || !dx || !dy || !md || !bx || !by || !dist || !u || !cx || !cy || !side || !vis) {
+        fprintf(stderr, "rays: allocation failed\n");
+    } else {
+        srand(o->seed);
+        for (int i = 0; i < n; i++) {
+            int x, y;
+            do { x = rand() % mapW; y = rand() % mapH; } while (MAP_SOLID(x, y));
+            ox[i] = x + (rand() % 1000) / 1000.0f;
+            oy[i] = y + (rand() % 1000) / 1000.0f;
+            float a = (rand() % 6283) / 1000.0f;
+            dx[i] = cosf(a); dy[i] = sinf(a);
+            md[i] = 32.0f;
+            bx[i] = ox[i] + dx[i] * 12.0f;
+            by[i] = oy[i] + dy[i] * 12.0f;
+        }
+        RayBatch b = { n, ox, oy, dx, dy, md, cx, cy, side, dist, u };
+        const char *names[3] = { "scalar", "sse2", "threads" };
+        for (int mode = 0; mode < 3; mode++) {
+            raycast_set_simd(mode > 0);
+            if (mode < 2) jobs_shutdown();
+            else jobs_init(o->threads);
+            double t0 = now_ms();
+            raycast_batch(&b);
+            double t1 = now_ms();
+            raycast_los(n, ox, oy, bx, by, vis);
+            double t2 = now_ms();
+            long hits = 0, visible = 0;
+            for (int i = 0; i < n; i++) { hits += side[i] >= 0; visible += vis[i]; }
+            printf("rays %-8s threads=%-2d n=%d hitscan=%.2fM/s los=%.2fM/s hits=%ld visible=%ld\n",
+                names[mode], mode == 2 ? jobs_thread_count() : 1, n,
+                n / ((t1 - t0) * 1000.0), n / ((t2 - t1) * 1000.0), hits, visible);
+        }
+        raycast_set_simd(1);
+    }
+    free(ox); free(oy); free(dx); free(dy); free(md); free(bx); free(by);
+    free(dist); free(u); free(cx); free(cy); free(side); free(vis);
+}
+
+#define NAV_BENCH_POINTS 256 // waypoints kept per path
+#define NAV_BENCH_GOALS 8
+#define NAV_BENCH_EDITS 64
+
+// every open cell, so sparse generated maps can be sampled without probing
+static int *bench_open_cells(int *count) {
+    int *cells = malloc(sizeof(int) * (size_t)mapW * mapH);
+    *count = 0;
+    if (!cells) return NULL;
+    for (int i = 0; i < mapW * mapH; i++) if (!mapSolid[i]) cells[(*count)++] = i;
+    return cells;
+}
+
+static void bench_pick(const int *cells, int count, int *x, int *y) {
+    int c = cells[(int)(((unsigned)rand() * (unsigned long long)(RAND_MAX + 1u) + (unsigned)rand()) % (unsigned)count)];
+    *x = c % mapW;
+    *y = c / mapW;
+}
+
+// path throughput through the job queue, then flow field builds and single-cell repairs
+static void nav_bench_map(const BenchOpts *o, const char *label) {
+    nav_reset();
+    srand(o->seed);
+    int n = o->paths, open = 0;
+    int *cells = bench_open_cells(&open);
+    NavPathRequest *req = calloc((size_t)n, sizeof(NavPathRequest));
+    int *pts = malloc(sizeof(int) * 2 * NAV_BENCH_POINTS * (size_t)n);
+    if (!cells || !req || !pts) { fprintf(stderr, "nav: allocation failed\n"); free(cells); free(req); free(pts); return; }
+    if (open == 0) { printf("nav %-18s no open cells\n", label); free(cells); free(req); free(pts); return; }
+    for (int i = 0; i < n; i++) {
+        bench_pick(cells, open, &req[i].startX, &req[i].startY);
+        bench_pick(cells, open, &req[i].goalX, &req[i].goalY);
+        req[i].points = pts + 2 * NAV_BENCH_POINTS * (size_t)i;
+        req[i].maxPoints = NAV_BENCH_POINTS;
+    }
+    double t0 = now_ms();
+    for (int i = 0; i < n; i++) nav_submit_path(&req[i]);
+    for (int i = 0; i < n; i++) while (!SDL_AtomicGet(&req[i].done)) SDL_Delay(0);
+    double tp = now_ms() - t0;
+    long found = 0, points = 0;
+    for (int i = 0; i < n; i++) if (req[i].count > 0) { found++; points += req[i].count; }
+
+    BenchTimer build = {0}, update = {0};
+    for (int g = 0; g < NAV_BENCH_GOALS; g++) {
+        int gx, gy;
+        bench_pick(cells, open, &gx, &gy);
+        double t1 = now_ms();
+        nav_flow_field_wait(gx, gy);
+        timer_add(&build, now_ms() - t1);
+    }
+    // close and reopen single open cells; occupancy is poked directly so only the repair is timed
+    for (int e = 0; e < NAV_BENCH_EDITS; e++) {
+        int x, y;
+        bench_pick(cells, open, &x, &y);
+        int was = MAP_AT(x, y);
+        for (int pass = 0; pass < 2; pass++) {
+            MAP_AT(x, y) = pass ? was : 1;
+            MAP_SOLID(x, y) = (unsigned char)(pass == 0);
+            double t1 = now_ms();
+            nav_update_rect(x, y, x, y);
+            timer_add(&update, now_ms() - t1);
+        }
+    }
+    printf("nav %-18s %4dx%-4d threads=%-2d paths=%d found=%ld avg_points=%.1f paths/s=%.0f "
+           "flow_build avg=%.3fms max=%.3fms flow_update avg=%.3fms max=%.3fms (%d fields)\n",
+        label, mapW, mapH, jobs_thread_count(), n, found, found ? (double)points / found : 0.0,
+        tp > 0.0 ? n * 1000.0 / tp : 0.0, build.total / build.frames, build.max,
+        update.total / update.frames, update.max, NAV_BENCH_GOALS);
+    nav_reset();
+    free(cells);
+    free(req);
+    free(pts);
+}
+
+static void scene_nav(const BenchOpts *o) {
+    jobs_init(o->threads);
+    if (o->mapPath) {
+        if (load_map_file(o->mapPath)) nav_bench_map(o, o->mapPath);
+        return;
+    }
+    DIR *d = opendir("maps");
+    if (d) {
+        struct dirent *ent;
+        while ((ent = readdir(d)) != NULL) {
+            size_t L = strlen(ent->d_name);
+            if (L <= 4 || strcmp(ent->d_name + L - 4, ".map") != 0) continue;
+            char path[512];
+            snprintf(path, sizeof(path), "maps/%s", ent->d_name);
+            if (load_map_file(path)) nav_bench_map(o, path);
+        }
+        closedir(d);
+    }
+    static const int sizes[] = { 256, 512, 1024 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char label[32];
+        snprintf(label, sizeof(label), "default-%d", sizes[i]);
+        srand(o->seed);
+        mapW = mapH = sizes[i];
+        load_default_map();
+        nav_bench_map(o, label);
+    }
+}
+
+#define ROOMS_BENCH_SPRITES 2000
+#define ROOMS_BENCH_PITCH 16 // dungeon rooms are 15x15 inside, walls shared
+
+// square rooms on a grid, each wall pierced by a 2-cell doorway at a random
+// offset, with the rooms declared the way a generator would
+static void bench_dungeon(int size) {
+    int *m = mem_alloc(MEM_MAP, sizeof(int) * size * size, MEM_CACHE_LINE);
+    if (!m) return;
+    for (int i = 0; i < size * size; i++) m[i] = 0;
+    mapRoomCount = 0;
+    for (int y = 0; y < size; y++) for (int x = 0; x < size; x++) {
+        bool wall = x % ROOMS_BENCH_PITCH == 0 || y % ROOMS_BENCH_PITCH == 0 || x == size - 1 || y == size - 1;
+        if (wall) m[x + size * y] = 1 + ((x / ROOMS_BENCH_PITCH + y / ROOMS_BENCH_PITCH) % 3);
+    }
+    for (int ry = 0; ry + 2 < size; ry += ROOMS_BENCH_PITCH) {
+        for (int rx = 0; rx + 2 < size; rx += ROOMS_BENCH_PITCH) {
+            int ex = rx + ROOMS_BENCH_PITCH < size - 1 ? rx + ROOMS_BENCH_PITCH : size - 1;
+            int ey = ry + ROOMS_BENCH_PITCH < size - 1 ? ry + ROOMS_BENCH_PITCH : size - 1;
+            if (mapRoomCount < MAX_MAP_ROOMS) mapRooms[mapRoomCount++] = (MapRect){ rx + 1, ry + 1, ex - 1, ey - 1 };
+            // doorways east and south
+            if (ex < size - 1) {
+                int d = ry + 1 + rand() % (ey - ry - 2);
+                m[ex + size * d] = m[ex + size * (d + 1 < ey ? d + 1 : d)] = 0;
+            }
+            if (ey < size - 1) {
+                int d = rx + 1 + rand() % (ex - rx - 2);
+                m[(d + 1 < ex ? d + 1 : d) + size * ey] = m[d + size * ey] = 0;
+            }
+        }
+    }
+    mem_free(worldMap);
+    worldMap = m;
+    mapW = mapH = size;
+    mapLightCount = 0;
+    mapDoorCount = 0;
+    mapAmbient = MAP_LIGHT_MAX;
+    map_rebuild_occupancy();
+}
+
+// rooms_build() cost and PVS size, then sprite_render with and without the
+// room cull from random cells of the map; frames whose pixels differ are
+// sprites the room cull wrongly hid, so it must stay at zero
+static void rooms_bench_map(const BenchOpts *o, const char *label, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    light_bake();
+    double t0 = now_ms();
+    bool built = rooms_build();
+    double buildMs = now_ms() - t0;
+    if (!built) { printf("rooms %-18s build failed\n", label); return; }
+    long long visible = 0;
+    for (int r = 0; r < roomCount; r++) {
+        for (int w = 0; w < roomPVSWords; w++) {
+            Uint32 v = roomPVS[(size_t)r * roomPVSWords + w];
+            while (v) { visible++; v &= v - 1; }
+        }
+    }
+    srand(o->seed);
+    int open = 0;
+    int *cells = bench_open_cells(&open);
+    Uint32 *check = malloc((size_t)o->w * o->h * sizeof(Uint32));
+    if (!cells || !check || open == 0) { free(cells); free(check); return; }
+    sprite_reset();
+    for (int i = 0; i < ROOMS_BENCH_SPRITES; i++) {
+        int x, y;
+        bench_pick(cells, open, &x, &y);
+        sprite_spawn(x + 0.5, y + 0.5, i & 1);
+    }
+    BenchTimer on = {0}, off = {0};
+    long long culled = 0;
+    long mismatched = 0;
+    int frames = o->frames < 100 ? o->frames : 100;
+    for (int f = 0; f < frames; f++) {
+        int x, y;
+        bench_pick(cells, open, &x, &y);
+        double a = 2.0 * M_PI * (rand() % 360) / 360.0;
+        BenchCam c = { x + 0.5, y + 0.5, cos(a), sin(a), -sin(a) * 0.84, cos(a) * 0.84 };
+        SpriteStats st;
+        render_world(pixels, o->w, o->h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, zbuffer);
+        memcpy(check, pixels, (size_t)o->w * o->h * sizeof(Uint32));
+        roomsValid = false;
+        double t1 = now_ms();
+        sprite_render(check, o->w, o->h, zbuffer, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, NULL);
+        timer_add(&off, now_ms() - t1);
+        roomsValid = true;
+        t1 = now_ms();
+        sprite_render(pixels, o->w, o->h, zbuffer, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, &st);
+        timer_add(&on, now_ms() - t1);
+        culled += st.roomCulled;
+        if (memcmp(check, pixels, (size_t)o->w * o->h * sizeof(Uint32)) != 0) mismatched++;
+    }
+    printf("rooms %-18s %4dx%-4d rooms=%d portals=%d build=%.2fms pvs=%.1f%% "
+           "sprites avg=%.3fms (no cull %.3fms) culled/frame=%lld mismatched-frames=%ld\n",
+        label, mapW, mapH, roomCount, roomPortalCount / 2, buildMs,
+        roomCount ? 100.0 * visible / ((double)roomCount * roomCount) : 0.0,
+        on.frames ? on.total / on.frames : 0.0, off.frames ? off.total / off.frames : 0.0,
+        frames ? culled / frames : 0, mismatched);
+    sprite_reset();
+    free(cells);
+    free(check);
+}
+
+static void scene_rooms(const BenchOpts *o, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    if (o->mapPath) {
+        if (load_map_file(o->mapPath)) rooms_bench_map(o, o->mapPath, pixels, zbuffer, textures);
+        bench_load_map(o);
+        return;
+    }
+    DIR *d = opendir("maps");
+    if (d) {
+        struct dirent *ent;
+        while ((ent = readdir(d)) != NULL) {
+            size_t L = strlen(ent->d_name);
+            if (L <= 4 || strcmp(ent->d_name + L - 4, ".map") != 0) continue;
+            char path[512];
+            snprintf(path, sizeof(path), "maps/%s", ent->d_name);
+            if (load_map_file(path)) rooms_bench_map(o, path, pixels, zbuffer, textures);
+        }
+        closedir(d);
+    }
+    srand(o->seed);
+    mapW = mapH = 64;
+    load_default_map();
+    rooms_bench_map(o, "default-64", pixels, zbuffer, textures);
+    static const int sizes[] = { 128, 256 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char label[32];
+        snprintf(label, sizeof(label), "dungeon-%d", sizes[i]);
+        srand(o->seed);
+        bench_dungeon(sizes[i]);
+        rooms_bench_map(o, label, pixels, zbuffer, textures);
+    }
+    bench_load_map(o);
+}
+
+// the cached fields' costs, to hold the repaired ones against a rebuild
+static void nav_bench_snapshot(Uint32 *out, const int *gx, const int *gy) {
+    size_t cells = (size_t)mapW * mapH;
+    for (int g = 0; g < NAV_BENCH_GOALS; g++) {
+        const NavFlowField *nf = nav_flow_field(gx[g], gy[g]);
+        if (nf) memcpy(out + g * cells, nf->cost, sizeof(Uint32) * cells);
+        else memset(out + g * cells, 0, sizeof(Uint32) * cells);
+    }
+}
+
+// every field dropped and built again, timed; returns those that differ from snap
+static long nav_bench_rebuild(const Uint32 *snap, const int *gx, const int *gy, BenchTimer *t) {
+    size_t cells = (size_t)mapW * mapH;
+    double t0 = now_ms();
+    nav_reset();
+    for (int g = 0; g < NAV_BENCH_GOALS; g++) nav_flow_field_wait(gx[g], gy[g]);
+    timer_add(t, now_ms() - t0);
+    long bad = 0;
+    for (int g = 0; g < NAV_BENCH_GOALS; g++) {
+        const NavFlowField *nf = nav_flow_field(gx[g], gy[g]);
+        bad += !nf || memcmp(snap + g * cells, nf->cost, sizeof(Uint32) * cells) != 0;
+    }
+    return bad;
+}
+
+#define EDITS_BENCH_MAP 256     // arena size when no --map is given
+#define EDITS_BENCH_CLUSTERS 16 // the edits of a tick land around this many spots
+
+// --edits cell writes per tick, grouped like explosions and doors would be,
+// then the dirty rectangles are handed to light, the minimap and nav; timed
+// against rebuilding all three. The lightmap is checked against a fresh bake.
+static void scene_edits(const BenchOpts *o) {
+    jobs_init(o->threads);
+    nav_reset();
+    if (o->mapPath) {
+        if (!load_map_file(o->mapPath)) return;
+    } else {
+        // the arena, dimmed and lit every 16 cells so light updates have work to do
+        bench_arena(EDITS_BENCH_MAP);
+        mapAmbient = 4;
+        for (int y = 8; y < mapH && mapLightCount < MAX_MAP_LIGHTS; y += 16) {
+            for (int x = 8; x < mapW && mapLightCount < MAX_MAP_LIGHTS; x += 16) mapLights[mapLightCount++] = (MapLight){ x, y, 10 };
+        }
+    }
+    light_bake();
+    srand(o->seed);
+    int open = 0;
+    int *cells = bench_open_cells(&open);
+    Uint8 *check = malloc((size_t)mapW * mapH);
+    Uint32 *navCheck = malloc(sizeof(Uint32) * (size_t)mapW * mapH * NAV_BENCH_GOALS);
+    if (!cells || !check || !navCheck || open == 0) {
+        fprintf(stderr, "edits: allocation failed\n");
+        free(cells); free(check); free(navCheck);
+        return;
+    }
+    Minimap mm = {0};
+    minimap_update(&mm, 4);
+    int gx[NAV_BENCH_GOALS], gy[NAV_BENCH_GOALS];
+    for (int g = 0; g < NAV_BENCH_GOALS; g++) {
+        bench_pick(cells, open, &gx[g], &gy[g]);
+        nav_flow_field_wait(gx[g], gy[g]);
+    }
+    // a door: one cell shut per tick and opened again, the edit the nav
+    // repair is for, against rebuilding the fields after it
+    BenchTimer td = {0}, tdf = {0};
+    long doorMismatched = 0;
+    MapRect door[MAP_DIRTY_MAX];
+    for (int f = 0; f < o->frames; f++) {
+        int x, y;
+        bench_pick(cells, open, &x, &y);
+        bool goal = false;
+        for (int g = 0; g < NAV_BENCH_GOALS; g++) goal |= x == gx[g] && y == gy[g];
+        if (goal) continue;
+        for (int shut = 1; shut >= 0; shut--) {
+            map_set_cell(x, y, shut);
+            int n = map_take_dirty(door);
+            double t0 = now_ms();
+            nav_update_rects(door, n);
+            timer_add(&td, now_ms() - t0);
+            nav_bench_snapshot(navCheck, gx, gy);
+            doorMismatched += nav_bench_rebuild(navCheck, gx, gy, &tdf);
+        }
+    }
+    BenchTimer tw = {0}, ti = {0}, tn = {0}, tf = {0}, tnf = {0};
+    long long rects = 0, area = 0;
+    long mismatched = 0, navMismatched = 0;
+    MapRect dirty[MAP_DIRTY_MAX];
+    for (int f = 0; f < o->frames; f++) {
+        int cx[EDITS_BENCH_CLUSTERS], cy[EDITS_BENCH_CLUSTERS];
+        for (int c = 0; c < EDITS_BENCH_CLUSTERS; c++) bench_pick(cells, open, &cx[c], &cy[c]);
+        double t0 = now_ms();
+        for (int e = 0; e < o->edits; e++) {
+            int c = e % EDITS_BENCH_CLUSTERS;
+            int x = cx[c] + rand() % 9 - 4, y = cy[c] + rand() % 9 - 4;
+            // keep the border and the goals open
+            if (x <= 0 || y <= 0 || x >= mapW - 1 || y >= mapH - 1) continue;
+            bool goal = false;
+            for (int g = 0; g < NAV_BENCH_GOALS; g++) goal |= x == gx[g] && y == gy[g];
+            if (!goal) map_set_cell(x, y, MAP_AT(x, y) ? 0 : 1);
+        }
+        double t1 = now_ms();
+        int n = map_take_dirty(dirty);
+        for (int i = 0; i < n; i++) {
+            light_update_rect(dirty[i].x0, dirty[i].y0, dirty[i].x1, dirty[i].y1);
+            minimap_update_rect(&mm, dirty[i].x0, dirty[i].y0, dirty[i].x1, dirty[i].y1);
+            area += (long long)(dirty[i].x1 - dirty[i].x0 + 1) * (dirty[i].y1 - dirty[i].y0 + 1);
+        }
+        double t2 = now_ms();
+        nav_update_rects(dirty, n);
+        timer_add(&tw, t1 - t0);
+        timer_add(&ti, t2 - t1);
+        timer_add(&tn, now_ms() - t2);
+        rects += n;
+        nav_bench_snapshot(navCheck, gx, gy);
+        // what the same edits cost without the rectangles: everything rebuilt
+        memcpy(check, lightMap, (size_t)mapW * mapH);
+        double t3 = now_ms();
+        map_rebuild_occupancy();
+        light_bake();
+        minimap_update(&mm, 4);
+        timer_add(&tf, now_ms() - t3);
+        navMismatched += nav_bench_rebuild(navCheck, gx, gy, &tnf);
+        if (memcmp(check, lightMap, (size_t)mapW * mapH) != 0) mismatched++;
+    }
+    char extra[96];
+    snprintf(extra, sizeof(extra), "edits/tick=%d", o->edits);
+    timer_report("edit-write", o, &tw, extra);
+    snprintf(extra, sizeof(extra), "rects/tick=%.1f cells/tick=%lld light-mismatches=%ld",
+        (double)rects / o->frames, area / o->frames, mismatched);
+    timer_report("edit-inc", o, &ti, extra);
+    timer_report("edit-full", o, &tf, NULL);
+    // nav separately; the repaired fields are checked against the rebuilt ones
+    snprintf(extra, sizeof(extra), "fields=%d nav-mismatches=%ld", NAV_BENCH_GOALS, navMismatched);
+    timer_report("edit-nav", o, &tn, extra);
+    snprintf(extra, sizeof(extra), "fields=%d", NAV_BENCH_GOALS);
+    timer_report("edit-navfull", o, &tnf, extra);
+    snprintf(extra, sizeof(extra), "fields=%d nav-mismatches=%ld", NAV_BENCH_GOALS, doorMismatched);
+    timer_report("edit-navdoor", o, &td, extra);
+    snprintf(extra, sizeof(extra), "fields=%d speedup=%.1fx", NAV_BENCH_GOALS, td.total > 0.0 ? tdf.total / td.total : 0.0);
+    timer_report("edit-navdoorfull", o, &tdf, extra);
+    minimap_free(&mm);
+    nav_reset();
+    free(cells);
+    free(check);
+    free(navCheck);
+}
+
+// one camera sweep through render_world(); the frame is cleared to 0 first
+// (every real pixel is opaque) so rows the renderer skipped show up as holes
+static void heights_frame(const BenchOpts *o, int f, BenchTimer *t, Uint32 *pixels, float *zbuffer,
+    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H], long long *holes) {
+    BenchCam c = bench_camera(f, o->frames);
+    memset(pixels, 0, sizeof(Uint32) * (size_t)o->w * o->h);
+    double t0 = now_ms();
+    render_world(pixels, o->w, o->h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, zbuffer);
+    timer_add(t, now_ms() - t0);
+    for (int i = 0; i < o->w * o->h; i++) *holes += pixels[i] == 0;
+}
+
+static void heights_report(const char *scene, const BenchOpts *o, const BenchTimer *t, long long holes, const char *more) {
+    char extra[160];
+    double avg = t->frames ? t->total / t->frames : 0.0;
+    snprintf(extra, sizeof(extra), "ns/column=%.1f holes=%lld%s%s", avg * 1e6 / o->w, holes, more ? " " : "", more ? more : "");
+    timer_report(scene, o, t, extra);
+}
+
+// The single-height renderer against the height renderer on one map: first
+// with every cell at the default heights, so the two draw the same scene and
+// only the per-column walk differs, then with low walls, raised ceilings and
+// steps scattered over it so rays run on past the low walls.
+static void heights_map(const BenchOpts *o, const char *label, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    size_t n = (size_t)o->w * o->h;
+    Uint32 *ref = malloc(sizeof(Uint32) * n);
+    if (!ref || !map_heights_alloc()) { free(ref); return; }
+    MapHeight *heights = mapHeights;
+    BenchTimer tf = {0}, ts = {0}, tv = {0};
+    long long flatHoles = 0, sameHoles = 0, varHoles = 0, diff = 0;
+    for (int f = 0; f < o->frames; f++) {
+        mapHeights = NULL;
+        heights_frame(o, f, &tf, pixels, zbuffer, textures, &flatHoles);
+        memcpy(ref, pixels, sizeof(Uint32) * n);
+        mapHeights = heights;
+        heights_frame(o, f, &ts, pixels, zbuffer, textures, &sameHoles);
+        for (size_t i = 0; i < n; i++) diff += pixels[i] != ref[i];
+    }
+    srand(o->seed);
+    for (int y = 1; y < mapH - 1; y++) for (int x = 1; x < mapW - 1; x++) {
+        if (MAP_SOLID(x, y) && rand() % 3 == 0) map_set_heights(x, y, x, y, 0.0f, 1.0f, 0.2f + (rand() % 4) * 0.1f);
+    }
+    for (int y = 0; y < mapH; y += 8) for (int x = 0; x < mapW; x += 8) {
+        if (rand() % 3 == 0) for (int cy = y; cy < y + 8 && cy < mapH; cy++) for (int cx = x; cx < x + 8 && cx < mapW; cx++) {
+            MapHeight *h = &mapHeights[cx + mapW * cy];
+            h->ceil = 2.0f;
+            if (!MAP_SOLID(cx, cy)) h->floor = (cx + cy) % 5 == 0 ? 0.2f : 0.0f;
+        }
+    }
+    for (int f = 0; f < o->frames; f++) heights_frame(o, f, &tv, pixels, zbuffer, textures, &varHoles);
+    map_heights_clear();
+
+    char name[48], more[64];
+    snprintf(name, sizeof(name), "heights %s flat", label);
+    heights_report(name, o, &tf, flatHoles, NULL);
+    snprintf(name, sizeof(name), "heights %s same", label);
+    snprintf(more, sizeof(more), "differing=%.3f%%", o->frames ? 100.0 * diff / ((double)n * o->frames) : 0.0);
+    heights_report(name, o, &ts, sameHoles, more);
+    snprintf(name, sizeof(name), "heights %s varied", label);
+    heights_report(name, o, &tv, varHoles, NULL);
+    free(ref);
+}
+
+// A sprite behind a waist-high wall in the 64 arena, seen from a few points
+// along the wall: its upper half shows over the wall, and none of the pixels
+// the wall covers (those that change when it is taken away) may be painted.
+// Returns the wall pixels overdrawn; *shown counts the sprite pixels drawn.
+#define LOW_WALL_X 14
+static long long heights_sprite_check(const BenchOpts *o, Uint32 *pixels, float *zbuffer,
+    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H], long long *shown) {
+    size_t n = (size_t)o->w * o->h;
+    Uint32 *open = malloc(sizeof(Uint32) * n);
+    Uint32 *world = malloc(sizeof(Uint32) * n);
+    if (!open || !world || !map_heights_alloc()) { free(open); free(world); return -1; }
+    long long over = 0;
+    *shown = 0;
+    for (int f = 0; f < 8; f++) {
+        double posX = 11.5, posY = 30.5 + f * 0.5, side = (f % 3 - 1) * 0.4;
+        for (int y = 29; y <= 35; y++) worldMap[LOW_WALL_X + mapW * y] = 0;
+        map_rebuild_occupancy();
+        render_world(open, o->w, o->h, posX, posY, 1.0, 0.0, 0.0, 0.84, textures, zbuffer);
+        for (int y = 29; y <= 35; y++) {
+            worldMap[LOW_WALL_X + mapW * y] = 1;
+            map_set_heights(LOW_WALL_X, y, LOW_WALL_X, y, 0.0f, 1.0f, 0.3f);
+        }
+        map_rebuild_occupancy();
+        render_world(world, o->w, o->h, posX, posY, 1.0, 0.0, 0.0, 0.84, textures, zbuffer);
+        memcpy(pixels, world, sizeof(Uint32) * n);
+        sprite_reset();
+        sprite_spawn(LOW_WALL_X + 2.5, posY + side, f & 1);
+        sprite_render(pixels, o->w, o->h, zbuffer, posX, posY, 1.0, 0.0, 0.0, 0.84, NULL);
+        for (size_t i = 0; i < n; i++) {
+            if (pixels[i] == world[i]) continue;
+            (*shown)++;
+            over += world[i] != open[i];
+        }
+    }
+    for (int y = 29; y <= 35; y++) worldMap[LOW_WALL_X + mapW * y] = 0;
+    map_rebuild_occupancy();
+    map_heights_clear();
+    sprite_reset();
+    free(open);
+    free(world);
+    return over;
+}
+
+static void scene_heights(const BenchOpts *o, Uint32 *pixels, float *zbuffer, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    if (!bench_load_map(o)) return;
+    heights_map(o, o->mapPath ? o->mapPath : "default", pixels, zbuffer, textures);
+    bench_arena(64);
+    heights_map(o, "arena-64", pixels, zbuffer, textures);
+    long long shown = 0, over = heights_sprite_check(o, pixels, zbuffer, textures, &shown);
+    printf("heights sprite-behind-low-wall  sprite-pixels=%lld wall-pixels-overdrawn=%lld\n", shown, over);
+    bench_load_map(o);
+}
+
+// The same camera path drawn straight into rows, and into columns followed by
+// the transpose to rows, at a range of resolutions; the two results are
+// compared pixel for pixel.
+static void scene_layout(const BenchOpts *o, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    static const int sizes[][2] = { { 320, 200 }, { 640, 480 }, { 1024, 768 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        BenchOpts so = *o;
+        so.w = sizes[i][0];
+        so.h = sizes[i][1];
+        size_t n = (size_t)so.w * so.h;
+        Uint32 *rows = malloc(sizeof(Uint32) * n), *cols = malloc(sizeof(Uint32) * n), *out = malloc(sizeof(Uint32) * n);
+        float *z = malloc(sizeof(float) * (size_t)so.w);
+        if (!rows || !cols || !out || !z) {
+            printf("layout %dx%d: out of memory\n", so.w, so.h);
+            free(rows); free(cols); free(out); free(z);
+            continue;
+        }
+        BenchTimer tr = {0}, tc = {0}, tt = {0};
+        long long diff = 0;
+        for (int f = 0; f < o->frames; f++) {
+            BenchCam c = bench_camera(f, o->frames);
+            double t0 = now_ms();
+            render_world(rows, so.w, so.h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, z);
+            double t1 = now_ms();
+            render_world_columns(cols, so.w, so.h, c.posX, c.posY, c.dirX, c.dirY, c.planeX, c.planeY, textures, z);
+            double t2 = now_ms();
+            render_transpose(out, so.w, cols, so.w, so.h);
+            double t3 = now_ms();
+            timer_add(&tr, t1 - t0);
+            timer_add(&tc, t2 - t1);
+            timer_add(&tt, t3 - t2);
+            for (size_t k = 0; k < n; k++) diff += out[k] != rows[k];
+        }
+        char extra[128];
+        snprintf(extra, sizeof(extra), "transpose=%.3fms with-transpose=%.3fms differing=%lld",
+            tt.total / o->frames, (tc.total + tt.total) / o->frames, diff);
+        timer_report("layout-row", &so, &tr, NULL);
+        timer_report("layout-col", &so, &tc, extra);
+        free(rows); free(cols); free(out); free(z);
+    }
+}
+
+static void usage(const char *argv0) {
+    printf("Usage: %s [--scene world|views|capture|sprites|rays|nav|edits|rooms|heights|layout|all] [--map PATH] [--mapsize N] [--size WxH]\n"
+           "          [--frames N] [--entities N] [--arena N] [--rays N] [--paths N] [--threads N] [--seed N]\n"
+           "          [--edits N] [--interlace]\n"
+           "--interlace also times the world scene in the interlaced render mode.\n"
+           "--edits sets the cell writes per tick in the edits scene (default 4096).\n"
+           "Without --map the sprites scene runs in an open NxN arena (default 192), the nav\n"
+           "scene walks every maps/*.map plus generated 256, 512 and 1024 maps, the rooms scene\n"
+           "every maps/*.map, a generated 64 map and 128 and 256 grid dungeons, and the edits\n"
+           "scene a lit 256x256 arena. The heights scene runs on the map and a 64x64 arena.\n"
+           "The layout scene ignores --size and times row- against column-major frames from\n"
+           "320x200 to 3840x2160.\n", argv0);
+}
+
+int main(int argc, char *argv[]) {
+    BenchOpts o = { "all", NULL, 64, 1024, 768, 300, 10000, 192, 1 << 20, 4096, -1, 4096, false, 1 };
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(a, "--scene") == 0 && v) { o.scene = v; i++; }
+        else if (strcmp(a, "--map") == 0 && v) { o.mapPath = v; i++; }
+        else if (strcmp(a, "--mapsize") == 0 && v) { o.mapSize = atoi(v); i++; }
+        else if (strcmp(a, "--size") == 0 && v) { if (sscanf(v, "%dx%d", &o.w, &o.h) != 2) { usage(argv[0]); return 1; } i++; }
+        else if (strcmp(a, "--frames") == 0 && v) { o.frames = atoi(v); i++; }
+        else if (strcmp(a, "--entities") == 0 && v) { o.entities = atoi(v); i++; }
+        else if (strcmp(a, "--arena") == 0 && v) { o.arenaSize = atoi(v); i++; }
+        else if (strcmp(a, "--rays") == 0 && v) { o.rays = atoi(v); i++; }
+        else if (strcmp(a, "--paths") == 0 && v) { o.paths = atoi(v); i++; }
+        else if (strcmp(a, "--threads") == 0 && v) { o.threads = atoi(v); i++; }
+        else if (strcmp(a, "--edits") == 0 && v) { o.edits = atoi(v); i++; }
+        else if (strcmp(a, "--interlace") == 0) { o.interlace = true; }
+        else if (strcmp(a, "--seed") == 0 && v) { o.seed = (unsigned int)strtoul(v, NULL, 10); i++; }
+        else { usage(argv[0]); return strcmp(a, "--help") == 0 ? 0 : 1; }
+    }
+    if (o.w <= 0 || o.h <= 0 || o.frames <= 0 || o.mapSize < 8 || o.arenaSize < 8 || o.rays <= 0 || o.paths <= 0 || o.edits <= 0) { usage(argv[0]); return 1; }
+    if (!bench_load_map(&o)) return 1;
+
+    static Uint32 textures[4][GAME_TEX_W * GAME_TEX_H];
+    init_textures(textures);
+    Uint32 *pixels = malloc((size_t)o.w * o.h * sizeof(Uint32));
+    float *zbuffer = malloc((size_t)o.w * sizeof(float));
+    if (!pixels || !zbuffer) { fprintf(stderr, "failed to allocate %dx%d frame\n", o.w, o.h); return 1; }
+
+    bool all = strcmp(o.scene, "all") == 0;
+    bool ran = false;
+    if (all || strcmp(o.scene, "world") == 0) { scene_world(&o, pixels, zbuffer, textures); ran = true; }
+    if (all || strcmp(o.scene, "views") == 0) { scene_views(&o, pixels, zbuffer, textures); ran = true; }
+    if (all || strcmp(o.scene, "capture") == 0) { scene_capture(&o, pixels, zbuffer, textures); ran = true; }
+    if (all || strcmp(o.scene, "sprites") == 0) { scene_sprites(&o, pixels, zbuffer, textures); ran = true; }
+    if (all || strcmp(o.scene, "rays") == 0) { scene_rays(&o); ran = true; }
+    if (all || strcmp(o.scene, "nav") == 0) { scene_nav(&o); ran = true; }
+    if (all || strcmp(o.scene, "edits") == 0) { scene_edits(&o); ran = true; }
+    if (all || strcmp(o.scene, "rooms") == 0) { scene_rooms(&o, pixels, zbuffer, textures); ran = true; }
+    if (all || strcmp(o.scene, "heights") == 0) { scene_heights(&o, pixels, zbuffer, textures); ran = true; }
+    if (all || strcmp(o.scene, "layout") == 0) { scene_layout(&o, textures); ran = true; }
+    if (!ran) { fprintf(stderr, "unknown scene '%s'\n", o.scene); usage(argv[0]); }
+
+    nav_shutdown();
+    jobs_shutdown();
+    free(pixels);
+    free(zbuffer);
+    mem_free(worldMap);
+    return ran ? 0 : 1;
+}
@@ -0,0 +1,353 @@
+// Headless map editor benchmark: the editor's core operations on generated
+// maps from 64x64 up, without a window or an event loop, reported as JSON.
+//
+// Schema (EDITOR_BENCH_SCHEMA, bumped on any incompatible change):
+//   { "schema": 1, "bench": "map_editor", "seed": N, "complexity": N,
+//     "runs": N, "results": [ { "width": N, "height": N, "op": "...",
+//     "runs": N, "avg_ms": F, "min_ms": F, "max_ms": F, "cells": N,
+//     "bytes": N }, ... ] }
+// One result per map size and op. "runs" counts the timed calls; "cells" is
+// what one call covered (cells changed, drawn or written) and "bytes" what it
+// produced (file size, undo history); either is 0 where it means nothing.
+// Ops: generate.<stage> for each bsp_generate() stage and generate.total;
+// edit.rect, edit.undo and edit.redo; edit.stroke.b1 and edit.stroke.b8;
+// file.save, file.load and file.save_async (the time the editor waits on a
+// background save) for the text format, the same with a ".rle" suffix for the
+// run-length one; draw.grid.
+#include <SDL2/SDL.h>
+#include "bsp_gen.h"
+#include "edit.h"
+#include "edit_draw.h"
+#include "edit_io.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EDITOR_BENCH_SCHEMA 1
+#define EDITOR_BENCH_MAX_SIZES 16
+#define EDITOR_BENCH_RECTS 64    // undoable operations timed per run
+#define EDITOR_BENCH_SEGMENTS 16 // long Bresenham segments per stroke
+#define EDITOR_BENCH_CELL 32     // the editor's cell size in pixels
+#define EDITOR_BENCH_VIEW_W 1920 // largest window the grid is drawn into
+#define EDITOR_BENCH_VIEW_H 1080
+
+typedef struct EditorBenchOpts {
+    int sizes[EDITOR_BENCH_MAX_SIZES];
+    int sizeCount;
+    int runs;
+    int complexity;
+    unsigned int seed;
+    const char *outPath;
+    const char *filePath; // scratch map for save and load
+} EditorBenchOpts;
+
+typedef struct BenchTimer {
+    double total, min, max;
+    int frames;
+} BenchTimer;
+
+typedef struct BenchResult {
+    int w, h;
+    char op[32];
+    BenchTimer t;
+    long long cells;
+    long long bytes;
+} BenchResult;
+
+static BenchResult *results = NULL;
+static int resultCount = 0, resultCap = 0;
+
+static double now_ms(void) {
+    return (double)SDL_GetPerformanceCounter() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static void timer_add(BenchTimer *t, double ms) {
+    if (t->frames == 0 || ms < t->min) t->min = ms;
+    if (t->frames == 0 || ms > t->max) t->max = ms;
+    t->total += ms;
+    t->frames++;
+}
+
+static void result_add(int w, int h, const char *op, const BenchTimer *t, long long cells, long long bytes) {
+    if (resultCount == resultCap) {
+        int cap = resultCap ? resultCap * 2 : 64;
+        BenchResult *r = realloc(results, sizeof(BenchResult) * (size_t)cap);
+        if (!r) return;
+        results = r;
+        resultCap = cap;
+    }
+    BenchResult *r = &results[resultCount++];
+    r->w = w;
+    r->h = h;
+    snprintf(r->op, sizeof(r->op), "%s", op);
+    r->t = *t;
+    r->cells = cells;
+    r->bytes = bytes;
+    double avg = t->frames ? t->total / t->frames : 0.0;
+    fprintf(stderr, "%5dx%-5d %-18s runs=%-3d avg=%.3fms min=%.3fms max=%.3fms cells=%lld bytes=%lld\n",
+        w, h, op, t->frames, avg, t->min, t->max, cells, bytes);
+}
+
+static bool write_json(FILE *f, const EditorBenchOpts *o) {
+    fprintf(f, "{\n  \"schema\": %d,\n  \"bench\": \"map_editor\",\n  \"seed\": %u,\n  \"complexity\": %d,\n  \"runs\": %d,\n  \"results\": [",
+        EDITOR_BENCH_SCHEMA, o->seed, o->complexity, o->runs);
+    for (int i = 0; i < resultCount; i++) {
+        const BenchResult *r = &results[i];
+        double avg = r->t.frames ? r->t.total / r->t.frames : 0.0;
+        fprintf(f, "%s\n    { \"width\": %d, \"height\": %d, \"op\": \"%s\", \"runs\": %d, \"avg_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f, \"cells\": %lld, \"bytes\": %lld }",
+            i ? "," : "", r->w, r->h, r->op, r->t.frames, avg, r->t.min, r->t.max, r->cells, r->bytes);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return !ferror(f);
+}
+
+typedef struct GenTiming {
+    double last;
+    double stage[BSP_DONE + 1];
+} GenTiming;
+
+// time since the previous report goes to the stage just reported
+static bool gen_progress(void *ctx, BspStage stage, const int *cells, int W, int H) {
+    (void)cells; (void)W; (void)H;
+    GenTiming *g = ctx;
+    double t = now_ms();
+    g->stage[stage] += t - g->last;
+    g->last = t;
+    return true;
+}
+
+// runs generations with consecutive seeds; the last map is kept in *out
+static bool bench_generate(const EditorBenchOpts *o, int size, BspMap *out) {
+    BenchTimer stages[BSP_DONE + 1] = {0}, total = {0};
+    out->cells = NULL;
+    for (int r = 0; r < o->runs; r++) {
+        GenTiming g = {0};
+        double t0 = g.last = now_ms();
+        BspMap m;
+        if (!bsp_generate(&m, size, size, o->complexity, o->seed + (unsigned)r, gen_progress, &g)) {
+            fprintf(stderr, "generate %dx%d failed\n", size, size);
+            bsp_map_free(out);
+            return false;
+        }
+        timer_add(&total, now_ms() - t0);
+        for (int s = 0; s <= BSP_DONE; s++) timer_add(&stages[s], g.stage[s]);
+        bsp_map_free(out);
+        *out = m;
+    }
+    for (int s = 0; s <= BSP_DONE; s++) {
+        char op[32];
+        // the final pass marks the walls next to floors
+        snprintf(op, sizeof(op), "generate.%s", s == BSP_DONE ? "walls" : bsp_stage_name((BspStage)s));
+        result_add(size, size, op, &stages[s], 0, 0);
+    }
+    result_add(size, size, "generate.total", &total, (long long)size * size, 0);
+    return true;
+}
+
+// undoable rectangle fills, then every one undone and redone
+static void bench_undo(const EditorBenchOpts *o, EditMap *em) {
+    BenchTimer tr = {0}, tu = {0}, tre = {0};
+    long long changed = 0;
+    size_t bytes = 0;
+    for (int r = 0; r < o->runs; r++) {
+        edit_history_free();
+        for (int i = 0; i < EDITOR_BENCH_RECTS; i++) {
+            int x0 = rand() % em->W, y0 = rand() % em->H;
+            int x1 = x0 + rand() % (em->W / 8 + 1), y1 = y0 + rand() % (em->H / 8 + 1);
+            double t0 = now_ms();
+            changed += edit_fill_rect(em, x0, y0, x1, y1, i % 4);
+            timer_add(&tr, now_ms() - t0);
+        }
+        bytes = edit_history_bytes();
+        for (int i = 0; i < EDITOR_BENCH_RECTS; i++) {
+            double t0 = now_ms();
+            edit_undo(em);
+            timer_add(&tu, now_ms() - t0);
+        }
+        for (int i = 0; i < EDITOR_BENCH_RECTS; i++) {
+            double t0 = now_ms();
+            edit_redo(em);
+            timer_add(&tre, now_ms() - t0);
+        }
+        // back to the generated map for the next run
+        while (edit_undo(em)) {}
+    }
+    long long perOp = tr.frames ? changed / tr.frames : 0;
+    result_add(em->W, em->H, "edit.rect", &tr, perOp, (long long)bytes);
+    result_add(em->W, em->H, "edit.undo", &tu, perOp, 0);
+    result_add(em->W, em->H, "edit.redo", &tre, perOp, 0);
+    edit_history_free();
+}
+
+// one drag of the paint tool along long segments between random points, as
+// the editor does it: brush down, edit_stroke() per motion, one undo entry
+static void bench_stroke(const EditorBenchOpts *o, EditMap *em, int brush) {
+    BenchTimer t = {0};
+    long long changed = 0;
+    for (int r = 0; r < o->runs; r++) {
+        int x = rand() % em->W, y = rand() % em->H;
+        double t0 = now_ms();
+        edit_begin(em);
+        int n = edit_brush(em, x, y, brush, 4);
+        for (int s = 0; s < EDITOR_BENCH_SEGMENTS; s++) {
+            int nx = rand() % em->W, ny = rand() % em->H;
+            n += edit_stroke(em, x, y, nx, ny, brush, 4);
+            x = nx;
+            y = ny;
+        }
+        edit_end(em);
+        timer_add(&t, now_ms() - t0);
+        changed += n;
+        edit_undo(em);
+    }
+    char op[32];
+    snprintf(op, sizeof(op), "edit.stroke.b%d", brush);
+    result_add(em->W, em->H, op, &t, t.frames ? changed / t.frames : 0, 0);
+    edit_history_free();
+}
+
+// one format: synchronous save and load, then how long edit_save_start()
+// holds the caller (the copy it takes) while the write goes on elsewhere
+static void bench_file_format(const EditorBenchOpts *o, EditMap *em, EditDoc *doc, const char *suffix) {
+    BenchTimer ts = {0}, tl = {0}, ta = {0};
+    long long bytes = 0;
+    for (int r = 0; r < o->runs; r++) {
+        double t0 = now_ms();
+        if (!edit_save(o->filePath, em, doc)) { fprintf(stderr, "cannot write %s\n", o->filePath); return; }
+        timer_add(&ts, now_ms() - t0);
+    }
+    FILE *f = fopen(o->filePath, "rb");
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        bytes = ftell(f);
+        fclose(f);
+    }
+    EditMap loaded = { NULL, 0, 0 };
+    EditDoc loadedDoc = { .roomCount = 0, .extra = NULL };
+    bool same = true;
+    for (int r = 0; r < o->runs; r++) {
+        double t0 = now_ms();
+        if (!edit_load(o->filePath, &loaded, &loadedDoc)) { same = false; break; }
+        timer_add(&tl, now_ms() - t0);
+    }
+    if (!same || loaded.W != em->W || loaded.H != em->H || memcmp(loaded.cells, em->cells, sizeof(int) * (size_t)em->W * em->H) != 0
+        || loadedDoc.format != doc->format || loadedDoc.roomCount != doc->roomCount) {
+        fprintf(stderr, "%s did not load back as saved\n", o->filePath);
+    }
+    for (int r = 0; r < o->runs; r++) {
+        double t0 = now_ms();
+        EditSave *s = edit_save_start(o->filePath, em, doc);
+        timer_add(&ta, now_ms() - t0);
+        if (!s || !edit_save_finish(s)) { fprintf(stderr, "cannot write %s in the background\n", o->filePath); break; }
+    }
+    char op[32];
+    snprintf(op, sizeof(op), "file.save%s", suffix);
+    result_add(em->W, em->H, op, &ts, (long long)em->W * em->H, bytes);
+    snprintf(op, sizeof(op), "file.load%s", suffix);
+    result_add(em->W, em->H, op, &tl, (long long)em->W * em->H, bytes);
+    snprintf(op, sizeof(op), "file.save_async%s", suffix);
+    result_add(em->W, em->H, op, &ta, (long long)em->W * em->H, bytes);
+    free(loaded.cells);
+    edit_doc_free(&loadedDoc);
+}
+
+static void bench_file(const EditorBenchOpts *o, EditMap *em, const BspMap *gen) {
+    EditDoc doc = { .roomCount = gen->roomCount, .extra = NULL, .format = EDIT_FORMAT_TEXT };
+    memcpy(doc.rooms, gen->rooms, sizeof(BspRoom) * (size_t)gen->roomCount);
+    bench_file_format(o, em, &doc, "");
+    doc.format = EDIT_FORMAT_RLE;
+    bench_file_format(o, em, &doc, ".rle");
+    edit_doc_free(&doc);
+    remove(o->filePath);
+}
+
+// the editor's redraw into a software renderer, in the window the editor
+// opens for the map (EDITOR_BENCH_CELL pixels per cell) up to 1920x1080
+static void bench_draw(const EditorBenchOpts *o, const EditMap *em) {
+    int vw = em->W * EDITOR_BENCH_CELL < EDITOR_BENCH_VIEW_W ? em->W * EDITOR_BENCH_CELL : EDITOR_BENCH_VIEW_W;
+    int vh = em->H * EDITOR_BENCH_CELL < EDITOR_BENCH_VIEW_H ? em->H * EDITOR_BENCH_CELL : EDITOR_BENCH_VIEW_H;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, vw, vh, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *ren = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if (!ren) {
+        fprintf(stderr, "no software renderer: %s\n", SDL_GetError());
+        if (surface) SDL_FreeSurface(surface);
+        return;
+    }
+    int cols = vw / EDITOR_BENCH_CELL, rows = vh / EDITOR_BENCH_CELL;
+    BenchTimer t = {0};
+    for (int r = 0; r < o->runs; r++) {
+        double t0 = now_ms();
+        SDL_SetRenderDrawColor(ren, 32,32,32,255);
+        SDL_RenderClear(ren);
+        edit_draw_grid(ren, em->cells, em->W, em->H, cols, rows, EDITOR_BENCH_CELL);
+        SDL_RenderPresent(ren);
+        timer_add(&t, now_ms() - t0);
+    }
+    result_add(em->W, em->H, "draw.grid", &t, (long long)cols * rows, 0);
+    SDL_DestroyRenderer(ren);
+    SDL_FreeSurface(surface);
+}
+
+static void bench_size(const EditorBenchOpts *o, int size) {
+    BspMap gen;
+    if (!bench_generate(o, size, &gen)) return;
+    // the editor owns its cells; keep the generated map for the file rooms
+    EditMap em = { malloc(sizeof(int) * (size_t)size * size), size, size };
+    if (!em.cells) { fprintf(stderr, "out of memory at %dx%d\n", size, size); bsp_map_free(&gen); return; }
+    memcpy(em.cells, gen.cells, sizeof(int) * (size_t)size * size);
+    srand(o->seed);
+    bench_undo(o, &em);
+    bench_stroke(o, &em, 1);
+    bench_stroke(o, &em, 8);
+    bench_file(o, &em, &gen);
+    bench_draw(o, &em);
+    free(em.cells);
+    bsp_map_free(&gen);
+}
+
+static bool parse_sizes(EditorBenchOpts *o, const char *v) {
+    o->sizeCount = 0;
+    while (*v && o->sizeCount < EDITOR_BENCH_MAX_SIZES) {
+        char *end;
+        long n = strtol(v, &end, 10);
+        if (end == v || n < 8 || n > 16384) return false;
+        o->sizes[o->sizeCount++] = (int)n;
+        v = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return false;
+    }
+    return o->sizeCount > 0;
+}
+
+static void usage(const char *argv0) {
+    printf("Usage: %s [--sizes N,N,...] [--runs N] [--complexity N] [--seed N] [--out FILE] [--file PATH]\n"
+           "Times map generation by stage, undo/redo, brush strokes, save/load and the grid\n"
+           "redraw on square maps (default 64,256,1024,4096,8192) and writes JSON to FILE\n"
+           "(default stdout); a readable line per result goes to stderr. --file is the\n"
+           "scratch map written and read back (default editor_bench.tmp.map).\n", argv0);
+}
+
+int main(int argc, char *argv[]) {
+    EditorBenchOpts o = { { 64, 256, 1024, 4096, 8192 }, 5, 3, 8, 1, NULL, "editor_bench.tmp.map" };
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(a, "--sizes") == 0 && v) { if (!parse_sizes(&o, v)) { usage(argv[0]); return 1; } i++; }
+        else if (strcmp(a, "--runs") == 0 && v) { o.runs = atoi(v); i++; }
+        else if (strcmp(a, "--complexity") == 0 && v) { o.complexity = atoi(v); i++; }
+        else if (strcmp(a, "--seed") == 0 && v) { o.seed = (unsigned int)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "--out") == 0 && v) { o.outPath = v; i++; }
+        else if (strcmp(a, "--file") == 0 && v) { o.filePath = v; i++; }
+        else { usage(argv[0]); return strcmp(a, "--help") == 0 ? 0 : 1; }
+    }
+    if (o.runs <= 0 || o.complexity <= 0) { usage(argv[0]); return 1; }
+
+    for (int i = 0; i < o.sizeCount; i++) bench_size(&o, o.sizes[i]);
+
+    FILE *out = o.outPath ? fopen(o.outPath, "w") : stdout;
+    if (!out) { fprintf(stderr, "cannot write %s\n", o.outPath); free(results); return 1; }
+    bool ok = write_json(out, &o);
+    if (out != stdout && fclose(out) != 0) ok = false;
+    free(results);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+#include "bsp_gen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+#define BSP_MAX_NODES 512
+#define BSP_PUBLISH_MS 33 // a job copies out a preview at most this often within a stage
+
+// BSP node type used by generator
+typedef struct BSPNode { int x,y,w,h; int left,right; int roomx,roomy,roomw,roomh; } BSPNode;
+
+// xorshift, one stream per generation so parallel jobs don't share libc's;
+// non-negative like rand()
+static int bsp_rand(Uint32 *state) {
+    Uint32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (int)(x >> 1);
+}
+
+static int find_center_x(BSPNode *nodes, int idx) {
+    if (idx < 0) return 0;
+    if (nodes[idx].left == -1 && nodes[idx].right == -1) return nodes[idx].roomx + nodes[idx].roomw/2;
+    if (nodes[idx].left != -1) return find_center_x(nodes, nodes[idx].left);
+    if (nodes[idx].right != -1) return find_center_x(nodes, nodes[idx].right);
+    return nodes[idx].x + nodes[idx].w/2;
+}
+static int find_center_y(BSPNode *nodes, int idx) {
+    if (idx < 0) return 0;
+    if (nodes[idx].left == -1 && nodes[idx].right == -1) return nodes[idx].roomy + nodes[idx].roomh/2;
+    if (nodes[idx].left != -1) return find_center_y(nodes, nodes[idx].left);
+    if (nodes[idx].right != -1) return find_center_y(nodes, nodes[idx].right);
+    return nodes[idx].y + nodes[idx].h/2;
+}
+
+const char *bsp_stage_name(BspStage stage) {
+    static const char *names[] = { "splits", "rooms", "corridors", "smoothing", "done" };
+    return (unsigned)stage <= BSP_DONE ? names[stage] : "?";
+}
+
+void bsp_map_free(BspMap *m) {
+    free(m->cells);
+    m->cells = NULL;
+    m->roomCount = 0;
+}
+
+#define REPORT(stage) do { if (progress && !progress(ctx, (stage), m, W, H)) goto cancelled; } while (0)
+
+bool bsp_generate(BspMap *out, int W, int H, int complexity, Uint32 seed, BspProgressFn progress, void *ctx) {
+    out->cells = NULL;
+    out->roomCount = 0;
+    int *m = malloc(sizeof(int) * W * H);
+    if (!m) return false;
+    for (int i=0;i<W*H;i++) m[i] = 1;
+    BSPNode nodes[BSP_MAX_NODES]; int ncount = 0;
+    nodes[ncount++] = (BSPNode){1,1,W-2,H-2,-1,-1,0,0,0,0};
+    Uint32 rng = seed ? seed : 0x9E3779B9u;
+
+    // split nodes into a BSP tree
+    for (int it=0; it<complexity && ncount + 2 <= BSP_MAX_NODES; ++it) {
+        // pick random leaf
+        int sel = -1, leaves = 0;
+        for (int i=0;i<ncount;i++) if (nodes[i].left == -1 && nodes[i].right == -1) { if (bsp_rand(&rng) % ++leaves == 0) sel = i; }
+        if (sel == -1) break;
+        BSPNode nd = nodes[sel];
+        if (nd.w < 6 && nd.h < 6) continue;
+        bool splitH = (nd.h > nd.w);
+        if (nd.w > nd.h && nd.w > 12) splitH = false;
+        if (nd.h > nd.w && nd.h > 12) splitH = true;
+        if (splitH) {
+            int minSplit = 3, maxSplit = nd.h - 3;
+            if (maxSplit <= minSplit) continue;
+            int s = minSplit + bsp_rand(&rng) % (maxSplit - minSplit + 1);
+            // top and bottom
+            nodes[ncount] = (BSPNode){nd.x, nd.y, nd.w, s, -1,-1,0,0,0,0};
+            nodes[ncount+1] = (BSPNode){nd.x, nd.y + s, nd.w, nd.h - s, -1,-1,0,0,0,0};
+            nodes[sel].left = ncount; nodes[sel].right = ncount+1; ncount += 2;
+        } else {
+            int minSplit = 3, maxSplit = nd.w - 3;
+            if (maxSplit <= minSplit) continue;
+            int s = minSplit + bsp_rand(&rng) % (maxSplit - minSplit + 1);
+            nodes[ncount] = (BSPNode){nd.x, nd.y, s, nd.h, -1,-1,0,0,0,0};
+            nodes[ncount+1] = (BSPNode){nd.x + s, nd.y, nd.w - s, nd.h, -1,-1,0,0,0,0};
+            nodes[sel].left = ncount; nodes[sel].right = ncount+1; ncount += 2;
+        }
+    }
+    if (progress) {
+        // preview of the partition: each leaf open, with a wall along its far edges
+        for (int i=0;i<ncount;i++) if (nodes[i].left == -1 && nodes[i].right == -1) {
+            for (int y=nodes[i].y;y<nodes[i].y+nodes[i].h-1 && y<H-1;y++) for (int x=nodes[i].x;x<nodes[i].x+nodes[i].w-1 && x<W-1;x++) m[x + W*y] = 0;
+        }
+        REPORT(BSP_SPLITS);
+        for (int i=0;i<W*H;i++) m[i] = 1;
+    }
+
+    // create rooms in leaves (ellipse rooms to avoid strict rectangles)
+    for (int i=0;i<ncount;i++) if (nodes[i].left == -1 && nodes[i].right == -1) {
+        BSPNode *nd = &nodes[i];
+        int rw = max(3, nd->w - 2);
+        int rh = max(3, nd->h - 2);
+        int rx = nd->x + 1 + (bsp_rand(&rng) % (rw));
+        int ry = nd->y + 1 + (bsp_rand(&rng) % (rh));
+        int rw2 = (rw>3)?(3 + bsp_rand(&rng)%(rw-2)):rw;
+        int rh2 = (rh>3)?(3 + bsp_rand(&rng)%(rh-2)):rh;
+        if (rx + rw2 >= W-1) rw2 = W-2 - rx;
+        if (ry + rh2 >= H-1) rh2 = H-2 - ry;
+        nd->roomx = rx; nd->roomy = ry; nd->roomw = rw2; nd->roomh = rh2;
+        if (out->roomCount < BSP_MAX_ROOMS && rw2 > 0 && rh2 > 0) out->rooms[out->roomCount++] = (BspRoom){ rx, ry, rx + rw2 - 1, ry + rh2 - 1 };
+        // carve an ellipse rather than a rectangle
+        double rxr = rw2 / 2.0; double ryr = rh2 / 2.0;
+        double cx = rx + rxr; double cy = ry + ryr;
+        for (int y=ry;y<ry+rh2;y++) for (int x=rx;x<rx+rw2;x++) {
+            double dx = (x + 0.5 - cx) / (rxr > 0 ? rxr : 1.0);
+            double dy = (y + 0.5 - cy) / (ryr > 0 ? ryr : 1.0);
+            if (dx*dx + dy*dy <= 1.0) m[x + W*y] = 0;
+        }
+        REPORT(BSP_ROOMS);
+    }
+
+    // connect rooms by walking internal nodes
+    for (int i=0;i<ncount;i++) {
+        if (nodes[i].left != -1 && nodes[i].right != -1) {
+            int x1 = find_center_x(nodes, nodes[i].left);
+            int y1 = find_center_y(nodes, nodes[i].left);
+            int x2 = find_center_x(nodes, nodes[i].right);
+            int y2 = find_center_y(nodes, nodes[i].right);
+            int cx = x1, cy = y1;
+            while (cx != x2) { m[cx + W*cy] = 0; cx += (x2>cx)?1:-1; }
+            while (cy != y2) { m[cx + W*cy] = 0; cy += (y2>cy)?1:-1; }
+        }
+    }
+    REPORT(BSP_CORRIDORS);
+
+    // apply cellular automata smoothing to reduce boxiness; two grids trade
+    // places each pass instead of a fresh one per pass
+    int *spare = malloc(sizeof(int) * W * H);
+    for (int pass = 0; spare && pass < BSP_SMOOTH_PASSES; pass++) {
+        for (int x=0;x<W;x++) { spare[x] = m[x]; spare[x + W*(H-1)] = m[x + W*(H-1)]; }
+        for (int y=0;y<H;y++) { spare[W*y] = m[W*y]; spare[W-1 + W*y] = m[W-1 + W*y]; }
+        for (int y=1;y<H-1;y++) for (int x=1;x<W-1;x++) {
+            int floors = 0;
+            for (int yy=-1; yy<=1; yy++) for (int xx=-1; xx<=1; xx++) if (m[(x+xx) + W*(y+yy)] == 0) floors++;
+            // if many neighboring floors, become floor; else wall
+            if (floors >= 5) spare[x + W*y] = 0; else spare[x + W*y] = 1;
+        }
+        int *t = m; m = spare; spare = t;
+        if (progress && !progress(ctx, BSP_SMOOTH, m, W, H)) { free(spare); goto cancelled; }
+    }
+    free(spare);
+
+    // mark walls adjacent to floors as colored variants
+    for (int y=1;y<H-1;y++) for (int x=1;x<W-1;x++) {
+        if (m[x + W*y] == 1) {
+            bool adj = false; for (int yy=-1;yy<=1 && !adj;yy++) for (int xx=-1;xx<=1 && !adj;xx++) if (m[(x+xx) + W*(y+yy)] == 0) adj = true;
+            if (adj) m[x + W*y] = ((x/6 + y/6) % 3) + 1;
+        }
+    }
+    REPORT(BSP_DONE);
+    out->W = W;
+    out->H = H;
+    out->cells = m;
+    return true;
+
+cancelled:
+    free(m);
+    out->roomCount = 0;
+    return false;
+}
+
+#undef REPORT
+
+struct BspJob {
+    SDL_Thread *thread;
+    SDL_atomic_t cancel;
+    SDL_atomic_t done;
+    int W, H, complexity;
+    Uint32 seed;
+    // guarded by lock
+    SDL_mutex *lock;
+    int *preview;
+    unsigned version;
+    BspStage stage;
+    BspMap result;
+    bool ok;
+    // worker only
+    Uint32 lastPublish;
+};
+
+static bool job_progress(void *ctx, BspStage stage, const int *cells, int W, int H) {
+    BspJob *j = ctx;
+    if (SDL_AtomicGet(&j->cancel)) return false;
+    // a new stage is always shown; within one, previews are rate limited
+    Uint32 now = SDL_GetTicks();
+    if (j->version > 0 && stage == j->stage && stage != BSP_DONE && now - j->lastPublish < BSP_PUBLISH_MS) return true;
+    SDL_LockMutex(j->lock);
+    memcpy(j->preview, cells, sizeof(int) * (size_t)W * H);
+    j->stage = stage;
+    j->version++;
+    SDL_UnlockMutex(j->lock);
+    j->lastPublish = now;
+    return true;
+}
+
+static int job_main(void *data) {
+    BspJob *j = data;
+    BspMap m;
+    bool ok = bsp_generate(&m, j->W, j->H, j->complexity, j->seed, job_progress, j);
+    SDL_LockMutex(j->lock);
+    if (ok) j->result = m;
+    j->ok = ok;
+    SDL_UnlockMutex(j->lock);
+    SDL_AtomicSet(&j->done, 1);
+    return 0;
+}
+
+BspJob *bsp_job_start(int W, int H, int complexity, Uint32 seed) {
+    if (W < 3 || H < 3) return NULL;
+    BspJob *j = calloc(1, sizeof(BspJob));
+    if (!j) return NULL;
+    j->W = W;
+    j->H = H;
+    j->complexity = complexity;
+    j->seed = seed;
+    j->stage = BSP_SPLITS;
+    j->preview = malloc(sizeof(int) * (size_t)W * H);
+    j->lock = SDL_CreateMutex();
+    if (!j->preview || !j->lock) {
+        fprintf(stderr, "bsp: failed to set up a %dx%d job\n", W, H);
+        bsp_job_free(j);
+        return NULL;
+    }
+    for (int i = 0; i < W * H; i++) j->preview[i] = 1;
+    j->thread = SDL_CreateThread(job_main, "bsp_gen", j);
+    if (!j->thread) {
+        fprintf(stderr, "bsp: failed to start worker: %s\n", SDL_GetError());
+        bsp_job_free(j);
+        return NULL;
+    }
+    return j;
+}
+
+void bsp_job_cancel(BspJob *j) {
+    if (j) SDL_AtomicSet(&j->cancel, 1);
+}
+
+bool bsp_job_done(BspJob *j) {
+    return SDL_AtomicGet(&j->done) != 0;
+}
+
+bool bsp_job_preview(BspJob *j, int *dst, unsigned *seen, BspStage *stage) {
+    bool fresh = false;
+    SDL_LockMutex(j->lock);
+    if (j->version != *seen) {
+        memcpy(dst, j->preview, sizeof(int) * (size_t)j->W * j->H);
+        *seen = j->version;
+        fresh = true;
+    }
+    if (stage) *stage = j->stage;
+    SDL_UnlockMutex(j->lock);
+    return fresh;
+}
+
+bool bsp_job_take(BspJob *j, BspMap *out) {
+    if (!bsp_job_done(j)) return false;
+    SDL_LockMutex(j->lock);
+    bool ok = j->ok && j->result.cells;
+    if (ok) {
+        *out = j->result;
+        j->result.cells = NULL;
+    }
+    SDL_UnlockMutex(j->lock);
+    return ok;
+}
+
+void bsp_job_free(BspJob *j) {
+    if (!j) return;
+    if (j->thread) SDL_WaitThread(j->thread, NULL);
+    bsp_map_free(&j->result);
+    free(j->preview);
+    if (j->lock) SDL_DestroyMutex(j->lock);
+    free(j);
+}
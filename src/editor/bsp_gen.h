@@ -0,0 +1,49 @@
+#ifndef EDITOR_BSP_GEN_H
+#define EDITOR_BSP_GEN_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// BSP dungeon generator. bsp_generate() runs on the caller's thread and
+// reports each stage (splits, rooms, corridors, smoothing passes) to a
+// callback that can cancel it. A BspJob runs it on its own thread and keeps
+// the newest stage as a preview; several jobs run side by side. The random
+// stream is per call, so a seed gives the same map on any thread.
+
+#define BSP_MAX_ROOMS 256
+#define BSP_SMOOTH_PASSES 3
+
+typedef enum { BSP_SPLITS, BSP_ROOMS, BSP_CORRIDORS, BSP_SMOOTH, BSP_DONE } BspStage;
+
+typedef struct BspRoom { int x0, y0, x1, y1; } BspRoom; // inclusive
+
+typedef struct BspMap {
+    int W, H;
+    int *cells;                   // malloc'ed, W * H
+    BspRoom rooms[BSP_MAX_ROOMS]; // the rooms carved, before smoothing
+    int roomCount;
+} BspMap;
+
+// called with the grid so far; false cancels the generation
+typedef bool (*BspProgressFn)(void *ctx, BspStage stage, const int *cells, int W, int H);
+
+// false when cancelled or out of memory; progress may be NULL
+bool bsp_generate(BspMap *out, int W, int H, int complexity, Uint32 seed, BspProgressFn progress, void *ctx);
+void bsp_map_free(BspMap *m);
+const char *bsp_stage_name(BspStage stage);
+
+typedef struct BspJob BspJob;
+
+BspJob *bsp_job_start(int W, int H, int complexity, Uint32 seed); // NULL on failure
+// asks the worker to stop at its next stage report; the job still has to be freed
+void bsp_job_cancel(BspJob *j);
+bool bsp_job_done(BspJob *j);
+// copies the newest preview (W * H cells) into dst when it is newer than *seen
+// and returns true; *stage is the stage it shows
+bool bsp_job_preview(BspJob *j, int *dst, unsigned *seen, BspStage *stage);
+// once done, moves the map out; false when cancelled or failed
+bool bsp_job_take(BspJob *j, BspMap *out);
+// waits for the worker, so cancel first and free once done to avoid blocking
+void bsp_job_free(BspJob *j);
+
+#endif
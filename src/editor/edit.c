@@ -0,0 +1,436 @@
+#include "edit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct EditEntry {
+    bool snapshot;
+    // snapshot: the whole map as it was
+    int W, H;
+    int *cells;
+    // delta: runs of consecutive cells and their values back to back; a run
+    // whose old (or new) values are all the same stores just one
+    int runs, oldCount, newCount;
+    int *runStart, *runLen;
+    unsigned char *runFlags;
+    int *oldv, *newv;
+} EditEntry;
+
+#define RUN_OLD_SAME 1
+#define RUN_NEW_SAME 2
+
+typedef struct EditRec { int idx, old; } EditRec;
+
+static EditEntry undoStack[EDIT_HISTORY_MAX]; static int undoCount = 0;
+static EditEntry redoStack[EDIT_HISTORY_MAX]; static int redoCount = 0;
+
+// the open operation: each cell's value before its first write, once
+static int depth = 0;
+static EditRec *rec = NULL, *recTmp = NULL; static int recCount = 0, recCap = 0;
+static unsigned *stamp = NULL; static size_t stampCells = 0; static unsigned stampGen = 0;
+static bool recFailed = false;
+
+// flood fill span stack
+static int *spanStack = NULL; static int spanCap = 0;
+
+static size_t entry_bytes(const EditEntry *e) {
+    if (e->snapshot) return sizeof(int) * (size_t)e->W * e->H;
+    return (2 * sizeof(int) + 1) * (size_t)e->runs + sizeof(int) * ((size_t)e->oldCount + e->newCount);
+}
+
+static void entry_free(EditEntry *e) {
+    free(e->cells);
+    free(e->runStart);
+    free(e->runLen);
+    free(e->runFlags);
+    free(e->oldv);
+    free(e->newv);
+    memset(e, 0, sizeof(*e));
+}
+
+// push onto a stack, dropping its oldest entry when full
+static void stack_push(EditEntry *stack, int *count, EditEntry *e) {
+    if (*count >= EDIT_HISTORY_MAX) {
+        entry_free(&stack[0]);
+        memmove(stack, stack + 1, sizeof(EditEntry) * (EDIT_HISTORY_MAX - 1));
+        (*count)--;
+    }
+    stack[(*count)++] = *e;
+}
+
+static void clear_redo(void) {
+    for (int i = 0; i < redoCount; i++) entry_free(&redoStack[i]);
+    redoCount = 0;
+}
+
+void edit_begin(EditMap *m) {
+    if (depth++ > 0) return;
+    recCount = 0;
+    recFailed = false;
+    size_t cells = (size_t)m->W * m->H;
+    if (stampCells != cells) {
+        free(stamp);
+        stamp = calloc(cells ? cells : 1, sizeof(unsigned));
+        stampCells = stamp ? cells : 0;
+        stampGen = 0;
+    }
+    if (++stampGen == 0) {
+        if (stamp) memset(stamp, 0, sizeof(unsigned) * stampCells);
+        stampGen = 1;
+    }
+}
+
+bool edit_set(EditMap *m, int x, int y, int v) {
+    if ((unsigned)x >= (unsigned)m->W || (unsigned)y >= (unsigned)m->H) return false;
+    int i = x + m->W * y;
+    if (m->cells[i] == v) return true;
+    if (depth > 0 && stamp && stamp[i] != stampGen) {
+        if (recCount == recCap) {
+            int cap = recCap ? recCap * 2 : 1024;
+            EditRec *r = realloc(rec, sizeof(EditRec) * (size_t)cap);
+            // out of memory: the edit still happens, the entry is lost
+            if (!r) { recFailed = true; m->cells[i] = v; return true; }
+            rec = r;
+            recCap = cap;
+        }
+        rec[recCount++] = (EditRec){ i, m->cells[i] };
+        stamp[i] = stampGen;
+    }
+    m->cells[i] = v;
+    return true;
+}
+
+// LSD radix sort by index, 11 bits a pass; records arrive mostly in order,
+// so an ordered list is left alone
+static bool sort_rec(int n) {
+    bool sorted = true;
+    for (int i = 1; i < n && sorted; i++) sorted = rec[i].idx > rec[i - 1].idx;
+    if (sorted) return true;
+    EditRec *tmp = realloc(recTmp, sizeof(EditRec) * (size_t)recCap);
+    if (!tmp) return false;
+    recTmp = tmp;
+    EditRec *src = rec, *dst = recTmp;
+    for (int shift = 0; shift < 32; shift += 11) {
+        int counts[2048] = {0};
+        for (int i = 0; i < n; i++) counts[((unsigned)src[i].idx >> shift) & 2047]++;
+        if (counts[((unsigned)src[0].idx >> shift) & 2047] == n) continue;
+        for (int d = 0, sum = 0; d < 2048; d++) { int c = counts[d]; counts[d] = sum; sum += c; }
+        for (int i = 0; i < n; i++) dst[counts[((unsigned)src[i].idx >> shift) & 2047]++] = src[i];
+        EditRec *t = src; src = dst; dst = t;
+    }
+    if (src != rec) memcpy(rec, src, sizeof(EditRec) * (size_t)n);
+    return true;
+}
+
+static bool all_same(const int *v, int n) {
+    for (int i = 1; i < n; i++) if (v[i] != v[0]) return false;
+    return true;
+}
+
+void edit_end(EditMap *m) {
+    if (depth == 0 || --depth > 0) return;
+    // cells written back to their old value don't count
+    int n = 0;
+    for (int i = 0; i < recCount; i++) if (m->cells[rec[i].idx] != rec[i].old) rec[n++] = rec[i];
+    if (n == 0) return;
+    if (recFailed || !sort_rec(n)) {
+        fprintf(stderr, "edit: out of memory, operation not undoable\n");
+        return;
+    }
+    int runs = 1;
+    for (int i = 1; i < n; i++) runs += rec[i].idx != rec[i - 1].idx + 1;
+    EditEntry e = {0};
+    e.runs = runs;
+    e.runStart = malloc(sizeof(int) * (size_t)runs);
+    e.runLen = malloc(sizeof(int) * (size_t)runs);
+    e.runFlags = malloc((size_t)runs);
+    e.oldv = malloc(sizeof(int) * (size_t)n);
+    e.newv = malloc(sizeof(int) * (size_t)n);
+    if (!e.runStart || !e.runLen || !e.runFlags || !e.oldv || !e.newv) {
+        fprintf(stderr, "edit: out of memory, operation not undoable\n");
+        entry_free(&e);
+        return;
+    }
+    for (int i = 0, r = 0; i < n; r++) {
+        int len = 1;
+        while (i + len < n && rec[i + len].idx == rec[i].idx + len) len++;
+        e.runStart[r] = rec[i].idx;
+        e.runLen[r] = len;
+        // values go in place, then collapse when the run is uniform
+        int *ov = e.oldv + e.oldCount, *nv = e.newv + e.newCount;
+        for (int k = 0; k < len; k++) {
+            ov[k] = rec[i + k].old;
+            nv[k] = m->cells[rec[i + k].idx];
+        }
+        e.runFlags[r] = 0;
+        if (all_same(ov, len)) { e.runFlags[r] |= RUN_OLD_SAME; e.oldCount++; } else e.oldCount += len;
+        if (all_same(nv, len)) { e.runFlags[r] |= RUN_NEW_SAME; e.newCount++; } else e.newCount += len;
+        i += len;
+    }
+    // keep only what the runs use
+    int *ov = realloc(e.oldv, sizeof(int) * (size_t)e.oldCount);
+    int *nv = realloc(e.newv, sizeof(int) * (size_t)e.newCount);
+    if (ov) e.oldv = ov;
+    if (nv) e.newv = nv;
+    clear_redo();
+    stack_push(undoStack, &undoCount, &e);
+}
+
+void edit_snapshot(const EditMap *m) {
+    EditEntry e = {0};
+    e.snapshot = true;
+    e.W = m->W;
+    e.H = m->H;
+    e.cells = malloc(sizeof(int) * (size_t)m->W * m->H);
+    if (!e.cells) { fprintf(stderr, "edit: out of memory for a %dx%d snapshot\n", m->W, m->H); return; }
+    memcpy(e.cells, m->cells, sizeof(int) * (size_t)m->W * m->H);
+    clear_redo();
+    stack_push(undoStack, &undoCount, &e);
+}
+
+bool edit_resize(EditMap *m, int w, int h) {
+    if (w <= 0 || h <= 0 || (w == m->W && h == m->H)) return false;
+    int *cells = malloc(sizeof(int) * (size_t)w * h);
+    if (!cells) return false;
+    for (int y = 0; y < h; y++) for (int x = 0; x < w; x++) {
+        cells[x + w * y] = (x < m->W && y < m->H) ? m->cells[x + m->W * y] : 0;
+    }
+    edit_snapshot(m);
+    free(m->cells);
+    m->cells = cells;
+    m->W = w;
+    m->H = h;
+    return true;
+}
+
+// undo or redo the top of `from`, leaving its inverse on `to`
+static bool step_history(EditMap *m, EditEntry *from, int *fromCount, EditEntry *to, int *toCount, bool undo) {
+    if (depth > 0 || *fromCount == 0) return false;
+    EditEntry e = from[*fromCount - 1];
+    if (e.snapshot) {
+        // swap the stored map with the current one
+        EditEntry inv = { true, m->W, m->H, m->cells, 0, 0, 0, NULL, NULL, NULL, NULL, NULL };
+        m->cells = e.cells;
+        m->W = e.W;
+        m->H = e.H;
+        e = inv;
+    } else {
+        const int *vals = undo ? e.oldv : e.newv;
+        unsigned char same = undo ? RUN_OLD_SAME : RUN_NEW_SAME;
+        for (int r = 0; r < e.runs; r++) {
+            int *dst = m->cells + e.runStart[r], len = e.runLen[r];
+            if (e.runFlags[r] & same) {
+                for (int k = 0; k < len; k++) dst[k] = *vals;
+                vals++;
+            } else {
+                memcpy(dst, vals, sizeof(int) * (size_t)len);
+                vals += len;
+            }
+        }
+    }
+    (*fromCount)--;
+    stack_push(to, toCount, &e);
+    return true;
+}
+
+bool edit_undo(EditMap *m) {
+    return step_history(m, undoStack, &undoCount, redoStack, &redoCount, true);
+}
+
+bool edit_redo(EditMap *m) {
+    return step_history(m, redoStack, &redoCount, undoStack, &undoCount, false);
+}
+
+int edit_undo_count(void) { return undoCount; }
+int edit_redo_count(void) { return redoCount; }
+
+size_t edit_history_bytes(void) {
+    size_t b = 0;
+    for (int i = 0; i < undoCount; i++) b += entry_bytes(&undoStack[i]);
+    for (int i = 0; i < redoCount; i++) b += entry_bytes(&redoStack[i]);
+    return b;
+}
+
+void edit_history_free(void) {
+    for (int i = 0; i < undoCount; i++) entry_free(&undoStack[i]);
+    undoCount = 0;
+    clear_redo();
+    free(rec);
+    free(recTmp);
+    rec = recTmp = NULL;
+    recCount = recCap = 0;
+    free(stamp);
+    stamp = NULL;
+    stampCells = 0;
+    free(spanStack);
+    spanStack = NULL;
+    spanCap = 0;
+}
+
+// writes [x0,x1]x[y0,y1] clipped; returns cells changed
+static int fill_clipped(EditMap *m, int x0, int y0, int x1, int y1, int v) {
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= m->W) x1 = m->W - 1;
+    if (y1 >= m->H) y1 = m->H - 1;
+    int changed = 0;
+    for (int y = y0; y <= y1; y++) for (int x = x0; x <= x1; x++) {
+        if (m->cells[x + m->W * y] == v) continue;
+        edit_set(m, x, y, v);
+        changed++;
+    }
+    return changed;
+}
+
+int edit_brush(EditMap *m, int x, int y, int brush, int v) {
+    int half = brush / 2;
+    edit_begin(m);
+    int n = fill_clipped(m, x - half, y - half, x + half, y + half, v);
+    edit_end(m);
+    return n;
+}
+
+int edit_stroke(EditMap *m, int x0, int y0, int x1, int y1, int brush, int v) {
+    int half = brush / 2, n = 0;
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    edit_begin(m);
+    while (x0 != x1 || y0 != y1) {
+        int e2 = 2 * err;
+        bool stepX = e2 >= dy, stepY = e2 <= dx;
+        if (stepX) { err += dy; x0 += sx; }
+        if (stepY) { err += dx; y0 += sy; }
+        // a square moved by one cell only uncovers its leading column / row
+        if (stepX) n += fill_clipped(m, x0 + sx * half, y0 - half, x0 + sx * half, y0 + half, v);
+        if (stepY) n += fill_clipped(m, x0 - half, y0 + sy * half, x0 + half, y0 + sy * half, v);
+    }
+    edit_end(m);
+    return n;
+}
+
+int edit_line(EditMap *m, int x0, int y0, int x1, int y1, int brush, int v) {
+    edit_begin(m);
+    int n = edit_brush(m, x0, y0, brush, v);
+    n += edit_stroke(m, x0, y0, x1, y1, brush, v);
+    edit_end(m);
+    return n;
+}
+
+int edit_fill_rect(EditMap *m, int x0, int y0, int x1, int y1, int v) {
+    edit_begin(m);
+    int n = fill_clipped(m, x0, y0, x1, y1, v);
+    edit_end(m);
+    return n;
+}
+
+static bool span_push(int *top, int x, int y) {
+    if (*top + 2 > spanCap) {
+        int cap = spanCap ? spanCap * 2 : 1024;
+        int *s = realloc(spanStack, sizeof(int) * (size_t)cap);
+        if (!s) return false;
+        spanStack = s;
+        spanCap = cap;
+    }
+    spanStack[(*top)++] = x;
+    spanStack[(*top)++] = y;
+    return true;
+}
+
+// seeds for the target runs of row y within [lx, rx]
+static bool span_seed_row(const EditMap *m, int *top, int lx, int rx, int y, int target) {
+    if (y < 0 || y >= m->H) return true;
+    const int *row = m->cells + (size_t)m->W * y;
+    for (int x = lx; x <= rx; x++) {
+        if (row[x] != target) continue;
+        if (!span_push(top, x, y)) return false;
+        while (x <= rx && row[x] == target) x++;
+    }
+    return true;
+}
+
+int edit_flood(EditMap *m, int x, int y, int v) {
+    if ((unsigned)x >= (unsigned)m->W || (unsigned)y >= (unsigned)m->H) return 0;
+    int target = m->cells[x + m->W * y];
+    if (target == v) return 0;
+    int top = 0, n = 0;
+    if (!span_push(&top, x, y)) return 0;
+    edit_begin(m);
+    while (top > 0) {
+        int sy = spanStack[--top], sx = spanStack[--top];
+        int *row = m->cells + (size_t)m->W * sy;
+        if (row[sx] != target) continue;
+        int lx = sx, rx = sx;
+        while (lx > 0 && row[lx - 1] == target) lx--;
+        while (rx < m->W - 1 && row[rx + 1] == target) rx++;
+        for (int cx = lx; cx <= rx; cx++) edit_set(m, cx, sy, v);
+        n += rx - lx + 1;
+        if (!span_seed_row(m, &top, lx, rx, sy - 1, target) || !span_seed_row(m, &top, lx, rx, sy + 1, target)) {
+            fprintf(stderr, "edit: out of memory, fill stopped early\n");
+            break;
+        }
+    }
+    edit_end(m);
+    return n;
+}
+
+bool edit_copy(const EditMap *m, int x0, int y0, int x1, int y1, EditClip *out) {
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= m->W) x1 = m->W - 1;
+    if (y1 >= m->H) y1 = m->H - 1;
+    if (x0 > x1 || y0 > y1) return false;
+    int w = x1 - x0 + 1, h = y1 - y0 + 1;
+    int *cells = malloc(sizeof(int) * (size_t)w * h);
+    if (!cells) return false;
+    for (int y = 0; y < h; y++) memcpy(cells + (size_t)w * y, m->cells + x0 + (size_t)m->W * (y0 + y), sizeof(int) * (size_t)w);
+    edit_clip_free(out);
+    out->w = w;
+    out->h = h;
+    out->cells = cells;
+    return true;
+}
+
+int edit_paste(EditMap *m, const EditClip *c, int x, int y) {
+    if (!c->cells) return 0;
+    int n = 0;
+    edit_begin(m);
+    for (int cy = 0; cy < c->h; cy++) {
+        int ty = y + cy;
+        if (ty < 0 || ty >= m->H) continue;
+        for (int cx = 0; cx < c->w; cx++) {
+            int tx = x + cx, v = c->cells[cx + c->w * cy];
+            if (tx < 0 || tx >= m->W || m->cells[tx + m->W * ty] == v) continue;
+            edit_set(m, tx, ty, v);
+            n++;
+        }
+    }
+    edit_end(m);
+    return n;
+}
+
+int edit_move(EditMap *m, int x0, int y0, int x1, int y1, int dx, int dy, int fill) {
+    EditClip c = {0};
+    if (!edit_copy(m, x0, y0, x1, y1, &c)) return 0;
+    int sx = x0 < x1 ? x0 : x1, sy = y0 < y1 ? y0 : y1;
+    if (sx < 0) sx = 0;
+    if (sy < 0) sy = 0;
+    edit_begin(m);
+    fill_clipped(m, sx, sy, sx + c.w - 1, sy + c.h - 1, fill);
+    edit_paste(m, &c, sx + dx, sy + dy);
+    edit_end(m);
+    int n = c.w * c.h;
+    edit_clip_free(&c);
+    return n;
+}
+
+void edit_clip_free(EditClip *c) {
+    free(c->cells);
+    c->cells = NULL;
+    c->w = c->h = 0;
+}
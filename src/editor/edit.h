@@ -0,0 +1,60 @@
+#ifndef EDITOR_EDIT_H
+#define EDITOR_EDIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Map edits with undo. Every tool writes through edit_set() between
+// edit_begin() and edit_end(), which makes one undo entry holding only the
+// cells that changed, as runs of consecutive cells with their old and new
+// values (one value for a run that is all the same, as fills are); a cell
+// written twice in one operation is recorded once. Replacing or resizing the
+// whole map goes through edit_snapshot() instead. All tools run in time
+// proportional to the cells they touch.
+
+#define EDIT_HISTORY_MAX 256 // undo entries kept; the oldest go first
+
+typedef struct EditMap {
+    int *cells;
+    int W, H;
+} EditMap;
+
+typedef struct EditClip {
+    int w, h;
+    int *cells;
+} EditClip;
+
+// operations nest: only the outermost edit_end() closes the entry
+void edit_begin(EditMap *m);
+bool edit_set(EditMap *m, int x, int y, int v); // false outside the map
+void edit_end(EditMap *m);
+// record the whole map as one entry before replacing or resizing it
+void edit_snapshot(const EditMap *m);
+// grow or shrink to w x h, new cells open; one entry
+bool edit_resize(EditMap *m, int w, int h);
+bool edit_undo(EditMap *m);
+bool edit_redo(EditMap *m);
+int edit_undo_count(void);
+int edit_redo_count(void);
+size_t edit_history_bytes(void);
+void edit_history_free(void);
+
+// tools; each is one operation (or part of the one that is open) and
+// returns the number of cells it changed
+int edit_brush(EditMap *m, int x, int y, int brush, int v);
+// square brush dragged from (x0, y0) to (x1, y1); the brush is already
+// down at (x0, y0), so only the cells it newly covers are written
+int edit_stroke(EditMap *m, int x0, int y0, int x1, int y1, int brush, int v);
+int edit_line(EditMap *m, int x0, int y0, int x1, int y1, int brush, int v);
+int edit_fill_rect(EditMap *m, int x0, int y0, int x1, int y1, int v);
+// 4-connected scanline flood fill of the region holding (x, y)'s value
+int edit_flood(EditMap *m, int x, int y, int v);
+
+// region copy/paste; rectangles are inclusive and clipped to the map
+bool edit_copy(const EditMap *m, int x0, int y0, int x1, int y1, EditClip *out);
+int edit_paste(EditMap *m, const EditClip *c, int x, int y);
+// move a region by (dx, dy), leaving `fill` behind; returns the cells moved
+int edit_move(EditMap *m, int x0, int y0, int x1, int y1, int dx, int dy, int fill);
+void edit_clip_free(EditClip *c);
+
+#endif
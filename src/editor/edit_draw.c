@@ -0,0 +1,27 @@
+#include "edit_draw.h"
+
+void edit_cell_rgb(int v, Uint8 *r, Uint8 *g, Uint8 *b) {
+    *r = *g = *b = 50;
+    if (v == 1) { *r = 200; *g = 0; *b = 0; }
+    else if (v == 2) { *r = 0; *g = 200; *b = 0; }
+    else if (v == 3) { *r = 0; *g = 0; *b = 200; }
+    else if (v != 0) { *r = 200; *g = 200; *b = 200; }
+}
+
+void edit_draw_grid(SDL_Renderer *ren, const int *cells, int W, int H, int cols, int rows, int cell) {
+    for (int y=0;y<rows;y++){
+        for (int x=0;x<cols;x++){
+            int v = 0;
+            if (x < W && y < H) v = cells[x + W*y];
+            Uint8 r, g, b;
+            edit_cell_rgb(v, &r, &g, &b);
+            SDL_SetRenderDrawColor(ren, r, g, b, 255);
+            SDL_Rect rc = { x*cell, y*cell, cell-1, cell-1 };
+            SDL_RenderFillRect(ren, &rc);
+        }
+    }
+    // draw grid lines
+    SDL_SetRenderDrawColor(ren, 24,24,24,255);
+    for (int gx=0; gx<=cols; gx++) SDL_RenderDrawLine(ren, gx*cell, 0, gx*cell, rows*cell);
+    for (int gy=0; gy<=rows; gy++) SDL_RenderDrawLine(ren, 0, gy*cell, cols*cell, gy*cell);
+}
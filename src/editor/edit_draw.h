@@ -0,0 +1,13 @@
+#ifndef EDITOR_EDIT_DRAW_H
+#define EDITOR_EDIT_DRAW_H
+
+#include <SDL2/SDL.h>
+
+// colour of a cell value: open dark grey, walls 1-3 red, green, blue, any
+// other value light grey
+void edit_cell_rgb(int v, Uint8 *r, Uint8 *g, Uint8 *b);
+// cols x rows cells of `cell` pixels from the map's top-left corner, cells
+// past the map drawn open, then the grid lines over them
+void edit_draw_grid(SDL_Renderer *ren, const int *cells, int W, int H, int cols, int rows, int cell);
+
+#endif
@@ -0,0 +1,273 @@
+// fileno and fsync
+#define _POSIX_C_SOURCE 200809L
+
+#include "edit_io.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// saves are formatted into this much memory and written out a buffer at a time
+#define EDIT_SAVE_BUFFER (1 << 20)
+
+static bool read_u32(FILE *f, Uint32 *v) {
+    Uint8 b[4];
+    if (fread(b, 1, 4, f) != 4) return false;
+    *v = (Uint32)b[0] | (Uint32)b[1] << 8 | (Uint32)b[2] << 16 | (Uint32)b[3] << 24;
+    return true;
+}
+
+// the RLE grid after its magic; NULL on a short or inconsistent file
+static int *read_rle(FILE *f, int *outW, int *outH) {
+    int version = fgetc(f);
+    Uint32 w, h;
+    if (version != EDIT_RLE_VERSION || !read_u32(f, &w) || !read_u32(f, &h)) return NULL;
+    if (w == 0 || h == 0 || (Uint64)w * h > INT_MAX / sizeof(int)) return NULL;
+    size_t n = (size_t)w * h, at = 0;
+    int *cells = malloc(n * sizeof(int));
+    if (!cells) return NULL;
+    while (at < n) {
+        Uint32 count, value;
+        if (!read_u32(f, &count) || !read_u32(f, &value) || count == 0 || count > n - at) { free(cells); return NULL; }
+        for (Uint32 i = 0; i < count; i++) cells[at++] = (int)value;
+    }
+    *outW = (int)w;
+    *outH = (int)h;
+    return cells;
+}
+
+bool edit_load(const char *path, EditMap *m, EditDoc *doc) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    int w, h;
+    int *cells;
+    EditFormat format = EDIT_FORMAT_TEXT;
+    char magic[4];
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, EDIT_RLE_MAGIC, 4) == 0) {
+        format = EDIT_FORMAT_RLE;
+        cells = read_rle(f, &w, &h);
+        if (!cells) { fclose(f); return false; }
+    } else {
+        rewind(f);
+        if (fscanf(f, "%d %d", &w, &h) != 2 || w <= 0 || h <= 0) { fclose(f); return false; }
+        cells = calloc((size_t)w * h, sizeof(int));
+        if (!cells) { fclose(f); return false; }
+        for (int y=0;y<h;y++) for (int x=0;x<w;x++) if (fscanf(f, "%d", &cells[x + w*y]) != 1) cells[x + w*y] = 0;
+    }
+    // directives after the grid: keep rooms, carry the rest over verbatim
+    EditDoc d = { .roomCount = 0, .extra = NULL, .format = format };
+    char line[256];
+    size_t extraLen = 0;
+    while (fgets(line, sizeof(line), f)) {
+        BspRoom r;
+        if (sscanf(line, " room %d %d %d %d", &r.x0, &r.y0, &r.x1, &r.y1) == 4) {
+            if (d.roomCount < BSP_MAX_ROOMS) d.rooms[d.roomCount++] = r;
+            continue;
+        }
+        char word[16];
+        if (sscanf(line, " %15s", word) != 1) continue;
+        size_t n = strlen(line);
+        char *e = realloc(d.extra, extraLen + n + 2);
+        if (!e) break;
+        d.extra = e;
+        memcpy(d.extra + extraLen, line, n);
+        extraLen += n;
+        if (line[n-1] != '\n') d.extra[extraLen++] = '\n';
+        d.extra[extraLen] = '\0';
+    }
+    fclose(f);
+    free(m->cells);
+    m->cells = cells;
+    m->W = w;
+    m->H = h;
+    edit_doc_free(doc);
+    *doc = d;
+    return true;
+}
+
+typedef struct SaveOut {
+    FILE *f;
+    char *buf;
+    size_t len;
+    bool ok;
+} SaveOut;
+
+static void out_flush(SaveOut *o) {
+    if (o->len && fwrite(o->buf, 1, o->len, o->f) != o->len) o->ok = false;
+    o->len = 0;
+}
+
+static void out_bytes(SaveOut *o, const void *p, size_t n) {
+    if (o->len + n > EDIT_SAVE_BUFFER) out_flush(o);
+    if (n > EDIT_SAVE_BUFFER) { if (fwrite(p, 1, n, o->f) != n) o->ok = false; return; }
+    memcpy(o->buf + o->len, p, n);
+    o->len += n;
+}
+
+static void out_u32(SaveOut *o, Uint32 v) {
+    Uint8 b[4] = { (Uint8)v, (Uint8)(v >> 8), (Uint8)(v >> 16), (Uint8)(v >> 24) };
+    out_bytes(o, b, 4);
+}
+
+// decimal v at p, at most 11 bytes; returns the end
+static char *put_int(char *p, int v) {
+    // walls and floors: nearly every cell is a single digit
+    if ((unsigned)v < 10) { *p++ = (char)('0' + v); return p; }
+    unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+    char tmp[10];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) *p++ = '-';
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+// same bytes as fprintf("%d %d\n") and then "%d " per cell, "\n" per row
+static void write_text(SaveOut *o, const EditMap *m) {
+    char *p = o->buf, *end = o->buf + EDIT_SAVE_BUFFER - 13;
+    p = put_int(p, m->W);
+    *p++ = ' ';
+    p = put_int(p, m->H);
+    *p++ = '\n';
+    for (int y = 0; y < m->H; y++) {
+        const int *row = m->cells + (size_t)m->W * y;
+        for (int x = 0; x < m->W; x++) {
+            if (p > end) { o->len = (size_t)(p - o->buf); out_flush(o); p = o->buf; }
+            p = put_int(p, row[x]);
+            *p++ = ' ';
+        }
+        if (p > end) { o->len = (size_t)(p - o->buf); out_flush(o); p = o->buf; }
+        *p++ = '\n';
+    }
+    o->len = (size_t)(p - o->buf);
+}
+
+static void write_rle(SaveOut *o, const EditMap *m) {
+    out_bytes(o, EDIT_RLE_MAGIC, 4);
+    Uint8 version = EDIT_RLE_VERSION;
+    out_bytes(o, &version, 1);
+    out_u32(o, (Uint32)m->W);
+    out_u32(o, (Uint32)m->H);
+    size_t n = (size_t)m->W * m->H;
+    for (size_t i = 0; i < n; ) {
+        size_t run = 1;
+        while (i + run < n && m->cells[i + run] == m->cells[i] && run < 0xffffffffu) run++;
+        out_u32(o, (Uint32)run);
+        out_u32(o, (Uint32)m->cells[i]);
+        i += run;
+    }
+}
+
+static bool write_doc(FILE *f, const EditMap *m, const EditDoc *doc) {
+    SaveOut o = { f, malloc(EDIT_SAVE_BUFFER), 0, true };
+    if (!o.buf) return false;
+    if (doc->format == EDIT_FORMAT_RLE) write_rle(&o, m);
+    else write_text(&o, m);
+    if (doc->extra) out_bytes(&o, doc->extra, strlen(doc->extra));
+    for (int i = 0; i < doc->roomCount; i++) {
+        const BspRoom *r = &doc->rooms[i];
+        char line[64], *p = line;
+        memcpy(p, "room ", 5);
+        p += 5;
+        p = put_int(p, r->x0); *p++ = ' ';
+        p = put_int(p, r->y0); *p++ = ' ';
+        p = put_int(p, r->x1); *p++ = ' ';
+        p = put_int(p, r->y1); *p++ = '\n';
+        out_bytes(&o, line, (size_t)(p - line));
+    }
+    out_flush(&o);
+    free(o.buf);
+    return o.ok;
+}
+
+bool edit_save(const char *path, const EditMap *m, const EditDoc *doc) {
+    // ensure directory exists
+    char dir[512];
+    strncpy(dir, path, sizeof(dir)-1);
+    dir[sizeof(dir)-1] = '\0';
+    for (int i = (int)strlen(dir)-1; i>=0; --i) {
+        if (dir[i] == '/') { dir[i] = '\0'; break; }
+    }
+    if (strchr(path, '/') && strlen(dir) > 0) mkdir(dir, 0755);
+    // write beside the target and rename over it: readers (and a crash) see
+    // the old map or the whole new one, never a truncated grid the game would
+    // pad with walls
+    char tmp[520];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) return false;
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return false;
+    // write_doc buffers on its own
+    setvbuf(f, NULL, _IONBF, 0);
+    bool ok = write_doc(f, m, doc);
+    if (fflush(f) != 0 || fsync(fileno(f)) != 0) ok = false;
+    if (fclose(f) != 0) ok = false;
+    if (ok && rename(tmp, path) != 0) ok = false;
+    if (!ok) remove(tmp);
+    return ok;
+}
+
+void edit_doc_free(EditDoc *doc) {
+    free(doc->extra);
+    doc->extra = NULL;
+    doc->roomCount = 0;
+}
+
+struct EditSave {
+    SDL_Thread *thread;
+    SDL_atomic_t done;
+    char *path;
+    EditMap map;
+    EditDoc doc;
+    bool ok; // set by the worker before done
+};
+
+static int save_main(void *arg) {
+    EditSave *s = arg;
+    s->ok = edit_save(s->path, &s->map, &s->doc);
+    SDL_AtomicSet(&s->done, 1);
+    return 0;
+}
+
+static void save_free(EditSave *s) {
+    free(s->path);
+    free(s->map.cells);
+    edit_doc_free(&s->doc);
+    free(s);
+}
+
+EditSave *edit_save_start(const char *path, const EditMap *m, const EditDoc *doc) {
+    EditSave *s = calloc(1, sizeof(EditSave));
+    if (!s) return NULL;
+    size_t pathLen = strlen(path) + 1, cellBytes = sizeof(int) * (size_t)m->W * m->H;
+    size_t extraLen = doc->extra ? strlen(doc->extra) + 1 : 0;
+    s->path = malloc(pathLen);
+    s->map = (EditMap){ malloc(cellBytes), m->W, m->H };
+    s->doc = *doc;
+    s->doc.extra = extraLen ? malloc(extraLen) : NULL;
+    if (!s->path || !s->map.cells || (extraLen && !s->doc.extra)) { save_free(s); return NULL; }
+    memcpy(s->path, path, pathLen);
+    memcpy(s->map.cells, m->cells, cellBytes);
+    if (extraLen) memcpy(s->doc.extra, doc->extra, extraLen);
+    s->thread = SDL_CreateThread(save_main, "edit_save", s);
+    if (!s->thread) {
+        fprintf(stderr, "edit: failed to start save: %s\n", SDL_GetError());
+        save_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+bool edit_save_done(EditSave *s) {
+    return SDL_AtomicGet(&s->done) != 0;
+}
+
+bool edit_save_finish(EditSave *s) {
+    SDL_WaitThread(s->thread, NULL);
+    bool ok = s->ok;
+    save_free(s);
+    return ok;
+}
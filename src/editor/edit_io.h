@@ -0,0 +1,45 @@
+#ifndef EDITOR_EDIT_IO_H
+#define EDITOR_EDIT_IO_H
+
+#include <stdbool.h>
+
+#include "bsp_gen.h"
+#include "edit.h"
+
+// How the grid is stored. Text is the game's original "w h" line followed by
+// one row of numbers per line. RLE starts with "G90M", a version byte and w,
+// h as u32, then runs of u32 count + i32 value (little-endian) until all
+// w * h cells are covered; directive lines follow as text in both.
+typedef enum EditFormat { EDIT_FORMAT_TEXT, EDIT_FORMAT_RLE } EditFormat;
+
+#define EDIT_RLE_MAGIC "G90M"
+#define EDIT_RLE_VERSION 1
+
+// A map file as the editor keeps it: the grid, the rooms (read from "room"
+// lines or taken from the generator, so the game keeps them instead of
+// guessing regions) and every other directive line, written back verbatim.
+typedef struct EditDoc {
+    BspRoom rooms[BSP_MAX_ROOMS];
+    int roomCount;
+    char *extra; // NULL or newline-terminated lines
+    EditFormat format; // what the file was read as; saves use it too
+} EditDoc;
+
+// replaces m's cells and doc's rooms and lines; false, leaving both as they
+// were, when the file can't be read
+bool edit_load(const char *path, EditMap *m, EditDoc *doc);
+// creates the file's directory if needed, writes "<path>.tmp", syncs it and
+// renames it over path, so a failed or interrupted save leaves the old file
+bool edit_save(const char *path, const EditMap *m, const EditDoc *doc);
+void edit_doc_free(EditDoc *doc);
+
+// edit_save() on its own thread, from a copy of the map and doc taken here,
+// so the caller can keep editing. NULL when the copy or thread fails.
+typedef struct EditSave EditSave;
+
+EditSave *edit_save_start(const char *path, const EditMap *m, const EditDoc *doc);
+bool edit_save_done(EditSave *s);
+// waits for the write, frees the job and returns whether the save succeeded
+bool edit_save_finish(EditSave *s);
+
+#endif
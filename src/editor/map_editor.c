@@ -3,188 +3,209 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <sys/stat.h>
 #include <stdbool.h>
 #include <time.h>
 
-#ifndef max
-#define max(a,b) ((a)>(b)?(a):(b))
-#endif
+#include "bsp_gen.h"
+#include "edit.h"
+#include "edit_draw.h"
+#include "edit_io.h"
 
-typedef struct { int W, H; int *data; } Snap;
-#define MAX_STACK 64
-static Snap undoStack[MAX_STACK]; static int undoCount = 0;
-static Snap redoStack[MAX_STACK]; static int redoCount = 0;
+// rooms and directive lines of the map being edited
+static EditDoc doc;
 
-// BSP node type used by generator
-typedef struct BSPNode { int x,y,w,h; int left,right; int roomx,roomy,roomw,roomh; } BSPNode;
+// Background generation: G runs one job whose stages replace the grid as
+// they arrive, B runs GEN_BATCH seeds side by side as thumbnails to pick
+// from. Changing complexity or seed restarts whatever is running; cancelled
+// jobs finish their current stage in the background and are freed later.
+#define GEN_BATCH 6
+#define GEN_BATCH_COLS 3
+#define GEN_THUMB_MAX 128 // thumbnail texture size in cells at most
+#define GEN_RETIRED_MAX 32
 
-static int find_center_x(BSPNode *nodes, int idx) {
-    if (idx < 0) return 0;
-    if (nodes[idx].left == -1 && nodes[idx].right == -1) return nodes[idx].roomx + nodes[idx].roomw/2;
-    if (nodes[idx].left != -1) return find_center_x(nodes, nodes[idx].left);
-    if (nodes[idx].right != -1) return find_center_x(nodes, nodes[idx].right);
-    return nodes[idx].x + nodes[idx].w/2;
+typedef struct GenSlot {
+    BspJob *job;
+    Uint32 seed;
+    int W, H;
+    int *preview;       // newest stage, W * H
+    unsigned seen;
+    BspStage stage;
+    SDL_Texture *thumb;
+    int tw, th, step;   // thumbnail size, cells per texel
+    SDL_Rect rect;      // where the thumbnail was last drawn
+} GenSlot;
+
+static GenSlot genSingle;
+static GenSlot genBatch[GEN_BATCH];
+static bool batchOpen = false;
+static BspJob *retired[GEN_RETIRED_MAX]; static int retiredCount = 0;
+
+static void retire_job(BspJob *j) {
+    if (!j) return;
+    bsp_job_cancel(j);
+    if (retiredCount == GEN_RETIRED_MAX) {
+        // too many stragglers: wait for the oldest
+        bsp_job_free(retired[0]);
+        memmove(retired, retired + 1, sizeof(BspJob *) * (GEN_RETIRED_MAX - 1));
+        retiredCount--;
+    }
+    retired[retiredCount++] = j;
 }
-static int find_center_y(BSPNode *nodes, int idx) {
-    if (idx < 0) return 0;
-    if (nodes[idx].left == -1 && nodes[idx].right == -1) return nodes[idx].roomy + nodes[idx].roomh/2;
-    if (nodes[idx].left != -1) return find_center_y(nodes, nodes[idx].left);
-    if (nodes[idx].right != -1) return find_center_y(nodes, nodes[idx].right);
-    return nodes[idx].y + nodes[idx].h/2;
+
+static void reap_retired(void) {
+    for (int i = 0; i < retiredCount;) {
+        if (!bsp_job_done(retired[i])) { i++; continue; }
+        bsp_job_free(retired[i]);
+        retired[i] = retired[--retiredCount];
+    }
 }
 
-static void free_snap(Snap *s) { if (s && s->data) { free(s->data); s->data = NULL; } }
+static void slot_stop(GenSlot *s) {
+    retire_job(s->job);
+    free(s->preview);
+    if (s->thumb) SDL_DestroyTexture(s->thumb);
+    memset(s, 0, sizeof(*s));
+}
+
+static bool slot_start(GenSlot *s, int W, int H, int complexity, Uint32 seed) {
+    slot_stop(s);
+    s->preview = malloc(sizeof(int) * (size_t)W * H);
+    if (!s->preview) return false;
+    for (int i = 0; i < W * H; i++) s->preview[i] = 1;
+    s->job = bsp_job_start(W, H, complexity, seed);
+    if (!s->job) { slot_stop(s); return false; }
+    s->seed = seed;
+    s->W = W;
+    s->H = H;
+    return true;
+}
 
-static void push_undo(int *map_in, int W_in, int H_in) {
-    // clear redo
-    for (int i = 0; i < redoCount; i++) {
-        free_snap(&redoStack[i]);
+// redraw a slot's thumbnail from its preview, nearest cell per texel
+static void slot_thumb(SDL_Renderer *ren, GenSlot *s) {
+    if (!s->thumb) {
+        int big = s->W > s->H ? s->W : s->H;
+        s->step = (big + GEN_THUMB_MAX - 1) / GEN_THUMB_MAX;
+        s->tw = (s->W + s->step - 1) / s->step;
+        s->th = (s->H + s->step - 1) / s->step;
+        s->thumb = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, s->tw, s->th);
+        if (!s->thumb) return;
     }
-    redoCount = 0;
-    // if full, drop oldest (shift left)
-    if (undoCount >= MAX_STACK) {
-        free_snap(&undoStack[0]);
-        for (int i=1;i<undoCount;i++) undoStack[i-1] = undoStack[i];
-        undoCount--;
+    Uint32 texels[GEN_THUMB_MAX * GEN_THUMB_MAX];
+    for (int y = 0; y < s->th; y++) for (int x = 0; x < s->tw; x++) {
+        Uint8 r, g, b;
+        edit_cell_rgb(s->preview[x * s->step + s->W * (y * s->step)], &r, &g, &b);
+        texels[x + s->tw * y] = 0xFF000000u | ((Uint32)r << 16) | ((Uint32)g << 8) | b;
     }
-    Snap *s = &undoStack[undoCount++];
-    s->W = W_in; s->H = H_in; s->data = malloc(sizeof(int) * W_in * H_in);
-    if (s->data) memcpy(s->data, map_in, sizeof(int) * W_in * H_in);
+    SDL_UpdateTexture(s->thumb, NULL, texels, s->tw * (int)sizeof(Uint32));
 }
 
-static int do_undo(int **map_p, int *W_p, int *H_p) {
-    if (undoCount <= 0) return 0;
-    // push current to redo
-    if (redoCount >= MAX_STACK) { free_snap(&redoStack[0]); for (int i=1;i<redoCount;i++) redoStack[i-1]=redoStack[i]; redoCount--; }
-    Snap *r = &redoStack[redoCount++]; r->W = *W_p; r->H = *H_p; r->data = malloc(sizeof(int) * (*W_p) * (*H_p));
-    if (r->data) memcpy(r->data, *map_p, sizeof(int) * (*W_p) * (*H_p));
-
-    // pop last undo into map
-    Snap s = undoStack[undoCount-1]; undoCount--;
-    free(*map_p);
-    *map_p = s.data; *W_p = s.W; *H_p = s.H;
-    // prevent double-free (s.data now owned by map)
-    return 1;
+// move a finished slot's map into the editor, undoably
+static bool slot_accept(GenSlot *s, EditMap *em) {
+    BspMap m;
+    if (!s->job || !bsp_job_take(s->job, &m)) return false;
+    edit_snapshot(em);
+    free(em->cells);
+    em->cells = m.cells;
+    em->W = m.W;
+    em->H = m.H;
+    memcpy(doc.rooms, m.rooms, sizeof(BspRoom) * (size_t)m.roomCount);
+    doc.roomCount = m.roomCount;
+    return true;
 }
 
-static int do_redo(int **map_p, int *W_p, int *H_p) {
-    if (redoCount <= 0) return 0;
-    if (undoCount >= MAX_STACK) { free_snap(&undoStack[0]); for (int i=1;i<undoCount;i++) undoStack[i-1]=undoStack[i]; undoCount--; }
-    Snap *u = &undoStack[undoCount++]; u->W = *W_p; u->H = *H_p; u->data = malloc(sizeof(int) * (*W_p) * (*H_p));
-    if (u->data) memcpy(u->data, *map_p, sizeof(int) * (*W_p) * (*H_p));
+static void batch_close(void) {
+    for (int i = 0; i < GEN_BATCH; i++) slot_stop(&genBatch[i]);
+    batchOpen = false;
+}
 
-    Snap s = redoStack[redoCount-1]; redoCount--;
-    free(*map_p);
-    *map_p = s.data; *W_p = s.W; *H_p = s.H;
-    return 1;
+static void batch_open(int W, int H, int complexity, Uint32 seed) {
+    batch_close();
+    for (int i = 0; i < GEN_BATCH; i++) slot_start(&genBatch[i], W, H, complexity, seed + (Uint32)i);
+    batchOpen = true;
 }
 
-// simple BSP generator for editor
-static int *generate_bsp(int W, int H, int complexity, unsigned int seed) {
-    int *m = malloc(sizeof(int) * W * H);
-    if (!m) return NULL;
-    for (int i=0;i<W*H;i++) m[i] = 1;
-    BSPNode nodes[512]; int ncount = 0;
-    nodes[ncount++] = (BSPNode){1,1,W-2,H-2,-1,-1,0,0,0,0};
-    srand(seed);
-
-    // split nodes into a BSP tree
-    for (int it=0; it<complexity; ++it) {
-        // pick random leaf
-        int sel = -1;
-        for (int i=0;i<ncount;i++) if (nodes[i].left == -1 && nodes[i].right == -1) { if (rand()% (it+2) == 0) sel = i; }
-        if (sel == -1) break;
-        BSPNode nd = nodes[sel];
-        if (nd.w < 6 && nd.h < 6) continue;
-        bool splitH = (nd.h > nd.w);
-        if (nd.w > nd.h && nd.w > 12) splitH = false;
-        if (nd.h > nd.w && nd.h > 12) splitH = true;
-        if (splitH) {
-            int minSplit = 3, maxSplit = nd.h - 3;
-            if (maxSplit <= minSplit) continue;
-            int s = minSplit + rand() % (maxSplit - minSplit + 1);
-            // top and bottom
-            nodes[ncount] = (BSPNode){nd.x, nd.y, nd.w, s, -1,-1,0,0,0,0};
-            nodes[sel] = (BSPNode){nd.x, nd.y + s, nd.w, nd.h - s, -1,-1,0,0,0,0};
-            nodes[sel].left = ncount; nodes[sel].right = sel; nodes[ncount].left = nodes[ncount].right = -1; ncount++;
-        } else {
-            int minSplit = 3, maxSplit = nd.w - 3;
-            if (maxSplit <= minSplit) continue;
-            int s = minSplit + rand() % (maxSplit - minSplit + 1);
-            nodes[ncount] = (BSPNode){nd.x, nd.y, s, nd.h, -1,-1,0,0,0,0};
-            nodes[sel] = (BSPNode){nd.x + s, nd.y, nd.w - s, nd.h, -1,-1,0,0,0,0};
-            nodes[sel].left = ncount; nodes[sel].right = sel; nodes[ncount].left = nodes[ncount].right = -1; ncount++;
-        }
-    }
+// Editing tools. A drag is one undo entry: the brush stroke stays open from
+// button down to button up, the shape tools and moves apply on release.
+typedef enum { TOOL_PAINT, TOOL_FILL, TOOL_RECT, TOOL_LINE, TOOL_SELECT } Tool;
+static const char *toolNames[] = { "paint", "fill", "rect", "line", "select" };
 
-    // create rooms in leaves (ellipse rooms to avoid strict rectangles)
-    for (int i=0;i<ncount;i++) if (nodes[i].left == -1 && nodes[i].right == -1) {
-        BSPNode *nd = &nodes[i];
-        int rw = max(3, nd->w - 2);
-        int rh = max(3, nd->h - 2);
-        int rx = nd->x + 1 + (rand() % (rw));
-        int ry = nd->y + 1 + (rand() % (rh));
-        int rw2 = (rw>3)?(3 + rand()%(rw-2)):rw;
-        int rh2 = (rh>3)?(3 + rand()%(rh-2)):rh;
-        if (rx + rw2 >= W-1) rw2 = W-2 - rx;
-        if (ry + rh2 >= H-1) rh2 = H-2 - ry;
-        nd->roomx = rx; nd->roomy = ry; nd->roomw = rw2; nd->roomh = rh2;
-        // carve an ellipse rather than a rectangle
-        double rxr = rw2 / 2.0; double ryr = rh2 / 2.0;
-        double cx = rx + rxr; double cy = ry + ryr;
-        for (int y=ry;y<ry+rh2;y++) for (int x=rx;x<rx+rw2;x++) {
-            double dx = (x + 0.5 - cx) / (rxr > 0 ? rxr : 1.0);
-            double dy = (y + 0.5 - cy) / (ryr > 0 ? ryr : 1.0);
-            if (dx*dx + dy*dy <= 1.0) m[x + W*y] = 0;
-        }
-    }
+static Tool tool = TOOL_PAINT;
+static bool dragging = false, movingSel = false;
+static int dragVal = 0;
+static int anchorX, anchorY, lastX, lastY; // drag start and newest cell
+static bool hasSel = false;
+static int selX0, selY0, selX1, selY1;     // inclusive
+static EditClip clip;
 
-    // use file-scope helpers find_center_x/ find_center_y
-
-    // connect rooms by walking internal nodes
-    for (int i=0;i<ncount;i++) {
-        if (nodes[i].left != -1 && nodes[i].right != -1) {
-            int x1 = find_center_x(nodes, nodes[i].left);
-            int y1 = find_center_y(nodes, nodes[i].left);
-            int x2 = find_center_x(nodes, nodes[i].right);
-            int y2 = find_center_y(nodes, nodes[i].right);
-            int cx = x1, cy = y1;
-            while (cx != x2) { m[cx + W*cy] = 0; cx += (x2>cx)?1:-1; }
-            while (cy != y2) { m[cx + W*cy] = 0; cy += (y2>cy)?1:-1; }
-        }
-    }
+static bool in_sel(int x, int y) {
+    return hasSel && x >= selX0 && x <= selX1 && y >= selY0 && y <= selY1;
+}
 
-    // apply cellular automata smoothing to reduce boxiness
-    int smoothPasses = 3;
-    for (int pass = 0; pass < smoothPasses; pass++) {
-        int *tmp = malloc(sizeof(int) * W * H);
-        if (!tmp) break;
-        for (int y=0;y<H;y++) for (int x=0;x<W;x++) tmp[x + W*y] = m[x + W*y];
-        for (int y=1;y<H-1;y++) for (int x=1;x<W-1;x++) {
-            int floors = 0;
-            for (int yy=-1; yy<=1; yy++) for (int xx=-1; xx<=1; xx++) if (m[(x+xx) + W*(y+yy)] == 0) floors++;
-            // if many neighboring floors, become floor; else wall
-            if (floors >= 5) tmp[x + W*y] = 0; else tmp[x + W*y] = 1;
-        }
-        free(m);
-        m = tmp;
+static void drag_begin(EditMap *em, int gx, int gy, int v, int brush) {
+    dragging = true;
+    dragVal = v;
+    anchorX = lastX = gx;
+    anchorY = lastY = gy;
+    movingSel = tool == TOOL_SELECT && in_sel(gx, gy);
+    if (tool == TOOL_PAINT) {
+        edit_begin(em);
+        edit_brush(em, gx, gy, brush, v);
+    } else if (tool == TOOL_FILL) {
+        edit_flood(em, gx, gy, v);
+        dragging = false;
     }
+}
 
-    // mark walls adjacent to floors as colored variants
-    for (int y=1;y<H-1;y++) for (int x=1;x<W-1;x++) {
-        if (m[x + W*y] == 1) {
-            bool adj = false; for (int yy=-1;yy<=1 && !adj;yy++) for (int xx=-1;xx<=1 && !adj;xx++) if (m[(x+xx) + W*(y+yy)] == 0) adj = true;
-            if (adj) m[x + W*y] = ((x/6 + y/6) % 3) + 1;
-        }
+static void drag_to(EditMap *em, int gx, int gy, int brush) {
+    if (tool == TOOL_PAINT) edit_stroke(em, lastX, lastY, gx, gy, brush, dragVal);
+    lastX = gx;
+    lastY = gy;
+}
+
+static void drag_end(EditMap *em, int brush) {
+    if (!dragging) return;
+    dragging = false;
+    int x0 = anchorX < lastX ? anchorX : lastX, x1 = anchorX < lastX ? lastX : anchorX;
+    int y0 = anchorY < lastY ? anchorY : lastY, y1 = anchorY < lastY ? lastY : anchorY;
+    if (tool == TOOL_PAINT) edit_end(em);
+    else if (tool == TOOL_RECT) edit_fill_rect(em, x0, y0, x1, y1, dragVal);
+    else if (tool == TOOL_LINE) edit_line(em, anchorX, anchorY, lastX, lastY, brush, dragVal);
+    else if (tool == TOOL_SELECT && movingSel) {
+        int dx = lastX - anchorX, dy = lastY - anchorY;
+        edit_move(em, selX0, selY0, selX1, selY1, dx, dy, 0);
+        selX0 += dx; selX1 += dx; selY0 += dy; selY1 += dy;
+        movingSel = false;
+    } else if (tool == TOOL_SELECT) {
+        hasSel = true;
+        selX0 = x0; selY0 = y0; selX1 = x1; selY1 = y1;
     }
-    return m;
+}
+
+// the save running in the background, if any
+static EditSave *saving = NULL;
+static const char *savePath = NULL;
+
+static bool saving_finish(void) {
+    bool ok = edit_save_finish(saving);
+    saving = NULL;
+    return ok;
+}
+
+static void save_report(bool ok) {
+    if (ok) printf("Saved %s\n", savePath);
+    else fprintf(stderr, "Failed to save %s\n", savePath);
+}
+
+static void show_status(SDL_Window *win, int paintVal, int brush, int complexity, unsigned seed) {
+    char buf[192];
+    snprintf(buf, sizeof(buf), "Map Editor - %s paint=%d brush=%d complexity=%d seed=%u undo=%d redo=%d (%zu KB)",
+             toolNames[tool], paintVal, brush, complexity, seed, edit_undo_count(), edit_redo_count(), edit_history_bytes() / 1024);
+    SDL_SetWindowTitle(win, buf);
 }
 
 int main(int argc, char **argv) {
     const char *outpath = "maps/custom.map";
-    int W = 24, H = 24;
-    int *map = NULL;
+    EditMap em = { NULL, 24, 24 };
 
     // If a path was provided, try to load it. Otherwise prompt for size.
     const char *loadpath = NULL;
@@ -195,25 +216,13 @@ int main(int argc, char **argv) {
         printf("Map Editor\nEnter width and height (e.g. '24 24') or press Enter for default (24 24): ");
         if (fgets(buf, sizeof(buf), stdin)) {
             int a=0,b=0;
-            if (sscanf(buf, "%d %d", &a, &b) == 2 && a > 0 && b > 0) { W = a; H = b; }
-        }
-    }
-    map = calloc(W*H, sizeof(int));
-    if (!map) return 1;
-
-    if (loadpath) {
-        FILE *f = fopen(loadpath, "r");
-        if (f) {
-            int rw, rh;
-            if (fscanf(f, "%d %d", &rw, &rh) == 2) {
-                int *m = realloc(map, sizeof(int)*rw*rh);
-                if (m) map = m;
-                W = rw; H = rh;
-                for (int y=0;y<H;y++) for (int x=0;x<W;x++) fscanf(f, "%d", &map[x + W*y]);
-            }
-            fclose(f);
+            if (sscanf(buf, "%d %d", &a, &b) == 2 && a > 0 && b > 0) { em.W = a; em.H = b; }
         }
     }
+    em.cells = calloc(em.W*em.H, sizeof(int));
+    if (!em.cells) return 1;
+
+    if (loadpath) edit_load(loadpath, &em, &doc);
 
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         fprintf(stderr, "SDL init: %s\n", SDL_GetError());
@@ -221,50 +230,45 @@ int main(int argc, char **argv) {
     }
 
     int cell = 32;
-    SDL_Window *win = SDL_CreateWindow("Map Editor", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, W*cell, H*cell, SDL_WINDOW_RESIZABLE);
+    SDL_Window *win = SDL_CreateWindow("Map Editor", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, em.W*cell, em.H*cell, SDL_WINDOW_RESIZABLE);
     SDL_Renderer *ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED);
 
     int paintVal = 1;
     int brush = 1;
     int complexity = 8;
     unsigned int gen_seed = (unsigned int)time(NULL);
-    int prev_gx = -1, prev_gy = -1;
     int running = 1;
     // initial window title
     char titlebuf[128];
-    snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d undo=%d redo=%d", paintVal, brush, undoCount, redoCount);
-    SDL_SetWindowTitle(win, titlebuf);
+    show_status(win, paintVal, brush, complexity, gen_seed);
     while (running) {
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             if (e.type == SDL_QUIT) running = 0;
             if (e.type == SDL_KEYDOWN) {
-                if (e.key.keysym.sym == SDLK_ESCAPE) running = 0;
+                // keys act on a settled map: finish the drag where it is
+                drag_end(&em, brush);
+                // Esc closes the thumbnails or cancels a generation before it quits
+                if (e.key.keysym.sym == SDLK_ESCAPE) {
+                    if (batchOpen) batch_close();
+                    else if (genSingle.job) slot_stop(&genSingle);
+                    else running = 0;
+                }
                 if (e.key.keysym.sym == SDLK_s) {
                     // require Ctrl+S to save
                     SDL_Keymod mods = SDL_GetModState();
                     if (mods & KMOD_CTRL) {
-                        const char *savepath = outpath;
-                        if (argc > 1) savepath = argv[1];
-                        // ensure directory exists
-                        char dir[512];
-                        strncpy(dir, savepath, sizeof(dir)-1);
-                        dir[sizeof(dir)-1] = '\0';
-                        for (int i = (int)strlen(dir)-1; i>=0; --i) {
-                            if (dir[i] == '/') { dir[i] = '\0'; break; }
-                        }
-                        if (strlen(dir) > 0) mkdir(dir, 0755);
-                        FILE *f = fopen(savepath, "w");
-                        if (f) {
-                            fprintf(f, "%d %d\n", W, H);
-                            for (int y=0;y<H;y++){
-                                for (int x=0;x<W;x++) fprintf(f, "%d ", map[x + W*y]);
-                                fprintf(f, "\n");
-                            }
-                            fclose(f);
-                            printf("Saved %s\n", savepath);
+                        // Ctrl+Shift+S switches between the text and RLE formats
+                        if (mods & KMOD_SHIFT) doc.format = doc.format == EDIT_FORMAT_RLE ? EDIT_FORMAT_TEXT : EDIT_FORMAT_RLE;
+                        // one save at a time, so the file ends up with the newest
+                        if (saving) save_report(saving_finish());
+                        savePath = argc > 1 ? argv[1] : outpath;
+                        saving = edit_save_start(savePath, &em, &doc);
+                        if (saving) {
+                            snprintf(titlebuf, sizeof(titlebuf), "Map Editor - saving %s (%s)...", savePath, doc.format == EDIT_FORMAT_RLE ? "rle" : "text");
+                            SDL_SetWindowTitle(win, titlebuf);
                         } else {
-                            fprintf(stderr, "Failed to save %s\n", savepath);
+                            save_report(edit_save(savePath, &em, &doc));
                         }
                     } else {
                         printf("Hold Ctrl and press S to save.\n");
@@ -272,125 +276,160 @@ int main(int argc, char **argv) {
                 }
                     // Ctrl+Z undo, Ctrl+Y redo
                     SDL_Keymod mods = SDL_GetModState();
-                    if ((mods & KMOD_CTRL) && e.key.keysym.sym == SDLK_z) {
-                        if (do_undo(&map, &W, &H)) {
-                            snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d undo=%d redo=%d", paintVal, brush, undoCount, redoCount);
-                            SDL_SetWindowTitle(win, titlebuf);
-                        }
-                    }
-                    if ((mods & KMOD_CTRL) && e.key.keysym.sym == SDLK_y) {
-                        if (do_redo(&map, &W, &H)) {
-                            snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d undo=%d redo=%d", paintVal, brush, undoCount, redoCount);
-                            SDL_SetWindowTitle(win, titlebuf);
-                        }
-                    }
+                    if ((mods & KMOD_CTRL) && e.key.keysym.sym == SDLK_z) edit_undo(&em);
+                    if ((mods & KMOD_CTRL) && e.key.keysym.sym == SDLK_y) edit_redo(&em);
                     // brush size +/-
-                    if (e.key.keysym.sym == SDLK_EQUALS) { if (brush < 16) brush++; snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d undo=%d redo=%d", paintVal, brush, undoCount, redoCount); SDL_SetWindowTitle(win, titlebuf); }
-                    if (e.key.keysym.sym == SDLK_MINUS) { if (brush > 1) brush--; snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d undo=%d redo=%d", paintVal, brush, undoCount, redoCount); SDL_SetWindowTitle(win, titlebuf); }
+                    if (e.key.keysym.sym == SDLK_EQUALS) { if (brush < 16) brush++; }
+                    if (e.key.keysym.sym == SDLK_MINUS) { if (brush > 1) brush--; }
                 if (e.key.keysym.sym >= SDLK_0 && e.key.keysym.sym <= SDLK_9) {
                     int n = e.key.keysym.sym - SDLK_0;
                     paintVal = n;
                     printf("paint set to %d\n", paintVal);
                 }
-                // BSP controls: G generate, [ ] adjust complexity, R randomize seed
-                if (e.key.keysym.sym == SDLK_g) {
-                    push_undo(map, W, H);
-                    int *gen = generate_bsp(W, H, complexity, gen_seed);
-                    if (gen) { free(map); map = gen; }
-                    snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d complexity=%d seed=%u undo=%d redo=%d", paintVal, brush, complexity, gen_seed, undoCount, redoCount);
-                    SDL_SetWindowTitle(win, titlebuf);
+                // tools: P paint, F fill, T rectangle, L line, M select; Ctrl+C/X/V copy, cut, paste at the cursor
+                if (!(mods & KMOD_CTRL)) {
+                    if (e.key.keysym.sym == SDLK_p) tool = TOOL_PAINT;
+                    if (e.key.keysym.sym == SDLK_f) tool = TOOL_FILL;
+                    if (e.key.keysym.sym == SDLK_t) tool = TOOL_RECT;
+                    if (e.key.keysym.sym == SDLK_l) tool = TOOL_LINE;
+                    if (e.key.keysym.sym == SDLK_m) tool = TOOL_SELECT;
+                    if (tool != TOOL_SELECT) hasSel = false;
+                }
+                if ((mods & KMOD_CTRL) && (e.key.keysym.sym == SDLK_c || e.key.keysym.sym == SDLK_x) && hasSel) {
+                    edit_copy(&em, selX0, selY0, selX1, selY1, &clip);
+                    if (e.key.keysym.sym == SDLK_x) edit_fill_rect(&em, selX0, selY0, selX1, selY1, 0);
                 }
-                if (e.key.keysym.sym == SDLK_LEFTBRACKET) { if (complexity > 1) complexity--; snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d complexity=%d seed=%u undo=%d redo=%d", paintVal, brush, complexity, gen_seed, undoCount, redoCount); SDL_SetWindowTitle(win, titlebuf); }
-                if (e.key.keysym.sym == SDLK_RIGHTBRACKET) { if (complexity < 64) complexity++; snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d complexity=%d seed=%u undo=%d redo=%d", paintVal, brush, complexity, gen_seed, undoCount, redoCount); SDL_SetWindowTitle(win, titlebuf); }
-                if (e.key.keysym.sym == SDLK_r) { gen_seed = (unsigned int)time(NULL) ^ rand(); snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d complexity=%d seed=%u undo=%d redo=%d", paintVal, brush, complexity, gen_seed, undoCount, redoCount); SDL_SetWindowTitle(win, titlebuf); }
+                if ((mods & KMOD_CTRL) && e.key.keysym.sym == SDLK_v && clip.cells) {
+                    int mx, my; SDL_GetMouseState(&mx, &my);
+                    edit_paste(&em, &clip, mx / cell, my / cell);
+                }
+                // BSP controls: G generate, B pick from a batch of seeds, [ ] adjust complexity, R randomize seed
+                SDL_Keycode k = e.key.keysym.sym;
+                if (k == SDLK_g) slot_start(&genSingle, em.W, em.H, complexity, gen_seed);
+                if (k == SDLK_b) { if (batchOpen) batch_close(); else batch_open(em.W, em.H, complexity, gen_seed); }
+                if (k == SDLK_LEFTBRACKET) { if (complexity > 1) complexity--; }
+                if (k == SDLK_RIGHTBRACKET) { if (complexity < 64) complexity++; }
+                if (k == SDLK_r) { gen_seed = (unsigned int)time(NULL) ^ rand(); }
+                if (k == SDLK_LEFTBRACKET || k == SDLK_RIGHTBRACKET || k == SDLK_r) {
+                    // new parameters: whatever is generating starts over with them
+                    if (genSingle.job) slot_start(&genSingle, em.W, em.H, complexity, gen_seed);
+                    if (batchOpen) batch_open(em.W, em.H, complexity, gen_seed);
+                }
+                if (!genSingle.job && !batchOpen) show_status(win, paintVal, brush, complexity, gen_seed);
             }
-            if (e.type == SDL_MOUSEBUTTONDOWN) {
-                int mx,my;
-                SDL_GetMouseState(&mx,&my);
-                int winW, winH; SDL_GetWindowSize(win,&winW,&winH);
-                int cols = winW / cell; int rows = winH / cell;
-                int gx = mx / cell; int gy = my / cell;
-                if (gx >=0 && gx < cols && gy >=0 && gy < rows) {
-                        // push undo snapshot before making changes
-                        push_undo(map, W, H);
-                        // ensure map resized if window bigger
-                        if (cols != W || rows != H) {
-                            int *m = realloc(map, sizeof(int)*cols*rows);
-                            if (m) {
-                                // initialize new cells to 0
-                                for (int y=0;y<rows;y++) for (int x=0;x<cols;x++) if (x>=W || y>=H) m[x + cols*y] = 0;
-                                map = m; W = cols; H = rows;
-                            }
-                        }
-                        int half = brush/2;
-                        for (int oy = -half; oy <= half; oy++) for (int ox = -half; ox <= half; ox++) {
-                            int tx = gx + ox; int ty = gy + oy;
-                            if (tx>=0 && tx < W && ty>=0 && ty < H) {
-                                if (e.button.button == SDL_BUTTON_LEFT) map[tx + W*ty] = paintVal;
-                                else if (e.button.button == SDL_BUTTON_RIGHT) map[tx + W*ty] = 0;
-                            }
-                        }
-                        prev_gx = gx; prev_gy = gy;
-                        snprintf(titlebuf, sizeof(titlebuf), "Map Editor - paint=%d brush=%d undo=%d redo=%d", paintVal, brush, undoCount, redoCount);
-                        SDL_SetWindowTitle(win, titlebuf);
+            if (e.type == SDL_MOUSEBUTTONDOWN && batchOpen) {
+                // pick a finished thumbnail
+                SDL_Point p = { e.button.x, e.button.y };
+                for (int i = 0; i < GEN_BATCH; i++) {
+                    if (!SDL_PointInRect(&p, &genBatch[i].rect) || !slot_accept(&genBatch[i], &em)) continue;
+                    gen_seed = genBatch[i].seed;
+                    batch_close();
+                    show_status(win, paintVal, brush, complexity, gen_seed);
+                    break;
                 }
-            } else if (e.type == SDL_MOUSEMOTION && (SDL_GetMouseState(NULL,NULL) & SDL_BUTTON(SDL_BUTTON_LEFT))) {
+            } else if ((genSingle.job || batchOpen) && (e.type == SDL_MOUSEBUTTONDOWN || e.type == SDL_MOUSEMOTION)) {
+                // the map isn't on screen; no painting until the generation lands
+            } else if (e.type == SDL_MOUSEBUTTONDOWN && !dragging && (e.button.button == SDL_BUTTON_LEFT || e.button.button == SDL_BUTTON_RIGHT)) {
                 int mx,my;
                 SDL_GetMouseState(&mx,&my);
                 int winW, winH; SDL_GetWindowSize(win,&winW,&winH);
                 int cols = winW / cell; int rows = winH / cell;
                 int gx = mx / cell; int gy = my / cell;
                 if (gx >=0 && gx < cols && gy >=0 && gy < rows) {
-                        // first time dragging after press should have pushed undo; we push on buttondown only
-                        if (cols != W || rows != H) {
-                            int *m = realloc(map, sizeof(int)*cols*rows);
-                            if (m) {
-                                for (int y=0;y<rows;y++) for (int x=0;x<cols;x++) if (x>=W || y>=H) m[x + cols*y] = 0;
-                                map = m; W = cols; H = rows;
-                            }
-                        }
-                        // draw line from prev to current (Bresenham) for diagonal strokes
-                        if (prev_gx < 0) { prev_gx = gx; prev_gy = gy; }
-                        int x0 = prev_gx, y0 = prev_gy, x1 = gx, y1 = gy;
-                        int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
-                        int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
-                        int err = dx + dy;
-                        while (1) {
-                            int half = brush/2;
-                            for (int oy = -half; oy <= half; oy++) for (int ox = -half; ox <= half; ox++) {
-                                int tx = x0 + ox; int ty = y0 + oy;
-                                if (tx>=0 && tx < W && ty>=0 && ty < H) map[tx + W*ty] = paintVal;
-                            }
-                            if (x0 == x1 && y0 == y1) break;
-                            int e2 = 2 * err;
-                            if (e2 >= dy) { err += dy; x0 += sx; }
-                            if (e2 <= dx) { err += dx; y0 += sy; }
-                        }
-                        prev_gx = gx; prev_gy = gy;
+                        // ensure map resized if window bigger
+                        edit_resize(&em, cols, rows);
+                        drag_begin(&em, gx, gy, e.button.button == SDL_BUTTON_LEFT ? paintVal : 0, brush);
+                        show_status(win, paintVal, brush, complexity, gen_seed);
                 }
+            } else if (e.type == SDL_MOUSEMOTION && dragging) {
+                int gx = e.motion.x / cell; int gy = e.motion.y / cell;
+                if (gx < 0) gx = 0;
+                if (gy < 0) gy = 0;
+                if (gx >= em.W) gx = em.W - 1;
+                if (gy >= em.H) gy = em.H - 1;
+                drag_to(&em, gx, gy, brush);
+            } else if (e.type == SDL_MOUSEBUTTONUP && dragging) {
+                drag_end(&em, brush);
+                show_status(win, paintVal, brush, complexity, gen_seed);
+            }
+        }
+
+        if (saving && edit_save_done(saving)) {
+            save_report(saving_finish());
+            show_status(win, paintVal, brush, complexity, gen_seed);
+        }
+        // pick up whatever the generators produced since the last frame
+        reap_retired();
+        if (genSingle.job) {
+            BspStage prevStage = genSingle.stage;
+            bsp_job_preview(genSingle.job, genSingle.preview, &genSingle.seen, &genSingle.stage);
+            if (bsp_job_done(genSingle.job)) {
+                slot_accept(&genSingle, &em);
+                slot_stop(&genSingle);
+                show_status(win, paintVal, brush, complexity, gen_seed);
+            } else if (genSingle.stage != prevStage || genSingle.seen == 1) {
+                snprintf(titlebuf, sizeof(titlebuf), "Map Editor - generating seed=%u: %s (Esc cancels)", genSingle.seed, bsp_stage_name(genSingle.stage));
+                SDL_SetWindowTitle(win, titlebuf);
+            }
+        }
+        int batchDone = 0;
+        if (batchOpen) {
+            for (int i = 0; i < GEN_BATCH; i++) {
+                GenSlot *sl = &genBatch[i];
+                if (!sl->job) continue;
+                if (bsp_job_preview(sl->job, sl->preview, &sl->seen, &sl->stage)) slot_thumb(ren, sl);
+                batchDone += bsp_job_done(sl->job);
             }
         }
 
         int winW, winH; SDL_GetWindowSize(win,&winW,&winH);
         SDL_SetRenderDrawColor(ren, 32,32,32,255);
         SDL_RenderClear(ren);
+        if (batchOpen) {
+            // thumbnails in a grid, each fitted to its cell with the map's aspect
+            int bcols = GEN_BATCH_COLS, brows = (GEN_BATCH + GEN_BATCH_COLS - 1) / GEN_BATCH_COLS;
+            int cw = winW / bcols, ch = winH / brows;
+            for (int i = 0; i < GEN_BATCH; i++) {
+                GenSlot *sl = &genBatch[i];
+                SDL_Rect box = { (i % bcols) * cw + 8, (i / bcols) * ch + 8, cw - 16, ch - 16 };
+                if (sl->W > 0 && sl->H > 0) {
+                    if (box.w * sl->H > box.h * sl->W) { int w = box.h * sl->W / sl->H; box.x += (box.w - w) / 2; box.w = w; }
+                    else { int h = box.w * sl->H / sl->W; box.y += (box.h - h) / 2; box.h = h; }
+                }
+                sl->rect = box;
+                if (sl->thumb) SDL_RenderCopy(ren, sl->thumb, NULL, &box);
+                // finished ones get a bright frame
+                bool done = sl->job && bsp_job_done(sl->job);
+                SDL_SetRenderDrawColor(ren, done ? 255 : 90, done ? 255 : 90, done ? 255 : 90, 255);
+                SDL_RenderDrawRect(ren, &box);
+            }
+            snprintf(titlebuf, sizeof(titlebuf), "Map Editor - batch seeds %u..%u: %d/%d done, click one (Esc closes)", genBatch[0].seed, genBatch[0].seed + GEN_BATCH - 1, batchDone, GEN_BATCH);
+            SDL_SetWindowTitle(win, titlebuf);
+            SDL_RenderPresent(ren);
+            SDL_Delay(16);
+            continue;
+        }
+        // while generating, the grid shows the newest stage instead of the map
+        const int *shown = genSingle.job ? genSingle.preview : em.cells;
+        int sw = genSingle.job ? genSingle.W : em.W, sh = genSingle.job ? genSingle.H : em.H;
         int cols = winW / cell; int rows = winH / cell;
-        for (int y=0;y<rows;y++){
-            for (int x=0;x<cols;x++){
-                int v = 0;
-                if (x < W && y < H) v = map[x + W*y];
-                if (v == 0) SDL_SetRenderDrawColor(ren, 50,50,50,255);
-                else if (v == 1) SDL_SetRenderDrawColor(ren, 200,0,0,255);
-                else if (v == 2) SDL_SetRenderDrawColor(ren, 0,200,0,255);
-                else if (v == 3) SDL_SetRenderDrawColor(ren, 0,0,200,255);
-                SDL_Rect r = { x*cell, y*cell, cell-1, cell-1 };
-                SDL_RenderFillRect(ren, &r);
+        edit_draw_grid(ren, shown, sw, sh, cols, rows, cell);
+        // shape being dragged, selection and where a move would put it
+        if (!genSingle.job) {
+            SDL_SetRenderDrawColor(ren, 255,220,0,255);
+            if (dragging && tool == TOOL_LINE) {
+                SDL_RenderDrawLine(ren, anchorX*cell + cell/2, anchorY*cell + cell/2, lastX*cell + cell/2, lastY*cell + cell/2);
+            } else if (dragging && (tool == TOOL_RECT || (tool == TOOL_SELECT && !movingSel))) {
+                int x0 = anchorX < lastX ? anchorX : lastX, y0 = anchorY < lastY ? anchorY : lastY;
+                SDL_Rect r = { x0*cell, y0*cell, (abs(lastX - anchorX) + 1)*cell, (abs(lastY - anchorY) + 1)*cell };
+                SDL_RenderDrawRect(ren, &r);
+            }
+            if (hasSel) {
+                int dx = movingSel ? lastX - anchorX : 0, dy = movingSel ? lastY - anchorY : 0;
+                SDL_Rect r = { (selX0 + dx)*cell, (selY0 + dy)*cell, (selX1 - selX0 + 1)*cell, (selY1 - selY0 + 1)*cell };
+                SDL_RenderDrawRect(ren, &r);
             }
         }
-        // draw grid lines
-        SDL_SetRenderDrawColor(ren, 24,24,24,255);
-        for (int gx=0; gx<=cols; gx++) SDL_RenderDrawLine(ren, gx*cell, 0, gx*cell, rows*cell);
-        for (int gy=0; gy<=rows; gy++) SDL_RenderDrawLine(ren, 0, gy*cell, cols*cell, gy*cell);
         // highlight hovered cell
         int mx, my; SDL_GetMouseState(&mx,&my);
         int hx = mx / cell; int hy = my / cell;
@@ -405,12 +444,19 @@ int main(int argc, char **argv) {
         SDL_Delay(16);
     }
 
+    // a save still writing has to land before the process goes
+    if (saving) save_report(saving_finish());
+    batch_close();
+    slot_stop(&genSingle);
+    for (int i = 0; i < retiredCount; i++) bsp_job_free(retired[i]);
+    retiredCount = 0;
     SDL_DestroyRenderer(ren);
     SDL_DestroyWindow(win);
     SDL_Quit();
-    // free undo/redo stacks
-    for (int i=0;i<undoCount;i++) free_snap(&undoStack[i]);
-    for (int i=0;i<redoCount;i++) free_snap(&redoStack[i]);
-    free(map);
+    drag_end(&em, brush);
+    edit_history_free();
+    edit_clip_free(&clip);
+    free(em.cells);
+    edit_doc_free(&doc);
     return 0;
 }
@@ -0,0 +1,359 @@
+#include "capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPTURE_QUEUE 64 // pending frames; repeats need no buffer, so this exceeds CAPTURE_BUFFERS
+
+static const char captureMagic[4] = { 'G', '9', '0', 'V' };
+
+typedef struct CaptureItem {
+    int buf;       // -1 for a repeat
+    Uint32 frame;
+} CaptureItem;
+
+struct Capture {
+    FILE *f;
+    int w, h;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *wake;
+    SDL_cond *freed;
+    // guarded by lock
+    Uint32 *buffers[CAPTURE_BUFFERS];
+    int freeList[CAPTURE_BUFFERS];
+    int freeCount;
+    CaptureItem queue[CAPTURE_QUEUE];
+    int head, len;
+    bool quit, failed;
+    bool lastKept;     // the previous submitted frame was queued
+    CaptureStats stats;
+    // encoder thread only
+    Uint32 *prev;  // last written frame, swapped with the buffer that replaces it
+    Uint32 *diff;
+    Uint8 *out;
+    int sinceKey;
+};
+
+static double now_ms(void) {
+    return (double)SDL_GetPerformanceCounter() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static Uint8 *put_u32(Uint8 *o, Uint32 v) {
+    o[0] = (Uint8)v; o[1] = (Uint8)(v >> 8); o[2] = (Uint8)(v >> 16); o[3] = (Uint8)(v >> 24);
+    return o + 4;
+}
+
+static Uint8 *put_varint(Uint8 *o, Uint32 v) {
+    while (v >= 0x80) {
+        *o++ = (Uint8)((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    *o++ = (Uint8)v;
+    return o;
+}
+
+static Uint8 *put_literals(Uint8 *o, const Uint32 *px, Uint32 n) {
+    o = put_varint(o, n << 1);
+    for (Uint32 i = 0; i < n; i++) o = put_u32(o, px[i]);
+    return o;
+}
+
+// run coding; runs shorter than 3 pixels cost more than they save
+static size_t put_runs(Uint8 *out, const Uint32 *px, Uint32 n) {
+    Uint8 *o = out;
+    Uint32 i = 0, lit = 0;
+    while (i < n) {
+        Uint32 j = i + 1;
+        while (j < n && px[j] == px[i]) j++;
+        if (j - i >= 3) {
+            if (lit) o = put_literals(o, px + i - lit, lit);
+            lit = 0;
+            o = put_varint(o, ((j - i) << 1) | 1);
+            o = put_u32(o, px[i]);
+        } else {
+            lit += j - i;
+        }
+        i = j;
+    }
+    if (lit) o = put_literals(o, px + n - lit, lit);
+    return (size_t)(o - out);
+}
+
+static bool write_frame(Capture *c, Uint32 frame, int type, const Uint8 *payload, size_t size) {
+    Uint8 head[9];
+    put_u32(head, frame);
+    head[4] = (Uint8)type;
+    put_u32(head + 5, (Uint32)size);
+    if (fwrite(head, 1, sizeof(head), c->f) != sizeof(head)) return false;
+    if (size && fwrite(payload, 1, size, c->f) != size) return false;
+    return true;
+}
+
+static int encoder_main(void *arg) {
+    Capture *c = arg;
+    size_t n = (size_t)c->w * c->h;
+    SDL_LockMutex(c->lock);
+    for (;;) {
+        while (!c->quit && c->len == 0) SDL_CondWait(c->wake, c->lock);
+        if (c->len == 0) break; // quit with nothing left to write
+        CaptureItem it = c->queue[c->head];
+        c->head = (c->head + 1) % CAPTURE_QUEUE;
+        c->len--;
+        bool failed = c->failed;
+        SDL_UnlockMutex(c->lock);
+
+        double t0 = now_ms();
+        size_t size = 0;
+        int type = CAPTURE_REPEAT;
+        if (it.buf >= 0) {
+            Uint32 *cur = c->buffers[it.buf];
+            if (c->sinceKey == 0) {
+                type = CAPTURE_KEY;
+                size = put_runs(c->out, cur, (Uint32)n);
+            } else {
+                type = CAPTURE_DELTA;
+                for (size_t i = 0; i < n; i++) c->diff[i] = cur[i] ^ c->prev[i];
+                size = put_runs(c->out, c->diff, (Uint32)n);
+            }
+            c->sinceKey = (c->sinceKey + 1) % CAPTURE_KEY_INTERVAL;
+            // the new frame becomes the reference; the old reference goes back into the pool
+            c->buffers[it.buf] = c->prev;
+            c->prev = cur;
+        }
+        bool ok = failed || write_frame(c, it.frame, type, c->out, size);
+        double ms = now_ms() - t0;
+
+        SDL_LockMutex(c->lock);
+        if (it.buf >= 0) {
+            c->freeList[c->freeCount++] = it.buf;
+            SDL_CondSignal(c->freed);
+        }
+        if (!ok && !c->failed) {
+            fprintf(stderr, "capture: write failed, later frames are discarded\n");
+            c->failed = true;
+        }
+        if (!failed && ok) {
+            c->stats.written++;
+            c->stats.bytes += 9 + size;
+        }
+        c->stats.encodeMs += ms;
+    }
+    SDL_UnlockMutex(c->lock);
+    return 0;
+}
+
+static void capture_free(Capture *c) {
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) free(c->buffers[i]);
+    free(c->prev);
+    free(c->diff);
+    free(c->out);
+    if (c->wake) SDL_DestroyCond(c->wake);
+    if (c->freed) SDL_DestroyCond(c->freed);
+    if (c->lock) SDL_DestroyMutex(c->lock);
+    if (c->f) fclose(c->f);
+    free(c);
+}
+
+Capture *capture_start(const char *path, int w, int h) {
+    if (w <= 0 || h <= 0 || w > 0xFFFF || h > 0xFFFF || (size_t)w * h > (1u << 28)) {
+        fprintf(stderr, "capture: unsupported frame size %dx%d\n", w, h);
+        return NULL;
+    }
+    Capture *c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->w = w;
+    c->h = h;
+    size_t n = (size_t)w * h;
+    bool ok = true;
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        c->buffers[i] = malloc(sizeof(Uint32) * n);
+        ok = ok && c->buffers[i];
+        c->freeList[c->freeCount++] = i;
+    }
+    c->prev = malloc(sizeof(Uint32) * n);
+    c->diff = malloc(sizeof(Uint32) * n);
+    // worst case is all literals: 4 bytes a pixel plus a varint per literal run
+    // (a run of 3 or more ends each one, so there are at most n/4 + 1 of them)
+    c->out = malloc(4 * n + 5 * (n / 4 + 1));
+    c->lock = SDL_CreateMutex();
+    c->wake = SDL_CreateCond();
+    c->freed = SDL_CreateCond();
+    if (!ok || !c->prev || !c->diff || !c->out || !c->lock || !c->wake || !c->freed) {
+        fprintf(stderr, "capture: failed to allocate buffers for %dx%d\n", w, h);
+        capture_free(c);
+        return NULL;
+    }
+    c->f = fopen(path, "wb");
+    if (!c->f) {
+        fprintf(stderr, "capture: cannot create %s\n", path);
+        capture_free(c);
+        return NULL;
+    }
+    Uint8 head[9];
+    memcpy(head, captureMagic, 4);
+    head[4] = CAPTURE_VERSION;
+    head[5] = (Uint8)w; head[6] = (Uint8)(w >> 8);
+    head[7] = (Uint8)h; head[8] = (Uint8)(h >> 8);
+    fwrite(head, 1, sizeof(head), c->f);
+    c->thread = SDL_CreateThread(encoder_main, "capture", c);
+    if (!c->thread) {
+        fprintf(stderr, "capture: failed to start the encoder thread: %s\n", SDL_GetError());
+        capture_free(c);
+        return NULL;
+    }
+    return c;
+}
+
+static void submit_done(Capture *c, double t0) {
+    double ms = now_ms() - t0;
+    c->stats.submitMs += ms;
+    if (ms > c->stats.submitMaxMs) c->stats.submitMaxMs = ms;
+}
+
+bool capture_frame(Capture *c, const Uint32 *pixels, int pitch, int flags) {
+    double t0 = now_ms();
+    SDL_LockMutex(c->lock);
+    c->stats.submitted++;
+    Uint32 frame = c->stats.submitted - 1;
+    // a repeat refers to the previous frame, so that one must have been kept
+    if ((flags & CAPTURE_SAME) && c->lastKept && c->len < CAPTURE_QUEUE) {
+        c->queue[(c->head + c->len) % CAPTURE_QUEUE] = (CaptureItem){ -1, frame };
+        c->len++;
+        submit_done(c, t0);
+        SDL_CondSignal(c->wake);
+        SDL_UnlockMutex(c->lock);
+        return true;
+    }
+    while ((flags & CAPTURE_WAIT) && c->freeCount == 0) SDL_CondWait(c->freed, c->lock);
+    if (c->freeCount == 0 || c->len == CAPTURE_QUEUE) {
+        c->stats.dropped++;
+        c->lastKept = false;
+        submit_done(c, t0);
+        SDL_UnlockMutex(c->lock);
+        return false;
+    }
+    int buf = c->freeList[--c->freeCount];
+    SDL_UnlockMutex(c->lock);
+
+    // the copy is the only per-frame work on this thread
+    Uint32 *dst = c->buffers[buf];
+    if (pitch == c->w) {
+        memcpy(dst, pixels, sizeof(Uint32) * (size_t)c->w * c->h);
+    } else {
+        for (int y = 0; y < c->h; y++) memcpy(dst + (size_t)y * c->w, pixels + (size_t)y * pitch, sizeof(Uint32) * c->w);
+    }
+
+    SDL_LockMutex(c->lock);
+    c->queue[(c->head + c->len) % CAPTURE_QUEUE] = (CaptureItem){ buf, frame };
+    c->len++;
+    c->lastKept = true;
+    submit_done(c, t0);
+    SDL_CondSignal(c->wake);
+    SDL_UnlockMutex(c->lock);
+    return true;
+}
+
+void capture_stats(Capture *c, CaptureStats *out) {
+    SDL_LockMutex(c->lock);
+    *out = c->stats;
+    SDL_UnlockMutex(c->lock);
+}
+
+bool capture_stop(Capture *c, CaptureStats *out) {
+    if (!c) return false;
+    SDL_LockMutex(c->lock);
+    c->quit = true;
+    SDL_CondSignal(c->wake);
+    SDL_UnlockMutex(c->lock);
+    SDL_WaitThread(c->thread, NULL);
+    if (out) *out = c->stats;
+    bool ok = !c->failed && !ferror(c->f);
+    if (fclose(c->f) != 0) ok = false;
+    c->f = NULL;
+    if (!ok) fprintf(stderr, "capture: write failed\n");
+    capture_free(c);
+    return ok;
+}
+
+static bool get_u32(CaptureReader *r, Uint32 *v) {
+    if (r->size - r->pos < 4) return false;
+    const Uint8 *b = r->data + r->pos;
+    *v = (Uint32)b[0] | (Uint32)b[1] << 8 | (Uint32)b[2] << 16 | (Uint32)b[3] << 24;
+    r->pos += 4;
+    return true;
+}
+
+static bool get_varint(CaptureReader *r, size_t end, Uint32 *v) {
+    *v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (r->pos >= end) return false;
+        Uint8 b = r->data[r->pos++];
+        *v |= (Uint32)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool capture_open(CaptureReader *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "capture: cannot open %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    r->data = len > 0 ? malloc((size_t)len) : NULL;
+    r->size = r->data && fread(r->data, 1, (size_t)len, f) == (size_t)len ? (size_t)len : 0;
+    fclose(f);
+    if (r->size < 9 || memcmp(r->data, captureMagic, 4) != 0 || r->data[4] != CAPTURE_VERSION) {
+        fprintf(stderr, "capture: %s is not a version %d capture\n", path, CAPTURE_VERSION);
+        capture_close(r);
+        return false;
+    }
+    r->w = r->data[5] | r->data[6] << 8;
+    r->h = r->data[7] | r->data[8] << 8;
+    r->pos = 9;
+    r->pixels = calloc((size_t)r->w * r->h, sizeof(Uint32));
+    if (!r->pixels || r->w == 0 || r->h == 0) {
+        fprintf(stderr, "capture: bad frame size %dx%d in %s\n", r->w, r->h, path);
+        capture_close(r);
+        return false;
+    }
+    return true;
+}
+
+bool capture_next(CaptureReader *r) {
+    Uint32 frame, size;
+    if (r->size - r->pos < 9 || !get_u32(r, &frame)) return false;
+    int type = r->data[r->pos++];
+    if (!get_u32(r, &size) || size > r->size - r->pos || type > CAPTURE_REPEAT) return false;
+    size_t end = r->pos + size, n = (size_t)r->w * r->h, i = 0;
+    while (r->pos < end) {
+        Uint32 v, count, px = 0;
+        if (!get_varint(r, end, &v)) return false;
+        count = v >> 1;
+        if (count > n - i) return false;
+        if (v & 1) {
+            if (!get_u32(r, &px)) return false;
+        } else if ((size_t)count * 4 > end - r->pos) {
+            return false;
+        }
+        for (Uint32 k = 0; k < count; k++, i++) {
+            if (!(v & 1) && !get_u32(r, &px)) return false;
+            r->pixels[i] = type == CAPTURE_KEY ? px : r->pixels[i] ^ px;
+        }
+    }
+    if (type != CAPTURE_REPEAT && i != n) return false;
+    r->frame = frame;
+    return true;
+}
+
+void capture_close(CaptureReader *r) {
+    free(r->data);
+    free(r->pixels);
+    memset(r, 0, sizeof(*r));
+}
@@ -0,0 +1,61 @@
+#ifndef GAME_CAPTURE_H
+#define GAME_CAPTURE_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Frame capture to disk. The caller's thread only copies the frame into one
+// of a few recycled buffers; a background thread compresses and writes it.
+// When every buffer is still waiting for the encoder the frame is dropped.
+//
+// File layout: "G90V", version byte, u16 width, u16 height, then per frame
+//   u32 frame number, u8 type, u32 payload size, payload
+// (little-endian). A key frame codes the pixels, a delta frame their XOR
+// with the previous written frame, and a repeat frame has no payload.
+// Payloads are runs: varint v, then v>>1 pixels as u32 if v is even
+// (literals), or one u32 repeated v>>1 times if v is odd.
+// Frame numbers count submitted frames, so drops show up as gaps.
+
+#define CAPTURE_VERSION 1
+#define CAPTURE_BUFFERS 4
+#define CAPTURE_KEY_INTERVAL 120 // written frames between key frames
+
+enum { CAPTURE_KEY, CAPTURE_DELTA, CAPTURE_REPEAT };    // frame types
+enum { CAPTURE_SAME = 1, CAPTURE_WAIT = 2 };           // capture_frame flags
+
+typedef struct CaptureStats {
+    Uint32 submitted, written, dropped;
+    Uint64 bytes;        // compressed payload and frame headers
+    double submitMs;     // total time the caller spent in capture_frame
+    double submitMaxMs;
+    double encodeMs;     // total encoder thread time
+} CaptureStats;
+
+typedef struct Capture Capture;
+
+// NULL on failure; w x h is fixed for the whole capture
+Capture *capture_start(const char *path, int w, int h);
+// queue a copy of the frame (pitch in pixels); false if it was dropped.
+// CAPTURE_SAME: identical to the previous frame, recorded without a copy
+// when that one was kept. CAPTURE_WAIT: block on a full pool instead of
+// dropping, for offline captures that must keep every frame.
+bool capture_frame(Capture *c, const Uint32 *pixels, int pitch, int flags);
+void capture_stats(Capture *c, CaptureStats *out);
+// drains the queue and closes the file; false if writing failed
+bool capture_stop(Capture *c, CaptureStats *out);
+
+// sequential reader, for tools and the bench's round trip
+typedef struct CaptureReader {
+    Uint8 *data;
+    size_t size, pos;
+    int w, h;
+    Uint32 *pixels;      // the last decoded frame
+    Uint32 frame;        // its number
+} CaptureReader;
+
+bool capture_open(CaptureReader *r, const char *path);
+// decodes the next frame into r->pixels; false at the end or on a bad frame
+bool capture_next(CaptureReader *r);
+void capture_close(CaptureReader *r);
+
+#endif
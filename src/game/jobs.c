@@ -0,0 +1,174 @@
+#include "jobs.h"
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+#define JOBS_MAX_WORKERS 32
+#define JOBS_QUEUE_MAX 4096
+
+static SDL_Thread *workers[JOBS_MAX_WORKERS];
+static int workerCount = 0;
+static SDL_mutex *lock = NULL;
+static SDL_cond *wake = NULL;
+static SDL_cond *idle = NULL;
+static SDL_mutex *batchLock = NULL; // one parallel_for in flight at a time
+static int quit = 0;
+static unsigned generation = 0;
+static int busy = 0; // workers currently inside a batch, guarded by lock
+
+// the batch being worked on; written under lock while no worker is busy
+static JobRangeFn batchFn = NULL;
+static void *batchCtx = NULL;
+static int batchCount = 0;
+static int batchGrain = 1;
+static SDL_atomic_t batchNext;
+
+// FIFO of fire-and-forget tasks, guarded by lock
+typedef struct JobTask { JobFn fn; void *ctx; } JobTask;
+static JobTask queue[JOBS_QUEUE_MAX];
+static int queueHead = 0;
+static int queueLen = 0;
+static int running = 0; // tasks popped but not finished
+
+static _Thread_local int inWorker = 0;
+
+static void run_chunks(void) {
+    for (;;) {
+        int begin = SDL_AtomicAdd(&batchNext, batchGrain);
+        if (begin >= batchCount) break;
+        int end = begin + batchGrain;
+        if (end > batchCount) end = batchCount;
+        batchFn(batchCtx, begin, end);
+    }
+}
+
+static int worker_main(void *arg) {
+    (void)arg;
+    inWorker = 1;
+    unsigned seen = 0;
+    SDL_LockMutex(lock);
+    for (;;) {
+        while (!quit && generation == seen && queueLen == 0) SDL_CondWait(wake, lock);
+        if (quit) break;
+        if (generation != seen) {
+            // parallel_for batches go first, they have a caller blocked on them
+            seen = generation;
+            busy++;
+            SDL_UnlockMutex(lock);
+            run_chunks();
+            SDL_LockMutex(lock);
+            if (--busy == 0) SDL_CondBroadcast(idle);
+            continue;
+        }
+        JobTask t = queue[queueHead];
+        queueHead = (queueHead + 1) % JOBS_QUEUE_MAX;
+        queueLen--;
+        running++;
+        SDL_UnlockMutex(lock);
+        t.fn(t.ctx);
+        SDL_LockMutex(lock);
+        running--;
+    }
+    SDL_UnlockMutex(lock);
+    return 0;
+}
+
+int jobs_init(int count) {
+    if (lock) return workerCount;
+    if (count < 0) count = SDL_GetCPUCount() - 1;
+    if (count > JOBS_MAX_WORKERS) count = JOBS_MAX_WORKERS;
+    lock = SDL_CreateMutex();
+    batchLock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    idle = SDL_CreateCond();
+    if (!lock || !batchLock || !wake || !idle) {
+        fprintf(stderr, "jobs: failed to create sync objects: %s\n", SDL_GetError());
+        jobs_shutdown();
+        return 0;
+    }
+    quit = 0;
+    for (int i = 0; i < count; i++) {
+        workers[workerCount] = SDL_CreateThread(worker_main, "game90-worker", NULL);
+        if (!workers[workerCount]) {
+            fprintf(stderr, "jobs: failed to start worker %d: %s\n", i, SDL_GetError());
+            break;
+        }
+        workerCount++;
+    }
+    return workerCount;
+}
+
+void jobs_shutdown(void) {
+    if (lock) {
+        SDL_LockMutex(lock);
+        quit = 1;
+        SDL_CondBroadcast(wake);
+        SDL_UnlockMutex(lock);
+    }
+    for (int i = 0; i < workerCount; i++) SDL_WaitThread(workers[i], NULL);
+    workerCount = 0;
+    while (queueLen > 0) {
+        JobTask t = queue[queueHead];
+        queueHead = (queueHead + 1) % JOBS_QUEUE_MAX;
+        queueLen--;
+        t.fn(t.ctx);
+    }
+    if (wake) SDL_DestroyCond(wake);
+    if (idle) SDL_DestroyCond(idle);
+    if (batchLock) SDL_DestroyMutex(batchLock);
+    if (lock) SDL_DestroyMutex(lock);
+    wake = idle = NULL;
+    batchLock = lock = NULL;
+}
+
+int jobs_thread_count(void) {
+    return workerCount + 1;
+}
+
+void jobs_parallel_for(int count, int grain, JobRangeFn fn, void *ctx) {
+    if (count <= 0) return;
+    if (grain < 1) grain = 1;
+    // nested calls from a worker, tiny ranges and a missing pool all run inline
+    if (workerCount == 0 || inWorker || count <= grain) { fn(ctx, 0, count); return; }
+
+    SDL_LockMutex(batchLock);
+    SDL_LockMutex(lock);
+    while (busy > 0) SDL_CondWait(idle, lock); // stragglers from the last batch
+    batchFn = fn;
+    batchCtx = ctx;
+    batchCount = count;
+    batchGrain = grain;
+    SDL_AtomicSet(&batchNext, 0);
+    generation++;
+    SDL_CondBroadcast(wake);
+    SDL_UnlockMutex(lock);
+
+    run_chunks();
+
+    SDL_LockMutex(lock);
+    while (busy > 0) SDL_CondWait(idle, lock);
+    SDL_UnlockMutex(lock);
+    SDL_UnlockMutex(batchLock);
+}
+
+void jobs_submit(JobFn fn, void *ctx) {
+    if (workerCount == 0) { fn(ctx); return; }
+    SDL_LockMutex(lock);
+    if (queueLen == JOBS_QUEUE_MAX) {
+        SDL_UnlockMutex(lock);
+        fn(ctx);
+        return;
+    }
+    queue[(queueHead + queueLen) % JOBS_QUEUE_MAX] = (JobTask){ fn, ctx };
+    queueLen++;
+    SDL_CondSignal(wake);
+    SDL_UnlockMutex(lock);
+}
+
+int jobs_pending(void) {
+    if (!lock) return 0;
+    SDL_LockMutex(lock);
+    int n = queueLen + running;
+    SDL_UnlockMutex(lock);
+    return n;
+}
@@ -0,0 +1,22 @@
+#ifndef GAME_JOBS_H
+#define GAME_JOBS_H
+
+// Small worker pool on SDL threads. Work submitted before jobs_init() (or with
+// zero workers) simply runs on the calling thread.
+
+typedef void (*JobRangeFn)(void *ctx, int begin, int end);
+typedef void (*JobFn)(void *ctx);
+
+int jobs_init(int workers); // workers < 0 picks cpu count - 1
+void jobs_shutdown(void);
+int jobs_thread_count(void); // workers plus the calling thread
+
+// run fn over [0, count) in chunks of `grain`, caller participates, returns when done
+void jobs_parallel_for(int count, int grain, JobRangeFn fn, void *ctx);
+
+// queue fn(ctx) for the next free worker; runs inline when there are no workers
+// or the queue is full. Tasks still queued at shutdown run on the caller.
+void jobs_submit(JobFn fn, void *ctx);
+int jobs_pending(void);
+
+#endif
@@ -0,0 +1,172 @@
+#include "light.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Uint8 *lightMap = NULL;
+int lightW = 0;
+int lightH = 0;
+
+Uint32 lightShadedTex[LIGHT_SHADES][4][GAME_TEX_W * GAME_TEX_H];
+Uint8 lightWallShade[2][LIGHT_LEVELS][LIGHT_FOG_STEPS];
+Uint32 lightFloorColor[LIGHT_LEVELS][LIGHT_FOG_STEPS][2];
+
+static Uint32 (*tablesFor)[GAME_TEX_W * GAME_TEX_H] = NULL;
+static double fogStart = 6.0;
+static double fogEnd = 28.0;
+
+// scratch for one light's flood fill: BFS queue and visited stamps over its box
+#define LIGHT_BOX (2 * MAP_LIGHT_MAX + 1)
+static int floodQueue[LIGHT_BOX * LIGHT_BOX];
+static Uint8 floodSeen[LIGHT_BOX * LIGHT_BOX];
+
+static double fog_factor(double dist) {
+    if (dist <= fogStart) return 1.0;
+    if (dist >= fogEnd) return 0.15;
+    double t = (dist - fogStart) / (fogEnd - fogStart);
+    return 1.0 - t * 0.85;
+}
+
+static void build_shade_tables(void) {
+    for (int side = 0; side < 2; side++)
+    for (int l = 0; l < LIGHT_LEVELS; l++)
+    for (int b = 0; b < LIGHT_FOG_STEPS; b++) {
+        double dist = (b + 0.5) / LIGHT_FOG_SCALE;
+        double k = (double)l / MAP_LIGHT_MAX * fog_factor(dist) * (side ? 0.5 : 1.0);
+        int s = (int)(k * (LIGHT_SHADES - 1) + 0.5);
+        lightWallShade[side][l][b] = (Uint8)s;
+        if (side == 0) {
+            // floor keeps its two checker tones, scaled by the same factor
+            for (int c = 0; c < 2; c++) {
+                int f = c ? 80 : 110;
+                Uint8 r = (Uint8)(f / 2 * k), g = (Uint8)(f * k), bl = (Uint8)(f / 3 * k);
+                lightFloorColor[l][b][c] = (0xFFu << 24) | ((Uint32)r << 16) | ((Uint32)g << 8) | bl;
+            }
+        }
+    }
+}
+
+void light_prepare(Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    if (tablesFor == textures) return;
+    for (int s = 0; s < LIGHT_SHADES; s++) {
+        double k = (double)s / (LIGHT_SHADES - 1);
+        for (int t = 0; t < 4; t++) for (int i = 0; i < GAME_TEX_W * GAME_TEX_H; i++) {
+            Uint32 col = textures[t][i];
+            Uint8 r = (Uint8)(((col >> 16) & 0xFF) * k);
+            Uint8 g = (Uint8)(((col >> 8) & 0xFF) * k);
+            Uint8 b = (Uint8)((col & 0xFF) * k);
+            lightShadedTex[s][t][i] = (0xFFu << 24) | ((Uint32)r << 16) | ((Uint32)g << 8) | b;
+        }
+    }
+    build_shade_tables();
+    tablesFor = textures;
+}
+
+void light_set_fog(double start, double end) {
+    if (end <= start) end = start + 1.0;
+    fogStart = start;
+    fogEnd = end;
+    build_shade_tables();
+}
+
+// breadth-first flood from one light through open cells, keeping the max level
+static void flood_light(const MapLight *L) {
+    if (L->level <= 0) return;
+    if (L->x < 0 || L->x >= mapW || L->y < 0 || L->y >= mapH) return;
+    if (MAP_SOLID(L->x, L->y)) return;
+    int r = L->level - 1;
+    int bx = L->x - r, by = L->y - r, bw = 2 * r + 1;
+    memset(floodSeen, 0, sizeof(floodSeen));
+    int head = 0, tail = 0;
+    floodQueue[tail++] = (L->x - bx) + bw * (L->y - by);
+    floodSeen[floodQueue[0]] = (Uint8)L->level;
+    while (head < tail) {
+        int q = floodQueue[head++];
+        int lx = q % bw, ly = q / bw;
+        int level = floodSeen[q];
+        int idx = (bx + lx) + mapW * (by + ly);
+        if (lightMap[idx] < level) lightMap[idx] = (Uint8)level;
+        if (level <= 1) continue;
+        static const int dx[4] = { 1, -1, 0, 0 };
+        static const int dy[4] = { 0, 0, 1, -1 };
+        for (int k = 0; k < 4; k++) {
+            int nx = lx + dx[k], ny = ly + dy[k];
+            int mx = bx + nx, my = by + ny;
+            if (mx < 0 || mx >= mapW || my < 0 || my >= mapH) continue;
+            if (floodSeen[nx + bw * ny] || MAP_SOLID(mx, my)) continue;
+            floodSeen[nx + bw * ny] = (Uint8)(level - 1);
+            floodQueue[tail++] = nx + bw * ny;
+        }
+    }
+}
+
+static int light_touches(const MapLight *L, int x0, int y0, int x1, int y1) {
+    int r = L->level;
+    return L->x + r >= x0 && L->x - r <= x1 && L->y + r >= y0 && L->y - r <= y1;
+}
+
+void light_bake(void) {
+    if (!worldMap || !mapSolid) return;
+    if (lightW != mapW || lightH != mapH || !lightMap) {
+        Uint8 *m = realloc(lightMap, (size_t)mapW * mapH);
+        if (!m) { fprintf(stderr, "failed to allocate lightMap\n"); return; }
+        lightMap = m;
+        lightW = mapW;
+        lightH = mapH;
+    }
+    memset(lightMap, mapAmbient, (size_t)mapW * mapH);
+    for (int i = 0; i < mapLightCount; i++) flood_light(&mapLights[i]);
+}
+
+// re-light after cells in [x0,x1]x[y0,y1] changed; only lights that can reach
+// the rectangle are re-flooded, and only the area they cover is cleared
+void light_update_rect(int x0, int y0, int x1, int y1) {
+    if (!lightMap || lightW != mapW || lightH != mapH) { light_bake(); return; }
+    int rx0 = x0, ry0 = y0, rx1 = x1, ry1 = y1;
+    for (int i = 0; i < mapLightCount; i++) {
+        const MapLight *L = &mapLights[i];
+        if (!light_touches(L, x0, y0, x1, y1)) continue;
+        if (L->x - L->level < rx0) rx0 = L->x - L->level;
+        if (L->y - L->level < ry0) ry0 = L->y - L->level;
+        if (L->x + L->level > rx1) rx1 = L->x + L->level;
+        if (L->y + L->level > ry1) ry1 = L->y + L->level;
+    }
+    if (rx0 < 0) rx0 = 0;
+    if (ry0 < 0) ry0 = 0;
+    if (rx1 >= mapW) rx1 = mapW - 1;
+    if (ry1 >= mapH) ry1 = mapH - 1;
+    if (rx0 > rx1 || ry0 > ry1) return;
+    for (int y = ry0; y <= ry1; y++) memset(&lightMap[rx0 + mapW * y], mapAmbient, (size_t)(rx1 - rx0 + 1));
+    for (int i = 0; i < mapLightCount; i++) {
+        if (light_touches(&mapLights[i], rx0, ry0, rx1, ry1)) flood_light(&mapLights[i]);
+    }
+}
+
+int light_add(int x, int y, int level) {
+    if (mapLightCount >= MAX_MAP_LIGHTS) return -1;
+    if (level < 0) level = 0;
+    if (level > MAP_LIGHT_MAX) level = MAP_LIGHT_MAX;
+    int index = mapLightCount++;
+    mapLights[index] = (MapLight){ x, y, level };
+    light_update_rect(x, y, x, y);
+    return index;
+}
+
+void light_set(int index, int x, int y, int level) {
+    if (index < 0 || index >= mapLightCount) return;
+    MapLight old = mapLights[index];
+    if (level < 0) level = 0;
+    if (level > MAP_LIGHT_MAX) level = MAP_LIGHT_MAX;
+    mapLights[index] = (MapLight){ x, y, level };
+    light_update_rect(old.x, old.y, old.x, old.y);
+    light_update_rect(x, y, x, y);
+}
+
+void light_remove(int index) {
+    if (index < 0 || index >= mapLightCount) return;
+    MapLight old = mapLights[index];
+    mapLights[index] = mapLights[--mapLightCount];
+    light_update_rect(old.x, old.y, old.x, old.y);
+}
@@ -0,0 +1,45 @@
+#ifndef GAME_LIGHT_H
+#define GAME_LIGHT_H
+
+#include <SDL2/SDL.h>
+
+#include "map.h"
+#include "render.h"
+
+#define LIGHT_LEVELS (MAP_LIGHT_MAX + 1)
+#define LIGHT_SHADES 32       // brightness steps baked into the texture tables
+#define LIGHT_FOG_STEPS 64    // distance buckets in the fog tables
+#define LIGHT_FOG_SCALE 2.0   // buckets per map unit
+
+// baked per-cell light level (0..MAP_LIGHT_MAX), NULL until light_bake() ran
+extern Uint8 *lightMap;
+extern int lightW;
+extern int lightH;
+
+void light_bake(void);
+void light_update_rect(int x0, int y0, int x1, int y1);
+int light_add(int x, int y, int level);
+void light_set(int index, int x, int y, int level);
+void light_remove(int index);
+void light_set_fog(double start, double end);
+
+// lookup tables used by the renderer; rebuilt when the texture set changes
+void light_prepare(Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]);
+extern Uint32 lightShadedTex[LIGHT_SHADES][4][GAME_TEX_W * GAME_TEX_H];
+extern Uint8 lightWallShade[2][LIGHT_LEVELS][LIGHT_FOG_STEPS];
+extern Uint32 lightFloorColor[LIGHT_LEVELS][LIGHT_FOG_STEPS][2];
+
+static inline int light_fog_bucket(double dist) {
+    if (!(dist < LIGHT_FOG_STEPS / LIGHT_FOG_SCALE)) return LIGHT_FOG_STEPS - 1;
+    int b = (int)(dist * LIGHT_FOG_SCALE);
+    return b < 0 ? 0 : (b >= LIGHT_FOG_STEPS ? LIGHT_FOG_STEPS - 1 : b);
+}
+
+// level at a cell, ambient when out of bounds or not baked
+static inline int light_level_at(int x, int y) {
+    if (!lightMap || lightW != mapW || lightH != mapH) return mapAmbient;
+    if (x < 0 || x >= mapW || y < 0 || y >= mapH) return mapAmbient;
+    return lightMap[x + mapW * y];
+}
+
+#endif
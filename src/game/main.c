@@ -1,13 +1,24 @@
 #include <SDL2/SDL.h>
+#include "capture.h"
 #include "imgui_c.h"
+#include "jobs.h"
+#include "light.h"
 #include "map.h"
+#include "maplib.h"
+#include "mem.h"
+#include "minimap.h"
+#include "nav.h"
+#include "pacing.h"
 #include "render.h"
+#include "replay.h"
+#include "rooms.h"
+#include "sim.h"
+#include "sprite.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -16,8 +27,280 @@
 int screenW = 800;
 int screenH = 600;
 
+static const double fovDeg = 80.0;
+static const double mouseSensitivity = 0.0035; // radians per pixel of relative motion
+
+#define THUMB_TEXTURES 64 // picker thumbnails kept as textures
+
+typedef struct GameOpts {
+    const char *mapPath;
+    const char *recordPath;
+    const char *replayPath;
+    const char *capturePath;
+    bool headless;
+    bool interlace;
+    bool columns;
+    bool lowLatency;
+    Uint32 seed;
+    int renderW, renderH; // headless only
+} GameOpts;
+
+static void usage(const char *argv0) {
+    printf("Usage: %s [MAP] [--record FILE] [--replay FILE] [--capture FILE] [--seed N] [--interlace] [--columns] [--low-latency]\n"
+           "       %s --replay FILE --headless [--size WxH] [--capture FILE] [--interlace] [--columns]\n"
+           "--seed sets the rand() seed used by generated maps (default 1).\n"
+           "--interlace casts half the columns per frame (F2 toggles it in game).\n"
+           "--columns draws full frames column-major and transposes them for upload.\n"
+           "--low-latency reads input just before each frame's deadline (F3 toggles it).\n"
+           "F4 tints each column by its ray's cost (builds with GAME90_RENDER_STATS).\n"
+           "--capture writes the rendered frames to FILE (.g90v, lossless); the game drops\n"
+           "frames the encoder can't keep up with, headless runs keep every one.\n"
+           "--headless renders every replayed tick offscreen and prints per-frame timing.\n"
+           "--mem-cap TAG:MIB refuses allocations past MIB mebibytes for render, map or ui.\n", argv0, argv0);
+}
+
+// the player is actor 0 of the simulation; camera plane computed from FOV
+static int spawn_player(SimActors *actors) {
+    double planeLen = tan((fovDeg * M_PI / 180.0) / 2.0);
+    return sim_add(actors, 22.0, 12.0, -1.0, 0.0, planeLen);
+}
+
+// load a map (NULL or "": generated) and rebuild everything derived from it
+static void game_load_map(const char *path, SimActors *actors, int player) {
+    if (!path || !path[0] || !load_map_file(path)) load_default_map();
+    nav_reset();
+    light_bake();
+    rooms_build();
+    sprite_spawn_map_things();
+    // keep the player inside the map bounds
+    if (actors->posX[player] < 1.0) actors->posX[player] = 1.5;
+    if (actors->posY[player] < 1.0) actors->posY[player] = 1.5;
+    if (actors->posX[player] >= mapW - 1) actors->posX[player] = mapW - 2 + 0.5;
+    if (actors->posY[player] >= mapH - 1) actors->posY[player] = mapH - 2 + 0.5;
+}
+
+// doors open while the player is within a cell and a half of them; driven by
+// the simulated position only, so replays open them on the same ticks
+static void game_doors_tick(const SimActors *actors, int player, double dt) {
+    for (int i = 0; i < mapDoorCount; i++) {
+        double dx = actors->posX[player] - (mapDoors[i].x + 0.5);
+        double dy = actors->posY[player] - (mapDoors[i].y + 0.5);
+        map_door_set(i, fabs(dx) < 1.5 && fabs(dy) < 1.5);
+    }
+    map_doors_step(dt);
+}
+
+// pass the map edits made since the last call on to everything derived from
+// the map; the renderer reads mapSolid directly and its caches follow mapRevision
+static void game_apply_map_edits(Minimap *minimap) {
+    MapRect dirty[MAP_DIRTY_MAX];
+    int n = map_take_dirty(dirty);
+    for (int i = 0; i < n; i++) {
+        const MapRect *r = &dirty[i];
+        light_update_rect(r->x0, r->y0, r->x1, r->y1);
+        rooms_update_rect(r->x0, r->y0, r->x1, r->y1);
+        if (minimap) minimap_update_rect(minimap, r->x0, r->y0, r->x1, r->y1);
+    }
+    nav_update_rects(dirty, n);
+}
+
+static ReplayPose player_pose(const SimActors *actors, int player) {
+    ReplayPose p = { actors->posX[player], actors->posY[player], actors->dirX[player], actors->dirY[player] };
+    return p;
+}
+
+// compare the state at the end of a replay with the one recorded; false on divergence
+static bool replay_check(FILE *out, const ReplayReader *r, const SimActors *actors, int player) {
+    if (!r->hasFinal) {
+        fprintf(out, "replay: %u ticks, recording has no final state to check\n", (unsigned)r->ticks);
+        return true;
+    }
+    ReplayPose p = player_pose(actors, player);
+    bool same = r->ticks == r->finalTicks && memcmp(&p, &r->final, sizeof(p)) == 0;
+    if (same) {
+        fprintf(out, "replay: %u ticks, final state matches\n", (unsigned)r->ticks);
+    } else {
+        fprintf(out, "replay: DIVERGED after %u ticks (recorded %u): pos %.17g,%.17g dir %.17g,%.17g, expected pos %.17g,%.17g dir %.17g,%.17g\n",
+            (unsigned)r->ticks, (unsigned)r->finalTicks, p.posX, p.posY, p.dirX, p.dirY,
+            r->final.posX, r->final.posY, r->final.dirX, r->final.dirY);
+    }
+    return same;
+}
+
+typedef struct ThumbTex {
+    SDL_Texture *tex;
+    char path[MAPLIB_PATH_MAX];
+    Sint64 mtime;
+    Uint32 used; // picker frame it was last drawn in
+} ThumbTex;
+
+static ThumbTex thumbTex[THUMB_TEXTURES];
+
+// texture of a read map's thumbnail, replacing the one drawn longest ago;
+// called with the map library locked
+static SDL_Texture *thumb_texture(SDL_Renderer *ren, const MapInfo *info, Uint32 frame) {
+    if (!info->ready || info->broken) return NULL;
+    ThumbTex *slot = &thumbTex[0];
+    for (int i = 0; i < THUMB_TEXTURES; i++) {
+        ThumbTex *t = &thumbTex[i];
+        if (t->tex && t->mtime == info->mtime && strcmp(t->path, info->path) == 0) {
+            t->used = frame;
+            return t->tex;
+        }
+        if (slot->tex && (!t->tex || t->used < slot->used)) slot = t;
+    }
+    // every texture is already on screen this frame
+    if (slot->tex && slot->used == frame) return NULL;
+    if (!slot->tex) slot->tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, MAPLIB_THUMB, MAPLIB_THUMB);
+    if (!slot->tex) return NULL;
+    SDL_UpdateTexture(slot->tex, NULL, info->thumb, MAPLIB_THUMB * (int)sizeof(Uint32));
+    snprintf(slot->path, sizeof(slot->path), "%s", info->path);
+    slot->mtime = info->mtime;
+    slot->used = frame;
+    return slot->tex;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Replays a recording without a window: one simulation tick and one full
+// frame per recorded tick, timing written to stdout as CSV and a summary to stderr.
+// Returns 0 when the final state matches the recording, 2 when it diverged.
+static int run_headless(const GameOpts *o) {
+    ReplayReader rp;
+    if (!replay_open(&rp, o->replayPath)) return 1;
+    srand(rp.seed);
+    jobs_init(-1);
+
+    SimActors actors;
+    Uint32 *pixels = mem_pool_get(MEM_RENDER, (size_t)o->renderW * o->renderH * sizeof(Uint32));
+    float *zbuffer = mem_pool_get(MEM_RENDER, (size_t)o->renderW * sizeof(float));
+    if (!pixels || !zbuffer || !sim_init(&actors, 1)) {
+        fprintf(stderr, "Failed to allocate render pixels for %dx%d\n", o->renderW, o->renderH);
+        mem_pool_put(pixels);
+        mem_pool_put(zbuffer);
+        replay_close(&rp);
+        jobs_shutdown();
+        return 1;
+    }
+    int player = spawn_player(&actors);
+    static Uint32 textures[4][GAME_TEX_W * GAME_TEX_H];
+    init_textures(textures);
+
+    const double tickDt = 1.0 / rp.tickHz;
+    const double perfFreq = (double)SDL_GetPerformanceFrequency();
+    double *frameMs = NULL;
+    int frames = 0, frameCap = 0;
+    double total = 0.0;
+    static const char *const viewNames[] = { "full", "rotated", "reused" };
+    RenderCache viewCache = { 0 };
+    viewCache.interlace = o->interlace;
+    viewCache.columns = o->columns;
+    Capture *capture = o->capturePath ? capture_start(o->capturePath, o->renderW, o->renderH) : NULL;
+    printf("frame,view,sim_ms,render_ms,total_ms\n");
+    ReplayEvent ev;
+    ReplayEventType t;
+    while ((t = replay_next(&rp, &ev)) != REPLAY_END) {
+        if (t == REPLAY_MAP) {
+            game_load_map(ev.mapPath, &actors, player);
+            continue;
+        }
+        actors.input[player] = ev.input;
+        actors.turn[player] = -ev.mouseDx * mouseSensitivity;
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        sim_step(&actors, tickDt);
+        game_doors_tick(&actors, player, tickDt);
+        game_apply_map_edits(NULL);
+        Uint64 t1 = SDL_GetPerformanceCounter();
+        SimCamera cam = sim_camera(&actors, player);
+        RenderReuse reuse = render_world_cached(&viewCache, sprite_revision(), pixels, o->renderW, o->renderH,
+            cam.posX, cam.posY, cam.dirX, cam.dirY, cam.planeX, cam.planeY, textures, zbuffer);
+        if (reuse != RENDER_REUSED) {
+            sprite_render(pixels, o->renderW, o->renderH, zbuffer, cam.posX, cam.posY, cam.dirX, cam.dirY, cam.planeX, cam.planeY, NULL);
+        }
+        Uint64 t2 = SDL_GetPerformanceCounter();
+        if (capture) capture_frame(capture, pixels, o->renderW, CAPTURE_WAIT | (reuse == RENDER_REUSED ? CAPTURE_SAME : 0));
+        double simMs = (double)(t1 - t0) * 1000.0 / perfFreq;
+        double renderMs = (double)(t2 - t1) * 1000.0 / perfFreq;
+        printf("%d,%s,%.4f,%.4f,%.4f\n", frames, viewNames[reuse], simMs, renderMs, simMs + renderMs);
+        if (frames == frameCap) {
+            frameCap = frameCap ? frameCap * 2 : 1024;
+            double *grown = realloc(frameMs, sizeof(double) * (size_t)frameCap);
+            if (!grown) { fprintf(stderr, "out of memory recording frame times\n"); break; }
+            frameMs = grown;
+        }
+        frameMs[frames++] = simMs + renderMs;
+        total += simMs + renderMs;
+    }
+    if (frames > 0) {
+        qsort(frameMs, (size_t)frames, sizeof(double), cmp_double);
+        fprintf(stderr, "headless %dx%d frames=%d avg=%.3fms p50=%.3fms p95=%.3fms p99=%.3fms max=%.3fms\n",
+            o->renderW, o->renderH, frames, total / frames, frameMs[frames / 2],
+            frameMs[(int)(frames * 0.95)], frameMs[(int)(frames * 0.99)], frameMs[frames - 1]);
+    }
+    if (capture) {
+        CaptureStats cs;
+        capture_stop(capture, &cs);
+        fprintf(stderr, "capture %s frames=%u bytes=%llu submit avg=%.3fms max=%.3fms encode avg=%.3fms\n",
+            o->capturePath, (unsigned)cs.written, (unsigned long long)cs.bytes,
+            cs.submitted ? cs.submitMs / cs.submitted : 0.0, cs.submitMaxMs, cs.written ? cs.encodeMs / cs.written : 0.0);
+    }
+    fflush(stdout);
+    bool same = replay_check(stderr, &rp, &actors, player); // stderr keeps the CSV clean
+
+    free(frameMs);
+    render_cache_free(&viewCache);
+    mem_pool_put(pixels);
+    mem_pool_put(zbuffer);
+    sim_free(&actors);
+    replay_close(&rp);
+    nav_shutdown();
+    jobs_shutdown();
+    mem_free(worldMap);
+    mem_free(mapSolid);
+    free(lightMap);
+    rooms_free();
+    mem_pool_trim();
+    return same ? 0 : 2;
+}
+
+// "map:64" caps the map tag at 64 MiB
+static bool parse_mem_cap(const char *v) {
+    const char *colon = strchr(v, ':');
+    if (!colon) return false;
+    for (int t = 0; t < MEM_TAGS; t++) {
+        const char *name = mem_tag_name((MemTag)t);
+        if (strlen(name) != (size_t)(colon - v) || strncmp(v, name, strlen(name)) != 0) continue;
+        mem_set_cap((MemTag)t, (size_t)strtoul(colon + 1, NULL, 10) * 1024 * 1024);
+        return true;
+    }
+    return false;
+}
+
 int main(int argc, char *argv[])
 {
+    GameOpts o = { NULL, NULL, NULL, NULL, false, false, false, false, 1, 800, 600 };
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(a, "--record") == 0 && v) { o.recordPath = v; i++; }
+        else if (strcmp(a, "--replay") == 0 && v) { o.replayPath = v; i++; }
+        else if (strcmp(a, "--capture") == 0 && v) { o.capturePath = v; i++; }
+        else if (strcmp(a, "--headless") == 0) { o.headless = true; }
+        else if (strcmp(a, "--interlace") == 0) { o.interlace = true; }
+        else if (strcmp(a, "--columns") == 0) { o.columns = true; }
+        else if (strcmp(a, "--low-latency") == 0) { o.lowLatency = true; }
+        else if (strcmp(a, "--seed") == 0 && v) { o.seed = (Uint32)strtoul(v, NULL, 10); i++; }
+        else if (strcmp(a, "--size") == 0 && v && sscanf(v, "%dx%d", &o.renderW, &o.renderH) == 2) { i++; }
+        else if (strcmp(a, "--mem-cap") == 0 && v && parse_mem_cap(v)) { i++; }
+        else if (a[0] != '-' && !o.mapPath) { o.mapPath = a; }
+        else { usage(argv[0]); return strcmp(a, "--help") == 0 ? 0 : 1; }
+    }
+    if ((o.headless && !o.replayPath) || o.renderW <= 0 || o.renderH <= 0) { usage(argv[0]); return 1; }
+    if (o.headless) return run_headless(&o);
+
     if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER) != 0) {
         fprintf(stderr, "SDL_Init error: %s\n", SDL_GetError());
         return 1;
@@ -43,6 +326,17 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    jobs_init(-1);
+
+    // pacing needs the refresh rate; 0 (unknown) falls back to 60 Hz
+    SDL_DisplayMode displayMode;
+    int refreshHz = SDL_GetWindowDisplayMode(win, &displayMode) == 0 ? displayMode.refresh_rate : 0;
+    FramePacer pacer;
+    pacer_init(&pacer, refreshHz, (renderer_flags & SDL_RENDERER_PRESENTVSYNC) != 0);
+    bool lowLatency = o.lowLatency;
+    int threadCount = jobs_thread_count(); // workers plus this thread, tunable in the overlay
+    float renderScale = 1.0f;              // render size relative to the window
+
     ImGuiCContext imgui_ctx;
     imgui_ctx.window = win;
     imgui_ctx.renderer = ren;
@@ -51,18 +345,42 @@ int main(int argc, char *argv[])
         fprintf(stderr, "ImGui disabled or failed to initialize (build with IMGUI=1 and set IMGUI_DIR if needed).\n");
     }
 
-    double posX = 22.0, posY = 12.0; // player start
-    double dirX = -1.0, dirY = 0.0; // initial direction vector
-    double fov_deg = 80.0;
-    double planeLen = tan((fov_deg * M_PI / 180.0) / 2.0);
-    double planeX = 0.0, planeY = planeLen; // camera plane computed from FOV
-    const double mouseSensitivity = 0.0035;
+    SimActors actors;
+    if (!sim_init(&actors, 1)) {
+        SDL_DestroyRenderer(ren);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+        return 1;
+    }
+    int player = spawn_player(&actors);
     
     Uint32 textures[4][GAME_TEX_W * GAME_TEX_H];
     init_textures(textures);
 
+    // a replay brings its own seed, tick rate and map loads; live input is
+    // ignored until it runs out
+    ReplayReader replay;
+    bool replaying = false;
+    if (o.replayPath) {
+        if (!replay_open(&replay, o.replayPath)) {
+            SDL_DestroyRenderer(ren);
+            SDL_DestroyWindow(win);
+            SDL_Quit();
+            return 1;
+        }
+        replaying = true;
+        o.seed = replay.seed;
+    }
+    srand(o.seed);
+    int tickHz = replaying ? replay.tickHz : SIM_TICK_HZ;
+
     bool running = true;
-    Uint32 oldTime = SDL_GetTicks();
+    // fixed-rate simulation: frames feed real time into an accumulator and
+    // the camera is interpolated between the last two ticks
+    const double tickDt = 1.0 / tickHz;
+    const double perfFreq = (double)SDL_GetPerformanceFrequency();
+    Uint64 oldCounter = SDL_GetPerformanceCounter();
+    double accumulator = 0.0;
 
     bool ui_visible = imgui_enabled;
     if (ui_visible) {
@@ -76,58 +394,53 @@ int main(int argc, char *argv[])
     }
     bool isFullscreen = false;
     bool show_map_picker = false;
-    char *map_files_ui[256] = {0};
-    int map_files_count = 0;
+    Uint32 pickerFrame = 0;
+    // the index is loaded now; listing and reading maps/ carries on in the background
+    maplib_open("maps");
 
     // if no map argument provided, offer to pick one from maps/ or use default
-    if (argc > 1) {
-        if (!load_map_file(argv[1])) load_default_map();
+    char startMap[512] = ""; // empty: generated map
+    if (replaying) {
+        ReplayEvent ev;
+        if (replay_next(&replay, &ev) == REPLAY_MAP) {
+            snprintf(startMap, sizeof(startMap), "%s", ev.mapPath);
+        } else {
+            fprintf(stderr, "replay: %s does not start with a map\n", o.replayPath);
+            replay_close(&replay);
+            replaying = false;
+        }
+    } else if (o.mapPath) {
+        snprintf(startMap, sizeof(startMap), "%s", o.mapPath);
     } else {
-        // list maps directory
-        DIR *d = opendir("maps");
-        if (d) {
-            struct dirent *ent;
-            char *files[256];
-            int count = 0;
-            while ((ent = readdir(d)) != NULL) {
-                const char *name = ent->d_name;
-                size_t L = strlen(name);
-                if (L > 4 && strcmp(name + L - 4, ".map") == 0) {
-                    files[count] = malloc(512);
-                    snprintf(files[count], 512, "maps/%s", name);
-                    count++;
-                    if (count >= 255) break;
-                }
+        // only the listing is waited for; maps not read yet show without a size
+        maplib_wait_listed();
+        maplib_lock();
+        int count = maplib_count();
+        if (count > 0) {
+            printf("Available maps:\n");
+            for (int i = 0; i < count; i++) {
+                const MapInfo *info = maplib_get(i);
+                if (info->ready && !info->broken) printf("%d) %s (%dx%d)\n", i+1, info->path, info->w, info->h);
+                else printf("%d) %s\n", i+1, info->path);
             }
-            closedir(d);
-            if (count > 0) {
-                printf("Available maps:\n");
-                for (int i=0;i<count;i++) printf("%d) %s\n", i+1, files[i]);
-                printf("Enter map number to load, or 0 to use default: ");
-                char buf[32];
-                if (fgets(buf, sizeof(buf), stdin)) {
-                    int sel = atoi(buf);
-                    if (sel > 0 && sel <= count) {
-                        if (!load_map_file(files[sel-1])) load_default_map();
-                    } else {
-                        load_default_map();
-                    }
-                } else load_default_map();
-                for (int i=0;i<count;i++) free(files[i]);
-            } else {
-                load_default_map();
-            }
-        } else {
-            load_default_map();
+            printf("Enter map number to load, or 0 to use default: ");
+        }
+        maplib_unlock();
+        char buf[32];
+        if (count > 0 && fgets(buf, sizeof(buf), stdin)) {
+            int sel = atoi(buf);
+            // the listing doesn't change once made, so the number still points at the same map
+            maplib_lock();
+            if (sel > 0 && sel <= maplib_count()) snprintf(startMap, sizeof(startMap), "%s", maplib_get(sel-1)->path);
+            maplib_unlock();
         }
     }
+    game_load_map(startMap, &actors, player);
+
+    ReplayWriter recorder;
+    bool recording = o.recordPath && replay_create(&recorder, o.recordPath, o.seed, tickHz);
+    if (recording) replay_write_map(&recorder, startMap);
 
-    // map loaded
-    // ensure player start is inside map bounds
-        if (posX < 1.0) posX = 1.5;
-        if (posY < 1.0) posY = 1.5;
-        if (posX >= mapW - 1) posX = mapW - 2 + 0.5;
-        if (posY >= mapH - 1) posY = mapH - 2 + 0.5;
     // render-to-texture buffer (cap internal resolution for performance)
     const int MAX_RENDER_W = 1024;
     const int MAX_RENDER_H = 768;
@@ -137,18 +450,45 @@ int main(int argc, char *argv[])
     if (renderH > MAX_RENDER_H) renderH = MAX_RENDER_H;
     SDL_Texture *screenTex = NULL;
     Uint32 *pixels = NULL;
+    float *zbuffer = NULL; // per-column wall depth for the sprite pass
     SDL_Texture *tmpTex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, renderW, renderH);
-    Uint32 *tmpPixels = malloc((size_t)renderW * renderH * sizeof(Uint32));
-    if (!tmpTex || !tmpPixels) {
+    Uint32 *tmpPixels = mem_pool_get(MEM_RENDER, (size_t)renderW * renderH * sizeof(Uint32));
+    float *tmpDepth = mem_pool_get(MEM_RENDER, (size_t)renderW * sizeof(float));
+    if (!tmpTex || !tmpPixels || !tmpDepth) {
         fprintf(stderr, "Failed to allocate render texture/pixels for %dx%d\n", renderW, renderH);
         if (tmpTex) SDL_DestroyTexture(tmpTex);
-        free(tmpPixels);
+        mem_pool_put(tmpPixels);
+        mem_pool_put(tmpDepth);
     } else {
         screenTex = tmpTex;
         pixels = tmpPixels;
+        zbuffer = tmpDepth;
     }
 
+    // the capture keeps the size it started with; frames at any other size are skipped
+    Capture *capture = o.capturePath && pixels ? capture_start(o.capturePath, renderW, renderH) : NULL;
+    int captureW = renderW, captureH = renderH;
+
+    SimCamera prevCam = sim_camera(&actors, player); // state before the latest tick
+    RenderCache viewCache = { 0 }; // lets unchanged frames skip the render and upload
+    viewCache.interlace = o.interlace;
+    viewCache.columns = o.columns;
+    Minimap minimap = { 0 };
+    bool showMinimap = false;
+    // renderer work counters, gathered while the overlay or the heatmap shows
+    RenderStats renderStats = { 0 };
+    bool showHeat = false;
+    int heatBy = RENDER_HEAT_STEPS;
+    int mouseDx = 0; // relative motion not yet consumed by a tick
+    double lastTickTurn = 0.0; // mouse yaw applied by the latest tick
+    // overlay history, plotted in place
+    float frameMsValues[120], renderMsValues[120];
+    ImGuiCRing frameMsHistory = { frameMsValues, 120, 0, 0 };
+    ImGuiCRing renderMsHistory = { renderMsValues, 120, 0, 0 };
+    double presentMs = 0.0; // ui and present of the previous frame
     while (running) {
+        // low latency: sleep first so the input below is as fresh as the deadline allows
+        if (lowLatency) pacer_wait(&pacer);
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             if (imgui_enabled && (ui_visible || show_map_picker)) {
@@ -199,6 +539,23 @@ int main(int argc, char *argv[])
                         }
                     }
                 }
+                if (e.key.keysym.sym == SDLK_TAB) {
+                    showMinimap = !showMinimap;
+                    render_cache_invalidate(&viewCache); // the overlay lives in the frame's pixels
+                }
+                if (e.key.keysym.sym == SDLK_F2) {
+                    // interlaced rendering: half the columns cast per frame
+                    viewCache.interlace = !viewCache.interlace;
+                }
+                if (e.key.keysym.sym == SDLK_F3) {
+                    lowLatency = !lowLatency;
+                    pacer.missed = 0;
+                }
+                if (GAME90_RENDER_STATS && e.key.keysym.sym == SDLK_F4) {
+                    // per-column cost heatmap over the frame
+                    showHeat = !showHeat;
+                    render_cache_invalidate(&viewCache);
+                }
                 if (e.key.keysym.sym == SDLK_F11) {
                     // toggle fullscreen
                     if (!isFullscreen) {
@@ -208,48 +565,11 @@ int main(int argc, char *argv[])
                         SDL_SetWindowFullscreen(win, 0);
                         isFullscreen = false;
                     }
-                    // update sizes and render target
-                    SDL_GetWindowSize(win, &screenW, &screenH);
-                    int newRenderW = screenW;
-                    int newRenderH = screenH;
-                    if (newRenderW > MAX_RENDER_W) newRenderW = MAX_RENDER_W;
-                    if (newRenderH > MAX_RENDER_H) newRenderH = MAX_RENDER_H;
-                    if (newRenderW != renderW || newRenderH != renderH) {
-                        renderW = newRenderW;
-                        renderH = newRenderH;
-                            SDL_Texture *newTex2 = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, renderW, renderH);
-                            Uint32 *newPixels2 = malloc((size_t)renderW * renderH * sizeof(Uint32));
-                            if (!newTex2 || !newPixels2) {
-                                fprintf(stderr, "Failed to allocate render texture/pixels for fullscreen %dx%d\n", renderW, renderH);
-                                if (newTex2) SDL_DestroyTexture(newTex2);
-                                free(newPixels2);
-                            } else {
-                                if (screenTex) SDL_DestroyTexture(screenTex);
-                                screenTex = newTex2;
-                                if (pixels) free(pixels);
-                                pixels = newPixels2;
-                            }
-                    }
+                    // the render target follows the new window size below
                 }
                 if (e.key.keysym.sym == SDLK_m) {
-                    // open ImGui map picker
-                    // populate map list
-                    for (int i = 0; i < 256; ++i) { if (map_files_ui[i]) { free(map_files_ui[i]); map_files_ui[i] = NULL; } }
-                    map_files_count = 0;
-                    DIR *d = opendir("maps");
-                    if (d) {
-                        struct dirent *ent;
-                        while ((ent = readdir(d)) != NULL) {
-                            const char *name = ent->d_name;
-                            size_t L = strlen(name);
-                            if (L > 4 && strcmp(name + L - 4, ".map") == 0 && map_files_count < 256) {
-                                map_files_ui[map_files_count] = malloc(512);
-                                snprintf(map_files_ui[map_files_count], 512, "maps/%s", name);
-                                map_files_count++;
-                            }
-                        }
-                        closedir(d);
-                    }
+                    // open ImGui map picker on a fresh listing of maps/
+                    maplib_refresh();
                     show_map_picker = true;
                 }
             }
@@ -257,110 +577,143 @@ int main(int argc, char *argv[])
 
         const Uint8 *state = SDL_GetKeyboardState(NULL);
 
-        Uint32 currentTime = SDL_GetTicks();
-        double frameTime = (currentTime - oldTime) / 1000.0; // seconds
-        oldTime = currentTime;
+        Uint64 counter = SDL_GetPerformanceCounter();
+        double frameTime = (double)(counter - oldCounter) / perfFreq; // seconds
+        oldCounter = counter;
         double fps = (frameTime > 0.0) ? (1.0 / frameTime) : 0.0;
-
-        double moveSpeed = frameTime * 5.0; // the constant value is in squares/second
-        double rotSpeed = frameTime * 3.0; // radians/second
+        imgui_c_ring_push(&frameMsHistory, (float)(frameTime * 1000.0));
 
         int mx = 0;
         int my = 0;
         if (!ui_visible) {
             SDL_GetRelativeMouseState(&mx, &my);
         }
-        if (mx != 0) {
-            double rot = -mx * mouseSensitivity;
-            double oldDirX = dirX;
-            dirX = dirX * cos(rot) - dirY * sin(rot);
-            dirY = oldDirX * sin(rot) + dirY * cos(rot);
-            double oldPlaneX = planeX;
-            planeX = planeX * cos(rot) - planeY * sin(rot);
-            planeY = oldPlaneX * sin(rot) + planeY * cos(rot);
-        }
+        pacer_input_sampled(&pacer);
+        Uint8 input = 0;
+        if (state[SDL_SCANCODE_W]) input |= SIM_IN_FORWARD;
+        if (state[SDL_SCANCODE_S]) input |= SIM_IN_BACK;
+        if (state[SDL_SCANCODE_A]) input |= SIM_IN_LEFT;
+        if (state[SDL_SCANCODE_D]) input |= SIM_IN_RIGHT;
+        if (state[SDL_SCANCODE_LEFT]) input |= SIM_IN_TURN_LEFT;
+        if (state[SDL_SCANCODE_RIGHT]) input |= SIM_IN_TURN_RIGHT;
+        mouseDx += mx;
 
-        if (state[SDL_SCANCODE_W]) {
-            int nx = (int)(posX + dirX * moveSpeed);
-            int ny = (int)posY;
-            if (nx >= 0 && nx < mapW && ny >= 0 && ny < mapH && MAP_AT(nx,ny) == 0) posX += dirX * moveSpeed;
-            nx = (int)posX; ny = (int)(posY + dirY * moveSpeed);
-            if (nx >= 0 && nx < mapW && ny >= 0 && ny < mapH && MAP_AT(nx,ny) == 0) posY += dirY * moveSpeed;
-        }
-        if (state[SDL_SCANCODE_S]) {
-            int nx = (int)(posX - dirX * moveSpeed);
-            int ny = (int)posY;
-            if (nx >= 0 && nx < mapW && ny >= 0 && ny < mapH && MAP_AT(nx,ny) == 0) posX -= dirX * moveSpeed;
-            nx = (int)posX; ny = (int)(posY - dirY * moveSpeed);
-            if (nx >= 0 && nx < mapW && ny >= 0 && ny < mapH && MAP_AT(nx,ny) == 0) posY -= dirY * moveSpeed;
-        }
-        if (state[SDL_SCANCODE_D]) {
-            double strafeX = dirY;
-            double strafeY = -dirX;
-            int nx = (int)(posX + strafeX * moveSpeed);
-            int ny = (int)posY;
-            if (nx >= 0 && nx < mapW && ny >= 0 && ny < mapH && MAP_AT(nx,ny) == 0) posX += strafeX * moveSpeed;
-            nx = (int)posX; ny = (int)(posY + strafeY * moveSpeed);
-            if (nx >= 0 && nx < mapW && ny >= 0 && ny < mapH && MAP_AT(nx,ny) == 0) posY += strafeY * moveSpeed;
-        }
-        if (state[SDL_SCANCODE_A]) {
-            double strafeX = dirY;
-            double strafeY = -dirX;
-            int nx = (int)(posX - strafeX * moveSpeed);
-            int ny = (int)posY;
-            if (nx >= 0 && nx < mapW && ny >= 0 && ny < mapH && MAP_AT(nx,ny) == 0) posX -= strafeX * moveSpeed;
-            nx = (int)posX; ny = (int)(posY - strafeY * moveSpeed);
-            if (nx >= 0 && nx < mapW && ny >= 0 && ny < mapH && MAP_AT(nx,ny) == 0) posY -= strafeY * moveSpeed;
+        Uint64 simStart = SDL_GetPerformanceCounter();
+        accumulator += frameTime;
+        int ticks = 0;
+        while (accumulator >= tickDt && ticks < SIM_MAX_CATCHUP) {
+            prevCam = sim_camera(&actors, player);
+            // each tick sees exactly the input a recording stores for it
+            Uint8 tickInput = input;
+            int tickMouseDx = mouseDx;
+            mouseDx = 0;
+            if (replaying) {
+                ReplayEvent ev;
+                ReplayEventType t;
+                while ((t = replay_next(&replay, &ev)) == REPLAY_MAP) {
+                    game_load_map(ev.mapPath, &actors, player);
+                    prevCam = sim_camera(&actors, player);
+                    if (recording) replay_write_map(&recorder, ev.mapPath);
+                }
+                if (t == REPLAY_TICK) {
+                    tickInput = ev.input;
+                    tickMouseDx = ev.mouseDx;
+                } else {
+                    replay_check(stdout, &replay, &actors, player);
+                    replay_close(&replay);
+                    replaying = false;
+                }
+            }
+            actors.input[player] = tickInput;
+            actors.turn[player] = -tickMouseDx * mouseSensitivity;
+            lastTickTurn = actors.turn[player];
+            if (recording) replay_write_tick(&recorder, tickInput, tickMouseDx);
+            sim_step(&actors, tickDt);
+            game_doors_tick(&actors, player, tickDt);
+            accumulator -= tickDt;
+            ticks++;
         }
-        if (state[SDL_SCANCODE_RIGHT]) {
-            double oldDirX = dirX;
-            dirX = dirX * cos(-rotSpeed) - dirY * sin(-rotSpeed);
-            dirY = oldDirX * sin(-rotSpeed) + dirY * cos(-rotSpeed);
-            double oldPlaneX = planeX;
-            planeX = planeX * cos(-rotSpeed) - planeY * sin(-rotSpeed);
-            planeY = oldPlaneX * sin(-rotSpeed) + planeY * cos(-rotSpeed);
+        game_apply_map_edits(&minimap);
+        // spiral-of-death guard: after a long stall drop the backlog instead of
+        // running ever more ticks per frame
+        if (accumulator >= tickDt) accumulator = fmod(accumulator, tickDt);
+        double simMs = (double)(SDL_GetPerformanceCounter() - simStart) * 1000.0 / perfFreq;
+        SimCamera curCam = sim_camera(&actors, player);
+        SimCamera cam = sim_camera_lerp(&prevCam, &curCam, accumulator / tickDt);
+        if (lowLatency) {
+            // mouse look skips the tick delay: show the part of the last tick's
+            // mouse turn the blend hasn't reached yet, plus the motion the next
+            // tick will apply. Both land exactly where the simulation will be.
+            double pending = replaying ? 0.0 : -mouseDx * mouseSensitivity;
+            cam = sim_camera_turn(&cam, (1.0 - accumulator / tickDt) * lastTickTurn + pending);
         }
-        if (state[SDL_SCANCODE_LEFT]) {
-            double oldDirX = dirX;
-            dirX = dirX * cos(rotSpeed) - dirY * sin(rotSpeed);
-            dirY = oldDirX * sin(rotSpeed) + dirY * cos(rotSpeed);
-            double oldPlaneX = planeX;
-            planeX = planeX * cos(rotSpeed) - planeY * sin(rotSpeed);
-            planeY = oldPlaneX * sin(rotSpeed) + planeY * cos(rotSpeed);
+
+        // nothing to show while minimized; the simulation keeps ticking
+        if (SDL_GetWindowFlags(win) & SDL_WINDOW_MINIMIZED) {
+            SDL_Delay(1);
+            continue;
         }
 
-        // handle window resize events that may have occurred
-        int w, h;
-        SDL_GetWindowSize(win, &w, &h);
-        if (w != screenW || h != screenH) {
-            screenW = w;
-            screenH = h;
-            int newRenderW = screenW;
-            int newRenderH = screenH;
+        // follow window resizes and the resolution scale
+        SDL_GetWindowSize(win, &screenW, &screenH);
+        {
+            int newRenderW = (int)(screenW * renderScale);
+            int newRenderH = (int)(screenH * renderScale);
             if (newRenderW > MAX_RENDER_W) newRenderW = MAX_RENDER_W;
             if (newRenderH > MAX_RENDER_H) newRenderH = MAX_RENDER_H;
+            if (newRenderW < 64) newRenderW = 64;
+            if (newRenderH < 48) newRenderH = 48;
             if (newRenderW != renderW || newRenderH != renderH) {
-                renderW = newRenderW;
-                renderH = newRenderH;
-                SDL_Texture *newTex2 = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, renderW, renderH);
-                Uint32 *newPixels2 = malloc((size_t)renderW * renderH * sizeof(Uint32));
-                if (!newTex2 || !newPixels2) {
-                    fprintf(stderr, "Failed to allocate render texture/pixels for %dx%d\n", renderW, renderH);
+                SDL_Texture *newTex2 = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, newRenderW, newRenderH);
+                // pooled buffers are rounded up to a size class, so most
+                // resizes fit in the ones already held
+                size_t pixelBytes = (size_t)newRenderW * newRenderH * sizeof(Uint32);
+                size_t depthBytes = (size_t)newRenderW * sizeof(float);
+                Uint32 *newPixels2 = mem_size(pixels) >= pixelBytes ? pixels : mem_pool_get(MEM_RENDER, pixelBytes);
+                float *newDepth2 = mem_size(zbuffer) >= depthBytes ? zbuffer : mem_pool_get(MEM_RENDER, depthBytes);
+                if (!newTex2 || !newPixels2 || !newDepth2) {
+                    // keep rendering at the old size
+                    fprintf(stderr, "Failed to allocate render texture/pixels for %dx%d\n", newRenderW, newRenderH);
                     if (newTex2) SDL_DestroyTexture(newTex2);
-                    free(newPixels2);
+                    if (newPixels2 != pixels) mem_pool_put(newPixels2);
+                    if (newDepth2 != zbuffer) mem_pool_put(newDepth2);
+                    renderScale = (float)renderW / (screenW > 0 ? screenW : 1);
                 } else {
+                    renderW = newRenderW;
+                    renderH = newRenderH;
                     if (screenTex) SDL_DestroyTexture(screenTex);
                     screenTex = newTex2;
-                    if (pixels) free(pixels);
+                    if (pixels != newPixels2) mem_pool_put(pixels);
                     pixels = newPixels2;
+                    if (zbuffer != newDepth2) mem_pool_put(zbuffer);
+                    zbuffer = newDepth2;
                 }
             }
         }
 
-        render_world(pixels, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY, textures);
-
-        // upload pixel buffer and scale to window
-        SDL_UpdateTexture(screenTex, NULL, pixels, renderW * sizeof(Uint32));
+        // an unchanged view keeps last frame's pixels and texture as they are
+        Uint64 renderStart = SDL_GetPerformanceCounter();
+        render_stats_collect(ui_visible || showHeat ? &renderStats : NULL);
+        RenderReuse reuse = render_world_cached(&viewCache, sprite_revision(), pixels, renderW, renderH,
+            cam.posX, cam.posY, cam.dirX, cam.dirY, cam.planeX, cam.planeY, textures, zbuffer);
+        if (reuse != RENDER_REUSED) {
+            sprite_render(pixels, renderW, renderH, zbuffer, cam.posX, cam.posY, cam.dirX, cam.dirY, cam.planeX, cam.planeY, NULL);
+            // top-down map in the top-right corner, 4 pixels per cell
+            int mapSize = renderH / 4 < renderW - 16 ? renderH / 4 : renderW - 16;
+            if (showMinimap && mapSize > 16 && minimap_update(&minimap, 4)) {
+                minimap_draw(&minimap, pixels, renderW, renderW - mapSize - 8, 8, mapSize, mapSize,
+                    cam.posX, cam.posY, cam.dirX, cam.dirY);
+            }
+            if (showHeat) render_stats_heatmap(&renderStats, (RenderHeat)heatBy, pixels, renderW, renderW, renderH);
+            // upload pixel buffer and scale to window
+            SDL_UpdateTexture(screenTex, NULL, pixels, renderW * sizeof(Uint32));
+        }
+        if (capture && renderW == captureW && renderH == captureH) {
+            capture_frame(capture, pixels, renderW, reuse == RENDER_REUSED ? CAPTURE_SAME : 0);
+        }
+        double renderMs = (double)(SDL_GetPerformanceCounter() - renderStart) * 1000.0 / perfFreq;
+        imgui_c_ring_push(&renderMsHistory, (float)renderMs);
+        Uint64 presentStart = SDL_GetPerformanceCounter();
         SDL_SetRenderDrawColor(ren, 0,0,0,255);
         SDL_RenderClear(ren);
         SDL_RenderCopy(ren, screenTex, NULL, NULL);
@@ -369,51 +722,183 @@ int main(int argc, char *argv[])
             
             if (show_map_picker) {
                 imgui_c_begin("Map Picker");
-                if (map_files_count == 0) {
+                char picked[MAPLIB_PATH_MAX] = "";
+                maplib_lock();
+                int count = maplib_count();
+                if (!maplib_listed()) {
+                    imgui_c_text("Listing maps/...");
+                } else if (count == 0) {
                     imgui_c_text("No maps found in maps/");
                 } else {
-                    for (int i = 0; i < map_files_count; ++i) {
-                        const char *p = strrchr(map_files_ui[i], '/');
-                        const char *label = p ? p + 1 : map_files_ui[i];
-                        if (imgui_c_button(label)) {
-                            if (!load_map_file(map_files_ui[i])) {
-                                load_default_map();
-                            } else {
-                                if (posX < 1.0) posX = 1.5;
-                                if (posY < 1.0) posY = 1.5;
-                                if (posX >= mapW - 1) posX = mapW - 2 + 0.5;
-                                if (posY >= mapH - 1) posY = mapH - 2 + 0.5;
-                            }
-                            // close picker
-                            show_map_picker = false;
-                            for (int j = 0; j < map_files_count; ++j) { free(map_files_ui[j]); map_files_ui[j] = NULL; }
-                            map_files_count = 0;
-                            break;
+                    if (maplib_unread() > 0) imgui_c_textf("Reading maps: %d of %d left", maplib_unread(), count);
+                    pickerFrame++;
+                    // only the rows in view are drawn, so thousands of maps cost nothing
+                    int first, last;
+                    imgui_c_clip_begin(count);
+                    while (imgui_c_clip_step(&first, &last)) {
+                        for (int i = first; i < last; i++) {
+                            const MapInfo *info = maplib_get(i);
+                            const char *p = strrchr(info->path, '/');
+                            const char *label = p ? p + 1 : info->path;
+                            bool clicked = imgui_c_image_button(info->path, thumb_texture(ren, info, pickerFrame), MAPLIB_THUMB, MAPLIB_THUMB);
+                            imgui_c_same_line();
+                            clicked |= imgui_c_button(label);
+                            imgui_c_same_line();
+                            if (!info->ready) imgui_c_text("...");
+                            else if (info->broken) imgui_c_text("unreadable");
+                            else imgui_c_textf("%dx%d, %d walls, %d lights, %d things, %d doors", info->w, info->h, info->walls, info->lights, info->things, info->doors);
+                            if (clicked) snprintf(picked, sizeof(picked), "%s", info->path);
                         }
                     }
                 }
+                maplib_unlock();
+                if (picked[0]) {
+                    game_load_map(picked, &actors, player);
+                    if (recording) replay_write_map(&recorder, picked);
+                    prevCam = sim_camera(&actors, player); // don't blend across the teleport
+                    // close picker
+                    show_map_picker = false;
+                }
                 imgui_c_end();
             } else if (ui_visible) {
                 imgui_c_begin("Overlay");
-                char fps_text[64];
-                snprintf(fps_text, sizeof(fps_text), "FPS: %.1f", fps);
-                imgui_c_text(fps_text);
+                imgui_c_textf("FPS: %.1f", fps);
+                imgui_c_plot_lines("frame ms", &frameMsHistory, 0.0f, 50.0f, 0.0f, 40.0f);
+                imgui_c_plot_histogram("render ms", &renderMsHistory, 0.0f, 0.0f, 0.0f, 40.0f);
+                if (imgui_c_begin_table("stages", 2)) {
+                    imgui_c_table_setup_column("stage");
+                    imgui_c_table_setup_column("ms");
+                    imgui_c_table_headers_row();
+                    static const char *const stageNames[] = { "sim", "render", "ui + present" };
+                    const double stageMs[] = { simMs, renderMs, presentMs };
+                    for (int i = 0; i < 3; i++) {
+                        imgui_c_table_next_row();
+                        imgui_c_table_next_column();
+                        imgui_c_text(stageNames[i]);
+                        imgui_c_table_next_column();
+                        imgui_c_textf("%.3f", stageMs[i]);
+                    }
+                    imgui_c_end_table();
+                }
+                static const char *const viewNames[] = { "full", "rotated", "reused" };
+                imgui_c_textf("View: %s, %d cast / %d cached", viewNames[reuse], viewCache.cast, viewCache.cached);
+                if (viewCache.interlace) {
+                    imgui_c_textf("Interlaced: %d reprojected / %d interpolated", viewCache.reprojected, viewCache.interpolated);
+                }
+#if GAME90_RENDER_STATS
+                if (renderStats.columns > 0) {
+                    imgui_c_textf("Rays: %lld steps (%.1f avg, %d max), %d left the map", renderStats.steps,
+                        (double)renderStats.steps / renderStats.columns, renderStats.maxSteps, renderStats.offMap);
+                    imgui_c_textf("Pixels: %lld wall (texels), %lld floor, %lld ceiling, %lld overdrawn",
+                        renderStats.walls, renderStats.floors, renderStats.ceilings, renderStats.overdraw);
+                    imgui_c_textf("Columns: %.1f us avg, %.1f us max",
+                        (double)renderStats.ticks * 1e6 / perfFreq / renderStats.columns, (double)renderStats.maxTicks * 1e6 / perfFreq);
+                }
+#endif
+                imgui_c_textf("Input to present: %.1f ms (avg %.1f)", pacer.latency * 1000.0, pacer.latencyAvg * 1000.0);
+                if (lowLatency) {
+                    imgui_c_textf("Pacing: %.1f ms predicted, %d missed", pacer_predict(&pacer) * 1000.0, pacer.missed);
+                }
+                if (capture) {
+                    CaptureStats cs;
+                    capture_stats(capture, &cs);
+                    imgui_c_textf("Capture: %u written, %u dropped, %.3f ms/frame",
+                        (unsigned)cs.written, (unsigned)cs.dropped, cs.submitted ? cs.submitMs / cs.submitted : 0.0);
+                }
+
+                // runtime tuning
+                imgui_c_separator();
+                imgui_c_checkbox("Interlaced (F2)", &viewCache.interlace);
+                imgui_c_checkbox("Column-major target", &viewCache.columns);
+                if (imgui_c_checkbox("Minimap (Tab)", &showMinimap)) render_cache_invalidate(&viewCache);
+                if (imgui_c_checkbox("Low latency (F3)", &lowLatency)) pacer.missed = 0;
+#if GAME90_RENDER_STATS
+                static const char *const heatNames[] = { "DDA steps", "Time" };
+                if (imgui_c_checkbox("Cost heatmap (F4)", &showHeat)) render_cache_invalidate(&viewCache);
+                if (showHeat && imgui_c_combo("Heat by", &heatBy, heatNames, 2)) render_cache_invalidate(&viewCache);
+#endif
+                imgui_c_slider_float("Resolution scale", &renderScale, 0.25f, 1.0f, "%.2f");
+                if (imgui_c_slider_int("Threads", &threadCount, 1, SDL_GetCPUCount())) {
+                    // restarted between frames, when no batch is in flight
+                    jobs_shutdown();
+                    threadCount = jobs_init(threadCount - 1) + 1;
+                }
+                imgui_c_value_int("Render width", renderW);
+                imgui_c_same_line();
+                imgui_c_value_int("height", renderH);
+
+                // bytes per subsystem; parked pool blocks count for whoever freed them
+                if (imgui_c_begin_table("memory", 4)) {
+                    imgui_c_table_setup_column("memory");
+                    imgui_c_table_setup_column("KiB");
+                    imgui_c_table_setup_column("peak");
+                    imgui_c_table_setup_column("cap");
+                    imgui_c_table_headers_row();
+                    for (int t = 0; t < MEM_TAGS; t++) {
+                        MemStats ms = mem_stats((MemTag)t);
+                        imgui_c_table_next_row();
+                        imgui_c_table_next_column();
+                        imgui_c_textf("%s (%d)", mem_tag_name((MemTag)t), ms.allocs);
+                        imgui_c_table_next_column();
+                        imgui_c_textf("%zu", ms.bytes / 1024);
+                        imgui_c_table_next_column();
+                        imgui_c_textf("%zu", ms.peak / 1024);
+                        imgui_c_table_next_column();
+                        if (ms.cap) imgui_c_textf("%zu", ms.cap / 1024);
+                        else imgui_c_text("-");
+                    }
+                    imgui_c_end_table();
+                }
                 imgui_c_end();
             }
             
             imgui_c_render();
         }
         SDL_RenderPresent(ren);
+        pacer_presented(&pacer);
+        presentMs = (double)(SDL_GetPerformanceCounter() - presentStart) * 1000.0 / perfFreq;
+        // without vsync or pacing an unchanged view would spin a core for nothing
+        if (reuse == RENDER_REUSED && !lowLatency && !(renderer_flags & SDL_RENDERER_PRESENTVSYNC)) SDL_Delay(1);
     }
 
+    if (recording) {
+        ReplayPose pose = player_pose(&actors, player);
+        if (replay_finish(&recorder, &pose)) printf("recorded %u ticks to %s\n", (unsigned)recorder.ticks, o.recordPath);
+    }
+    if (capture) {
+        CaptureStats cs;
+        if (capture_stop(capture, &cs)) {
+            printf("captured %u of %u frames to %s (%llu bytes), %.3f ms per frame on the render thread\n",
+                (unsigned)cs.written, (unsigned)cs.submitted, o.capturePath, (unsigned long long)cs.bytes,
+                cs.submitted ? cs.submitMs / cs.submitted : 0.0);
+        }
+    }
+    if (replaying) {
+        printf("replay: stopped after %u ticks\n", (unsigned)replay.ticks);
+        replay_close(&replay);
+    }
     if (imgui_enabled) {
         imgui_c_shutdown();
     }
+    nav_shutdown();
+    jobs_shutdown();
+    for (int i = 0; i < THUMB_TEXTURES; i++) if (thumbTex[i].tex) SDL_DestroyTexture(thumbTex[i].tex);
     SDL_DestroyRenderer(ren);
     SDL_DestroyWindow(win);
     if (screenTex) SDL_DestroyTexture(screenTex);
-    if (pixels) free(pixels);
-    if (worldMap) free(worldMap);
+    mem_pool_put(pixels);
+    mem_pool_put(zbuffer);
+    sim_free(&actors);
+    render_cache_free(&viewCache);
+    render_stats_collect(NULL);
+    render_stats_free(&renderStats);
+    minimap_free(&minimap);
+    mem_free(worldMap);
+    mem_free(mapSolid);
+    free(lightMap);
+    rooms_free();
+    maplib_close();
+    mem_pool_trim();
     SDL_Quit();
     return 0;
 }
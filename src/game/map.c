@@ -1,6 +1,9 @@
 #include "map.h"
+#include "mem.h"
 
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +11,47 @@
 int mapW = 24;
 int mapH = 24;
 int *worldMap = NULL; // allocated and filled at startup
+unsigned char *mapSolid = NULL;
+unsigned mapRevision = 0;
+unsigned mapGeneration = 0;
+
+static MapRect mapDirty[MAP_DIRTY_MAX];
+static int mapDirtyCount = 0;
+
+MapDoor mapDoors[MAX_MAP_DOORS];
+int mapDoorCount = 0;
+
+MapRect mapRooms[MAX_MAP_ROOMS];
+int mapRoomCount = 0;
+
+MapHeight *mapHeights = NULL;
+static int heightsW = 0, heightsH = 0;
+typedef struct PendingHeight { MapRect r; float floor, ceil, top; } PendingHeight;
+
+// What a map file's keyword lines set, gathered while it is read and made
+// current only once its grid has loaded, so a file that fails to read leaves
+// the loaded map as it was. "height" and "door" lines need the grid anyway.
+typedef struct MapDirectives {
+    MapThing *things;
+    int thingCount, thingCap;
+    MapLight lights[MAX_MAP_LIGHTS];
+    int lightCount;
+    MapRect rooms[MAX_MAP_ROOMS];
+    int roomCount;
+    PendingHeight heights[MAX_MAP_HEIGHTS];
+    int heightCount;
+    int doorX[MAX_MAP_DOORS], doorY[MAX_MAP_DOORS];
+    int doorCount;
+    int ambient;
+} MapDirectives;
+
+MapLight mapLights[MAX_MAP_LIGHTS];
+int mapLightCount = 0;
+int mapAmbient = MAP_LIGHT_MAX;
+
+MapThing *mapThings = NULL;
+int mapThingCount = 0;
+static int mapThingCap = 0;
 
 static int defaultMap[24 * 24] = {
     /* row 0 */ 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
@@ -42,10 +86,11 @@ void load_default_map(void) {
     // small BSP generator: carve rooms and connect them with corridors
     int W = mapW;
     int H = mapH;
-    int *m = malloc(sizeof(int) * W * H);
+    int *m = mem_alloc(MEM_MAP, sizeof(int) * W * H, MEM_CACHE_LINE);
     if (!m) { fprintf(stderr, "failed to allocate worldMap\n"); exit(1); }
     // fill with walls (1)
     for (int i = 0; i < W * H; ++i) m[i] = 1;
+    mapRoomCount = 0;
 
     typedef struct Node { int x, y, w, h; struct Node *a, *b; int roomx, roomy, roomw, roomh; } Node;
     // simple recursive split
@@ -90,6 +135,7 @@ void load_default_map(void) {
             if (ex >= W - 1) ex = W - 2;
             if (ey >= H - 1) ey = H - 2;
             for (int yy = sy; yy < ey; yy++) for (int xx = sx; xx < ex; xx++) m[xx + W * yy] = 0;
+            if (ex > sx && ey > sy && mapRoomCount < MAX_MAP_ROOMS) mapRooms[mapRoomCount++] = (MapRect){ sx, sy, ex - 1, ey - 1 };
             if (roomCount < 128) { roomCentersX[roomCount] = rx + rw2 / 2; roomCentersY[roomCount] = ry + rh2 / 2; roomCount++; }
         }
     }
@@ -116,19 +162,289 @@ void load_default_map(void) {
         }
     }
 
+    // one light in the middle of every room, dim ambient elsewhere
+    mapThingCount = 0;
+    mapLightCount = 0;
+    mapDoorCount = 0;
+    mapAmbient = 5;
+    map_heights_clear();
+    for (int i = 0; i < roomCount && mapLightCount < MAX_MAP_LIGHTS; i++) {
+        if (m[roomCentersX[i] + W * roomCentersY[i]] != 0) continue;
+        mapLights[mapLightCount++] = (MapLight){ roomCentersX[i], roomCentersY[i], MAP_LIGHT_MAX };
+    }
+
     // replace worldMap
-    if (worldMap) free(worldMap);
+    mem_free(worldMap);
     mapW = W;
     mapH = H;
     worldMap = m;
+    map_rebuild_occupancy();
 }
 
-bool load_map_file(const char *path) {
-    FILE *f = fopen(path, "r");
-    if (!f) return false;
+void map_rebuild_occupancy(void) {
+    if (mem_size(mapSolid) != (size_t)mapW * mapH) {
+        mem_free(mapSolid);
+        mapSolid = mem_alloc(MEM_MAP, (size_t)mapW * mapH, MEM_CACHE_LINE);
+        if (!mapSolid) { fprintf(stderr, "failed to allocate occupancy grid\n"); exit(1); }
+    }
+    for (int i = 0; i < mapW * mapH; i++) mapSolid[i] = worldMap[i] > 0;
+    // heights belong to the grid they were set on
+    if (mapHeights && (heightsW != mapW || heightsH != mapH)) map_heights_clear();
+    mapRevision++;
+    mapGeneration++;
+    mapDirtyCount = 0;
+}
+
+static bool rects_touch(const MapRect *a, const MapRect *b) {
+    return a->x0 <= b->x1 + 1 && b->x0 <= a->x1 + 1 && a->y0 <= b->y1 + 1 && b->y0 <= a->y1 + 1;
+}
+
+static MapRect rect_union(const MapRect *a, const MapRect *b) {
+    MapRect r = *a;
+    if (b->x0 < r.x0) r.x0 = b->x0;
+    if (b->y0 < r.y0) r.y0 = b->y0;
+    if (b->x1 > r.x1) r.x1 = b->x1;
+    if (b->y1 > r.y1) r.y1 = b->y1;
+    return r;
+}
+
+static long rect_area(const MapRect *r) {
+    return (long)(r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1);
+}
+
+void map_mark_dirty(int x0, int y0, int x1, int y1) {
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= mapW) x1 = mapW - 1;
+    if (y1 >= mapH) y1 = mapH - 1;
+    if (x0 > x1 || y0 > y1) return;
+    MapRect r = { x0, y0, x1, y1 };
+    for (;;) {
+        // absorb everything it reaches; a grown rectangle may reach more
+        for (int i = 0; i < mapDirtyCount;) {
+            if (!rects_touch(&mapDirty[i], &r)) { i++; continue; }
+            r = rect_union(&mapDirty[i], &r);
+            mapDirty[i] = mapDirty[--mapDirtyCount];
+            i = 0;
+        }
+        if (mapDirtyCount < MAP_DIRTY_MAX) break;
+        // full: join the rectangle that grows least, then look again
+        int best = 0;
+        long bestGrowth = -1;
+        for (int i = 0; i < mapDirtyCount; i++) {
+            MapRect u = rect_union(&mapDirty[i], &r);
+            long growth = rect_area(&u) - rect_area(&mapDirty[i]);
+            if (bestGrowth < 0 || growth < bestGrowth) { best = i; bestGrowth = growth; }
+        }
+        r = rect_union(&mapDirty[best], &r);
+        mapDirty[best] = mapDirty[--mapDirtyCount];
+    }
+    mapDirty[mapDirtyCount++] = r;
+}
+
+int map_take_dirty(MapRect *out) {
+    int n = mapDirtyCount;
+    memcpy(out, mapDirty, sizeof(MapRect) * (size_t)n);
+    mapDirtyCount = 0;
+    return n;
+}
+
+// write one cell without marking it; true if it changed
+static bool put_cell(int x, int y, int value) {
+    if (MAP_AT(x, y) == value) return false;
+    MAP_AT(x, y) = value;
+    MAP_SOLID(x, y) = value > 0;
+    return true;
+}
+
+bool map_set_cell(int x, int y, int value) {
+    if (!worldMap || (unsigned)x >= (unsigned)mapW || (unsigned)y >= (unsigned)mapH) return false;
+    if (put_cell(x, y, value)) {
+        mapRevision++;
+        map_mark_dirty(x, y, x, y);
+    }
+    return true;
+}
+
+// copy w x h cells from src (row stride w) to (x, y), clipped; src NULL fills with value
+static void write_block(int x, int y, int w, int h, const int *src, int value) {
+    if (!worldMap) return;
+    int cx0 = x < 0 ? 0 : x, cy0 = y < 0 ? 0 : y;
+    int cx1 = x + w > mapW ? mapW : x + w, cy1 = y + h > mapH ? mapH : y + h;
+    // bounds of the cells that actually changed
+    MapRect d = { mapW, mapH, -1, -1 };
+    for (int cy = cy0; cy < cy1; cy++) {
+        for (int cx = cx0; cx < cx1; cx++) {
+            int v = src ? src[(cx - x) + (size_t)w * (cy - y)] : value;
+            if (!put_cell(cx, cy, v)) continue;
+            if (cx < d.x0) d.x0 = cx;
+            if (cx > d.x1) d.x1 = cx;
+            if (cy < d.y0) d.y0 = cy;
+            if (cy > d.y1) d.y1 = cy;
+        }
+    }
+    if (d.x1 < 0) return;
+    mapRevision++;
+    map_mark_dirty(d.x0, d.y0, d.x1, d.y1);
+}
+
+void map_fill_rect(int x0, int y0, int x1, int y1, int value) {
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    write_block(x0, y0, x1 - x0 + 1, y1 - y0 + 1, NULL, value);
+}
+
+void map_write_rect(int x, int y, int w, int h, const int *cells) {
+    if (w <= 0 || h <= 0 || !cells) return;
+    write_block(x, y, w, h, cells, 0);
+}
+
+bool map_heights_alloc(void) {
+    if (mapHeights) return true;
+    MapHeight *h = mem_alloc(MEM_MAP, sizeof(MapHeight) * (size_t)mapW * mapH, MEM_CACHE_LINE);
+    if (!h) { fprintf(stderr, "failed to allocate %dx%d heights\n", mapW, mapH); return false; }
+    for (int i = 0; i < mapW * mapH; i++) h[i] = (MapHeight){ 0.0f, 1.0f, 1.0f };
+    mapHeights = h;
+    heightsW = mapW;
+    heightsH = mapH;
+    mapRevision++;
+    return true;
+}
+
+void map_set_heights(int x0, int y0, int x1, int y1, float floor, float ceil, float top) {
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= mapW) x1 = mapW - 1;
+    if (y1 >= mapH) y1 = mapH - 1;
+    if (x0 > x1 || y0 > y1 || !map_heights_alloc()) return;
+    for (int y = y0; y <= y1; y++) for (int x = x0; x <= x1; x++) mapHeights[x + mapW * y] = (MapHeight){ floor, ceil, top };
+    mapRevision++;
+}
+
+void map_heights_clear(void) {
+    if (!mapHeights) return;
+    mem_free(mapHeights);
+    mapHeights = NULL;
+    heightsW = heightsH = 0;
+    mapRevision++;
+}
+
+int map_door_add(int x, int y) {
+    if (mapDoorCount >= MAX_MAP_DOORS || !worldMap) return -1;
+    if ((unsigned)x >= (unsigned)mapW || (unsigned)y >= (unsigned)mapH || MAP_AT(x, y) <= 0) return -1;
+    mapDoors[mapDoorCount] = (MapDoor){ x, y, MAP_AT(x, y), 0.0, false };
+    return mapDoorCount++;
+}
+
+void map_door_set(int index, bool open) {
+    if (index < 0 || index >= mapDoorCount) return;
+    mapDoors[index].opening = open;
+}
+
+void map_doors_step(double dt) {
+    for (int i = 0; i < mapDoorCount; i++) {
+        MapDoor *d = &mapDoors[i];
+        if (d->opening ? d->open >= 1.0 : d->open <= 0.0) continue;
+        // leaving the fully open state: the wall is back before it starts to move
+        if (d->open >= 1.0) map_set_cell(d->x, d->y, d->value);
+        d->open += d->opening ? dt * MAP_DOOR_SPEED : -dt * MAP_DOOR_SPEED;
+        if (d->open <= 0.0) d->open = 0.0;
+        if (d->open >= 1.0) {
+            d->open = 1.0;
+            map_set_cell(d->x, d->y, 0);
+        }
+    }
+}
+
+// parse a "keyword args" line that follows or is mixed into the cell grid
+static void parse_map_directive(MapDirectives *d, const char *p) {
+    int x, y, x1, y1, level;
+    double tx, ty;
+    float fz, cz, tz;
+    int n;
+    if (sscanf(p, "thing %lf %lf %d", &tx, &ty, &level) == 3) {
+        if (d->thingCount == d->thingCap) {
+            int cap = d->thingCap ? d->thingCap * 2 : 64;
+            MapThing *t = realloc(d->things, sizeof(MapThing) * cap);
+            if (!t) return;
+            d->things = t;
+            d->thingCap = cap;
+        }
+        d->things[d->thingCount++] = (MapThing){ tx, ty, level };
+    } else if (sscanf(p, "light %d %d %d", &x, &y, &level) == 3) {
+        if (d->lightCount < MAX_MAP_LIGHTS) {
+            if (level < 0) level = 0;
+            if (level > MAP_LIGHT_MAX) level = MAP_LIGHT_MAX;
+            d->lights[d->lightCount++] = (MapLight){ x, y, level };
+        }
+    } else if (sscanf(p, "room %d %d %d %d", &x, &y, &x1, &y1) == 4) {
+        if (d->roomCount < MAX_MAP_ROOMS) d->rooms[d->roomCount++] = (MapRect){ x, y, x1, y1 };
+    } else if ((n = sscanf(p, "height %d %d %d %d %f %f %f", &x, &y, &x1, &y1, &fz, &cz, &tz)) >= 6) {
+        if (d->heightCount < MAX_MAP_HEIGHTS) d->heights[d->heightCount++] = (PendingHeight){ { x, y, x1, y1 }, fz, cz, n == 7 ? tz : cz };
+    } else if (sscanf(p, "door %d %d", &x, &y) == 2) {
+        // the cell may not be read yet; load_map_file() checks it afterwards
+        if (d->doorCount < MAX_MAP_DOORS) {
+            d->doorX[d->doorCount] = x;
+            d->doorY[d->doorCount++] = y;
+        }
+    } else if (sscanf(p, "ambient %d", &level) == 1) {
+        if (level < 0) level = 0;
+        if (level > MAP_LIGHT_MAX) level = MAP_LIGHT_MAX;
+        d->ambient = level;
+    }
+}
+
+static bool read_u32(FILE *f, uint32_t *v) {
+    uint8_t b[4];
+    if (fread(b, 1, 4, f) != 4) return false;
+    *v = (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+    return true;
+}
+
+// the run-length grid after its magic; unlike the text one, a short file is
+// rejected rather than padded
+static int *read_rle(FILE *f, int *outW, int *outH) {
+    uint32_t w, h;
+    if (fgetc(f) != MAP_RLE_VERSION || !read_u32(f, &w) || !read_u32(f, &h)) return NULL;
+    if (w == 0 || h == 0 || (uint64_t)w * h > INT_MAX / sizeof(int)) return NULL;
+    size_t n = (size_t)w * h, at = 0;
+    int *m = mem_alloc(MEM_MAP, sizeof(int) * n, MEM_CACHE_LINE);
+    if (!m) return NULL;
+    while (at < n) {
+        uint32_t count, value;
+        if (!read_u32(f, &count) || !read_u32(f, &value) || count == 0 || count > n - at) { mem_free(m); return NULL; }
+        for (uint32_t i = 0; i < count; i++) m[at++] = (int)value;
+    }
+    *outW = (int)w;
+    *outH = (int)h;
+    return m;
+}
+
+int *map_read_file(const char *path, int *outW, int *outH, MapDirectiveFn directive, void *ctx) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
     char line[4096];
-    // read first non-comment line for dimensions
     int w = 0, h = 0;
+    char magic[4];
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, MAP_RLE_MAGIC, 4) == 0) {
+        int *m = read_rle(f, &w, &h);
+        if (!m) { fclose(f); return NULL; }
+        while (fgets(line, sizeof(line), f)) {
+            char *p = line;
+            while (*p && isspace((unsigned char)*p)) p++;
+            if (isalpha((unsigned char)*p) && directive) directive(ctx, p);
+        }
+        fclose(f);
+        *outW = w;
+        *outH = h;
+        return m;
+    }
+    rewind(f);
+    // read first non-comment line for dimensions
     while (fgets(line, sizeof(line), f)) {
         // skip leading whitespace
         char *p = line;
@@ -136,14 +452,17 @@ bool load_map_file(const char *path) {
         if (*p == '\0' || *p == '#') continue;
         if (sscanf(p, "%d %d", &w, &h) == 2) break;
     }
-    if (w <= 0 || h <= 0) { fclose(f); return false; }
-    int *m = malloc(sizeof(int) * w * h);
-    if (!m) { fclose(f); return false; }
+    if (w <= 0 || h <= 0) { fclose(f); return NULL; }
+    int *m = mem_alloc(MEM_MAP, sizeof(int) * w * h, MEM_CACHE_LINE);
+    if (!m) { fclose(f); return NULL; }
     // initialize to walls so missing/extra data won't leave garbage
     for (int i = 0; i < w * h; ++i) m[i] = 1;
     int x = 0, y = 0;
-    while (y < h && fgets(line, sizeof(line), f)) {
+    while (fgets(line, sizeof(line), f)) {
         char *p = line;
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (isalpha((unsigned char)*p)) { if (directive) directive(ctx, p); continue; }
+        if (y >= h) continue;
         while (*p) {
             // skip whitespace
             while (*p && isspace((unsigned char)*p)) p++;
@@ -161,9 +480,47 @@ bool load_map_file(const char *path) {
         }
     }
     fclose(f);
-    if (worldMap) free(worldMap);
+    *outW = w;
+    *outH = h;
+    return m;
+}
+
+static void apply_directive(void *ctx, const char *line) {
+    parse_map_directive(ctx, line);
+}
+
+bool load_map_file(const char *path) {
+    // maps without light lines render fully lit
+    static MapDirectives d;
+    memset(&d, 0, sizeof(d));
+    d.ambient = MAP_LIGHT_MAX;
+    int w, h;
+    int *m = map_read_file(path, &w, &h, apply_directive, &d);
+    if (!m) {
+        free(d.things);
+        return false;
+    }
+    mem_free(worldMap);
     mapW = w;
     mapH = h;
     worldMap = m;
+    free(mapThings);
+    mapThings = d.things;
+    mapThingCount = d.thingCount;
+    mapThingCap = d.thingCap;
+    memcpy(mapLights, d.lights, sizeof(MapLight) * (size_t)d.lightCount);
+    mapLightCount = d.lightCount;
+    memcpy(mapRooms, d.rooms, sizeof(MapRect) * (size_t)d.roomCount);
+    mapRoomCount = d.roomCount;
+    mapAmbient = d.ambient;
+    map_heights_clear();
+    map_rebuild_occupancy();
+    for (int i = 0; i < d.heightCount; i++) {
+        const PendingHeight *ph = &d.heights[i];
+        map_set_heights(ph->r.x0, ph->r.y0, ph->r.x1, ph->r.y1, ph->floor, ph->ceil, ph->top);
+    }
+    // keep the doors that sit on a wall, shut
+    mapDoorCount = 0;
+    for (int i = 0; i < d.doorCount; i++) map_door_add(d.doorX[i], d.doorY[i]);
     return true;
 }
@@ -5,11 +5,116 @@
 
 extern int mapW;
 extern int mapH;
+// grids are cache-line aligned mem_alloc(MEM_MAP) blocks; release with mem_free()
 extern int *worldMap;
 
 #define MAP_AT(x, y) worldMap[(x) + mapW * (y)]
 
+// occupancy: one byte per cell, non-zero where rays stop; shared by the renderer
+// and ray queries, rebuilt by the loaders (call again after editing worldMap
+// directly; the edit functions below keep it current themselves)
+extern unsigned char *mapSolid;
+
+#define MAP_SOLID(x, y) mapSolid[(x) + mapW * (y)]
+
+void map_rebuild_occupancy(void);
+
+// bumped by every change to worldMap, whether through map_rebuild_occupancy()
+// or the edit functions
+extern unsigned mapRevision;
+// bumped only by map_rebuild_occupancy(): the whole map may have changed
+extern unsigned mapGeneration;
+
+// Runtime edits (doors, destructible walls, scripted changes). Each write
+// updates worldMap and mapSolid in place and records the cells it changed as
+// a dirty rectangle; overlapping and touching rectangles are merged, and once
+// MAP_DIRTY_MAX are pending a new one joins whichever grows least. Whoever
+// keeps data derived from the map takes the rectangles once per tick and
+// updates just those areas, so no edit needs a whole-map rebuild.
+// Rectangles are inclusive; map_rebuild_occupancy() drops pending ones.
+#define MAP_DIRTY_MAX 32
+
+typedef struct MapRect { int x0, y0, x1, y1; } MapRect;
+
+bool map_set_cell(int x, int y, int value); // false when (x, y) is outside the map
+void map_fill_rect(int x0, int y0, int x1, int y1, int value);
+// copy a w x h block of row-major cells to (x, y), clipped to the map
+void map_write_rect(int x, int y, int w, int h, const int *cells);
+void map_mark_dirty(int x0, int y0, int x1, int y1);
+// moves the pending rectangles (at most MAP_DIRTY_MAX) into out; returns how many
+int map_take_dirty(MapRect *out);
+
+// doors ("door X Y" lines on a wall cell): the cell stays solid while the
+// door moves and empties once it is fully open, so a closing door blocks
+// straight away. Nothing draws a half-open door; it looks shut until open.
+#define MAX_MAP_DOORS 256
+#define MAP_DOOR_SPEED 2.0 // fraction of the opening travelled per second
+
+typedef struct MapDoor {
+    int x, y;
+    int value;     // the wall shown while the door is not open
+    double open;   // 0 shut .. 1 open
+    bool opening;
+} MapDoor;
+
+extern MapDoor mapDoors[MAX_MAP_DOORS];
+extern int mapDoorCount;
+
+int map_door_add(int x, int y); // -1 when full or the cell is not a wall
+void map_door_set(int index, bool open);
+void map_doors_step(double dt);
+
+// light sources placed by the map ("light X Y LEVEL" / "ambient LEVEL" lines)
+#define MAP_LIGHT_MAX 15
+#define MAX_MAP_LIGHTS 256
+
+typedef struct MapLight { int x, y, level; } MapLight;
+
+extern MapLight mapLights[MAX_MAP_LIGHTS];
+extern int mapLightCount;
+extern int mapAmbient;
+
+// rooms carved by the generators ("room X0 Y0 X1 Y1" lines, inclusive); only
+// a hint for rooms_build(), which labels everything else itself
+#define MAX_MAP_ROOMS 256
+
+extern MapRect mapRooms[MAX_MAP_ROOMS];
+extern int mapRoomCount;
+
+// per-cell heights in wall units, the eye at 0.5 ("height X0 Y0 X1 Y1 FLOOR
+// CEIL [TOP]" lines, inclusive; TOP defaults to CEIL). An open cell spans
+// floor..ceil; a wall fills its cell from below up to top with open air up to
+// ceil above it, so the renderer sees past walls lower than their
+// surroundings. Movement, nav and ray queries still stop at every wall.
+// NULL while all cells keep the defaults 0, 1, 1, and the renderer then
+// takes its single-height path.
+#define MAX_MAP_HEIGHTS 256
+
+typedef struct MapHeight { float floor, ceil, top; } MapHeight;
+
+extern MapHeight *mapHeights;
+
+bool map_heights_alloc(void); // defaults everywhere if not allocated yet
+void map_set_heights(int x0, int y0, int x1, int y1, float floor, float ceil, float top);
+void map_heights_clear(void);
+
+// billboard things placed by the map ("thing X Y TYPE" lines)
+typedef struct MapThing { double x, y; int type; } MapThing;
+
+extern MapThing *mapThings;
+extern int mapThingCount;
+
 void load_default_map(void);
 bool load_map_file(const char *path);
 
+// reads a map file's grid without touching the loaded map, so any thread may
+// call it; keyword lines go to `directive` (may be NULL). Returns a w x h
+// mem_alloc(MEM_MAP) grid, NULL when the file can't be read. Takes the text
+// grid or the editor's run-length one ("G90M", version byte, w and h as u32,
+// then u32 count + i32 value runs, little-endian), directives following both.
+#define MAP_RLE_MAGIC "G90M"
+#define MAP_RLE_VERSION 1
+typedef void (*MapDirectiveFn)(void *ctx, const char *line);
+int *map_read_file(const char *path, int *w, int *h, MapDirectiveFn directive, void *ctx);
+
 #endif
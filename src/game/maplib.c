@@ -0,0 +1,383 @@
+#include "maplib.h"
+
+#include "map.h"
+#include "mem.h"
+#include "minimap.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define MAPLIB_INDEX_NAME "index.g90i"
+#define MAPLIB_MAX_ENTRIES (1 << 20)
+#define MAPLIB_FLAG_READY 1
+#define MAPLIB_FLAG_BROKEN 2
+#define MAPLIB_BACKGROUND 0xFF000000u
+
+static const char indexMagic[4] = { 'G', '9', '0', 'I' };
+
+static char libDir[MAPLIB_PATH_MAX];
+static MapInfo *entries = NULL;
+static int entryCount = 0;
+static SDL_mutex *lock = NULL;
+static SDL_cond *listedCond = NULL;
+static SDL_cond *wakeCond = NULL;
+static SDL_Thread *worker = NULL;
+static SDL_atomic_t stopFlag;
+static bool listed = false;
+static bool refreshWanted = false;
+static bool dirty = false;      // differs from the saved index
+static unsigned revision = 0;
+static int unread = 0;
+
+static int cmp_path(const void *a, const void *b) {
+    return strcmp(((const MapInfo *)a)->path, ((const MapInfo *)b)->path);
+}
+
+// binary search in a path-sorted array
+static const MapInfo *find(const MapInfo *list, int count, const char *path) {
+    int lo = 0, hi = count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int c = strcmp(list[mid].path, path);
+        if (c == 0) return &list[mid];
+        if (c < 0) lo = mid + 1; else hi = mid - 1;
+    }
+    return NULL;
+}
+
+static void put_u16(FILE *f, Uint32 v) {
+    Uint8 b[2] = { (Uint8)v, (Uint8)(v >> 8) };
+    fwrite(b, 1, 2, f);
+}
+
+static void put_u32(FILE *f, Uint32 v) {
+    Uint8 b[4] = { (Uint8)v, (Uint8)(v >> 8), (Uint8)(v >> 16), (Uint8)(v >> 24) };
+    fwrite(b, 1, 4, f);
+}
+
+static void put_u64(FILE *f, Uint64 v) {
+    put_u32(f, (Uint32)v);
+    put_u32(f, (Uint32)(v >> 32));
+}
+
+typedef struct Reader { const Uint8 *p, *end; } Reader;
+
+static bool get_bytes(Reader *r, void *dst, size_t n) {
+    if ((size_t)(r->end - r->p) < n) return false;
+    memcpy(dst, r->p, n);
+    r->p += n;
+    return true;
+}
+
+static bool get_u16(Reader *r, Uint32 *v) {
+    Uint8 b[2];
+    if (!get_bytes(r, b, 2)) return false;
+    *v = (Uint32)b[0] | (Uint32)b[1] << 8;
+    return true;
+}
+
+static bool get_u32(Reader *r, Uint32 *v) {
+    Uint8 b[4];
+    if (!get_bytes(r, b, 4)) return false;
+    *v = (Uint32)b[0] | (Uint32)b[1] << 8 | (Uint32)b[2] << 16 | (Uint32)b[3] << 24;
+    return true;
+}
+
+static bool get_u64(Reader *r, Uint64 *v) {
+    Uint32 lo, hi;
+    if (!get_u32(r, &lo) || !get_u32(r, &hi)) return false;
+    *v = (Uint64)hi << 32 | lo;
+    return true;
+}
+
+static void index_path(char *out, size_t size) {
+    snprintf(out, size, "%s/%s", libDir, MAPLIB_INDEX_NAME);
+}
+
+// the saved index, or nothing when it's missing, damaged or from another version
+static void load_index(void) {
+    char path[MAPLIB_PATH_MAX + 16];
+    index_path(path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    Uint8 *data = size > 0 ? malloc((size_t)size) : NULL;
+    bool ok = data && fread(data, 1, (size_t)size, f) == (size_t)size;
+    fclose(f);
+    Reader r = { data, data + (ok ? size : 0) };
+    char magic[4];
+    Uint8 head[2];
+    Uint32 count = 0;
+    ok = ok && get_bytes(&r, magic, 4) && memcmp(magic, indexMagic, 4) == 0 && get_bytes(&r, head, 2)
+        && head[0] == MAPLIB_VERSION && head[1] == MAPLIB_THUMB && get_u32(&r, &count) && count <= MAPLIB_MAX_ENTRIES;
+    MapInfo *list = ok && count ? calloc(count, sizeof(MapInfo)) : NULL;
+    int n = 0;
+    while (list && n < (int)count) {
+        MapInfo *e = &list[n];
+        Uint32 len, v[8];
+        Uint64 mtime, bytes;
+        Uint8 flags;
+        if (!get_u16(&r, &len) || len >= MAPLIB_PATH_MAX || !get_bytes(&r, e->path, len)) break;
+        e->path[len] = '\0';
+        if (!get_u64(&r, &mtime) || !get_u64(&r, &bytes)) break;
+        int k = 0;
+        while (k < 8 && get_u32(&r, &v[k])) k++;
+        if (k < 8 || !get_bytes(&r, &flags, 1)) break;
+        e->mtime = (Sint64)mtime;
+        e->size = (Sint64)bytes;
+        e->w = (int)v[0]; e->h = (int)v[1];
+        e->open = (int)v[2]; e->walls = (int)v[3];
+        e->lights = (int)v[4]; e->things = (int)v[5]; e->doors = (int)v[6]; e->rooms = (int)v[7];
+        e->ready = flags & MAPLIB_FLAG_READY;
+        e->broken = flags & MAPLIB_FLAG_BROKEN;
+        if (e->ready && !e->broken) {
+            int t = 0;
+            while (t < MAPLIB_THUMB * MAPLIB_THUMB && get_u32(&r, &e->thumb[t])) t++;
+            if (t < MAPLIB_THUMB * MAPLIB_THUMB) break;
+        }
+        n++;
+    }
+    free(data);
+    if (list && n < (int)count) {
+        fprintf(stderr, "maplib: %s is damaged, rebuilding it\n", path);
+        free(list);
+        return;
+    }
+    if (!list) return;
+    qsort(list, (size_t)n, sizeof(MapInfo), cmp_path);
+    SDL_LockMutex(lock);
+    entries = list;
+    entryCount = n;
+    revision++;
+    SDL_UnlockMutex(lock);
+}
+
+static bool save_index(void) {
+    char path[MAPLIB_PATH_MAX + 16];
+    index_path(path, sizeof(path));
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "maplib: cannot write %s\n", path);
+        return false;
+    }
+    fwrite(indexMagic, 1, 4, f);
+    fputc(MAPLIB_VERSION, f);
+    fputc(MAPLIB_THUMB, f);
+    put_u32(f, (Uint32)entryCount);
+    for (int i = 0; i < entryCount; i++) {
+        const MapInfo *e = &entries[i];
+        size_t len = strlen(e->path);
+        put_u16(f, (Uint32)len);
+        fwrite(e->path, 1, len, f);
+        put_u64(f, (Uint64)e->mtime);
+        put_u64(f, (Uint64)e->size);
+        const int v[8] = { e->w, e->h, e->open, e->walls, e->lights, e->things, e->doors, e->rooms };
+        for (int k = 0; k < 8; k++) put_u32(f, (Uint32)v[k]);
+        fputc((e->ready ? MAPLIB_FLAG_READY : 0) | (e->broken ? MAPLIB_FLAG_BROKEN : 0), f);
+        if (e->ready && !e->broken) for (int k = 0; k < MAPLIB_THUMB * MAPLIB_THUMB; k++) put_u32(f, e->thumb[k]);
+    }
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "maplib: write to %s failed\n", path);
+    return ok;
+}
+
+static void count_directive(void *ctx, const char *line) {
+    MapInfo *e = ctx;
+    if (strncmp(line, "light", 5) == 0) e->lights++;
+    else if (strncmp(line, "thing", 5) == 0) e->things++;
+    else if (strncmp(line, "door", 4) == 0) e->doors++;
+    else if (strncmp(line, "room", 4) == 0) e->rooms++;
+}
+
+// stats and thumbnail for one map; the path, mtime and size are already set
+static void read_map(MapInfo *e) {
+    e->lights = e->things = e->doors = e->rooms = 0;
+    int w, h;
+    int *cells = map_read_file(e->path, &w, &h, count_directive, e);
+    e->ready = true;
+    e->broken = !cells;
+    if (!cells) return;
+    e->w = w;
+    e->h = h;
+    e->open = e->walls = 0;
+    for (int i = 0; i < w * h; i++) {
+        if (cells[i] == 0) e->open++;
+        else if (cells[i] > 0) e->walls++;
+    }
+    // nearest cell per pixel, the longer side filling the thumbnail
+    int big = w > h ? w : h;
+    int tw = w * MAPLIB_THUMB / big, th = h * MAPLIB_THUMB / big;
+    if (tw < 1) tw = 1;
+    if (th < 1) th = 1;
+    int ox = (MAPLIB_THUMB - tw) / 2, oy = (MAPLIB_THUMB - th) / 2;
+    for (int i = 0; i < MAPLIB_THUMB * MAPLIB_THUMB; i++) e->thumb[i] = MAPLIB_BACKGROUND;
+    for (int y = 0; y < th; y++) {
+        const int *row = cells + (size_t)w * (y * h / th);
+        Uint32 *dst = e->thumb + (size_t)MAPLIB_THUMB * (oy + y) + ox;
+        for (int x = 0; x < tw; x++) dst[x] = minimap_cell_color(row[x * w / tw]);
+    }
+    mem_free(cells);
+}
+
+// lists the directory and replaces the entries with what is there now,
+// keeping what was already read of unchanged files
+static void list_dir(void) {
+    MapInfo *list = NULL;
+    int n = 0, cap = 0;
+    DIR *d = opendir(libDir);
+    if (d) {
+        struct dirent *ent;
+        while ((ent = readdir(d)) != NULL && !SDL_AtomicGet(&stopFlag)) {
+            const char *name = ent->d_name;
+            size_t L = strlen(name);
+            if (L <= 4 || strcmp(name + L - 4, ".map") != 0) continue;
+            if (strlen(libDir) + 1 + L >= MAPLIB_PATH_MAX) continue;
+            if (n == cap) {
+                cap = cap ? cap * 2 : 256;
+                if (cap > MAPLIB_MAX_ENTRIES) break;
+                MapInfo *l = realloc(list, sizeof(MapInfo) * (size_t)cap);
+                if (!l) break;
+                list = l;
+            }
+            MapInfo *e = &list[n];
+            memset(e, 0, offsetof(MapInfo, thumb));
+            snprintf(e->path, sizeof(e->path), "%s/%s", libDir, name);
+            struct stat st;
+            if (stat(e->path, &st) != 0) continue;
+            e->mtime = (Sint64)st.st_mtime;
+            e->size = (Sint64)st.st_size;
+            n++;
+        }
+        closedir(d);
+    }
+    if (SDL_AtomicGet(&stopFlag)) {
+        // a cut-short listing would drop entries from the saved index
+        free(list);
+        return;
+    }
+    if (n > 1) qsort(list, (size_t)n, sizeof(MapInfo), cmp_path);
+    // only this thread changes entries, so reading the old ones needs no lock
+    bool changed = n != entryCount;
+    int missing = 0;
+    for (int i = 0; i < n; i++) {
+        const MapInfo *old = find(entries, entryCount, list[i].path);
+        if (old && old->mtime == list[i].mtime && old->size == list[i].size) list[i] = *old;
+        else changed = true;
+        if (!list[i].ready) missing++;
+    }
+    SDL_LockMutex(lock);
+    free(entries);
+    entries = list;
+    entryCount = n;
+    unread = missing;
+    dirty |= changed;
+    listed = true;
+    revision++;
+    SDL_CondBroadcast(listedCond);
+    SDL_UnlockMutex(lock);
+}
+
+// reads the entries the last listing left unread
+static void read_unread(MapInfo *e) {
+    for (int i = 0; i < entryCount && !SDL_AtomicGet(&stopFlag); i++) {
+        if (entries[i].ready) continue;
+        *e = entries[i];
+        read_map(e);
+        SDL_LockMutex(lock);
+        entries[i] = *e;
+        unread--;
+        dirty = true;
+        revision++;
+        SDL_UnlockMutex(lock);
+    }
+}
+
+static int worker_main(void *arg) {
+    (void)arg;
+    load_index();
+    MapInfo *e = malloc(sizeof(MapInfo));
+    for (;;) {
+        list_dir();
+        if (e) read_unread(e);
+        // sleep until maplib_refresh() or maplib_close()
+        SDL_LockMutex(lock);
+        while (!refreshWanted && !SDL_AtomicGet(&stopFlag)) SDL_CondWait(wakeCond, lock);
+        refreshWanted = false;
+        SDL_UnlockMutex(lock);
+        if (SDL_AtomicGet(&stopFlag)) break;
+    }
+    free(e);
+    return 0;
+}
+
+bool maplib_open(const char *dir) {
+    if (lock) return true;
+    snprintf(libDir, sizeof(libDir), "%s", dir);
+    lock = SDL_CreateMutex();
+    listedCond = SDL_CreateCond();
+    wakeCond = SDL_CreateCond();
+    if (!lock || !listedCond || !wakeCond) {
+        fprintf(stderr, "maplib: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_AtomicSet(&stopFlag, 0);
+    worker = SDL_CreateThread(worker_main, "maplib", NULL);
+    if (!worker) {
+        // no listing and no reading; the saved index still serves
+        fprintf(stderr, "maplib: no worker thread: %s\n", SDL_GetError());
+        load_index();
+        listed = true;
+        return false;
+    }
+    return true;
+}
+
+void maplib_close(void) {
+    if (!lock) return;
+    SDL_LockMutex(lock);
+    SDL_AtomicSet(&stopFlag, 1);
+    SDL_CondSignal(wakeCond);
+    SDL_UnlockMutex(lock);
+    if (worker) SDL_WaitThread(worker, NULL);
+    worker = NULL;
+    if (dirty) save_index();
+    free(entries);
+    entries = NULL;
+    entryCount = 0;
+    listed = dirty = refreshWanted = false;
+    unread = 0;
+    SDL_DestroyCond(wakeCond);
+    SDL_DestroyCond(listedCond);
+    SDL_DestroyMutex(lock);
+    wakeCond = listedCond = NULL;
+    lock = NULL;
+}
+
+void maplib_refresh(void) {
+    if (!worker) return;
+    SDL_LockMutex(lock);
+    refreshWanted = true;
+    SDL_CondSignal(wakeCond);
+    SDL_UnlockMutex(lock);
+}
+
+void maplib_lock(void) { if (lock) SDL_LockMutex(lock); }
+void maplib_unlock(void) { if (lock) SDL_UnlockMutex(lock); }
+int maplib_count(void) { return entryCount; }
+const MapInfo *maplib_get(int i) { return i >= 0 && i < entryCount ? &entries[i] : NULL; }
+unsigned maplib_revision(void) { return revision; }
+bool maplib_listed(void) { return listed; }
+int maplib_unread(void) { return unread; }
+
+void maplib_wait_listed(void) {
+    if (!lock) return;
+    SDL_LockMutex(lock);
+    while (!listed) SDL_CondWait(listedCond, lock);
+    SDL_UnlockMutex(lock);
+}
@@ -0,0 +1,55 @@
+#ifndef GAME_MAPLIB_H
+#define GAME_MAPLIB_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Index of the maps in a directory, keyed by path, mtime and size. Each entry
+// caches the map's size, cell counts and a top-down thumbnail, and the index
+// is saved in the directory ("G90I" file) so a later start has all of it
+// without opening a single map. maplib_open() returns at once; a worker thread
+// loads the saved index, lists the directory, drops files that are gone and
+// reads new or changed ones, one at a time, then sleeps until maplib_refresh()
+// asks for another listing. Only the worker changes the entries; readers hold
+// the lock while they look at them.
+//
+// File: "G90I", version byte, thumbnail edge byte, u32 count, then per entry
+// u16 path length + path, mtime and size as u64, w, h, open, walls, lights,
+// things, doors, rooms as u32, a flags byte and, for read entries, the
+// thumbnail as ARGB u32s. Everything little-endian.
+
+#define MAPLIB_VERSION 1
+#define MAPLIB_PATH_MAX 256
+#define MAPLIB_THUMB 48 // thumbnail edge in pixels; the map is letterboxed into it
+
+typedef struct MapInfo {
+    char path[MAPLIB_PATH_MAX];
+    Sint64 mtime, size;
+    int w, h;
+    int open, walls;                  // cells
+    int lights, things, doors, rooms; // directive lines
+    bool ready;                       // the fields below path/mtime/size are filled
+    bool broken;                      // read, but not a map
+    Uint32 thumb[MAPLIB_THUMB * MAPLIB_THUMB];
+} MapInfo;
+
+bool maplib_open(const char *dir);
+// stops the worker after the map it is reading and saves the index if it changed
+void maplib_close(void);
+// re-lists the directory in the background and reads files that are new or
+// whose mtime or size changed; a no-op while a refresh is already pending
+void maplib_refresh(void);
+
+void maplib_lock(void);
+void maplib_unlock(void);
+// entries sorted by path; valid while the lock is held
+int maplib_count(void);
+const MapInfo *maplib_get(int i);
+// bumped whenever the directory is listed or an entry is read
+unsigned maplib_revision(void);
+// the directory has been listed (entries may still be unread)
+bool maplib_listed(void);
+void maplib_wait_listed(void);
+int maplib_unread(void);
+
+#endif
@@ -0,0 +1,162 @@
+#include "mem.h"
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEM_MIN_ALIGN 16
+#define MEM_POOL_MIN_SHIFT 12 // 4 KiB
+#define MEM_POOL_CLASSES 19   // up to 1 GiB
+#define MEM_POOL_KEEP 2       // parked blocks per class
+
+// sits right before every block
+typedef struct MemHeader {
+    void *raw;
+    size_t size;
+    int tag;
+    int poolClass; // -1 when not from the pool
+} MemHeader;
+
+static MemStats stats[MEM_TAGS];
+static void *parked[MEM_POOL_CLASSES][MEM_POOL_KEEP];
+static int parkedCount[MEM_POOL_CLASSES];
+static SDL_SpinLock lock;
+
+static const char *const tagNames[MEM_TAGS] = { "render", "map", "ui" };
+
+static MemHeader *header(const void *p) {
+    return (MemHeader *)((unsigned char *)p - sizeof(MemHeader));
+}
+
+// charge or refund a tag; false (and nothing charged) when over its cap
+static bool account(MemTag tag, size_t size, bool add) {
+    bool ok = true;
+    SDL_AtomicLock(&lock);
+    MemStats *s = &stats[tag];
+    if (!add) {
+        s->bytes -= size;
+        s->allocs--;
+    } else if (s->cap && s->bytes + size > s->cap) {
+        ok = false;
+    } else {
+        s->bytes += size;
+        s->allocs++;
+        if (s->bytes > s->peak) s->peak = s->bytes;
+    }
+    SDL_AtomicUnlock(&lock);
+    return ok;
+}
+
+static void *alloc_block(MemTag tag, size_t size, size_t align, int poolClass) {
+    if (align < MEM_MIN_ALIGN) align = MEM_MIN_ALIGN;
+    if (size > SIZE_MAX - align - sizeof(MemHeader)) return NULL;
+    if (!account(tag, size, true)) {
+        fprintf(stderr, "mem: %s would pass its %zu byte cap\n", tagNames[tag], stats[tag].cap);
+        return NULL;
+    }
+    unsigned char *raw = malloc(size + align + sizeof(MemHeader));
+    if (!raw) { account(tag, size, false); return NULL; }
+    uintptr_t at = ((uintptr_t)raw + sizeof(MemHeader) + align - 1) & ~(uintptr_t)(align - 1);
+    void *p = (void *)at;
+    MemHeader *h = header(p);
+    h->raw = raw;
+    h->size = size;
+    h->tag = tag;
+    h->poolClass = poolClass;
+    return p;
+}
+
+void *mem_alloc(MemTag tag, size_t size, size_t align) {
+    return alloc_block(tag, size, align, -1);
+}
+
+void *mem_calloc(MemTag tag, size_t size, size_t align) {
+    void *p = mem_alloc(tag, size, align);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+static void release(MemHeader *h) {
+    account((MemTag)h->tag, h->size, false);
+    free(h->raw);
+}
+
+void mem_free(void *p) {
+    if (!p) return;
+    MemHeader *h = header(p);
+    if (h->poolClass >= 0) { mem_pool_put(p); return; }
+    release(h);
+}
+
+size_t mem_size(const void *p) {
+    return p ? header(p)->size : 0;
+}
+
+void mem_set_cap(MemTag tag, size_t cap) {
+    SDL_AtomicLock(&lock);
+    stats[tag].cap = cap;
+    SDL_AtomicUnlock(&lock);
+}
+
+MemStats mem_stats(MemTag tag) {
+    SDL_AtomicLock(&lock);
+    MemStats s = stats[tag];
+    SDL_AtomicUnlock(&lock);
+    return s;
+}
+
+const char *mem_tag_name(MemTag tag) {
+    return tag < MEM_TAGS ? tagNames[tag] : "?";
+}
+
+static int pool_class(size_t size) {
+    int c = 0;
+    while (c < MEM_POOL_CLASSES && ((size_t)1 << (MEM_POOL_MIN_SHIFT + c)) < size) c++;
+    return c < MEM_POOL_CLASSES ? c : -1;
+}
+
+void *mem_pool_get(MemTag tag, size_t size) {
+    int c = pool_class(size);
+    if (c < 0) return mem_alloc(tag, size, MEM_PAGE);
+    void *p = NULL;
+    SDL_AtomicLock(&lock);
+    if (parkedCount[c] > 0) {
+        p = parked[c][--parkedCount[c]];
+        // a parked block stays charged; move it to the tag taking it
+        MemHeader *h = header(p);
+        stats[h->tag].bytes -= h->size;
+        stats[h->tag].allocs--;
+        stats[tag].bytes += h->size;
+        stats[tag].allocs++;
+        if (stats[tag].bytes > stats[tag].peak) stats[tag].peak = stats[tag].bytes;
+        h->tag = tag;
+    }
+    SDL_AtomicUnlock(&lock);
+    return p ? p : alloc_block(tag, (size_t)1 << (MEM_POOL_MIN_SHIFT + c), MEM_PAGE, c);
+}
+
+void mem_pool_put(void *p) {
+    if (!p) return;
+    MemHeader *h = header(p);
+    int c = h->poolClass;
+    if (c < 0) { release(h); return; }
+    SDL_AtomicLock(&lock);
+    bool kept = parkedCount[c] < MEM_POOL_KEEP;
+    if (kept) parked[c][parkedCount[c]++] = p;
+    SDL_AtomicUnlock(&lock);
+    if (!kept) release(h);
+}
+
+void mem_pool_trim(void) {
+    for (int c = 0; c < MEM_POOL_CLASSES; c++) {
+        SDL_AtomicLock(&lock);
+        int n = parkedCount[c];
+        void *blocks[MEM_POOL_KEEP];
+        memcpy(blocks, parked[c], sizeof(void *) * (size_t)n);
+        parkedCount[c] = 0;
+        SDL_AtomicUnlock(&lock);
+        for (int i = 0; i < n; i++) release(header(blocks[i]));
+    }
+}
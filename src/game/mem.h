@@ -0,0 +1,41 @@
+#ifndef GAME_MEM_H
+#define GAME_MEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Allocation for buffers the game makes over and over. mem_alloc() hands out
+// aligned blocks charged to a subsystem tag, whose byte count the overlay
+// shows and which can be capped. The pool keeps freed blocks by power-of-two
+// size class so a buffer that comes back at the same size, like the
+// framebuffer across resizes, costs no malloc.
+
+#define MEM_CACHE_LINE 64
+#define MEM_PAGE 4096
+
+typedef enum { MEM_RENDER, MEM_MAP, MEM_UI, MEM_TAGS } MemTag;
+
+typedef struct MemStats {
+    size_t bytes;   // live, including blocks parked in the pool
+    size_t peak;
+    size_t cap;     // 0: unlimited
+    int allocs;     // live blocks
+} MemStats;
+
+// NULL when out of memory or over the tag's cap; align is a power of two
+void *mem_alloc(MemTag tag, size_t size, size_t align);
+void *mem_calloc(MemTag tag, size_t size, size_t align);
+void mem_free(void *p); // NULL is fine
+size_t mem_size(const void *p);
+
+void mem_set_cap(MemTag tag, size_t cap);
+MemStats mem_stats(MemTag tag);
+const char *mem_tag_name(MemTag tag);
+
+// recurring buffers: page aligned, rounded up to a power of two from 4 KiB;
+// put() parks the block for the next get() of its class
+void *mem_pool_get(MemTag tag, size_t size);
+void mem_pool_put(void *p);
+void mem_pool_trim(void); // frees every parked block
+
+#endif
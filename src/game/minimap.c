@@ -0,0 +1,138 @@
+#include "minimap.h"
+
+#include "map.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MINIMAP_BACKGROUND 0xFF000000u
+#define MINIMAP_FLOOR      0xFF202020u
+#define MINIMAP_FRAME      0xFF808080u
+#define MINIMAP_PLAYER     0xFFFFFF00u
+
+// walls use the texture colours from init_textures(), floors stay dark
+Uint32 minimap_cell_color(int val) {
+    switch (val) {
+    case 0: return MINIMAP_FLOOR;
+    case 1: return 0xFFB45050u;
+    case 2: return 0xFF50B450u;
+    case 3: return 0xFF5050B4u;
+    default: return 0xFFA0A0A0u;
+    }
+}
+
+static void draw_cell(Minimap *m, int cx, int cy, int val) {
+    Uint32 col = minimap_cell_color(val);
+    // a darker edge keeps neighbouring walls apart at larger cell sizes
+    Uint32 edge = m->cellPx >= 4 && val ? ((col >> 1) & 0x7F7F7F7Fu) | 0xFF000000u : col;
+    Uint32 *p = m->image + (size_t)cy * m->cellPx * m->w + (size_t)cx * m->cellPx;
+    for (int y = 0; y < m->cellPx; y++, p += m->w) {
+        for (int x = 0; x < m->cellPx; x++) {
+            bool border = x == m->cellPx - 1 || y == m->cellPx - 1;
+            p[x] = border ? edge : col;
+        }
+    }
+    m->cells[cx + m->mapW * cy] = val;
+}
+
+bool minimap_update(Minimap *m, int cellPx) {
+    if (!worldMap || cellPx <= 0) return false;
+    bool rebuild = !m->image || m->cellPx != cellPx || m->mapW != mapW || m->mapH != mapH;
+    if (!rebuild && m->mapGeneration == mapGeneration) {
+        m->redrawn = 0;
+        return true;
+    }
+    if (rebuild) {
+        Uint32 *image = realloc(m->image, sizeof(Uint32) * (size_t)mapW * cellPx * mapH * cellPx);
+        if (!image) { fprintf(stderr, "minimap: failed to allocate %dx%d image\n", mapW * cellPx, mapH * cellPx); return false; }
+        m->image = image;
+        int *cells = realloc(m->cells, sizeof(int) * (size_t)mapW * mapH);
+        if (!cells) { fprintf(stderr, "minimap: failed to allocate cell cache\n"); return false; }
+        m->cells = cells;
+        m->cellPx = cellPx;
+        m->mapW = mapW;
+        m->mapH = mapH;
+        m->w = mapW * cellPx;
+        m->h = mapH * cellPx;
+    }
+    m->redrawn = 0;
+    for (int cy = 0; cy < mapH; cy++) {
+        for (int cx = 0; cx < mapW; cx++) {
+            int val = MAP_AT(cx, cy);
+            if (!rebuild && m->cells[cx + mapW * cy] == val) continue;
+            draw_cell(m, cx, cy, val);
+            m->redrawn++;
+        }
+    }
+    m->mapGeneration = mapGeneration;
+    return true;
+}
+
+void minimap_update_rect(Minimap *m, int x0, int y0, int x1, int y1) {
+    if (!m->image || m->mapW != mapW || m->mapH != mapH) return;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= mapW) x1 = mapW - 1;
+    if (y1 >= mapH) y1 = mapH - 1;
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            int val = MAP_AT(cx, cy);
+            if (m->cells[cx + mapW * cy] == val) continue;
+            draw_cell(m, cx, cy, val);
+            m->redrawn++;
+        }
+    }
+}
+
+static void put_pixel(Uint32 *dst, int pitch, int x, int y, int w, int h, int px, int py, Uint32 col) {
+    if (px < 0 || py < 0 || px >= w || py >= h) return;
+    dst[(size_t)(y + py) * pitch + x + px] = col;
+}
+
+void minimap_draw(const Minimap *m, Uint32 *dst, int pitch, int x, int y, int w, int h,
+    double posX, double posY, double dirX, double dirY) {
+    if (!m->image || w <= 2 || h <= 2) return;
+    // image coordinates of the window's top-left corner
+    int left = (int)floor(posX * m->cellPx) - w / 2;
+    int top = (int)floor(posY * m->cellPx) - h / 2;
+    for (int row = 0; row < h; row++) {
+        Uint32 *out = dst + (size_t)(y + row) * pitch + x;
+        int sy = top + row;
+        if (sy < 0 || sy >= m->h) {
+            for (int i = 0; i < w; i++) out[i] = MINIMAP_BACKGROUND;
+            continue;
+        }
+        // copy the part that overlaps the image, pad the rest
+        int s0 = left < 0 ? -left : 0;
+        int s1 = m->w - left < w ? m->w - left : w;
+        if (s1 < s0) s1 = s0;
+        for (int i = 0; i < s0; i++) out[i] = MINIMAP_BACKGROUND;
+        if (s1 > s0) memcpy(out + s0, m->image + (size_t)sy * m->w + left + s0, sizeof(Uint32) * (size_t)(s1 - s0));
+        for (int i = s1; i < w; i++) out[i] = MINIMAP_BACKGROUND;
+    }
+    for (int i = 0; i < w; i++) {
+        dst[(size_t)y * pitch + x + i] = MINIMAP_FRAME;
+        dst[(size_t)(y + h - 1) * pitch + x + i] = MINIMAP_FRAME;
+    }
+    for (int i = 0; i < h; i++) {
+        dst[(size_t)(y + i) * pitch + x] = MINIMAP_FRAME;
+        dst[(size_t)(y + i) * pitch + x + w - 1] = MINIMAP_FRAME;
+    }
+    // camera, always at the centre: a 3x3 dot and a two-cell line along the view direction
+    int cx = w / 2, cy = h / 2;
+    for (int dy = -1; dy <= 1; dy++) for (int dx = -1; dx <= 1; dx++) put_pixel(dst, pitch, x, y, w, h, cx + dx, cy + dy, MINIMAP_PLAYER);
+    double len = sqrt(dirX * dirX + dirY * dirY);
+    if (len <= 0.0) return;
+    int steps = 2 * m->cellPx;
+    for (int i = 2; i <= steps; i++) {
+        put_pixel(dst, pitch, x, y, w, h, cx + (int)lround(dirX / len * i), cy + (int)lround(dirY / len * i), MINIMAP_PLAYER);
+    }
+}
+
+void minimap_free(Minimap *m) {
+    free(m->image);
+    free(m->cells);
+    memset(m, 0, sizeof(*m));
+}
@@ -0,0 +1,34 @@
+#ifndef GAME_MINIMAP_H
+#define GAME_MINIMAP_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Top-down overview of worldMap. The whole map is kept as an image of
+// cellPx-sized squares. Runtime edits are passed in as the map's dirty
+// rectangles; after a reload (mapGeneration moved on) every cell is compared
+// and only the ones whose value changed are redrawn. Zero-initialize before
+// first use.
+typedef struct Minimap {
+    int cellPx;
+    int mapW, mapH;        // map size the image was built for
+    int w, h;              // image size in pixels
+    Uint32 *image;
+    int *cells;            // worldMap value each cell was last drawn with
+    unsigned mapGeneration;
+    int redrawn;           // cells drawn since the last minimap_update()
+} Minimap;
+
+// bring the image up to date; a new map size or cellPx rebuilds it
+bool minimap_update(Minimap *m, int cellPx);
+// redraw the changed cells in [x0,x1]x[y0,y1]; no-op until the image exists
+void minimap_update_rect(Minimap *m, int x0, int y0, int x1, int y1);
+// copy a w x h window centred on (posX, posY) into dst at (x, y), framed,
+// with the camera marked by a dot and a line along (dirX, dirY)
+void minimap_draw(const Minimap *m, Uint32 *dst, int pitch, int x, int y, int w, int h,
+    double posX, double posY, double dirX, double dirY);
+void minimap_free(Minimap *m);
+// the colour a cell value is drawn with
+Uint32 minimap_cell_color(int val);
+
+#endif
@@ -0,0 +1,763 @@
+#include "nav.h"
+
+#include "jobs.h"
+#include "map.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NAV_BUCKETS 16 // ring for the flow build, must exceed the diagonal cost
+
+const int navDirX[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+const int navDirY[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+
+typedef struct NavHeapItem { Uint32 key; int cell; } NavHeapItem;
+
+// per-search scratch, pooled so concurrent workers never share one; stamps
+// compared against gen stand in for clearing the per-cell arrays
+typedef struct NavScratch {
+    int cells;
+    Uint32 gen;
+    Uint32 *g;
+    int *parent;
+    Uint32 *openStamp;
+    Uint32 *markStamp;   // closed set for JPS, touched set for flow repair
+    NavHeapItem *heap;   // open list for JPS, sorted seeds for flow repair
+    int heapLen, heapCap;
+    int *list;
+    int listLen, listCap;
+    int *bucket[NAV_BUCKETS];
+    int bucketLen[NAV_BUCKETS], bucketCap[NAV_BUCKETS];
+    struct NavScratch *next;
+} NavScratch;
+
+static NavScratch *scratchFree = NULL;
+static SDL_SpinLock scratchLock = 0;
+static SDL_atomic_t pathsInFlight;
+
+// flow field cache, owned by the main thread; builds run on workers into
+// private fields and are picked up by flow_collect()
+typedef struct NavBuild {
+    NavFlowField *field;
+    SDL_atomic_t done;
+    bool active;
+} NavBuild;
+
+typedef struct NavDirty { int x0, y0, x1, y1; } NavDirty;
+
+static NavFlowField *flowCache[NAV_FLOW_CACHE];
+static NavBuild builds[NAV_FLOW_CACHE];
+static NavDirty dirtyLog[NAV_DIRTY_LOG]; // the edit taking version v to v + 1 sits at v % NAV_DIRTY_LOG
+static unsigned navVersion = 0;
+static unsigned useClock = 0;
+
+static bool ensure_cap(void **buf, int *cap, int need, size_t elem) {
+    if (need <= *cap) return true;
+    int n = *cap ? *cap : 256;
+    while (n < need) n *= 2;
+    void *p = realloc(*buf, elem * (size_t)n);
+    if (!p) { fprintf(stderr, "nav: out of memory\n"); return false; }
+    *buf = p;
+    *cap = n;
+    return true;
+}
+
+static void scratch_free(NavScratch *s) {
+    free(s->g); free(s->parent); free(s->openStamp); free(s->markStamp);
+    free(s->heap); free(s->list);
+    for (int b = 0; b < NAV_BUCKETS; b++) free(s->bucket[b]);
+    free(s);
+}
+
+// a fresh generation: every stamp reads as unset again
+static void scratch_restamp(NavScratch *s) {
+    if (++s->gen == 0) {
+        memset(s->openStamp, 0, sizeof(Uint32) * (size_t)s->cells);
+        memset(s->markStamp, 0, sizeof(Uint32) * (size_t)s->cells);
+        s->gen = 1;
+    }
+}
+
+static void scratch_begin(NavScratch *s) {
+    scratch_restamp(s);
+    s->heapLen = 0;
+    s->listLen = 0;
+}
+
+static NavScratch *scratch_acquire(int cells) {
+    SDL_AtomicLock(&scratchLock);
+    NavScratch *s = scratchFree;
+    if (s) scratchFree = s->next;
+    SDL_AtomicUnlock(&scratchLock);
+    if (!s && !(s = calloc(1, sizeof(*s)))) { fprintf(stderr, "nav: out of memory\n"); return NULL; }
+    if (s->cells < cells) {
+        free(s->g); free(s->parent); free(s->openStamp); free(s->markStamp);
+        s->g = malloc(sizeof(Uint32) * (size_t)cells);
+        s->parent = malloc(sizeof(int) * (size_t)cells);
+        s->openStamp = calloc((size_t)cells, sizeof(Uint32));
+        s->markStamp = calloc((size_t)cells, sizeof(Uint32));
+        s->cells = cells;
+        s->gen = 0;
+        if (!s->g || !s->parent || !s->openStamp || !s->markStamp) {
+            fprintf(stderr, "nav: failed to allocate scratch for %d cells\n", cells);
+            scratch_free(s);
+            return NULL;
+        }
+    }
+    scratch_begin(s);
+    return s;
+}
+
+static void scratch_release(NavScratch *s) {
+    SDL_AtomicLock(&scratchLock);
+    s->next = scratchFree;
+    scratchFree = s;
+    SDL_AtomicUnlock(&scratchLock);
+}
+
+static bool heap_push(NavScratch *s, Uint32 key, int cell) {
+    if (!ensure_cap((void **)&s->heap, &s->heapCap, s->heapLen + 1, sizeof(NavHeapItem))) return false;
+    int i = s->heapLen++;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (s->heap[p].key <= key) break;
+        s->heap[i] = s->heap[p];
+        i = p;
+    }
+    s->heap[i] = (NavHeapItem){ key, cell };
+    return true;
+}
+
+static NavHeapItem heap_pop(NavScratch *s) {
+    NavHeapItem top = s->heap[0];
+    NavHeapItem last = s->heap[--s->heapLen];
+    int n = s->heapLen, i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && s->heap[c + 1].key < s->heap[c].key) c++;
+        if (last.key <= s->heap[c].key) break;
+        s->heap[i] = s->heap[c];
+        i = c;
+    }
+    if (n > 0) s->heap[i] = last;
+    return top;
+}
+
+static bool list_push(NavScratch *s, int cell) {
+    if (!ensure_cap((void **)&s->list, &s->listCap, s->listLen + 1, sizeof(int))) return false;
+    s->list[s->listLen++] = cell;
+    return true;
+}
+
+static inline bool walk(int x, int y) {
+    return (unsigned)x < (unsigned)mapW && (unsigned)y < (unsigned)mapH && !MAP_SOLID(x, y);
+}
+
+// step k from (x, y) lands on an open cell without cutting a corner
+static inline bool move_ok(int x, int y, int k) {
+    if (k < 0) return false;
+    int nx = x + navDirX[k], ny = y + navDirY[k];
+    return walk(nx, ny) && (k < 4 || (walk(nx, y) && walk(x, ny)));
+}
+
+static inline Uint32 octile(int ax, int ay, int bx, int by) {
+    int dx = abs(ax - bx), dy = abs(ay - by);
+    int lo = dx < dy ? dx : dy, hi = dx < dy ? dy : dx;
+    return (Uint32)(NAV_COST_DIAGONAL * lo + NAV_COST_STRAIGHT * (hi - lo));
+}
+
+// --- jump point search ---
+
+static int jump_straight(int x, int y, int dx, int dy, int goal) {
+    for (;;) {
+        x += dx; y += dy;
+        if (!walk(x, y)) return -1;
+        int i = x + mapW * y;
+        if (i == goal) return i;
+        // a side cell that the previous column could not reach diagonally is forced
+        if (dx) {
+            if ((walk(x, y - 1) && !walk(x - dx, y - 1)) || (walk(x, y + 1) && !walk(x - dx, y + 1))) return i;
+        } else {
+            if ((walk(x - 1, y) && !walk(x - 1, y - dy)) || (walk(x + 1, y) && !walk(x + 1, y - dy))) return i;
+        }
+    }
+}
+
+// the caller has checked both orthogonal cells, so the first step is legal
+static int jump_diagonal(int x, int y, int dx, int dy, int goal) {
+    for (;;) {
+        x += dx; y += dy;
+        if (!walk(x, y)) return -1;
+        int i = x + mapW * y;
+        if (i == goal) return i;
+        if (jump_straight(x, y, dx, 0, goal) >= 0 || jump_straight(x, y, 0, dy, goal) >= 0) return i;
+        if (!walk(x + dx, y) || !walk(x, y + dy)) return -1;
+    }
+}
+
+// pruned directions to search from (x, y) given where the search came from
+static int successors(int x, int y, int parent, int dirs[8][2]) {
+    int n = 0;
+    if (parent < 0) {
+        for (int k = 0; k < 8; k++) {
+            if (move_ok(x, y, k)) { dirs[n][0] = navDirX[k]; dirs[n][1] = navDirY[k]; n++; }
+        }
+        return n;
+    }
+    int px = parent % mapW, py = parent / mapW;
+    int dx = (x > px) - (x < px), dy = (y > py) - (y < py);
+    if (dx && dy) {
+        bool h = walk(x + dx, y), v = walk(x, y + dy);
+        if (v) { dirs[n][0] = 0; dirs[n][1] = dy; n++; }
+        if (h) { dirs[n][0] = dx; dirs[n][1] = 0; n++; }
+        if (h && v) { dirs[n][0] = dx; dirs[n][1] = dy; n++; }
+    } else if (dx) {
+        bool next = walk(x + dx, y), up = walk(x, y - 1), down = walk(x, y + 1);
+        if (next) {
+            dirs[n][0] = dx; dirs[n][1] = 0; n++;
+            if (up) { dirs[n][0] = dx; dirs[n][1] = -1; n++; }
+            if (down) { dirs[n][0] = dx; dirs[n][1] = 1; n++; }
+        }
+        if (up) { dirs[n][0] = 0; dirs[n][1] = -1; n++; }
+        if (down) { dirs[n][0] = 0; dirs[n][1] = 1; n++; }
+    } else {
+        bool next = walk(x, y + dy), left = walk(x - 1, y), right = walk(x + 1, y);
+        if (next) {
+            dirs[n][0] = 0; dirs[n][1] = dy; n++;
+            if (left) { dirs[n][0] = -1; dirs[n][1] = dy; n++; }
+            if (right) { dirs[n][0] = 1; dirs[n][1] = dy; n++; }
+        }
+        if (left) { dirs[n][0] = -1; dirs[n][1] = 0; n++; }
+        if (right) { dirs[n][0] = 1; dirs[n][1] = 0; n++; }
+    }
+    return n;
+}
+
+int nav_find_path(int startX, int startY, int goalX, int goalY, int *points, int maxPoints) {
+    if (!mapSolid || !walk(startX, startY) || !walk(goalX, goalY)) return -1;
+    NavScratch *s = scratch_acquire(mapW * mapH);
+    if (!s) return -1;
+    Uint32 gen = s->gen;
+    int start = startX + mapW * startY, goal = goalX + mapW * goalY;
+    s->g[start] = 0;
+    s->parent[start] = -1;
+    s->openStamp[start] = gen;
+    bool found = false, ok = heap_push(s, octile(startX, startY, goalX, goalY), start);
+    while (ok && s->heapLen > 0) {
+        int i = heap_pop(s).cell;
+        if (s->markStamp[i] == gen) continue;
+        s->markStamp[i] = gen;
+        if (i == goal) { found = true; break; }
+        int x = i % mapW, y = i / mapW;
+        int dirs[8][2];
+        int n = successors(x, y, s->parent[i], dirs);
+        for (int k = 0; k < n && ok; k++) {
+            int dx = dirs[k][0], dy = dirs[k][1];
+            int j = (dx && dy) ? jump_diagonal(x, y, dx, dy, goal) : jump_straight(x, y, dx, dy, goal);
+            if (j < 0 || s->markStamp[j] == gen) continue;
+            int jx = j % mapW, jy = j / mapW;
+            Uint32 ng = s->g[i] + octile(x, y, jx, jy);
+            if (s->openStamp[j] == gen && ng >= s->g[j]) continue;
+            s->g[j] = ng;
+            s->parent[j] = i;
+            s->openStamp[j] = gen;
+            ok = heap_push(s, ng + octile(jx, jy, goalX, goalY), j);
+        }
+    }
+    int count = -1;
+    if (found) {
+        for (int c = goal; c >= 0 && ok; c = s->parent[c]) ok = list_push(s, c);
+        if (ok) {
+            count = s->listLen;
+            for (int k = 0; k < count && k < maxPoints; k++) {
+                int c = s->list[count - 1 - k];
+                points[2 * k] = c % mapW;
+                points[2 * k + 1] = c / mapW;
+            }
+        }
+    }
+    scratch_release(s);
+    return count;
+}
+
+static void path_job(void *ctx) {
+    NavPathRequest *req = ctx;
+    req->count = nav_find_path(req->startX, req->startY, req->goalX, req->goalY, req->points, req->maxPoints);
+    SDL_AtomicSet(&req->done, 1);
+    SDL_AtomicAdd(&pathsInFlight, -1);
+}
+
+void nav_submit_path(NavPathRequest *req) {
+    SDL_AtomicSet(&req->done, 0);
+    SDL_AtomicAdd(&pathsInFlight, 1);
+    jobs_submit(path_job, req);
+}
+
+// --- flow fields ---
+
+static bool bucket_push(NavScratch *s, Uint32 key, int cell) {
+    int b = (int)(key & (NAV_BUCKETS - 1));
+    if (!ensure_cap((void **)&s->bucket[b], &s->bucketCap[b], s->bucketLen[b] + 1, sizeof(int))) return false;
+    s->bucket[b][s->bucketLen[b]++] = cell;
+    return true;
+}
+
+// steepest descent: the legal step to the cheapest neighbour, straight moves win ties
+static void flow_set_dir(NavFlowField *f, int i) {
+    Sint8 best = -1;
+    Uint32 c = f->cost[i];
+    if (c != NAV_UNREACHABLE && c != 0) {
+        int x = i % mapW, y = i / mapW;
+        Uint32 bestCost = NAV_UNREACHABLE;
+        for (int k = 0; k < 8; k++) {
+            if (!move_ok(x, y, k)) continue;
+            Uint32 n = f->cost[i + navDirX[k] + mapW * navDirY[k]];
+            if (n == NAV_UNREACHABLE) continue;
+            n += (k < 4) ? NAV_COST_STRAIGHT : NAV_COST_DIAGONAL;
+            if (n < bestCost) { bestCost = n; best = (Sint8)k; }
+        }
+    }
+    f->dir[i] = best;
+}
+
+// full Dijkstra from the goal; step costs are small so a bucket ring replaces the heap
+static void flow_build(NavScratch *s, NavFlowField *f) {
+    int n = f->w * f->h;
+    memset(f->cost, 0xFF, sizeof(Uint32) * (size_t)n);
+    memset(f->dir, -1, (size_t)n);
+    if (!walk(f->goalX, f->goalY)) return;
+    int goal = f->goalX + mapW * f->goalY;
+    f->cost[goal] = 0;
+    int pending = bucket_push(s, 0, goal);
+    for (Uint32 cur = 0; pending > 0; cur++) {
+        int b = (int)(cur & (NAV_BUCKETS - 1));
+        while (s->bucketLen[b] > 0) {
+            int u = s->bucket[b][--s->bucketLen[b]];
+            pending--;
+            if (f->cost[u] != cur) continue;
+            int ux = u % mapW, uy = u / mapW;
+            for (int k = 0; k < 8; k++) {
+                if (!move_ok(ux, uy, k)) continue;
+                int v = u + navDirX[k] + mapW * navDirY[k];
+                Uint32 nc = cur + ((k < 4) ? NAV_COST_STRAIGHT : NAV_COST_DIAGONAL);
+                if (nc < f->cost[v]) {
+                    f->cost[v] = nc;
+                    pending += bucket_push(s, nc, v);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < n; i++) flow_set_dir(f, i);
+}
+
+static void flow_touch(NavScratch *s, int i) {
+    if (s->markStamp[i] == s->gen) return;
+    s->markStamp[i] = s->gen;
+    list_push(s, i);
+}
+
+// diagonal steps around a changed cell start one cell outside its rectangle
+static NavDirty repair_bounds(const NavDirty *d) {
+    NavDirty r = { d->x0 - 1, d->y0 - 1, d->x1 + 1, d->y1 + 1 };
+    if (r.x0 < 0) r.x0 = 0;
+    if (r.y0 < 0) r.y0 = 0;
+    if (r.x1 >= mapW) r.x1 = mapW - 1;
+    if (r.y1 >= mapH) r.y1 = mapH - 1;
+    return r;
+}
+
+static int cmp_heap_item(const void *a, const void *b) {
+    Uint32 x = ((const NavHeapItem *)a)->key, y = ((const NavHeapItem *)b)->key;
+    return (x > y) - (x < y);
+}
+
+static bool seed_push(NavScratch *s, Uint32 key, int cell) {
+    if (!ensure_cap((void **)&s->heap, &s->heapCap, s->heapLen + 1, sizeof(NavHeapItem))) return false;
+    s->heap[s->heapLen++] = (NavHeapItem){ key, cell };
+    return true;
+}
+
+// Next cell of a wavefront in key order, its key left in *cur. The seeds in
+// s->heap (sorted) join as cur reaches their keys; what the pass pushes onto
+// the bucket ring lies at most a diagonal step above cur. Gaps between seeds
+// are skipped, so the cost follows the cells visited, not the key range.
+static bool wave_next(NavScratch *s, int *seedAt, int *pending, Uint32 *cur, int *cell) {
+    for (;;) {
+        if (*seedAt < s->heapLen && s->heap[*seedAt].key == *cur) {
+            *cell = s->heap[(*seedAt)++].cell;
+            return true;
+        }
+        int b = (int)(*cur & (NAV_BUCKETS - 1));
+        if (s->bucketLen[b] > 0) {
+            *cell = s->bucket[b][--s->bucketLen[b]];
+            (*pending)--;
+            return true;
+        }
+        if (*pending > 0) (*cur)++;
+        else if (*seedAt < s->heapLen) *cur = s->heap[*seedAt].key;
+        else return false;
+    }
+}
+
+static bool wave_begin(NavScratch *s, int *seedAt, int *pending, Uint32 *cur) {
+    qsort(s->heap, (size_t)s->heapLen, sizeof(NavHeapItem), cmp_heap_item);
+    *seedAt = *pending = 0;
+    *cur = s->heapLen > 0 ? s->heap[0].key : 0;
+    return s->heapLen > 0;
+}
+
+// Incremental repair after the cells in some rectangles changed, bounded by
+// the cells whose cost actually moves. Raise: in order of their old cost, the
+// cells in the rectangles, then the neighbours that drew their cost from a
+// raised cell, lose it unless another neighbour still gives the same cost.
+// Lower: the raised cells' surviving neighbours and the rectangles (newly
+// opened cells, corners that no longer block a diagonal) relax outward, and
+// the wave stops where a cost would not drop. Both passes run on the bucket
+// ring, and all the rectangles share them.
+static void flow_repair(NavScratch *s, NavFlowField *f, const NavDirty *rects, int count) {
+    if (!walk(f->goalX, f->goalY)) {
+        memset(f->cost, 0xFF, sizeof(Uint32) * (size_t)f->w * f->h);
+        memset(f->dir, -1, (size_t)f->w * f->h);
+        return;
+    }
+    int goal = f->goalX + mapW * f->goalY;
+    if (f->cost[goal] != 0) { flow_build(s, f); return; } // goal was solid until now
+
+    bool ok = true;
+    for (int r = 0; r < count && ok; r++) {
+        NavDirty b = repair_bounds(&rects[r]);
+        for (int y = b.y0; y <= b.y1 && ok; y++) for (int x = b.x0; x <= b.x1 && ok; x++) {
+            int i = x + mapW * y;
+            if (f->cost[i] == NAV_UNREACHABLE || i == goal || s->openStamp[i] == s->gen) continue;
+            s->openStamp[i] = s->gen;
+            ok = seed_push(s, f->cost[i], i);
+        }
+    }
+    int seedAt, pending, u;
+    Uint32 cur;
+    if (ok && wave_begin(s, &seedAt, &pending, &cur)) {
+        while (ok && wave_next(s, &seedAt, &pending, &cur, &u)) {
+            if (f->cost[u] != cur) continue;
+            int ux = u % mapW, uy = u / mapW;
+            bool held = false;
+            if (!MAP_SOLID(ux, uy)) {
+                for (int k = 0; k < 8 && !held; k++) {
+                    if (!move_ok(ux, uy, k)) continue;
+                    Uint32 n = f->cost[u + navDirX[k] + mapW * navDirY[k]];
+                    held = n != NAV_UNREACHABLE && n + ((k < 4) ? NAV_COST_STRAIGHT : NAV_COST_DIAGONAL) == cur;
+                }
+            }
+            if (held) continue;
+            f->cost[u] = NAV_UNREACHABLE;
+            flow_touch(s, u);
+            // neighbours whose cost came through u, legal step or not by now
+            for (int k = 0; k < 8 && ok; k++) {
+                int nx = ux - navDirX[k], ny = uy - navDirY[k];
+                if ((unsigned)nx >= (unsigned)mapW || (unsigned)ny >= (unsigned)mapH) continue;
+                int j = nx + mapW * ny;
+                Uint32 want = cur + ((k < 4) ? NAV_COST_STRAIGHT : NAV_COST_DIAGONAL);
+                if (f->cost[j] != want || s->openStamp[j] == s->gen) continue;
+                s->openStamp[j] = s->gen;
+                ok = bucket_push(s, want, j);
+                pending += ok;
+            }
+        }
+    }
+
+    s->heapLen = 0;
+    for (int h = 0; h < s->listLen && ok; h++) {
+        int c = s->list[h], cx = c % mapW, cy = c / mapW;
+        for (int k = 0; k < 8 && ok; k++) {
+            int nx = cx + navDirX[k], ny = cy + navDirY[k];
+            if ((unsigned)nx >= (unsigned)mapW || (unsigned)ny >= (unsigned)mapH) continue;
+            int j = nx + mapW * ny;
+            if (f->cost[j] != NAV_UNREACHABLE) ok = seed_push(s, f->cost[j], j);
+        }
+    }
+    for (int r = 0; r < count && ok; r++) {
+        NavDirty b = repair_bounds(&rects[r]);
+        for (int y = b.y0; y <= b.y1 && ok; y++) for (int x = b.x0; x <= b.x1 && ok; x++) {
+            int i = x + mapW * y;
+            if (f->cost[i] != NAV_UNREACHABLE) ok = seed_push(s, f->cost[i], i);
+        }
+    }
+    if (ok && wave_begin(s, &seedAt, &pending, &cur)) {
+        while (ok && wave_next(s, &seedAt, &pending, &cur, &u)) {
+            if (f->cost[u] != cur) continue;
+            int ux = u % mapW, uy = u / mapW;
+            for (int k = 0; k < 8 && ok; k++) {
+                if (!move_ok(ux, uy, k)) continue;
+                int v = u + navDirX[k] + mapW * navDirY[k];
+                Uint32 nc = cur + ((k < 4) ? NAV_COST_STRAIGHT : NAV_COST_DIAGONAL);
+                if (nc >= f->cost[v]) continue;
+                f->cost[v] = nc;
+                flow_touch(s, v);
+                ok = bucket_push(s, nc, v);
+                pending += ok;
+            }
+        }
+    }
+    // out of memory part way: the field is inconsistent, so start over
+    if (!ok) {
+        for (int b = 0; b < NAV_BUCKETS; b++) s->bucketLen[b] = 0;
+        flow_build(s, f);
+        return;
+    }
+
+    // directions of the cells whose cost moved and of their neighbours, once each
+    scratch_restamp(s);
+    for (int h = 0; h < s->listLen; h++) {
+        int c = s->list[h], cx = c % mapW, cy = c / mapW;
+        for (int k = -1; k < 8; k++) {
+            int nx = cx + (k < 0 ? 0 : navDirX[k]), ny = cy + (k < 0 ? 0 : navDirY[k]);
+            if ((unsigned)nx >= (unsigned)mapW || (unsigned)ny >= (unsigned)mapH) continue;
+            int j = nx + mapW * ny;
+            if (s->markStamp[j] == s->gen) continue;
+            s->markStamp[j] = s->gen;
+            flow_set_dir(f, j);
+        }
+    }
+}
+
+static void flow_free(NavFlowField *f) {
+    if (!f) return;
+    free(f->cost);
+    free(f->dir);
+    free(f);
+}
+
+static NavFlowField *flow_alloc(int goalX, int goalY) {
+    NavFlowField *f = calloc(1, sizeof(*f));
+    if (!f) return NULL;
+    f->goalX = goalX;
+    f->goalY = goalY;
+    f->w = mapW;
+    f->h = mapH;
+    f->version = navVersion;
+    f->cost = malloc(sizeof(Uint32) * (size_t)mapW * mapH);
+    f->dir = malloc((size_t)mapW * mapH);
+    if (!f->cost || !f->dir) {
+        fprintf(stderr, "nav: failed to allocate flow field %dx%d\n", mapW, mapH);
+        flow_free(f);
+        return NULL;
+    }
+    return f;
+}
+
+static void flow_job(void *ctx) {
+    NavBuild *b = ctx;
+    NavScratch *s = scratch_acquire(b->field->w * b->field->h);
+    if (s) {
+        flow_build(s, b->field);
+        scratch_release(s);
+    } else {
+        memset(b->field->cost, 0xFF, sizeof(Uint32) * (size_t)b->field->w * b->field->h);
+        memset(b->field->dir, -1, (size_t)b->field->w * b->field->h);
+    }
+    SDL_AtomicSet(&b->done, 1);
+}
+
+static NavFlowField *flow_find(int goalX, int goalY) {
+    for (int i = 0; i < NAV_FLOW_CACHE; i++) {
+        NavFlowField *f = flowCache[i];
+        if (f && f->goalX == goalX && f->goalY == goalY) { f->lastUse = ++useClock; return f; }
+    }
+    return NULL;
+}
+
+static NavBuild *build_for(int goalX, int goalY) {
+    for (int i = 0; i < NAV_FLOW_CACHE; i++) {
+        NavBuild *b = &builds[i];
+        if (b->active && b->field->goalX == goalX && b->field->goalY == goalY) return b;
+    }
+    return NULL;
+}
+
+// bring a finished field up to date with edits made while it was built, then cache it
+static void flow_install(NavFlowField *f) {
+    if (f->w != mapW || f->h != mapH) { flow_free(f); return; }
+    if (f->version != navVersion) {
+        NavScratch *s = scratch_acquire(mapW * mapH);
+        if (!s) { flow_free(f); return; }
+        if (navVersion - f->version > NAV_DIRTY_LOG) {
+            flow_build(s, f);
+        } else {
+            NavDirty pending[NAV_DIRTY_LOG];
+            int n = 0;
+            for (unsigned v = f->version; v != navVersion; v++) pending[n++] = dirtyLog[v % NAV_DIRTY_LOG];
+            scratch_begin(s);
+            flow_repair(s, f, pending, n);
+        }
+        scratch_release(s);
+        f->version = navVersion;
+    }
+    int slot = 0;
+    for (int i = 0; i < NAV_FLOW_CACHE; i++) {
+        if (!flowCache[i]) { slot = i; break; }
+        if (flowCache[i]->lastUse < flowCache[slot]->lastUse) slot = i;
+    }
+    flow_free(flowCache[slot]);
+    f->lastUse = ++useClock;
+    flowCache[slot] = f;
+}
+
+static void flow_collect(void) {
+    for (int i = 0; i < NAV_FLOW_CACHE; i++) {
+        NavBuild *b = &builds[i];
+        if (!b->active || !SDL_AtomicGet(&b->done)) continue;
+        b->active = false;
+        flow_install(b->field);
+        b->field = NULL;
+    }
+}
+
+const NavFlowField *nav_flow_field(int goalX, int goalY) {
+    if (!mapSolid || (unsigned)goalX >= (unsigned)mapW || (unsigned)goalY >= (unsigned)mapH) return NULL;
+    flow_collect();
+    NavFlowField *f = flow_find(goalX, goalY);
+    if (f || build_for(goalX, goalY)) return f;
+    NavBuild *b = NULL;
+    for (int i = 0; i < NAV_FLOW_CACHE && !b; i++) if (!builds[i].active) b = &builds[i];
+    if (!b || !(b->field = flow_alloc(goalX, goalY))) return NULL;
+    SDL_AtomicSet(&b->done, 0);
+    b->active = true;
+    jobs_submit(flow_job, b);
+    // without workers the build has already run inline
+    flow_collect();
+    return flow_find(goalX, goalY);
+}
+
+const NavFlowField *nav_flow_field_wait(int goalX, int goalY) {
+    if (!mapSolid || (unsigned)goalX >= (unsigned)mapW || (unsigned)goalY >= (unsigned)mapH) return NULL;
+    flow_collect();
+    NavFlowField *f = flow_find(goalX, goalY);
+    if (f) return f;
+    NavBuild *b = build_for(goalX, goalY);
+    if (b) {
+        while (!SDL_AtomicGet(&b->done)) SDL_Delay(0);
+        flow_collect();
+        return flow_find(goalX, goalY);
+    }
+    if (!(f = flow_alloc(goalX, goalY))) return NULL;
+    NavScratch *s = scratch_acquire(mapW * mapH);
+    if (!s) { flow_free(f); return NULL; }
+    flow_build(s, f);
+    scratch_release(s);
+    flow_install(f);
+    return flow_find(goalX, goalY);
+}
+
+int nav_flow_step(const NavFlowField *f, int x, int y, int *dx, int *dy) {
+    if (!f || (unsigned)x >= (unsigned)f->w || (unsigned)y >= (unsigned)f->h) return 0;
+    int d = f->dir[x + f->w * y];
+    if (d < 0) return 0;
+    *dx = navDirX[d];
+    *dy = navDirY[d];
+    return 1;
+}
+
+void nav_update_rect(int x0, int y0, int x1, int y1) {
+    MapRect r = { x0, y0, x1, y1 };
+    nav_update_rects(&r, 1);
+}
+
+// the rectangle ordered and clipped to the map; false when nothing is left
+static bool dirty_clip(const MapRect *r, NavDirty *out) {
+    NavDirty d = { r->x0, r->y0, r->x1, r->y1 };
+    if (d.x0 > d.x1) { int t = d.x0; d.x0 = d.x1; d.x1 = t; }
+    if (d.y0 > d.y1) { int t = d.y0; d.y0 = d.y1; d.y1 = t; }
+    if (d.x0 < 0) d.x0 = 0;
+    if (d.y0 < 0) d.y0 = 0;
+    if (d.x1 >= mapW) d.x1 = mapW - 1;
+    if (d.y1 >= mapH) d.y1 = mapH - 1;
+    *out = d;
+    return d.x0 <= d.x1 && d.y0 <= d.y1;
+}
+
+typedef struct NavRepairJob {
+    const MapRect *rects;
+    int count;
+    NavFlowField *fields[NAV_FLOW_CACHE];
+    bool failed[NAV_FLOW_CACHE];
+} NavRepairJob;
+
+// fields touch nothing shared but the read-only map, so each repairs on its own
+static void repair_range(void *ctx, int begin, int end) {
+    NavRepairJob *j = ctx;
+    NavScratch *s = scratch_acquire(mapW * mapH);
+    for (int i = begin; i < end; i++) {
+        if (!s) { j->failed[i] = true; continue; }
+        // the same slices as the log, so the result matches replaying it
+        for (int start = 0; start < j->count; start += NAV_DIRTY_LOG) {
+            NavDirty batch[NAV_DIRTY_LOG];
+            int n = 0;
+            for (int r = start; r < j->count && r < start + NAV_DIRTY_LOG; r++) {
+                if (dirty_clip(&j->rects[r], &batch[n])) n++;
+            }
+            if (n == 0) continue;
+            scratch_begin(s);
+            flow_repair(s, j->fields[i], batch, n);
+        }
+    }
+    if (s) scratch_release(s);
+}
+
+void nav_update_rects(const MapRect *rects, int count) {
+    if (!mapSolid) return;
+    flow_collect();
+    bool any = false;
+    for (int r = 0; r < count; r++) {
+        NavDirty d;
+        if (!dirty_clip(&rects[r], &d)) continue;
+        dirtyLog[navVersion % NAV_DIRTY_LOG] = d;
+        navVersion++;
+        any = true;
+    }
+    if (!any) return;
+    NavRepairJob j = { rects, count, { NULL }, { false } };
+    int slot[NAV_FLOW_CACHE], n = 0;
+    for (int i = 0; i < NAV_FLOW_CACHE; i++) {
+        NavFlowField *f = flowCache[i];
+        if (!f) continue;
+        if (f->w != mapW || f->h != mapH) { flow_free(f); flowCache[i] = NULL; continue; }
+        slot[n] = i;
+        j.fields[n++] = f;
+    }
+    jobs_parallel_for(n, 1, repair_range, &j);
+    for (int k = 0; k < n; k++) {
+        if (j.failed[k]) { flow_free(j.fields[k]); flowCache[slot[k]] = NULL; }
+        else j.fields[k]->version = navVersion;
+    }
+}
+
+void nav_reset(void) {
+    for (int i = 0; i < NAV_FLOW_CACHE; i++) {
+        NavBuild *b = &builds[i];
+        if (!b->active) continue;
+        while (!SDL_AtomicGet(&b->done)) SDL_Delay(1);
+        flow_free(b->field);
+        b->field = NULL;
+        b->active = false;
+    }
+    while (SDL_AtomicGet(&pathsInFlight) > 0) SDL_Delay(1);
+    for (int i = 0; i < NAV_FLOW_CACHE; i++) {
+        flow_free(flowCache[i]);
+        flowCache[i] = NULL;
+    }
+}
+
+void nav_shutdown(void) {
+    nav_reset();
+    SDL_AtomicLock(&scratchLock);
+    NavScratch *s = scratchFree;
+    scratchFree = NULL;
+    SDL_AtomicUnlock(&scratchLock);
+    while (s) {
+        NavScratch *next = s->next;
+        scratch_free(s);
+        s = next;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef GAME_NAV_H
+#define GAME_NAV_H
+
+#include <SDL2/SDL.h>
+
+#include "map.h"
+
+// Grid navigation over mapSolid: jump-point search for single paths and cached
+// flow fields for crowds sharing a goal. Moves are 8-way, a diagonal may not
+// cut a solid corner, and steps cost 10 straight / 14 diagonal.
+
+#define NAV_COST_STRAIGHT 10
+#define NAV_COST_DIAGONAL 14
+#define NAV_UNREACHABLE 0xFFFFFFFFu
+#define NAV_FLOW_CACHE 8   // goals kept at once, least recently used goes first
+#define NAV_DIRTY_LOG 32   // edits replayed onto fields that were mid-build
+
+// direction table shared by flow fields; the first four are the straight moves
+extern const int navDirX[8];
+extern const int navDirY[8];
+
+// Blocking search, safe from any thread. Writes up to maxPoints waypoints as
+// x, y pairs (start first, goal last, each leg a straight or diagonal run) and
+// returns the full waypoint count, or -1 when the goal cannot be reached.
+int nav_find_path(int startX, int startY, int goalX, int goalY, int *points, int maxPoints);
+
+// Same search queued on the job workers. The caller owns req and its points
+// buffer and keeps both alive until done reads non-zero.
+typedef struct NavPathRequest {
+    int startX, startY, goalX, goalY;
+    int *points;
+    int maxPoints;
+    int count;          // result, as nav_find_path
+    SDL_atomic_t done;
+} NavPathRequest;
+
+void nav_submit_path(NavPathRequest *req);
+
+typedef struct NavFlowField {
+    int goalX, goalY;
+    int w, h;
+    Uint32 *cost;       // integrated cost to the goal, NAV_UNREACHABLE when cut off
+    Sint8 *dir;         // index into navDirX/Y, -1 at the goal and where unreachable
+    unsigned version;   // edits already applied
+    unsigned lastUse;
+} NavFlowField;
+
+// Main thread only. Returns the cached field for the goal, or NULL while its
+// first build runs on a worker. The pointer stays valid until nav_reset() or
+// until NAV_FLOW_CACHE other goals have been asked for since.
+const NavFlowField *nav_flow_field(int goalX, int goalY);
+// as above but builds on the calling thread (or waits for the worker) on a miss
+const NavFlowField *nav_flow_field_wait(int goalX, int goalY);
+// next step toward the goal from cell (x, y); 0 at the goal or when cut off
+int nav_flow_step(const NavFlowField *f, int x, int y, int *dx, int *dy);
+
+// cells in [x0,x1]x[y0,y1] changed solidity (once mapSolid shows it):
+// cached fields are repaired in place, only the cells whose cost moved are touched
+void nav_update_rect(int x0, int y0, int x1, int y1);
+// the same for a batch, e.g. from map_take_dirty(): the fields are repaired
+// in parallel, one job each, and all are current again on return
+void nav_update_rects(const MapRect *rects, int count);
+// wait for queued work and drop every cached field; call when the map is
+// replaced (before freeing the old one if queries may still be in flight)
+void nav_reset(void);
+void nav_shutdown(void);
+
+#endif
@@ -0,0 +1,65 @@
+#include "pacing.h"
+
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+void pacer_init(FramePacer *p, int refreshHz, bool vsync) {
+    memset(p, 0, sizeof(*p));
+    p->period = 1.0 / (refreshHz > 0 ? refreshHz : 60);
+    p->margin = 0.001;
+    p->vsync = vsync;
+}
+
+double pacer_now(void) {
+    return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+static int cmp_cost(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+double pacer_predict(const FramePacer *p) {
+    // no history yet: assume the whole refresh is needed, i.e. don't wait
+    if (p->costCount == 0) return p->period;
+    double sorted[PACER_HISTORY];
+    memcpy(sorted, p->cost, sizeof(double) * p->costCount);
+    qsort(sorted, p->costCount, sizeof(double), cmp_cost);
+    // 90th percentile: one slow frame in ten may still miss, a steady hitch won't
+    double c = sorted[(p->costCount * 9) / 10] + p->margin;
+    return c < p->period ? c : p->period;
+}
+
+void pacer_wait(const FramePacer *p) {
+    if (p->deadline <= 0.0) return;
+    double target = p->deadline - pacer_predict(p);
+    // sleep in whole milliseconds while that can't overshoot, then yield until the target
+    for (;;) {
+        double left = target - pacer_now();
+        if (left <= 0.0) return;
+        SDL_Delay(left > 0.002 ? (Uint32)((left - 0.001) * 1000.0) : 0);
+    }
+}
+
+void pacer_input_sampled(FramePacer *p) {
+    p->sampledAt = pacer_now();
+}
+
+void pacer_presented(FramePacer *p) {
+    double t = pacer_now();
+    if (p->sampledAt > 0.0) {
+        double cost = t - p->sampledAt;
+        p->cost[p->costNext] = cost;
+        p->costNext = (p->costNext + 1) % PACER_HISTORY;
+        if (p->costCount < PACER_HISTORY) p->costCount++;
+        p->latency = cost;
+        p->latencyAvg = p->latencyAvg > 0.0 ? p->latencyAvg + (cost - p->latencyAvg) / 16.0 : cost;
+    }
+    if (p->deadline > 0.0 && t > p->deadline + 0.5 * p->period) p->missed++;
+    // a vsynced present returns at the refresh, so it anchors the next one;
+    // otherwise keep the cadence unless it fell behind or ran ahead of the clock
+    double next = p->deadline + p->period;
+    if (p->vsync || p->deadline <= 0.0 || next < t || next > t + 2.0 * p->period) next = t + p->period;
+    p->deadline = next;
+}
@@ -0,0 +1,37 @@
+#ifndef GAME_PACING_H
+#define GAME_PACING_H
+
+#include <stdbool.h>
+
+// Frame pacing for low latency. Rather than reading input straight after the
+// last present and then blocking in the next one until vsync, the frame
+// sleeps until its deadline minus the predicted cost of simulating, rendering
+// and presenting, so input is read as late as the frame allows. The cost is
+// predicted from a high percentile of recent frames plus a margin.
+// Times are seconds on the SDL performance counter.
+
+#define PACER_HISTORY 32
+
+typedef struct FramePacer {
+    double period;                // seconds per display refresh
+    double margin;                // slack added to the predicted cost
+    bool vsync;                   // presents block until the refresh
+    double cost[PACER_HISTORY];   // recent sample-to-present times
+    int costCount, costNext;
+    double deadline;              // when the next present is due, 0 before the first
+    double sampledAt;             // when this frame's input was read
+    double latency;               // last input-to-present time
+    double latencyAvg;            // smoothed over roughly the last 16 frames
+    int missed;                   // presents that landed a refresh late
+} FramePacer;
+
+void pacer_init(FramePacer *p, int refreshHz, bool vsync);
+double pacer_now(void);
+// cost the next frame is expected to need between sampling and present
+double pacer_predict(const FramePacer *p);
+// sleep until it is time to read input for the next present
+void pacer_wait(const FramePacer *p);
+void pacer_input_sampled(FramePacer *p);
+void pacer_presented(FramePacer *p);
+
+#endif
@@ -0,0 +1,196 @@
+#include "raycast.h"
+
+#include "jobs.h"
+
+#include <float.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define RAYCAST_HAVE_SSE2 1
+#else
+#define RAYCAST_HAVE_SSE2 0
+#endif
+
+#define RAYCAST_PARALLEL_MIN 8192 // below this a batch stays on the calling thread
+#define RAYCAST_GRAIN 2048
+#define LOS_CHUNK 256
+
+static int useSimd = 1;
+
+void raycast_set_simd(int enabled) {
+    useSimd = enabled;
+}
+
+static float face_u(int side, float ox, float oy, float dx, float dy, float t) {
+    float w = (side == 0) ? oy + t * dy : ox + t * dx;
+    float u = w - floorf(w);
+    if (side == 0 && dx > 0) u = 1.0f - u;
+    if (side == 1 && dy < 0) u = 1.0f - u;
+    return (u >= 1.0f) ? 0.0f : u;
+}
+
+static void store_hit(const RayBatch *b, int i, int hit, int cx, int cy, int side, float t) {
+    if (hit) {
+        b->cellX[i] = cx;
+        b->cellY[i] = cy;
+        b->side[i] = (Sint8)side;
+        b->dist[i] = t;
+        b->texU[i] = face_u(side, b->originX[i], b->originY[i], b->dirX[i], b->dirY[i], t);
+    } else {
+        b->cellX[i] = -1;
+        b->cellY[i] = -1;
+        b->side[i] = -1;
+        b->dist[i] = b->maxDist ? b->maxDist[i] : FLT_MAX;
+        b->texU[i] = 0.0f;
+    }
+}
+
+static void cast_scalar(const RayBatch *b, int i) {
+    double maxd = b->maxDist ? b->maxDist[i] : HUGE_VAL;
+    double ox = b->originX[i], oy = b->originY[i], dx = b->dirX[i], dy = b->dirY[i];
+    GridHit h = grid_dda(ox, oy, dx, dy, maxd);
+    double t = 0.0;
+    if (h.hit) {
+        if (h.side == 0) t = (dx != 0.0) ? (h.mapX - ox + (1 - h.stepX) / 2.0) / dx : 0.0;
+        else             t = (dy != 0.0) ? (h.mapY - oy + (1 - h.stepY) / 2.0) / dy : 0.0;
+    }
+    store_hit(b, i, h.hit, h.mapX, h.mapY, h.side, (float)t);
+}
+
+#if RAYCAST_HAVE_SSE2
+static inline __m128 sel_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i sel_epi32(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// four rays stepped in lock-step; lanes retire as they hit or run out of range
+static void cast_packet4(const RayBatch *b, int i0, int n) {
+    float ox[4], oy[4], dx[4], dy[4], md[4];
+    for (int l = 0; l < 4; l++) {
+        int i = i0 + (l < n ? l : 0);
+        ox[l] = b->originX[i]; oy[l] = b->originY[i];
+        dx[l] = b->dirX[i]; dy[l] = b->dirY[i];
+        md[l] = (l < n) ? (b->maxDist ? b->maxDist[i] : FLT_MAX) : -1.0f;
+    }
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 big = _mm_set1_ps(1e30f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 posX = _mm_loadu_ps(ox), posY = _mm_loadu_ps(oy);
+    __m128 rdX = _mm_loadu_ps(dx), rdY = _mm_loadu_ps(dy);
+    __m128 maxd = _mm_loadu_ps(md);
+
+    // floor() for the start cell: truncate, then step down where that rounded up
+    __m128i mapX = _mm_cvttps_epi32(posX), mapY = _mm_cvttps_epi32(posY);
+    mapX = _mm_add_epi32(mapX, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(mapX), posX)));
+    mapY = _mm_add_epi32(mapY, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(mapY), posY)));
+    __m128 mapXf = _mm_cvtepi32_ps(mapX), mapYf = _mm_cvtepi32_ps(mapY);
+
+    __m128 deltaX = _mm_min_ps(_mm_and_ps(_mm_div_ps(one, rdX), absMask), big);
+    __m128 deltaY = _mm_min_ps(_mm_and_ps(_mm_div_ps(one, rdY), absMask), big);
+    __m128 negX = _mm_cmplt_ps(rdX, zero), negY = _mm_cmplt_ps(rdY, zero);
+    __m128i stepX = sel_epi32(_mm_castps_si128(negX), _mm_set1_epi32(-1), _mm_set1_epi32(1));
+    __m128i stepY = sel_epi32(_mm_castps_si128(negY), _mm_set1_epi32(-1), _mm_set1_epi32(1));
+    __m128 sideX = _mm_mul_ps(sel_ps(negX, _mm_sub_ps(posX, mapXf), _mm_sub_ps(_mm_add_ps(mapXf, one), posX)), deltaX);
+    __m128 sideY = _mm_mul_ps(sel_ps(negY, _mm_sub_ps(posY, mapYf), _mm_sub_ps(_mm_add_ps(mapYf, one), posY)), deltaY);
+
+    __m128 active = _mm_cmpge_ps(maxd, zero);
+    __m128 dist = zero;
+    __m128i side = _mm_setzero_si128();
+    int hitMask = 0;
+    const __m128i lastX = _mm_set1_epi32(mapW - 1), lastY = _mm_set1_epi32(mapH - 1);
+    const __m128i zeroi = _mm_setzero_si128();
+    int cx[4], cy[4];
+
+    while (_mm_movemask_ps(active)) {
+        __m128 takeX = _mm_cmplt_ps(sideX, sideY);
+        __m128 t = sel_ps(takeX, sideX, sideY);
+        active = _mm_andnot_ps(_mm_cmpgt_ps(t, maxd), active);
+        __m128 ax = _mm_and_ps(active, takeX), ay = _mm_andnot_ps(takeX, active);
+        __m128i axi = _mm_castps_si128(ax), ayi = _mm_castps_si128(ay);
+        mapX = _mm_add_epi32(mapX, _mm_and_si128(axi, stepX));
+        mapY = _mm_add_epi32(mapY, _mm_and_si128(ayi, stepY));
+        sideX = _mm_add_ps(sideX, _mm_and_ps(ax, deltaX));
+        sideY = _mm_add_ps(sideY, _mm_and_ps(ay, deltaY));
+        dist = sel_ps(active, t, dist);
+        side = sel_epi32(axi, zeroi, sel_epi32(ayi, _mm_set1_epi32(1), side));
+
+        // out-of-map lanes hit; in-map lanes gather their occupancy byte
+        __m128i oob = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(mapX, zeroi), _mm_cmpgt_epi32(mapX, lastX)),
+                                   _mm_or_si128(_mm_cmplt_epi32(mapY, zeroi), _mm_cmpgt_epi32(mapY, lastY)));
+        int live = _mm_movemask_ps(active);
+        int oobMask = _mm_movemask_ps(_mm_castsi128_ps(oob));
+        _mm_storeu_si128((__m128i *)cx, mapX);
+        _mm_storeu_si128((__m128i *)cy, mapY);
+        int hits = live & oobMask;
+        for (int l = 0; l < 4; l++) {
+            if ((live >> l & 1) && !(oobMask >> l & 1) && MAP_SOLID(cx[l], cy[l])) hits |= 1 << l;
+        }
+        if (hits) {
+            hitMask |= hits;
+            __m128i keep = _mm_set_epi32(hits & 8 ? 0 : -1, hits & 4 ? 0 : -1, hits & 2 ? 0 : -1, hits & 1 ? 0 : -1);
+            active = _mm_and_ps(active, _mm_castsi128_ps(keep));
+        }
+    }
+
+    float dl[4];
+    int sl[4];
+    _mm_storeu_ps(dl, dist);
+    _mm_storeu_si128((__m128i *)sl, side);
+    _mm_storeu_si128((__m128i *)cx, mapX);
+    _mm_storeu_si128((__m128i *)cy, mapY);
+    for (int l = 0; l < n; l++) store_hit(b, i0 + l, hitMask >> l & 1, cx[l], cy[l], sl[l], dl[l]);
+}
+#endif
+
+static void cast_range(void *ctx, int begin, int end) {
+    const RayBatch *b = ctx;
+    int i = begin;
+#if RAYCAST_HAVE_SSE2
+    if (useSimd) {
+        for (; i < end; i += 4) cast_packet4(b, i, (end - i) < 4 ? end - i : 4);
+        return;
+    }
+#endif
+    for (; i < end; i++) cast_scalar(b, i);
+}
+
+void raycast_batch(const RayBatch *batch) {
+    if (!batch || batch->count <= 0 || !mapSolid) return;
+    if (batch->count >= RAYCAST_PARALLEL_MIN) jobs_parallel_for(batch->count, RAYCAST_GRAIN, cast_range, (void *)batch);
+    else cast_range((void *)batch, 0, batch->count);
+}
+
+typedef struct LosJob {
+    const float *ax, *ay, *bx, *by;
+    Uint8 *visible;
+} LosJob;
+
+static void los_range(void *ctx, int begin, int end) {
+    const LosJob *j = ctx;
+    float dx[LOS_CHUNK], dy[LOS_CHUNK], md[LOS_CHUNK], dist[LOS_CHUNK], u[LOS_CHUNK];
+    int cx[LOS_CHUNK], cy[LOS_CHUNK];
+    Sint8 side[LOS_CHUNK];
+    for (int c = begin; c < end; c += LOS_CHUNK) {
+        int n = (end - c) < LOS_CHUNK ? end - c : LOS_CHUNK;
+        for (int k = 0; k < n; k++) {
+            dx[k] = j->bx[c + k] - j->ax[c + k];
+            dy[k] = j->by[c + k] - j->ay[c + k];
+            md[k] = 1.0f;
+        }
+        RayBatch b = { n, j->ax + c, j->ay + c, dx, dy, md, cx, cy, side, dist, u };
+        cast_range(&b, 0, n);
+        for (int k = 0; k < n; k++) j->visible[c + k] = side[k] < 0 || dist[k] >= 1.0f;
+    }
+}
+
+void raycast_los(int count, const float *ax, const float *ay, const float *bx, const float *by, Uint8 *visible) {
+    if (count <= 0 || !mapSolid) return;
+    LosJob j = { ax, ay, bx, by, visible };
+    if (count >= RAYCAST_PARALLEL_MIN) jobs_parallel_for(count, RAYCAST_GRAIN, los_range, &j);
+    else los_range(&j, 0, count);
+}
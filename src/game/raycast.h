@@ -0,0 +1,71 @@
+#ifndef GAME_RAYCAST_H
+#define GAME_RAYCAST_H
+
+#include <SDL2/SDL.h>
+#include <math.h>
+
+#include "map.h"
+
+// Grid DDA shared by the renderer and the batch query API. Cells outside the
+// map count as solid, so every ray terminates.
+typedef struct GridHit {
+    int mapX, mapY;   // cell that stopped the ray (may sit just outside the map)
+    int stepX, stepY;
+    int side;         // 0 = crossed an x boundary, 1 = a y boundary
+    int hit;          // 0 when the ray ran past maxDist first
+    int steps;        // cells visited
+} GridHit;
+
+static inline GridHit grid_dda(double posX, double posY, double rayDirX, double rayDirY, double maxDist) {
+    GridHit h = { (int)floor(posX), (int)floor(posY), 1, 1, 0, 0, 0 };
+    double deltaDistX = (rayDirX == 0) ? 1e30 : fabs(1.0 / rayDirX);
+    double deltaDistY = (rayDirY == 0) ? 1e30 : fabs(1.0 / rayDirY);
+    double sideDistX, sideDistY;
+    if (rayDirX < 0) { h.stepX = -1; sideDistX = (posX - h.mapX) * deltaDistX; }
+    else { sideDistX = (h.mapX + 1.0 - posX) * deltaDistX; }
+    if (rayDirY < 0) { h.stepY = -1; sideDistY = (posY - h.mapY) * deltaDistY; }
+    else { sideDistY = (h.mapY + 1.0 - posY) * deltaDistY; }
+    for (;;) {
+        if (sideDistX < sideDistY) {
+            if (sideDistX > maxDist) break;
+            sideDistX += deltaDistX;
+            h.mapX += h.stepX;
+            h.side = 0;
+        } else {
+            if (sideDistY > maxDist) break;
+            sideDistY += deltaDistY;
+            h.mapY += h.stepY;
+            h.side = 1;
+        }
+        h.steps++;
+        if ((unsigned)h.mapX >= (unsigned)mapW || (unsigned)h.mapY >= (unsigned)mapH || MAP_SOLID(h.mapX, h.mapY)) {
+            h.hit = 1;
+            break;
+        }
+    }
+    return h;
+}
+
+// Batch queries. Inputs and outputs are caller-owned arrays of `count` entries;
+// hits are at origin + dist * dir. maxDist may be NULL for unbounded rays.
+typedef struct RayBatch {
+    int count;
+    const float *originX;
+    const float *originY;
+    const float *dirX;
+    const float *dirY;
+    const float *maxDist;
+    int *cellX;       // -1 on a miss
+    int *cellY;
+    Sint8 *side;      // 0/1 as in GridHit, -1 on a miss
+    float *dist;      // maxDist on a miss
+    float *texU;      // [0,1) across the face, oriented like the wall textures
+} RayBatch;
+
+void raycast_batch(const RayBatch *batch);
+// visible[i] = 1 when nothing solid lies strictly between a[i] and b[i]
+void raycast_los(int count, const float *ax, const float *ay, const float *bx, const float *by, Uint8 *visible);
+// 0 = scalar only, 1 = SSE2 packets where available (default)
+void raycast_set_simd(int enabled);
+
+#endif
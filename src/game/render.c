@@ -1,8 +1,61 @@
 #include "render.h"
 
+#include "jobs.h"
+#include "light.h"
 #include "map.h"
+#include "raycast.h"
 
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define RENDER_HAVE_SSE2 1
+#else
+#define RENDER_HAVE_SSE2 0
+#endif
+
+#define RENDER_VIEW_GRAIN 32 // columns per job in render_views
+#define RENDER_CACHE_MIN_BINS 256
+// a bin is trusted when its boundary rays are this close (in cells) at the
+// wall: a whole solid cell can't hide between them, so every ray in between
+// hits the same face
+#define RENDER_CACHE_SPAN 0.5
+#define RENDER_EYE_Z 0.5      // eye height in wall units
+#define RENDER_CEILING 0xFF404040
+#define RENDER_TRANSPOSE_BLOCK 64 // tile edge; a source and a destination tile take 32 KiB, inside L1
+
+// RENDER_STAT(...) holds code that only exists in builds with the counters
+#if GAME90_RENDER_STATS
+#define RENDER_STAT(...) __VA_ARGS__
+static RenderStats *renderStats = NULL;
+#else
+#define RENDER_STAT(...)
+#endif
+
+float *renderDepth = NULL;
+const float *renderDepthZ = NULL;
+int renderDepthW = 0, renderDepthH = 0;
+static size_t renderDepthCap = 0;
+
+// the per-pixel depth for a heights frame drawn with zbuffer, NULL when the
+// frame keeps none
+static float *depth_begin(float *zbuffer, int w, int h) {
+    renderDepthZ = NULL;
+    if (!mapHeights || !zbuffer || w <= 0 || h <= 0) return NULL;
+    size_t need = (size_t)w * h;
+    if (need > renderDepthCap) {
+        float *d = realloc(renderDepth, sizeof(float) * need);
+        if (!d) return NULL;
+        renderDepth = d;
+        renderDepthCap = need;
+    }
+    renderDepthZ = zbuffer;
+    renderDepthW = w;
+    renderDepthH = h;
+    return renderDepth;
+}
 
 void init_textures(Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
     // generate simple procedural textures: 1=red brick,2=green,3=blue
@@ -18,8 +71,309 @@ void init_textures(Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
     }
 }
 
-void render_world(
+// Bins are uniform in "diamond angle": 0..4 around the circle, one unit per
+// quadrant, monotonic in the real angle but free of trig. A bin spans at most
+// 8 / bins radians.
+static double diamond_angle(double x, double y) {
+    if (y >= 0.0) return x >= 0.0 ? y / (x + y) : 1.0 - x / (y - x);
+    return x < 0.0 ? 2.0 - y / (-x - y) : 3.0 + x / (x - y);
+}
+
+static void cache_boundary(RenderCache *c, double posX, double posY, int k) {
+    if (c->hitStamp[k] == c->stamp) return;
+    int quarter = c->bins / 4;
+    double f = (double)(k % quarter) / quarter;
+    static const int rot[4][4] = { { 1, 0, 0, 1 }, { 0, -1, 1, 0 }, { -1, 0, 0, -1 }, { 0, 1, -1, 0 } };
+    const int *r = rot[k / quarter];
+    double dx = r[0] * (1.0 - f) + r[1] * f;
+    double dy = r[2] * (1.0 - f) + r[3] * f;
+    GridHit g = grid_dda(posX, posY, dx, dy, HUGE_VAL);
+    double t = (g.side == 0) ? (g.mapX - posX + (1 - g.stepX) / 2.0) / dx : (g.mapY - posY + (1 - g.stepY) / 2.0) / dy;
+    c->hitX[k] = g.mapX;
+    c->hitY[k] = g.mapY;
+    c->hitSide[k] = (Sint8)g.side;
+    c->hitDist[k] = (float)t;
+    c->hitStamp[k] = c->stamp;
+}
+
+// the DDA result for this ray taken from the angle cache; false when the
+// ray's bin can't vouch for it and it has to be cast
+static bool cached_hit(RenderCache *c, double posX, double posY, double rayDirX, double rayDirY, GridHit *h) {
+    if (rayDirX == 0.0 || rayDirY == 0.0) return false;
+    int b = (int)(diamond_angle(rayDirX, rayDirY) * (c->bins / 4));
+    if (b >= c->bins) b = c->bins - 1;
+    // step directions flip at the axes, so bins touching one are never trusted
+    int inQuarter = b & (c->bins / 4 - 1);
+    if (inQuarter == 0 || inQuarter == c->bins / 4 - 1) return false;
+    cache_boundary(c, posX, posY, b);
+    cache_boundary(c, posX, posY, b + 1);
+    if (c->hitX[b] != c->hitX[b + 1] || c->hitY[b] != c->hitY[b + 1] || c->hitSide[b] != c->hitSide[b + 1]) return false;
+    float far = c->hitDist[b] > c->hitDist[b + 1] ? c->hitDist[b] : c->hitDist[b + 1];
+    if (far * 8.0f > RENDER_CACHE_SPAN * c->bins) return false;
+
+    h->mapX = c->hitX[b];
+    h->mapY = c->hitY[b];
+    h->stepX = rayDirX < 0.0 ? -1 : 1;
+    h->stepY = rayDirY < 0.0 ? -1 : 1;
+    h->side = c->hitSide[b];
+    h->hit = 1;
+    h->steps = 0;
+    // the ray must cross the face itself, not just fall in the bin by rounding
+    if (h->side == 0) {
+        double u = posY + (h->mapX - posX + (1 - h->stepX) / 2.0) / rayDirX * rayDirY;
+        return u >= h->mapY && u <= h->mapY + 1;
+    }
+    double u = posX + (h->mapY - posY + (1 - h->stepY) / 2.0) / rayDirY * rayDirX;
+    return u >= h->mapX && u <= h->mapX + 1;
+}
+
+#if GAME90_RENDER_STATS
+static void stats_column(RenderColumnStats *c, Uint64 start, int steps, bool offMap, int walls, int floors, int ceilings, int writes) {
+    c->steps = steps;
+    c->walls = walls;
+    c->floors = floors;
+    c->ceilings = ceilings;
+    c->writes = writes;
+    c->ticks = (Uint32)(SDL_GetPerformanceCounter() - start);
+    c->cast = true;
+    c->offMap = offMap;
+}
+#endif
+
+// the collector's columns for a frame w wide, cleared; NULL when nothing collects
+static RenderColumnStats *stats_begin(int w) {
+#if GAME90_RENDER_STATS
+    RenderStats *s = renderStats;
+    if (!s || w <= 0) return NULL;
+    if (s->w != w) {
+        free(s->cols);
+        free(s->heat);
+        s->cols = malloc(sizeof(RenderColumnStats) * (size_t)w);
+        s->heat = malloc(sizeof(Uint32) * (size_t)w);
+        s->w = s->cols && s->heat ? w : 0;
+        if (!s->w) {
+            free(s->cols);
+            free(s->heat);
+            s->cols = NULL;
+            s->heat = NULL;
+            return NULL;
+        }
+    }
+    memset(s->cols, 0, sizeof(RenderColumnStats) * (size_t)w);
+    return s->cols;
+#else
+    (void)w;
+    return NULL;
+#endif
+}
+
+// totals for the frame whose columns stats_begin handed out
+static void stats_end(RenderColumnStats *cols, int h) {
+    (void)cols;
+    (void)h;
+#if GAME90_RENDER_STATS
+    RenderStats *s = renderStats;
+    if (!cols || !s || s->cols != cols) return;
+    s->h = h;
+    s->columns = s->offMap = s->maxSteps = 0;
+    s->steps = s->walls = s->floors = s->ceilings = s->writes = 0;
+    s->ticks = 0;
+    s->maxTicks = 0;
+    for (int x = 0; x < s->w; x++) {
+        const RenderColumnStats *c = &cols[x];
+        if (!c->cast) continue;
+        s->columns++;
+        s->offMap += c->offMap;
+        s->steps += c->steps;
+        if (c->steps > s->maxSteps) s->maxSteps = c->steps;
+        s->walls += c->walls;
+        s->floors += c->floors;
+        s->ceilings += c->ceilings;
+        s->writes += c->writes;
+        s->ticks += c->ticks;
+        if (c->ticks > s->maxTicks) s->maxTicks = c->ticks;
+    }
+    s->overdraw = s->writes - (long long)s->columns * h;
+#endif
+}
+
+// the part of a cell rays can pass through, lo..hi; false when there is none
+// or the cell is off the map. A wall fills its cell up to its top.
+static inline bool cell_open_span(int x, int y, double *lo, double *hi) {
+    if ((unsigned)x >= (unsigned)mapW || (unsigned)y >= (unsigned)mapH) return false;
+    int i = x + mapW * y;
+    *lo = mapSolid[i] ? mapHeights[i].top : mapHeights[i].floor;
+    *hi = mapHeights[i].ceil;
+    return *lo < *hi;
+}
+
+// one textured face of the cell the ray enters, rows y0..y1-1 of column col
+// at distance dist
+static void draw_face(Uint32 *col, int rowStep, int y0, int y1, int rh, double dist, double scale,
+    double posX, double posY, double rayDirX, double rayDirY, int cellX, int cellY, int fromX, int fromY, int side) {
+    int val = 0;
+    if (cellX >= 0 && cellX < mapW && cellY >= 0 && cellY < mapH) val = MAP_AT(cellX, cellY);
+    int texNum = (val >= 1 && val <= 3) ? val : 1;
+    int shade = lightWallShade[side][light_level_at(fromX, fromY)][light_fog_bucket(dist)];
+    const Uint32 *tex = lightShadedTex[shade][texNum];
+    double wallX = side == 0 ? posY + dist * rayDirY : posX + dist * rayDirX;
+    wallX -= floor(wallX);
+    int texX = (int)(wallX * (double)GAME_TEX_W);
+    if (texX < 0) texX = 0;
+    if (texX >= GAME_TEX_W) texX = GAME_TEX_W - 1;
+    if (side == 0 && rayDirX > 0) texX = GAME_TEX_W - texX - 1;
+    if (side == 1 && rayDirY < 0) texX = GAME_TEX_W - texX - 1;
+    // textures repeat every wall unit, top edge at each whole height; the
+    // offset keeps the coordinate positive for walls up to 1024 units
+    double step = GAME_TEX_H / scale;
+    double texPos = ((y0 - rh / 2.0) / scale + (1.0 - RENDER_EYE_Z) + 1024.0) * GAME_TEX_H;
+    for (int y = y0; y < y1; y++, texPos += step) {
+        col[y * rowStep] = tex[((int)texPos & (GAME_TEX_H - 1)) * GAME_TEX_W + texX];
+    }
+}
+
+// Columns over a map with mapHeights. Each column keeps the rows not yet
+// drawn as one span top..bottom; walking the cells front to back, a cell's
+// ceiling and floor shrink it from the ends, as do the faces where the next
+// cell's opening is lower or higher, so every pixel is written exactly once.
+// The ray goes on past low walls and stops once the span is empty. With
+// depth (rh floats per column) every pixel's distance goes there and zbuffer
+// gets the farthest, where the span ran out; without it zbuffer gets the
+// distance at which the horizon row was covered.
+static void render_heights(int x0, int x1, int xStep, Uint32 *pixels, int colStep, int rowStep, int rw, int rh,
+    double posX, double posY, double dirX, double dirY, double planeX, double planeY, float *zbuffer, float *depth,
+    RenderColumnStats *stats) {
+    (void)stats;
+    const Uint8 *lm = (lightMap && lightW == mapW && lightH == mapH) ? lightMap : NULL;
+    double horizon = rh / 2.0;
+    int hrow = rh / 2;
+    for (int x = x0; x < x1; x += xStep) {
+        RENDER_STAT(Uint64 statStart = stats ? SDL_GetPerformanceCounter() : 0;
+            int statSteps = 0, statWalls = 0, statFloors = 0, statCeilings = 0;
+            bool statOffMap = false;)
+        Uint32 *col = pixels + (size_t)x * colStep;
+        float *colZ = depth ? depth + (size_t)x * rh : NULL;
+        double cameraX = 2.0 * x / (double)rw - 1.0;
+        double rayDirX = dirX + planeX * cameraX;
+        double rayDirY = dirY + planeY * cameraX;
+        int mapX = (int)floor(posX), mapY = (int)floor(posY);
+        int stepX = rayDirX < 0 ? -1 : 1, stepY = rayDirY < 0 ? -1 : 1;
+        double deltaDistX = (rayDirX == 0) ? 1e30 : fabs(1.0 / rayDirX);
+        double deltaDistY = (rayDirY == 0) ? 1e30 : fabs(1.0 / rayDirY);
+        double sideDistX = (rayDirX < 0 ? posX - mapX : mapX + 1.0 - posX) * deltaDistX;
+        double sideDistY = (rayDirY < 0 ? posY - mapY : mapY + 1.0 - posY) * deltaDistY;
+        double lo, hi;
+        // standing inside a wall: see out of it as if it were open
+        if (!cell_open_span(mapX, mapY, &lo, &hi)) { lo = 0.0; hi = 1.0; }
+        // walls hold no light of their own; their tops and faces take it from
+        // the last open cell on the ray
+        int litX = mapX, litY = mapY;
+        bool onWall = false;
+        int top = 0, bottom = rh;
+        double dist = 1e-6;
+        float z = -1.0f;
+        while (top < bottom) {
+            int nextX = mapX, nextY = mapY, side;
+            if (sideDistX < sideDistY) {
+                dist = sideDistX;
+                sideDistX += deltaDistX;
+                nextX += stepX;
+                side = 0;
+            } else {
+                dist = sideDistY;
+                sideDistY += deltaDistY;
+                nextY += stepY;
+                side = 1;
+            }
+            if (!(dist > 1e-6)) dist = 1e-6;
+            double scale = rh / dist;
+            RENDER_STAT(statSteps++;)
+
+            // ceiling and floor of this cell up to where the ray leaves it
+            if (hi > RENDER_EYE_Z) {
+                double e = ceil(horizon - (hi - RENDER_EYE_Z) * scale);
+                int end = e < top ? top : (e > bottom ? bottom : (int)e);
+                for (int y = top; y < end; y++) col[y * rowStep] = RENDER_CEILING;
+                if (colZ) {
+                    float k = (float)((hi - RENDER_EYE_Z) * rh), h = (float)horizon;
+                    for (int y = top; y < end; y++) colZ[y] = k / (h - (float)y);
+                }
+                RENDER_STAT(statCeilings += end - top;)
+                top = end;
+            }
+            if (lo < RENDER_EYE_Z && top < bottom) {
+                double e = floor(horizon + (RENDER_EYE_Z - lo) * scale) + 1.0;
+                int start = e > bottom ? bottom : (e < top ? top : (int)e);
+                for (int y = start; y < bottom; y++) {
+                    double rowDist = (RENDER_EYE_Z - lo) * rh / (y - horizon);
+                    int cx = (int)floor(posX + rowDist * rayDirX), cy = (int)floor(posY + rowDist * rayDirY);
+                    int checker = (cx + cy) & 1;
+                    if (onWall) { cx = litX; cy = litY; }
+                    int level = (lm && cx >= 0 && cx < mapW && cy >= 0 && cy < mapH) ? lm[cx + mapW * cy] : mapAmbient;
+                    col[y * rowStep] = lightFloorColor[level][light_fog_bucket(rowDist)][checker];
+                    if (colZ) colZ[y] = (float)rowDist;
+                }
+                RENDER_STAT(statFloors += bottom - start;)
+                bottom = start;
+            }
+            if (z < 0.0f && (top > hrow || bottom <= hrow)) z = (float)dist;
+
+            // faces where the next cell's opening is narrower than this one
+            double nlo, nhi;
+            bool open = cell_open_span(nextX, nextY, &nlo, &nhi) && nlo < hi && nhi > lo;
+            if (!open) {
+                if (top < bottom) draw_face(col, rowStep, top, bottom, rh, dist, scale, posX, posY, rayDirX, rayDirY, nextX, nextY, litX, litY, side);
+                if (colZ) for (int y = top; y < bottom; y++) colZ[y] = (float)dist;
+                RENDER_STAT(statWalls += bottom - top;
+                    statOffMap = (unsigned)nextX >= (unsigned)mapW || (unsigned)nextY >= (unsigned)mapH;)
+                top = bottom;
+            } else {
+                if (nhi < hi && top < bottom) {
+                    double e = ceil(horizon - (nhi - RENDER_EYE_Z) * scale);
+                    int end = e < top ? top : (e > bottom ? bottom : (int)e);
+                    draw_face(col, rowStep, top, end, rh, dist, scale, posX, posY, rayDirX, rayDirY, nextX, nextY, litX, litY, side);
+                    if (colZ) for (int y = top; y < end; y++) colZ[y] = (float)dist;
+                    RENDER_STAT(statWalls += end - top;)
+                    top = end;
+                }
+                if (nlo > lo && top < bottom) {
+                    double e = ceil(horizon - (nlo - RENDER_EYE_Z) * scale);
+                    int start = e > bottom ? bottom : (e < top ? top : (int)e);
+                    draw_face(col, rowStep, start, bottom, rh, dist, scale, posX, posY, rayDirX, rayDirY, nextX, nextY, litX, litY, side);
+                    if (colZ) for (int y = start; y < bottom; y++) colZ[y] = (float)dist;
+                    RENDER_STAT(statWalls += bottom - start;)
+                    bottom = start;
+                }
+            }
+            if (z < 0.0f && (top > hrow || bottom <= hrow)) z = (float)dist;
+            if (!open) break;
+            mapX = nextX;
+            mapY = nextY;
+            onWall = MAP_SOLID(mapX, mapY);
+            if (!onWall) { litX = mapX; litY = mapY; }
+            lo = nlo;
+            hi = nhi;
+        }
+        if (zbuffer) zbuffer[x] = z < 0.0f || colZ ? (float)dist : z;
+        // every row is written once here
+        RENDER_STAT(if (stats) stats_column(&stats[x], statStart, statSteps, statOffMap, statWalls, statFloors, statCeilings,
+            statWalls + statFloors + statCeilings);)
+    }
+}
+
+// casts columns x0, x0 + xStep, ... below x1, the others are left
+// untouched. Pixel (x, y) is pixels[x * colStep + y * rowStep]: colStep 1 for
+// rows of rowStep pixels, rowStep 1 for columns of colStep pixels.
+// light_prepare() must have run.
+static void render_view(
+    RenderCache *cache,
+    RenderColumnStats *stats,
+    int x0,
+    int x1,
+    int xStep,
     Uint32 *pixels,
+    int colStep,
+    int rowStep,
     int renderW,
     int renderH,
     double posX,
@@ -28,57 +382,48 @@ void render_world(
     double dirY,
     double planeX,
     double planeY,
-    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    float *zbuffer,
+    float *depth) {
+    if (mapHeights) {
+        // the angle cache holds single hits; every column walks its cells
+        if (cache) cache->cast += (x1 - x0 + xStep - 1) / xStep;
+        render_heights(x0, x1, xStep, pixels, colStep, rowStep, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY, zbuffer, depth, stats);
+        return;
+    }
     // render into pixel buffer at capped render resolution
     int rw = renderW;
     int rh = renderH;
-    for (int i = 0; i < rw * rh; i++) pixels[i] = 0xFF404040; // clear to ceiling color
+    const Uint8 *lm = (lightMap && lightW == mapW && lightH == mapH) ? lightMap : NULL;
+    // a whole frame is cleared in one sweep, partial ones per column below
+    bool dense = (colStep == 1 && rowStep == rw) || (rowStep == 1 && colStep == rh);
+    bool clearAll = x0 == 0 && x1 == rw && xStep == 1 && dense;
+    if (clearAll) for (int i = 0; i < rw * rh; i++) pixels[i] = RENDER_CEILING; // clear to ceiling color
 
-    for (int x = 0; x < rw; x++) {
+    (void)stats;
+    for (int x = x0; x < x1; x += xStep) {
+        RENDER_STAT(Uint64 statStart = stats ? SDL_GetPerformanceCounter() : 0;)
+        Uint32 *col = pixels + (size_t)x * colStep;
         double cameraX = 2.0 * x / (double)rw - 1.0;
         double rayDirX = dirX + planeX * cameraX;
         double rayDirY = dirY + planeY * cameraX;
 
-        int mapX = (int)posX;
-        int mapY = (int)posY;
-
-        double sideDistX;
-        double sideDistY;
-
-        double deltaDistX = (rayDirX == 0) ? 1e30 : fabs(1.0 / rayDirX);
-        double deltaDistY = (rayDirY == 0) ? 1e30 : fabs(1.0 / rayDirY);
-        double perpWallDist;
-
-        int stepX;
-        int stepY;
-
-        int hit = 0;
-        int side;
-
-        if (rayDirX < 0) { stepX = -1; sideDistX = (posX - mapX) * deltaDistX; }
-        else { stepX = 1; sideDistX = (mapX + 1.0 - posX) * deltaDistX; }
-        if (rayDirY < 0) { stepY = -1; sideDistY = (posY - mapY) * deltaDistY; }
-        else { stepY = 1; sideDistY = (mapY + 1.0 - posY) * deltaDistY; }
-
-        // DDA
-        int safety = 0;
-        while (hit == 0) {
-            if (sideDistX < sideDistY) {
-                sideDistX += deltaDistX;
-                mapX += stepX;
-                side = 0;
-            } else {
-                sideDistY += deltaDistY;
-                mapY += stepY;
-                side = 1;
-            }
-            if (mapX >= 0 && mapX < mapW && mapY >= 0 && mapY < mapH && MAP_AT(mapX, mapY) > 0) hit = 1;
-            if (++safety > (mapW * mapH * 2)) break; // safety guard
+        // DDA (shared with the ray query API); leaving the map counts as a hit
+        GridHit h;
+        if (cache && cached_hit(cache, posX, posY, rayDirX, rayDirY, &h)) {
+            cache->cached++;
+        } else {
+            h = grid_dda(posX, posY, rayDirX, rayDirY, HUGE_VAL);
+            if (cache) cache->cast++;
         }
+        int mapX = h.mapX, mapY = h.mapY;
+        int stepX = h.stepX, stepY = h.stepY;
+        int side = h.side;
+        double perpWallDist;
 
         if (side == 0) perpWallDist = (rayDirX != 0.0) ? (mapX - posX + (1 - stepX) / 2.0) / rayDirX : 1e-6;
         else           perpWallDist = (rayDirY != 0.0) ? (mapY - posY + (1 - stepY) / 2.0) / rayDirY : 1e-6;
         if (!isfinite(perpWallDist) || perpWallDist <= 0.0) perpWallDist = 1e-6;
+        if (zbuffer) zbuffer[x] = (float)perpWallDist;
 
         int lineHeight = (int)(rh / perpWallDist);
         if (lineHeight <= 0) lineHeight = rh;
@@ -88,12 +433,19 @@ void render_world(
         if (drawStart < 0) drawStart = 0;
         int drawEnd = lineHeight / 2 + rh / 2;
         if (drawEnd >= rh) drawEnd = rh - 1;
+        if (!clearAll) for (int y = 0; y < drawStart; y++) col[y * rowStep] = RENDER_CEILING;
 
         // textured wall
         int val = 0;
         if (mapX >= 0 && mapX < mapW && mapY >= 0 && mapY < mapH) val = MAP_AT(mapX, mapY);
         int texNum = (val >= 1 && val <= 3) ? val : 1;
 
+        // light the face from the open cell the ray arrived through
+        int lightX = (side == 0) ? mapX - stepX : mapX;
+        int lightY = (side == 1) ? mapY - stepY : mapY;
+        int shade = lightWallShade[side][light_level_at(lightX, lightY)][light_fog_bucket(perpWallDist)];
+        const Uint32 *tex = lightShadedTex[shade][texNum];
+
         double wallX; // where exactly the wall was hit
         if (side == 0) wallX = posY + perpWallDist * rayDirY;
         else            wallX = posX + perpWallDist * rayDirX;
@@ -110,28 +462,435 @@ void render_world(
             int texY = (lineHeight != 0) ? ((d * GAME_TEX_H) / lineHeight) / 256 : 0;
             if (texY < 0) texY = 0;
             if (texY >= GAME_TEX_H) texY = GAME_TEX_H - 1;
-            Uint32 col = textures[texNum][texY * GAME_TEX_W + texX];
-            // ensure alpha set
-            col |= 0xFF000000;
-            if (side == 1) {
-                Uint8 r = ((col >> 16) & 0xFF) / 2;
-                Uint8 g = ((col >> 8) & 0xFF) / 2;
-                Uint8 b = (col & 0xFF) / 2;
-                col = (0xFF << 24) | (r << 16) | (g << 8) | b;
-            }
-            pixels[y * rw + x] = col;
+            // shade tables already fold in light, fog, side darkening and alpha
+            col[y * rowStep] = tex[texY * GAME_TEX_W + texX];
         }
 
-        // floor (simple shading per column)
+        // floor (checker lit per cell, fogged per row)
         for (int y = drawEnd + 1; y < rh; y++) {
             double currentDist = rh / (2.0 * y - rh);
             double weight = currentDist / perpWallDist;
             double floorX = weight * (mapX + 0.5) + (1.0 - weight) * posX;
             double floorY = weight * (mapY + 0.5) + (1.0 - weight) * posY;
-            int checker = ((int)floor(floorX) + (int)floor(floorY)) % 2;
-            Uint8 f = checker ? 80 : 110;
-            Uint8 r = f / 2, g = f, b = f / 3;
-            pixels[y * rw + x] = (0xFF << 24) | (r << 16) | (g << 8) | b;
+            int cx = (int)floor(floorX), cy = (int)floor(floorY);
+            int checker = (cx + cy) & 1;
+            int level = (lm && cx >= 0 && cx < mapW && cy >= 0 && cy < mapH) ? lm[cx + mapW * cy] : mapAmbient;
+            col[y * rowStep] = lightFloorColor[level][light_fog_bucket(currentDist)][checker];
+        }
+        // a whole-frame clear wrote every row of the column before the wall and floor
+        RENDER_STAT(if (stats) stats_column(&stats[x], statStart, h.steps, (unsigned)mapX >= (unsigned)mapW || (unsigned)mapY >= (unsigned)mapH,
+            drawEnd - drawStart + 1, rh - 1 - drawEnd, drawStart, (clearAll ? rh : drawStart) + rh - drawStart);)
+    }
+}
+
+void render_world(
+    Uint32 *pixels,
+    int renderW,
+    int renderH,
+    double posX,
+    double posY,
+    double dirX,
+    double dirY,
+    double planeX,
+    double planeY,
+    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H],
+    float *zbuffer) {
+    light_prepare(textures);
+    RenderColumnStats *stats = stats_begin(renderW);
+    render_view(NULL, stats, 0, renderW, 1, pixels, 1, renderW, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY, zbuffer,
+        depth_begin(zbuffer, renderW, renderH));
+    stats_end(stats, renderH);
+}
+
+void render_world_columns(
+    Uint32 *pixels,
+    int renderW,
+    int renderH,
+    double posX,
+    double posY,
+    double dirX,
+    double dirY,
+    double planeX,
+    double planeY,
+    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H],
+    float *zbuffer) {
+    light_prepare(textures);
+    RenderColumnStats *stats = stats_begin(renderW);
+    render_view(NULL, stats, 0, renderW, 1, pixels, renderH, 1, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY, zbuffer,
+        depth_begin(zbuffer, renderW, renderH));
+    stats_end(stats, renderH);
+}
+
+// Square tiles, so both the columns read and the rows written stay in cache;
+// inside a tile SSE2 swaps 4x4 blocks in registers.
+void render_transpose(Uint32 *dst, int dstPitch, const Uint32 *src, int w, int h) {
+    for (int by = 0; by < h; by += RENDER_TRANSPOSE_BLOCK) {
+        int ey = by + RENDER_TRANSPOSE_BLOCK < h ? by + RENDER_TRANSPOSE_BLOCK : h;
+        for (int bx = 0; bx < w; bx += RENDER_TRANSPOSE_BLOCK) {
+            int ex = bx + RENDER_TRANSPOSE_BLOCK < w ? bx + RENDER_TRANSPOSE_BLOCK : w;
+            int y = by;
+#if RENDER_HAVE_SSE2
+            for (; y + 4 <= ey; y += 4) {
+                int x = bx;
+                for (; x + 4 <= ex; x += 4) {
+                    const Uint32 *s = src + (size_t)x * h + y;
+                    __m128i c0 = _mm_loadu_si128((const __m128i *)s);
+                    __m128i c1 = _mm_loadu_si128((const __m128i *)(s + h));
+                    __m128i c2 = _mm_loadu_si128((const __m128i *)(s + 2 * (size_t)h));
+                    __m128i c3 = _mm_loadu_si128((const __m128i *)(s + 3 * (size_t)h));
+                    __m128i lo01 = _mm_unpacklo_epi32(c0, c1), lo23 = _mm_unpacklo_epi32(c2, c3);
+                    __m128i hi01 = _mm_unpackhi_epi32(c0, c1), hi23 = _mm_unpackhi_epi32(c2, c3);
+                    Uint32 *d = dst + (size_t)y * dstPitch + x;
+                    _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi64(lo01, lo23));
+                    _mm_storeu_si128((__m128i *)(d + dstPitch), _mm_unpackhi_epi64(lo01, lo23));
+                    _mm_storeu_si128((__m128i *)(d + 2 * (size_t)dstPitch), _mm_unpacklo_epi64(hi01, hi23));
+                    _mm_storeu_si128((__m128i *)(d + 3 * (size_t)dstPitch), _mm_unpackhi_epi64(hi01, hi23));
+                }
+                for (; x < ex; x++) {
+                    for (int k = 0; k < 4; k++) dst[(size_t)(y + k) * dstPitch + x] = src[(size_t)x * h + y + k];
+                }
+            }
+#endif
+            for (; y < ey; y++) {
+                for (int x = bx; x < ex; x++) dst[(size_t)y * dstPitch + x] = src[(size_t)x * h + y];
+            }
+        }
+    }
+}
+
+typedef struct RenderViewsJob {
+    const RenderView *views;
+    int count;
+    const int *first; // first column of each view in the combined range
+} RenderViewsJob;
+
+static void views_range(void *ctx, int begin, int end) {
+    const RenderViewsJob *j = ctx;
+    int v = 0;
+    while (v + 1 < j->count && j->first[v + 1] <= begin) v++;
+    for (; v < j->count && j->first[v] < end; v++) {
+        const RenderView *rv = &j->views[v];
+        int x0 = begin > j->first[v] ? begin - j->first[v] : 0;
+        int x1 = end - j->first[v] < rv->w ? end - j->first[v] : rv->w;
+        if (x0 >= x1 || rv->h <= 0) continue;
+        render_view(NULL, NULL, x0, x1, 1, rv->pixels + (size_t)rv->y * rv->pitch + rv->x, 1, rv->pitch, rv->w, rv->h,
+            rv->posX, rv->posY, rv->dirX, rv->dirY, rv->planeX, rv->planeY, rv->zbuffer, NULL);
+    }
+}
+
+void render_views(const RenderView *views, int count, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]) {
+    if (count <= 0) return;
+    int firstBuf[16];
+    int *first = count < 16 ? firstBuf : malloc(sizeof(int) * ((size_t)count + 1));
+    if (!first) return;
+    first[0] = 0;
+    for (int v = 0; v < count; v++) first[v + 1] = first[v] + (views[v].w > 0 ? views[v].w : 0);
+    light_prepare(textures);
+    depth_begin(NULL, 0, 0);
+    RenderViewsJob j = { views, count, first };
+    jobs_parallel_for(first[count], RENDER_VIEW_GRAIN, views_range, &j);
+    if (first != firstBuf) free(first);
+}
+
+static void free_hits(RenderCache *c) {
+    free(c->hitX);
+    free(c->hitY);
+    free(c->hitSide);
+    free(c->hitDist);
+    free(c->hitStamp);
+    c->hitX = c->hitY = NULL;
+    c->hitSide = NULL;
+    c->hitDist = NULL;
+    c->hitStamp = NULL;
+    c->bins = 0;
+    c->stamp = 0;
+}
+
+// size the angle cache for a render width; false leaves it empty
+static bool cache_resize(RenderCache *c, int renderW) {
+    int bins = RENDER_CACHE_MIN_BINS;
+    while (bins < 2 * renderW) bins *= 2;
+    if (c->bins == bins) return true;
+    free_hits(c);
+    c->hitX = malloc(sizeof(int) * bins);
+    c->hitY = malloc(sizeof(int) * bins);
+    c->hitSide = malloc((size_t)bins);
+    c->hitDist = malloc(sizeof(float) * bins);
+    c->hitStamp = calloc((size_t)bins, sizeof(Uint32));
+    if (!c->hitX || !c->hitY || !c->hitSide || !c->hitDist || !c->hitStamp) {
+        free_hits(c);
+        return false;
+    }
+    c->bins = bins;
+    return true;
+}
+
+static void free_history(RenderCache *c) {
+    free(c->history);
+    free(c->historyZ);
+    free(c->frameZ);
+    free(c->fillSrc);
+    free(c->fillLeft);
+    free(c->fillRight);
+    free(c->fillStep);
+    c->history = NULL;
+    c->historyZ = c->frameZ = NULL;
+    c->fillSrc = c->fillLeft = c->fillRight = NULL;
+    c->fillStep = NULL;
+    c->historyW = c->historyH = 0;
+    c->historyValid = false;
+}
+
+// the column-major frame for the columns mode; false when it can't be
+// allocated (the frame is then drawn into pixels directly)
+static bool columns_resize(RenderCache *c, int w, int h) {
+    if (c->columnPixels && c->columnW == w && c->columnH == h) return true;
+    free(c->columnPixels);
+    c->columnPixels = malloc(sizeof(Uint32) * (size_t)w * h);
+    c->columnW = c->columnPixels ? w : 0;
+    c->columnH = c->columnPixels ? h : 0;
+    return c->columnPixels != NULL;
+}
+
+// world-only copy of the last frame for the interlaced mode; false when it
+// can't be allocated (the frame is then drawn in full)
+static bool history_resize(RenderCache *c, int w, int h) {
+    if (c->history && c->historyW == w && c->historyH == h) return true;
+    free_history(c);
+    c->history = malloc(sizeof(Uint32) * (size_t)w * h);
+    c->historyZ = malloc(sizeof(float) * (size_t)w);
+    c->frameZ = malloc(sizeof(float) * (size_t)w);
+    c->fillSrc = malloc(sizeof(int) * (size_t)w);
+    c->fillLeft = malloc(sizeof(int) * (size_t)w);
+    c->fillRight = malloc(sizeof(int) * (size_t)w);
+    c->fillStep = malloc(sizeof(Sint32) * (size_t)w);
+    if (!c->history || !c->historyZ || !c->frameZ || !c->fillSrc || !c->fillLeft || !c->fillRight || !c->fillStep) {
+        free_history(c);
+        return false;
+    }
+    c->historyW = w;
+    c->historyH = h;
+    return true;
+}
+
+// Where skipped column x finds its ray in the last frame. With the eye fixed
+// a ray keeps its hit and only its perpendicular distance changes, so the old
+// column is rescaled about the horizon by 1 / scale. False when the ray was
+// outside the old view.
+static bool reproject_column(const RenderCache *c, int w, int x, double dirX, double dirY,
+    double planeX, double planeY, int *srcX, double *scale) {
+    double cameraX = 2.0 * x / (double)w - 1.0;
+    double rayDirX = dirX + planeX * cameraX;
+    double rayDirY = dirY + planeY * cameraX;
+    // the ray in the old camera's basis: rayDir = ty * (oldDir + tx / ty * oldPlane)
+    double invDet = 1.0 / (c->planeX * c->dirY - c->dirX * c->planeY);
+    double tx = invDet * (c->dirY * rayDirX - c->dirX * rayDirY);
+    double ty = invDet * (-c->planeY * rayDirX + c->planeX * rayDirY);
+    if (!(ty > 1e-6)) return false;
+    int xs = (int)floor((tx / ty + 1.0) * 0.5 * w + 0.5);
+    if (xs < 0 || xs >= w) return false;
+    *srcX = xs;
+    *scale = ty;
+    return true;
+}
+
+// Half the columns are cast, alternating every frame; the rest come from the
+// previous frame while the eye stays put (exact when the camera didn't move
+// at all) or from their neighbours: averaged across one surface, the nearer
+// one copied across a depth edge so silhouettes stay sharp. The fill runs
+// row by row, the cast pass is what walks columns. Returns true when every
+// column matches a full render.
+static bool render_interlaced(RenderCache *c, RenderColumnStats *stats, Uint32 *pixels, int w, int h,
+    double posX, double posY, double dirX, double dirY, double planeX, double planeY) {
+    bool still = c->posX == posX && c->posY == posY;
+    bool same = still && c->dirX == dirX && c->dirY == dirY && c->planeX == planeX && c->planeY == planeY;
+    c->parity ^= 1;
+    int cast = w > 1 ? c->parity : 0;
+    render_view(c, stats, cast, w, 2, pixels, 1, w, w, h, posX, posY, dirX, dirY, planeX, planeY, c->frameZ, NULL);
+
+    // per skipped column: a source column in the history (src >= 0, rows
+    // scaled by rowStep), or neighbours l and r in this frame (src < 0)
+    int *src = c->fillSrc, *left = c->fillLeft, *right = c->fillRight;
+    Sint32 *rowStep = c->fillStep;
+    for (int x = 1 - cast; x < w; x += 2) {
+        int xs;
+        double scale;
+        if (same) {
+            src[x] = x;
+            rowStep[x] = 1 << 16;
+            c->frameZ[x] = c->historyZ[x];
+            c->reprojected++;
+        } else if (still && reproject_column(c, w, x, dirX, dirY, planeX, planeY, &xs, &scale)) {
+            src[x] = xs;
+            rowStep[x] = (Sint32)(65536.0 / scale);
+            c->frameZ[x] = (float)(c->historyZ[xs] / scale);
+            c->reprojected++;
+        } else {
+            int l = x - 1, r = x + 1 < w ? x + 1 : x - 1;
+            if (l < 0) l = r;
+            float zl = c->frameZ[l], zr = c->frameZ[r];
+            float zmin = zl < zr ? zl : zr;
+            if (l != r && fabsf(zl - zr) >= 0.05f * zmin) l = r = (zl <= zr ? l : r);
+            src[x] = -1;
+            left[x] = l;
+            right[x] = r;
+            c->frameZ[x] = zmin;
+            c->interpolated++;
+        }
+    }
+    int half = h / 2;
+    for (int y = 0; y < h; y++) {
+        Uint32 *row = pixels + (size_t)y * w;
+        Sint32 off = (Sint32)(((2 * (y - half) + 1) << 15));
+        for (int x = 1 - cast; x < w; x += 2) {
+            if (src[x] >= 0) {
+                // fixed point 16.16 keeps the per-pixel cost to a multiply
+                int ys = half + (int)(((Sint64)off * rowStep[x]) >> 32);
+                if (ys < 0) ys = 0;
+                if (ys >= h) ys = h - 1;
+                row[x] = c->history[(size_t)ys * w + src[x]];
+            } else {
+                Uint32 a = row[left[x]], b = row[right[x]];
+                row[x] = (a & b) + (((a ^ b) & 0xFEFEFEFEu) >> 1);
+            }
+        }
+    }
+    return same;
+}
+
+RenderReuse render_world_cached(
+    RenderCache *cache,
+    unsigned sceneRevision,
+    Uint32 *pixels,
+    int renderW,
+    int renderH,
+    double posX,
+    double posY,
+    double dirX,
+    double dirY,
+    double planeX,
+    double planeY,
+    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H],
+    float *zbuffer) {
+    RenderCache *c = cache;
+    bool samePos = c->bins > 0 && c->posX == posX && c->posY == posY && c->mapRevision == mapRevision;
+    if (c->valid && samePos && c->pixels == pixels && c->zbuffer == zbuffer && c->textures == (const void *)textures
+        && c->w == renderW && c->h == renderH && c->dirX == dirX && c->dirY == dirY
+        && c->planeX == planeX && c->planeY == planeY && c->sceneRevision == sceneRevision
+        // a heights frame's sprites also need its per-pixel depth still in place
+        && (!mapHeights || c->interlace || renderDepthZ == zbuffer)) {
+        return RENDER_REUSED;
+    }
+    RenderColumnStats *stats = stats_begin(renderW);
+    int bins = c->bins;
+    if (!cache_resize(c, renderW)) {
+        c->valid = false;
+        c->historyValid = false;
+        light_prepare(textures);
+        render_view(NULL, stats, 0, renderW, 1, pixels, 1, renderW, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY, zbuffer,
+            depth_begin(zbuffer, renderW, renderH));
+        stats_end(stats, renderH);
+        return RENDER_FULL;
+    }
+    if (c->bins != bins) samePos = false;
+    if (!samePos) {
+        // new eye position or map: every cached hit is stale
+        if (++c->stamp == 0) {
+            memset(c->hitStamp, 0, sizeof(Uint32) * c->bins);
+            c->stamp = 1;
+        }
+    }
+    c->cast = c->cached = c->reprojected = c->interpolated = 0;
+    light_prepare(textures);
+    bool exact = true;
+    if (c->interlace && history_resize(c, renderW, renderH)) {
+        depth_begin(NULL, 0, 0);
+        if (c->historyValid && c->mapRevision == mapRevision && c->textures == (const void *)textures) {
+            exact = render_interlaced(c, stats, pixels, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY);
+        } else {
+            render_view(c, stats, 0, renderW, 1, pixels, 1, renderW, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY, c->frameZ, NULL);
+        }
+        memcpy(c->history, pixels, sizeof(Uint32) * (size_t)renderW * renderH);
+        memcpy(c->historyZ, c->frameZ, sizeof(float) * (size_t)renderW);
+        if (zbuffer) memcpy(zbuffer, c->frameZ, sizeof(float) * (size_t)renderW);
+        c->historyValid = true;
+    } else if (c->columns && columns_resize(c, renderW, renderH)) {
+        render_view(c, stats, 0, renderW, 1, c->columnPixels, renderH, 1, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY, zbuffer,
+            depth_begin(zbuffer, renderW, renderH));
+        render_transpose(pixels, renderW, c->columnPixels, renderW, renderH);
+        c->historyValid = false;
+    } else {
+        render_view(c, stats, 0, renderW, 1, pixels, 1, renderW, renderW, renderH, posX, posY, dirX, dirY, planeX, planeY, zbuffer,
+            depth_begin(zbuffer, renderW, renderH));
+        c->historyValid = false;
+    }
+    stats_end(stats, renderH);
+    // an approximated frame is never reused; the next one completes it
+    c->valid = exact;
+    c->pixels = pixels;
+    c->zbuffer = zbuffer;
+    c->textures = textures;
+    c->w = renderW;
+    c->h = renderH;
+    c->posX = posX;
+    c->posY = posY;
+    c->dirX = dirX;
+    c->dirY = dirY;
+    c->planeX = planeX;
+    c->planeY = planeY;
+    c->mapRevision = mapRevision;
+    c->sceneRevision = sceneRevision;
+    return samePos ? RENDER_ROTATED : RENDER_FULL;
+}
+
+void render_cache_invalidate(RenderCache *cache) {
+    cache->valid = false;
+}
+
+void render_cache_free(RenderCache *cache) {
+    free_hits(cache);
+    free_history(cache);
+    free(cache->columnPixels);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void render_stats_collect(RenderStats *stats) {
+#if GAME90_RENDER_STATS
+    renderStats = stats;
+#else
+    (void)stats;
+#endif
+}
+
+void render_stats_heatmap(RenderStats *stats, RenderHeat by, Uint32 *pixels, int pitch, int w, int h) {
+    if (!stats->cols || stats->w != w) return;
+    Uint32 *heat = stats->heat;
+    double top = by == RENDER_HEAT_TIME ? (double)stats->maxTicks : (double)stats->maxSteps;
+    for (int x = 0; x < w; x++) {
+        const RenderColumnStats *c = &stats->cols[x];
+        // 0 leaves columns that weren't drawn this frame as they are
+        heat[x] = 0;
+        if (!c->cast) continue;
+        double v = by == RENDER_HEAT_TIME ? (double)c->ticks : (double)c->steps;
+        int u = top > 0.0 ? (int)(v / top * 510.0) : 0;
+        if (u > 510) u = 510;
+        Uint32 r = u < 255 ? 0 : (Uint32)(u - 255);
+        Uint32 g = u < 255 ? (Uint32)u : (Uint32)(510 - u);
+        Uint32 b = u < 255 ? (Uint32)(255 - u) : 0;
+        heat[x] = 0xFF000000u | r << 16 | g << 8 | b;
+    }
+    // half and half with the frame, row by row
+    for (int y = 0; y < h; y++) {
+        Uint32 *row = pixels + (size_t)y * pitch;
+        for (int x = 0; x < w; x++) {
+            Uint32 a = row[x], b = heat[x];
+            if (b) row[x] = (a & b) + (((a ^ b) & 0xFEFEFEFEu) >> 1);
         }
     }
 }
+
+void render_stats_free(RenderStats *stats) {
+    free(stats->cols);
+    free(stats->heat);
+    memset(stats, 0, sizeof(*stats));
+}
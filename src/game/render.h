@@ -2,11 +2,17 @@
 #define GAME_RENDER_H
 
 #include <SDL2/SDL.h>
+#include <stdbool.h>
 
 #define GAME_TEX_W 64
 #define GAME_TEX_H 64
 
 void init_textures(Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]);
+// zbuffer (optional, renderW floats) receives each column's perpendicular wall
+// distance. With mapHeights set, rays run on past walls lower than what lies
+// behind them and each column keeps a span of rows still to draw, so nothing
+// is drawn twice; a column then shows several depths, so zbuffer holds the
+// farthest one and renderDepth the distance of every pixel.
 void render_world(
     Uint32 *pixels,
     int renderW,
@@ -17,6 +23,160 @@ void render_world(
     double dirY,
     double planeX,
     double planeY,
-    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]);
+    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H],
+    float *zbuffer);
+
+// With mapHeights set, render_world, render_world_columns and
+// render_world_cached (not interlaced) leave each pixel's distance in
+// renderDepth, pixel (x, y) at renderDepth[x * renderDepthH + y], and point
+// renderDepthZ at the zbuffer of that frame; NULL otherwise. render_views
+// keeps no per-pixel depth: its zbuffers hold the distance where the horizon
+// row was covered.
+extern float *renderDepth;
+extern const float *renderDepthZ;
+extern int renderDepthW, renderDepthH;
+
+// render_world into a column-major buffer, pixel (x, y) at
+// pixels[x * renderH + y]: each column is then one sequential run of stores
+// rather than one store per row. Same pixels as render_world otherwise.
+void render_world_columns(
+    Uint32 *pixels,
+    int renderW,
+    int renderH,
+    double posX,
+    double posY,
+    double dirX,
+    double dirY,
+    double planeX,
+    double planeY,
+    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H],
+    float *zbuffer);
+// a column-major w x h frame into rows of dstPitch pixels
+void render_transpose(Uint32 *dst, int dstPitch, const Uint32 *src, int w, int h);
+
+// One camera drawn into a rectangle of a target buffer
+typedef struct RenderView {
+    Uint32 *pixels;    // target, pitch pixels per row
+    int pitch;
+    int x, y, w, h;    // rectangle inside the target
+    double posX, posY, dirX, dirY, planeX, planeY;
+    float *zbuffer;    // optional, w floats
+} RenderView;
+
+// Several views in one call: the lookup tables are prepared once and the
+// columns of all views are spread over the job workers. Rectangles must not
+// overlap; views may share a target or use different ones.
+void render_views(const RenderView *views, int count, Uint32 textures[4][GAME_TEX_W * GAME_TEX_H]);
+
+// Change tracking for one view. Wall hits are cached per absolute ray angle
+// (filled by casting the bin boundaries) for one eye position and map
+// revision, so a pure rotation only casts the angles that came into view.
+// With interlace set, each frame casts every other column, alternating, and
+// fills the rest from the previous frame while the eye stays put, or from
+// the neighbouring columns when it moved; a still camera converges to the
+// full render on the next frame. Zero-initialize before first use; interlace
+// may be toggled between frames.
+typedef struct RenderCache {
+    // the frame last drawn into pixels
+    bool valid;
+    Uint32 *pixels;
+    float *zbuffer;
+    const void *textures;
+    int w, h;
+    double posX, posY, dirX, dirY, planeX, planeY;
+    unsigned mapRevision, sceneRevision;
+    // per bin boundary: the cell and side hit and the distance along the unit ray
+    int bins;
+    int *hitX, *hitY;
+    Sint8 *hitSide;
+    float *hitDist;
+    Uint32 *hitStamp;  // entry is current when equal to stamp
+    Uint32 stamp;
+    // interlaced mode: world-only copy of the last frame (before sprites)
+    bool interlace;
+    int parity;
+    bool historyValid;
+    int historyW, historyH;
+    Uint32 *history;
+    float *historyZ, *frameZ;
+    int *fillSrc, *fillLeft, *fillRight; // per skipped column, see render.c
+    Sint32 *fillStep;
+    // columns mode: full frames are drawn column-major here, then transposed
+    // into pixels; the interlaced mode takes precedence
+    bool columns;
+    Uint32 *columnPixels;
+    int columnW, columnH;
+    // columns in the last frame that ran the DDA, used the hit cache, or were
+    // filled from the previous frame / from neighbours
+    int cast, cached, reprojected, interpolated;
+} RenderCache;
+
+typedef enum { RENDER_FULL, RENDER_ROTATED, RENDER_REUSED } RenderReuse;
+
+// render_world with change tracking. When the view, buffers, map revision and
+// sceneRevision (whatever else the caller draws into pixels, e.g.
+// sprite_revision()) all match the last call, pixels and zbuffer are left as
+// they are and RENDER_REUSED is returned; the caller can skip its own passes
+// and the upload too. Output is identical to render_world either way.
+RenderReuse render_world_cached(
+    RenderCache *cache,
+    unsigned sceneRevision,
+    Uint32 *pixels,
+    int renderW,
+    int renderH,
+    double posX,
+    double posY,
+    double dirX,
+    double dirY,
+    double planeX,
+    double planeY,
+    Uint32 textures[4][GAME_TEX_W * GAME_TEX_H],
+    float *zbuffer);
+// forget the last frame, e.g. after drawing something else into its pixels
+void render_cache_invalidate(RenderCache *cache);
+void render_cache_free(RenderCache *cache);
+
+// Work counters. Built in with GAME90_RENDER_STATS (a CMake option, on by
+// default); without it the renderer has no trace of them and the functions
+// below do nothing. render_world, render_world_columns and
+// render_world_cached fill the collector set with render_stats_collect()
+// each frame they draw (a reused frame keeps the last numbers);
+// render_views never does.
+#ifndef GAME90_RENDER_STATS
+#define GAME90_RENDER_STATS 0
+#endif
+
+typedef struct RenderColumnStats {
+    int steps;                      // cells the DDA walked; 0 for a cached hit
+    int walls, floors, ceilings;    // pixels of each the frame ends up with
+    int writes;                     // pixel stores, a cleared row and its repaint both count
+    Uint32 ticks;                   // performance counter ticks spent on the column
+    bool cast;                      // drawn this frame (interlaced frames fill the rest)
+    bool offMap;                    // the ray ended by leaving the map, not at a wall
+} RenderColumnStats;
+
+typedef struct RenderStats {
+    int w, h;
+    RenderColumnStats *cols;        // w entries, owned by the renderer
+    Uint32 *heat;                   // w entries, the heatmap's colour per column
+    // totals over the columns drawn
+    int columns, offMap;
+    long long steps;
+    int maxSteps;
+    // floors and ceilings are flat colours, so every texel fetched is a wall pixel
+    long long walls, floors, ceilings;
+    long long writes, overdraw;     // overdraw: stores beyond one per pixel
+    Uint64 ticks;
+    Uint32 maxTicks;
+} RenderStats;
+
+typedef enum { RENDER_HEAT_STEPS, RENDER_HEAT_TIME } RenderHeat;
+
+// NULL (the default) stops collecting
+void render_stats_collect(RenderStats *stats);
+// tints each column of a frame of rows by its cost relative to the frame's
+// costliest column: blue for nothing, through green, to red
+void render_stats_heatmap(RenderStats *stats, RenderHeat by, Uint32 *pixels, int pitch, int w, int h);
+void render_stats_free(RenderStats *stats);
 
 #endif
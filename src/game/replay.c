@@ -0,0 +1,198 @@
+#include "replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_TICK_MOUSE 0x40
+#define REPLAY_EV_MAP 0x80
+#define REPLAY_EV_END 0x81
+
+static const char replayMagic[4] = { 'G', '9', '0', 'R' };
+
+static void put_u32(FILE *f, Uint32 v) {
+    Uint8 b[4] = { (Uint8)v, (Uint8)(v >> 8), (Uint8)(v >> 16), (Uint8)(v >> 24) };
+    fwrite(b, 1, 4, f);
+}
+
+static void put_varint(FILE *f, Uint32 v) {
+    while (v >= 0x80) {
+        fputc((int)(v & 0x7F) | 0x80, f);
+        v >>= 7;
+    }
+    fputc((int)v, f);
+}
+
+// doubles are stored as their bit pattern so the final pose compares exactly
+static void put_double(FILE *f, double d) {
+    Uint64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    put_u32(f, (Uint32)bits);
+    put_u32(f, (Uint32)(bits >> 32));
+}
+
+bool replay_create(ReplayWriter *w, const char *path, Uint32 seed, int tickHz) {
+    memset(w, 0, sizeof(*w));
+    w->f = fopen(path, "wb");
+    if (!w->f) {
+        fprintf(stderr, "replay: cannot create %s\n", path);
+        return false;
+    }
+    fwrite(replayMagic, 1, 4, w->f);
+    fputc(REPLAY_VERSION, w->f);
+    put_u32(w->f, seed);
+    put_varint(w->f, (Uint32)tickHz);
+    return true;
+}
+
+void replay_write_map(ReplayWriter *w, const char *mapPath) {
+    if (!w->f) return;
+    size_t len = mapPath ? strlen(mapPath) : 0;
+    if (len >= REPLAY_PATH_MAX) len = REPLAY_PATH_MAX - 1;
+    fputc(REPLAY_EV_MAP, w->f);
+    put_varint(w->f, (Uint32)len);
+    if (len) fwrite(mapPath, 1, len, w->f);
+}
+
+void replay_write_tick(ReplayWriter *w, Uint8 input, int mouseDx) {
+    if (!w->f) return;
+    input &= 0x3F;
+    if (mouseDx == 0) {
+        fputc(input, w->f);
+    } else {
+        fputc(input | REPLAY_TICK_MOUSE, w->f);
+        // zigzag so small negative deltas stay one byte
+        put_varint(w->f, ((Uint32)mouseDx << 1) ^ (Uint32)(mouseDx >> 31));
+    }
+    w->ticks++;
+}
+
+bool replay_finish(ReplayWriter *w, const ReplayPose *final) {
+    if (!w->f) return false;
+    fputc(REPLAY_EV_END, w->f);
+    put_varint(w->f, w->ticks);
+    put_double(w->f, final->posX);
+    put_double(w->f, final->posY);
+    put_double(w->f, final->dirX);
+    put_double(w->f, final->dirY);
+    bool ok = !ferror(w->f);
+    if (fclose(w->f) != 0) ok = false;
+    w->f = NULL;
+    if (!ok) fprintf(stderr, "replay: write failed\n");
+    return ok;
+}
+
+static bool get_byte(ReplayReader *r, Uint8 *b) {
+    if (r->pos >= r->size) return false;
+    *b = r->data[r->pos++];
+    return true;
+}
+
+static bool get_u32(ReplayReader *r, Uint32 *v) {
+    if (r->size - r->pos < 4) return false;
+    const Uint8 *p = r->data + r->pos;
+    *v = (Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 | (Uint32)p[3] << 24;
+    r->pos += 4;
+    return true;
+}
+
+static bool get_varint(ReplayReader *r, Uint32 *v) {
+    Uint32 out = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        Uint8 b;
+        if (!get_byte(r, &b)) return false;
+        out |= (Uint32)(b & 0x7F) << shift;
+        if (!(b & 0x80)) { *v = out; return true; }
+    }
+    return false;
+}
+
+static bool get_double(ReplayReader *r, double *d) {
+    Uint32 lo, hi;
+    if (!get_u32(r, &lo) || !get_u32(r, &hi)) return false;
+    Uint64 bits = (Uint64)hi << 32 | lo;
+    memcpy(d, &bits, sizeof(*d));
+    return true;
+}
+
+bool replay_open(ReplayReader *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "replay: cannot open %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size > 0) r->data = malloc((size_t)size);
+    if (!r->data || fread(r->data, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "replay: cannot read %s\n", path);
+        fclose(f);
+        replay_close(r);
+        return false;
+    }
+    fclose(f);
+    r->size = (size_t)size;
+
+    Uint8 version;
+    Uint32 hz;
+    if (r->size < 4 || memcmp(r->data, replayMagic, 4) != 0) {
+        fprintf(stderr, "replay: %s is not a recording\n", path);
+        replay_close(r);
+        return false;
+    }
+    r->pos = 4;
+    if (!get_byte(r, &version) || version != REPLAY_VERSION || !get_u32(r, &r->seed) || !get_varint(r, &hz) || hz == 0) {
+        fprintf(stderr, "replay: %s has an unsupported header\n", path);
+        replay_close(r);
+        return false;
+    }
+    r->tickHz = (int)hz;
+    return true;
+}
+
+ReplayEventType replay_next(ReplayReader *r, ReplayEvent *ev) {
+    ev->type = REPLAY_END;
+    ev->input = 0;
+    ev->mouseDx = 0;
+    ev->mapPath[0] = '\0';
+    Uint8 b;
+    if (!get_byte(r, &b)) return REPLAY_END; // truncated recording
+    if (b == REPLAY_EV_MAP) {
+        Uint32 len;
+        if (!get_varint(r, &len) || len >= REPLAY_PATH_MAX || r->size - r->pos < len) {
+            r->pos = r->size;
+            return REPLAY_END;
+        }
+        memcpy(ev->mapPath, r->data + r->pos, len);
+        ev->mapPath[len] = '\0';
+        r->pos += len;
+        return ev->type = REPLAY_MAP;
+    }
+    if (b == REPLAY_EV_END) {
+        r->hasFinal = get_varint(r, &r->finalTicks) && get_double(r, &r->final.posX) && get_double(r, &r->final.posY)
+            && get_double(r, &r->final.dirX) && get_double(r, &r->final.dirY);
+        r->pos = r->size;
+        return REPLAY_END;
+    }
+    if (b & 0x80) { // unknown event, nothing after it can be trusted
+        r->pos = r->size;
+        return REPLAY_END;
+    }
+    ev->input = b & 0x3F;
+    if (b & REPLAY_TICK_MOUSE) {
+        Uint32 z;
+        if (!get_varint(r, &z)) {
+            r->pos = r->size;
+            return REPLAY_END;
+        }
+        ev->mouseDx = (int)(z >> 1) ^ -(int)(z & 1);
+    }
+    r->ticks++;
+    return ev->type = REPLAY_TICK;
+}
+
+void replay_close(ReplayReader *r) {
+    free(r->data);
+    memset(r, 0, sizeof(*r));
+}
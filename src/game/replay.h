@@ -0,0 +1,55 @@
+#ifndef GAME_REPLAY_H
+#define GAME_REPLAY_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Input recordings. A file is a small header ("G90R", version byte, rand()
+// seed as u32, tick rate as varint) followed by a byte stream of events:
+//   0x00-0x3F  one tick, low bits are the SIM_IN_* input
+//   0x40|bits  one tick with a mouse delta, zigzag varint follows
+//   0x80       map load, varint length + path follows (empty: generated map)
+//   0x81       end, varint tick count + final pose (4 little-endian doubles)
+// A recording cut short by a crash simply ends without the pose.
+
+#define REPLAY_VERSION 1
+#define REPLAY_PATH_MAX 512
+
+typedef struct ReplayPose { double posX, posY, dirX, dirY; } ReplayPose;
+
+typedef struct ReplayWriter {
+    FILE *f;
+    Uint32 ticks;
+} ReplayWriter;
+
+bool replay_create(ReplayWriter *w, const char *path, Uint32 seed, int tickHz);
+void replay_write_map(ReplayWriter *w, const char *mapPath);
+void replay_write_tick(ReplayWriter *w, Uint8 input, int mouseDx);
+bool replay_finish(ReplayWriter *w, const ReplayPose *final);
+
+typedef enum { REPLAY_TICK, REPLAY_MAP, REPLAY_END } ReplayEventType;
+
+typedef struct ReplayEvent {
+    ReplayEventType type;
+    Uint8 input;
+    int mouseDx;
+    char mapPath[REPLAY_PATH_MAX];
+} ReplayEvent;
+
+typedef struct ReplayReader {
+    Uint8 *data;
+    size_t size, pos;
+    Uint32 seed;
+    int tickHz;
+    Uint32 ticks;         // ticks read so far
+    bool hasFinal;        // set once the end record has been read
+    Uint32 finalTicks;
+    ReplayPose final;
+} ReplayReader;
+
+bool replay_open(ReplayReader *r, const char *path);
+ReplayEventType replay_next(ReplayReader *r, ReplayEvent *ev);
+void replay_close(ReplayReader *r);
+
+#endif
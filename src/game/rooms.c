@@ -0,0 +1,446 @@
+#include "rooms.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Uint16 *roomOf = NULL;
+MapRoom *rooms = NULL;
+int roomCount = 0;
+RoomPortal *roomPortals = NULL;
+int roomPortalCount = 0;
+Uint32 *roomPVS = NULL;
+int roomPVSWords = 0;
+bool roomsValid = false;
+unsigned roomsGeneration = 0;
+
+static const int dirX4[4] = { 1, -1, 0, 0 };
+static const int dirY4[4] = { 0, 0, 1, -1 };
+
+// label the generator's rooms, then flood the remaining open cells per tile;
+// -1 when that makes more than ROOM_MAX rooms
+static int label_rooms(const Uint8 *open, int *stack, int tile) {
+    int n = 0;
+    for (int i = 0; i < mapW * mapH; i++) roomOf[i] = ROOM_NONE;
+    for (int r = 0; r < mapRoomCount; r++) {
+        const MapRect *d = &mapRooms[r];
+        int x0 = d->x0 < 0 ? 0 : d->x0, y0 = d->y0 < 0 ? 0 : d->y0;
+        int x1 = d->x1 >= mapW ? mapW - 1 : d->x1, y1 = d->y1 >= mapH ? mapH - 1 : d->y1;
+        bool any = false;
+        for (int y = y0; y <= y1; y++) for (int x = x0; x <= x1; x++) {
+            int i = x + mapW * y;
+            if (!open[i] || roomOf[i] != ROOM_NONE) continue;
+            roomOf[i] = (Uint16)n;
+            any = true;
+        }
+        if (any && ++n > ROOM_MAX) return -1;
+    }
+    for (int i = 0; i < mapW * mapH; i++) {
+        if (!open[i] || roomOf[i] != ROOM_NONE) continue;
+        if (n >= ROOM_MAX) return -1;
+        int tx = (i % mapW) / tile, ty = (i / mapW) / tile;
+        int top = 0;
+        stack[top++] = i;
+        roomOf[i] = (Uint16)n;
+        while (top > 0) {
+            int c = stack[--top], cx = c % mapW, cy = c / mapW;
+            for (int k = 0; k < 4; k++) {
+                int nx = cx + dirX4[k], ny = cy + dirY4[k];
+                if ((unsigned)nx >= (unsigned)mapW || (unsigned)ny >= (unsigned)mapH) continue;
+                if (nx / tile != tx || ny / tile != ty) continue;
+                int j = nx + mapW * ny;
+                if (!open[j] || roomOf[j] != ROOM_NONE) continue;
+                roomOf[j] = (Uint16)n;
+                stack[top++] = j;
+            }
+        }
+        n++;
+    }
+    return n;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    Uint32 x = *(const Uint32 *)a, y = *(const Uint32 *)b;
+    return (x > y) - (x < y);
+}
+
+static void pvs_set(int a, int b) {
+    roomPVS[(size_t)a * roomPVSWords + (b >> 5)] |= 1u << (b & 31);
+}
+
+static bool pvs_get(int a, int b) {
+    return roomPVS[(size_t)a * roomPVSWords + (b >> 5)] >> (b & 31) & 1;
+}
+
+// a straight run of the boundary between two rooms, directed: lines crossing
+// it go from room `from` into room `to`, towards the side (nx, ny) points at
+typedef struct PortalRun {
+    double x0, y0, x1, y1;
+    double nx, ny;
+    int from, to;
+} PortalRun;
+
+typedef struct Seg {
+    double x0, y0, x1, y1;
+} Seg;
+
+#define PVS_EPS 1e-6
+
+static double side_of(double ax, double ay, double bx, double by, double px, double py) {
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+// keep the part of t on k's side of the line through a and b, the line itself
+// included; false when nothing is left
+static bool clip_side(Seg *t, double ax, double ay, double bx, double by, double kx, double ky) {
+    double sk = side_of(ax, ay, bx, by, kx, ky);
+    if (fabs(sk) < PVS_EPS) return true;
+    double s0 = side_of(ax, ay, bx, by, t->x0, t->y0) * (sk > 0 ? 1 : -1);
+    double s1 = side_of(ax, ay, bx, by, t->x1, t->y1) * (sk > 0 ? 1 : -1);
+    if (s0 < -PVS_EPS && s1 < -PVS_EPS) return false;
+    if (s0 < -PVS_EPS) {
+        double u = s0 / (s0 - s1);
+        t->x0 += (t->x1 - t->x0) * u;
+        t->y0 += (t->y1 - t->y0) * u;
+    } else if (s1 < -PVS_EPS) {
+        double u = s1 / (s1 - s0);
+        t->x1 += (t->x0 - t->x1) * u;
+        t->y1 += (t->y0 - t->y1) * u;
+    }
+    return true;
+}
+
+// keep the part of t some line through s and then p can reach: a line from an
+// end of s to an end of p with the other two ends on opposite sides bounds
+// every such line beyond p to the side of p's other end
+static bool clip_separators(Seg *t, const Seg *s, const Seg *p) {
+    double sx[2] = { s->x0, s->x1 }, sy[2] = { s->y0, s->y1 };
+    double px[2] = { p->x0, p->x1 }, py[2] = { p->y0, p->y1 };
+    for (int i = 0; i < 2; i++) for (int j = 0; j < 2; j++) {
+        double ax = sx[i], ay = sy[i], bx = px[j], by = py[j];
+        double ss = side_of(ax, ay, bx, by, sx[1 - i], sy[1 - i]);
+        double sp = side_of(ax, ay, bx, by, px[1 - j], py[1 - j]);
+        if (!(ss < -PVS_EPS && sp > PVS_EPS) && !(ss > PVS_EPS && sp < -PVS_EPS)) continue;
+        if (!clip_side(t, ax, ay, bx, by, px[1 - j], py[1 - j])) return false;
+    }
+    return true;
+}
+
+static bool clip_beyond(Seg *t, const PortalRun *r) {
+    double mx = (r->x0 + r->x1) * 0.5, my = (r->y0 + r->y1) * 0.5;
+    return clip_side(t, r->x0, r->y0, r->x1, r->y1, mx + r->nx, my + r->ny);
+}
+
+// where a walk has already been: the run's interval and the source run's
+// interval it was entered with. Runs are axis aligned, so one coordinate
+// places a point on them
+typedef struct RunMemo {
+    int source;                 // source run, -1 when empty
+    int depth;
+    double s0, s1, t0, t1;
+} RunMemo;
+
+typedef struct PVSWalk {
+    const PortalRun *runs;
+    const int *first;           // runs leaving room r are first[r]..first[r + 1]
+    RunMemo *memo;
+    int source;
+    int sourceIdx;
+    const PortalRun *sourceRun;
+    long steps;
+    bool over;
+} PVSWalk;
+
+static void run_span(const PortalRun *r, const Seg *s, double *lo, double *hi) {
+    double a = r->nx != 0.0 ? s->y0 : s->x0, b = r->nx != 0.0 ? s->y1 : s->x1;
+    *lo = a < b ? a : b;
+    *hi = a < b ? b : a;
+}
+
+// skip a state inside one already walked from the same source run: every
+// line it holds was followed then
+static bool memo_covered(PVSWalk *w, int run, const Seg *s, const Seg *t, int depth) {
+    RunMemo *m = &w->memo[run];
+    double s0, s1, t0, t1;
+    run_span(w->sourceRun, s, &s0, &s1);
+    run_span(&w->runs[run], t, &t0, &t1);
+    if (m->source == w->sourceIdx && m->depth <= depth && s0 >= m->s0 - PVS_EPS && s1 <= m->s1 + PVS_EPS &&
+        t0 >= m->t0 - PVS_EPS && t1 <= m->t1 + PVS_EPS) return true;
+    *m = (RunMemo){ w->sourceIdx, depth, s0, s1, t0, t1 };
+    return false;
+}
+
+// a line from the source room entered `room` through src and then pass (pass
+// alone when src is NULL); follow it out through every run that part of it
+// still reaches, narrowing both ends as it goes
+static void pvs_flow(PVSWalk *w, int room, const Seg *src, const Seg *pass, const PortalRun *passRun, int depth) {
+    pvs_set(w->source, room);
+    if (++w->steps > ROOM_PVS_STEPS || depth >= ROOM_PVS_DEPTH) { w->over = true; return; }
+    for (int i = w->first[room]; i < w->first[room + 1]; i++) {
+        const PortalRun *r = &w->runs[i];
+        if (r == passRun) continue;
+        Seg t = { r->x0, r->y0, r->x1, r->y1 };
+        if (!clip_beyond(&t, passRun) || !clip_beyond(&t, w->sourceRun)) continue;
+        Seg s = src ? *src : *pass;
+        if (src) {
+            if (!clip_separators(&t, src, pass)) continue;
+            if (!clip_separators(&s, &t, pass)) continue;
+        }
+        if (memo_covered(w, i, &s, &t, depth + 1)) continue;
+        pvs_flow(w, r->to, &s, &t, r, depth + 1);
+        if (w->over) return;
+    }
+}
+
+// maximal straight runs where two rooms' cells meet, each stored both ways;
+// the boundaries between columns when vertical is set, else between rows
+static bool collect_runs(PortalRun **runs, int *count, int *cap, bool vertical) {
+    int outer = vertical ? mapW - 1 : mapH - 1, inner = vertical ? mapH : mapW;
+    for (int a = 0; a < outer; a++) {
+        int runFrom = -1, runTo = -1, runStart = 0;
+        for (int b = 0; b <= inner; b++) {
+            int r = -1, o = -1;
+            if (b < inner) {
+                int i = vertical ? a + mapW * b : b + mapW * a;
+                int j = vertical ? i + 1 : i + mapW;
+                r = roomOf[i];
+                o = roomOf[j];
+                if (r == ROOM_NONE || o == ROOM_NONE || r == o) r = o = -1;
+            }
+            if (r == runFrom && o == runTo) continue;
+            if (runFrom >= 0) {
+                if (*count + 2 > *cap) {
+                    *cap = *cap ? *cap * 2 : 1024;
+                    PortalRun *p = realloc(*runs, sizeof(PortalRun) * (size_t)*cap);
+                    if (!p) return false;
+                    *runs = p;
+                }
+                double c = a + 1.0;
+                PortalRun run = vertical ? (PortalRun){ c, runStart, c, b, 1, 0, runFrom, runTo }
+                                         : (PortalRun){ runStart, c, b, c, 0, 1, runFrom, runTo };
+                (*runs)[(*count)++] = run;
+                run.nx = -run.nx;
+                run.ny = -run.ny;
+                run.from = runTo;
+                run.to = runFrom;
+                (*runs)[(*count)++] = run;
+            }
+            runFrom = r;
+            runTo = o;
+            runStart = b;
+        }
+    }
+    return true;
+}
+
+bool rooms_build(void) {
+    roomsValid = false;
+    if (!mapSolid) return false;
+    int cells = mapW * mapH;
+    Uint16 *of = realloc(roomOf, sizeof(Uint16) * (size_t)cells);
+    if (!of) { fprintf(stderr, "rooms: failed to allocate %dx%d labels\n", mapW, mapH); return false; }
+    roomOf = of;
+    Uint8 *open = malloc((size_t)cells);
+    int *scratch = malloc(sizeof(int) * (size_t)cells);
+    Uint32 *pairs = NULL;
+    int *start = NULL;
+    PortalRun *runs = NULL, *sorted = NULL;
+    int *first = NULL, *visited = NULL, *queue = NULL;
+    RunMemo *memo = NULL;
+    bool ok = false;
+    if (!open || !scratch) goto done;
+    for (int i = 0; i < cells; i++) open[i] = !mapSolid[i];
+    for (int i = 0; i < mapDoorCount; i++) open[mapDoors[i].x + mapW * mapDoors[i].y] = 1;
+
+    int n = -1;
+    for (int tile = ROOM_TILE; n < 0; tile *= 2) {
+        n = label_rooms(open, scratch, tile);
+        if (n < 0 && tile >= mapW && tile >= mapH) {
+            fprintf(stderr, "rooms: more than %d disconnected areas\n", ROOM_MAX);
+            goto done;
+        }
+    }
+
+    MapRoom *rs = realloc(rooms, sizeof(MapRoom) * (size_t)(n > 0 ? n : 1));
+    start = calloc((size_t)n + 1, sizeof(int));
+    if (!rs || !start) goto done;
+    rooms = rs;
+    roomCount = n;
+    for (int r = 0; r < n; r++) rooms[r] = (MapRoom){ mapW, mapH, -1, -1, 0, 0, 0 };
+    // bounds and a cell list per room; pairs of touching rooms as lo << 16 | hi
+    int pairCount = 0, pairCap = 0;
+    for (int i = 0; i < cells; i++) {
+        int r = roomOf[i];
+        if (r == ROOM_NONE) continue;
+        int x = i % mapW, y = i / mapW;
+        MapRoom *m = &rooms[r];
+        if (x < m->x0) m->x0 = x;
+        if (y < m->y0) m->y0 = y;
+        if (x > m->x1) m->x1 = x;
+        if (y > m->y1) m->y1 = y;
+        m->cells++;
+        for (int k = 0; k < 4; k += 2) {
+            int nx = x + dirX4[k], ny = y + dirY4[k];
+            if (nx >= mapW || ny >= mapH) continue;
+            int o = roomOf[nx + mapW * ny];
+            if (o == ROOM_NONE || o == r) continue;
+            if (pairCount == pairCap) {
+                pairCap = pairCap ? pairCap * 2 : 1024;
+                Uint32 *p = realloc(pairs, sizeof(Uint32) * (size_t)pairCap);
+                if (!p) goto done;
+                pairs = p;
+            }
+            pairs[pairCount++] = r < o ? (Uint32)r << 16 | (Uint32)o : (Uint32)o << 16 | (Uint32)r;
+        }
+    }
+    for (int r = 0; r < n; r++) start[r + 1] = start[r] + rooms[r].cells;
+    // counting sort; cells runs back down to zero, so restore it afterwards
+    for (int i = 0; i < cells; i++) {
+        if (roomOf[i] != ROOM_NONE) scratch[start[roomOf[i]] + --rooms[roomOf[i]].cells] = i;
+    }
+    for (int r = 0; r < n; r++) rooms[r].cells = start[r + 1] - start[r];
+
+    // portals: one per touching pair, stored from both sides
+    if (pairCount > 0) qsort(pairs, (size_t)pairCount, sizeof(Uint32), cmp_u32);
+    int unique = 0;
+    for (int i = 0; i < pairCount; i++) {
+        if (unique > 0 && pairs[unique - 1] == pairs[i]) continue;
+        pairs[unique++] = pairs[i];
+    }
+    RoomPortal *ps = realloc(roomPortals, sizeof(RoomPortal) * (size_t)(2 * unique + 1));
+    if (!ps) goto done;
+    roomPortals = ps;
+    roomPortalCount = 2 * unique;
+    for (int i = 0; i < unique; i++) {
+        rooms[pairs[i] >> 16].portalCount++;
+        rooms[pairs[i] & 0xFFFF].portalCount++;
+    }
+    for (int r = 0, at = 0; r < n; r++) {
+        rooms[r].firstPortal = at;
+        at += rooms[r].portalCount;
+        rooms[r].portalCount = 0;
+    }
+    for (int i = 0; i < unique; i++) {
+        int a = (int)(pairs[i] >> 16), b = (int)(pairs[i] & 0xFFFF);
+        roomPortals[rooms[a].firstPortal + rooms[a].portalCount++] = (RoomPortal){ b, 0 };
+        roomPortals[rooms[b].firstPortal + rooms[b].portalCount++] = (RoomPortal){ a, 0 };
+    }
+    // boundary lengths: each touching cell pair is met once, from its left or upper cell
+    for (int i = 0; i < cells; i++) {
+        int r = roomOf[i];
+        if (r == ROOM_NONE) continue;
+        int x = i % mapW, y = i / mapW;
+        for (int k = 0; k < 4; k += 2) {
+            int nx = x + dirX4[k], ny = y + dirY4[k];
+            if (nx >= mapW || ny >= mapH) continue;
+            int o = roomOf[nx + mapW * ny];
+            if (o == ROOM_NONE || o == r) continue;
+            for (int p = 0; p < rooms[r].portalCount; p++) {
+                RoomPortal *rp = &roomPortals[rooms[r].firstPortal + p];
+                if (rp->to == o) rp->cells++;
+            }
+            for (int p = 0; p < rooms[o].portalCount; p++) {
+                RoomPortal *rp = &roomPortals[rooms[o].firstPortal + p];
+                if (rp->to == r) rp->cells++;
+            }
+        }
+    }
+
+    // PVS: from each run leaving a room, follow the runs a line through all the
+    // runs so far could still cross. Walls inside rooms are ignored and the
+    // runs are clipped only by lines no sight line can cross, so a room left
+    // out is truly hidden; a walk over its step or depth budget takes every
+    // room the portals reach instead
+    int runCount = 0, runCap = 0;
+    if (!collect_runs(&runs, &runCount, &runCap, true) || !collect_runs(&runs, &runCount, &runCap, false)) goto done;
+    sorted = malloc(sizeof(PortalRun) * ((size_t)runCount + 1));
+    first = calloc((size_t)n + 2, sizeof(int));
+    memo = malloc(sizeof(RunMemo) * ((size_t)runCount + 1));
+    roomPVSWords = (n + 31) / 32;
+    Uint32 *pvs = realloc(roomPVS, sizeof(Uint32) * ((size_t)n * roomPVSWords + 1));
+    visited = malloc(sizeof(int) * ((size_t)n + 1));
+    queue = malloc(sizeof(int) * ((size_t)n + 1));
+    if (!sorted || !first || !memo || !pvs || !visited || !queue) goto done;
+    roomPVS = pvs;
+    memset(roomPVS, 0, sizeof(Uint32) * (size_t)n * roomPVSWords);
+    for (int i = 0; i < runCount; i++) first[runs[i].from + 2]++;
+    for (int r = 0; r < n; r++) first[r + 2] += first[r + 1];
+    for (int i = 0; i < runCount; i++) sorted[first[runs[i].from + 1]++] = runs[i];
+    for (int r = 0; r < n; r++) visited[r] = -1;
+    for (int i = 0; i < runCount; i++) memo[i].source = -1;
+    PVSWalk walk = { sorted, first, memo, 0, 0, NULL, 0, false };
+    for (int a = 0; a < n; a++) {
+        pvs_set(a, a);
+        walk.source = a;
+        walk.steps = 0;
+        walk.over = false;
+        for (int i = first[a]; i < first[a + 1] && !walk.over; i++) {
+            Seg s = { sorted[i].x0, sorted[i].y0, sorted[i].x1, sorted[i].y1 };
+            walk.sourceIdx = i;
+            walk.sourceRun = &sorted[i];
+            pvs_flow(&walk, sorted[i].to, NULL, &s, &sorted[i], 0);
+        }
+        if (!walk.over) continue;
+        int head = 0, tail = 0;
+        queue[tail++] = a;
+        visited[a] = a;
+        while (head < tail) {
+            int r = queue[head++];
+            pvs_set(a, r);
+            for (int p = 0; p < rooms[r].portalCount; p++) {
+                int b = roomPortals[rooms[r].firstPortal + p].to;
+                if (visited[b] == a) continue;
+                visited[b] = a;
+                queue[tail++] = b;
+            }
+        }
+    }
+    // keep it symmetric: clipping narrows the two directions differently
+    for (int a = 0; a < n; a++) for (int b = a + 1; b < n; b++) {
+        if (pvs_get(a, b) != pvs_get(b, a)) { pvs_set(a, b); pvs_set(b, a); }
+    }
+    roomsValid = true;
+    roomsGeneration = mapGeneration;
+    ok = true;
+done:
+    if (!ok) roomCount = 0;
+    free(open);
+    free(scratch);
+    free(pairs);
+    free(start);
+    free(runs);
+    free(sorted);
+    free(first);
+    free(memo);
+    free(visited);
+    free(queue);
+    return ok;
+}
+
+void rooms_update_rect(int x0, int y0, int x1, int y1) {
+    if (!rooms_ready()) return;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= mapW) x1 = mapW - 1;
+    if (y1 >= mapH) y1 = mapH - 1;
+    for (int y = y0; y <= y1; y++) for (int x = x0; x <= x1; x++) {
+        if (!MAP_SOLID(x, y) && roomOf[x + mapW * y] == ROOM_NONE) {
+            roomsValid = false;
+            return;
+        }
+    }
+}
+
+void rooms_free(void) {
+    free(roomOf);
+    free(rooms);
+    free(roomPortals);
+    free(roomPVS);
+    roomOf = NULL;
+    rooms = NULL;
+    roomPortals = NULL;
+    roomPVS = NULL;
+    roomCount = roomPortalCount = roomPVSWords = 0;
+    roomsValid = false;
+}
@@ -0,0 +1,67 @@
+#ifndef GAME_ROOMS_H
+#define GAME_ROOMS_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#include "map.h"
+
+// Room/portal graph and potentially visible sets. Every open cell (doors
+// count as open) belongs to one room: the rooms a generator recorded in
+// mapRooms where given, otherwise the 4-connected open cells sharing a
+// ROOM_TILE x ROOM_TILE tile, so hand-made maps get regions too. Rooms whose
+// cells touch are joined by a portal. A room's PVS is conservative: it holds
+// every room some line from anywhere in the room could reach through a chain
+// of portals, found by walking the portals with a narrowing frustum.
+
+#define ROOM_NONE 0xFFFFu
+#define ROOM_MAX 1024           // the tile doubles until the map fits
+#define ROOM_TILE 8
+#define ROOM_PVS_STEPS 200000   // portal walk budget per room before it takes all it reaches
+#define ROOM_PVS_DEPTH 512      // runs one line may cross before the walk gives up the same way
+
+typedef struct MapRoom {
+    int x0, y0, x1, y1;         // bounds of its cells
+    int cells;
+    int firstPortal, portalCount;
+} MapRoom;
+
+typedef struct RoomPortal {
+    int to;
+    int cells;                  // length of the shared boundary
+} RoomPortal;
+
+extern Uint16 *roomOf;          // room per cell, ROOM_NONE on walls
+extern MapRoom *rooms;
+extern int roomCount;
+extern RoomPortal *roomPortals; // grouped per room, see MapRoom
+extern int roomPortalCount;
+extern Uint32 *roomPVS;         // roomCount rows of roomPVSWords bits
+extern int roomPVSWords;
+// false after an edit opened cells no room covers; rooms_visible() then
+// answers true until the next rooms_build()
+extern bool roomsValid;
+extern unsigned roomsGeneration; // mapGeneration the rooms were built for
+
+bool rooms_build(void);
+// cells in [x0,x1]x[y0,y1] changed; closing cells only hides things, so only
+// newly opened ones matter
+void rooms_update_rect(int x0, int y0, int x1, int y1);
+void rooms_free(void);
+
+static inline bool rooms_ready(void) {
+    return roomsValid && roomsGeneration == mapGeneration;
+}
+
+static inline int room_at(double x, double y) {
+    if (!rooms_ready() || x < 0.0 || y < 0.0 || x >= mapW || y >= mapH) return (int)ROOM_NONE;
+    return roomOf[(int)x + mapW * (int)y];
+}
+
+// can anything in room `to` be seen from room `from`? true when unknown
+static inline bool rooms_visible(int from, int to) {
+    if (!rooms_ready() || from == (int)ROOM_NONE || to == (int)ROOM_NONE) return true;
+    return roomPVS[(size_t)from * roomPVSWords + (to >> 5)] >> (to & 31) & 1;
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "sim.h"
+
+#include "jobs.h"
+#include "map.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_PARALLEL_MIN 16384 // below this a step stays on the calling thread
+#define SIM_GRAIN 4096
+#define SIM_CHUNK 256
+
+static bool grow(SimActors *s, int capacity) {
+    if (capacity <= s->capacity) return true;
+    double **d[6] = { &s->posX, &s->posY, &s->dirX, &s->dirY, &s->planeX, &s->planeY };
+    for (int k = 0; k < 6; k++) {
+        double *p = realloc(*d[k], sizeof(double) * (size_t)capacity);
+        if (!p) goto fail;
+        *d[k] = p;
+    }
+    double *t = realloc(s->turn, sizeof(double) * (size_t)capacity);
+    if (!t) goto fail;
+    s->turn = t;
+    Uint8 *in = realloc(s->input, (size_t)capacity);
+    if (!in) goto fail;
+    s->input = in;
+    s->capacity = capacity;
+    return true;
+fail:
+    fprintf(stderr, "sim: failed to grow actors to %d\n", capacity);
+    return false;
+}
+
+bool sim_init(SimActors *s, int capacity) {
+    memset(s, 0, sizeof(*s));
+    return grow(s, capacity > 0 ? capacity : 1);
+}
+
+void sim_free(SimActors *s) {
+    free(s->posX); free(s->posY);
+    free(s->dirX); free(s->dirY);
+    free(s->planeX); free(s->planeY);
+    free(s->input); free(s->turn);
+    memset(s, 0, sizeof(*s));
+}
+
+int sim_add(SimActors *s, double x, double y, double dirX, double dirY, double planeLen) {
+    if (s->count == s->capacity && !grow(s, s->capacity * 2)) return -1;
+    int i = s->count++;
+    s->posX[i] = x;
+    s->posY[i] = y;
+    s->dirX[i] = dirX;
+    s->dirY[i] = dirY;
+    s->planeX[i] = -dirY * planeLen;
+    s->planeY[i] = dirX * planeLen;
+    s->input[i] = 0;
+    s->turn[i] = 0.0;
+    return i;
+}
+
+// everything an input byte means for one step: the keyboard turn as a
+// rotation, and forward/strafe speed in cells; built once per step
+typedef struct SimInputStep { double ca, sa, fwd, strafe; } SimInputStep;
+
+typedef struct SimStep {
+    SimActors *s;
+    SimInputStep lut[64];
+} SimStep;
+
+// written without short-circuits so the collision loop stays free of
+// unpredictable branches; cells outside the map read as solid
+static inline int open_cell(int x, int y) {
+    int inside = ((unsigned)x < (unsigned)mapW) & ((unsigned)y < (unsigned)mapH);
+    return inside & !mapSolid[inside ? x + mapW * y : 0];
+}
+
+static void step_range(void *ctx, int begin, int end) {
+    const SimStep *c = ctx;
+    SimActors *s = c->s;
+    double mx[SIM_CHUNK], my[SIM_CHUNK];
+    for (int c0 = begin; c0 < end; c0 += SIM_CHUNK) {
+        int n = (end - c0) < SIM_CHUNK ? end - c0 : SIM_CHUNK;
+        double *restrict dirX = s->dirX + c0, *restrict dirY = s->dirY + c0;
+        double *restrict planeX = s->planeX + c0, *restrict planeY = s->planeY + c0;
+        const Uint8 *restrict input = s->input + c0;
+        double *restrict turn = s->turn + c0;
+
+        // free-angle turns are rare (mouse look), so they take the scalar path
+        for (int k = 0; k < n; k++) {
+            if (turn[k] == 0.0) continue;
+            double ct = cos(turn[k]), st = sin(turn[k]);
+            double dx = dirX[k], px = planeX[k];
+            dirX[k] = dx * ct - dirY[k] * st;
+            dirY[k] = dx * st + dirY[k] * ct;
+            planeX[k] = px * ct - planeY[k] * st;
+            planeY[k] = px * st + planeY[k] * ct;
+            turn[k] = 0.0;
+        }
+        // keyboard turns and the movement vector, no branches and no trig
+        for (int k = 0; k < n; k++) {
+            const SimInputStep *in = &c->lut[input[k] & 63];
+            double dx = dirX[k] * in->ca - dirY[k] * in->sa;
+            double dy = dirX[k] * in->sa + dirY[k] * in->ca;
+            double px = planeX[k] * in->ca - planeY[k] * in->sa;
+            double py = planeX[k] * in->sa + planeY[k] * in->ca;
+            dirX[k] = dx; dirY[k] = dy;
+            planeX[k] = px; planeY[k] = py;
+            mx[k] = dx * in->fwd + dy * in->strafe;
+            my[k] = dy * in->fwd - dx * in->strafe;
+        }
+        // grid collision, one axis at a time so actors slide along walls
+        double *posX = s->posX + c0, *posY = s->posY + c0;
+        for (int k = 0; k < n; k++) {
+            double x = posX[k], y = posY[k];
+            double nx = x + mx[k];
+            x = open_cell((int)nx, (int)y) ? nx : x;
+            double ny = y + my[k];
+            y = open_cell((int)x, (int)ny) ? ny : y;
+            posX[k] = x;
+            posY[k] = y;
+        }
+    }
+}
+
+void sim_step(SimActors *s, double dt) {
+    if (!s || s->count <= 0 || !mapSolid) return;
+    double rot = dt * SIM_ROT_SPEED, move = dt * SIM_MOVE_SPEED;
+    double cr = cos(rot), sr = sin(rot);
+    SimStep c;
+    c.s = s;
+    for (int b = 0; b < 64; b++) {
+        int spin = !!(b & SIM_IN_TURN_LEFT) - !!(b & SIM_IN_TURN_RIGHT);
+        c.lut[b].ca = spin ? cr : 1.0;
+        c.lut[b].sa = spin * sr;
+        c.lut[b].fwd = (!!(b & SIM_IN_FORWARD) - !!(b & SIM_IN_BACK)) * move;
+        c.lut[b].strafe = (!!(b & SIM_IN_RIGHT) - !!(b & SIM_IN_LEFT)) * move;
+    }
+    if (s->count >= SIM_PARALLEL_MIN) jobs_parallel_for(s->count, SIM_GRAIN, step_range, &c);
+    else step_range(&c, 0, s->count);
+}
+
+SimCamera sim_camera(const SimActors *s, int i) {
+    SimCamera c = { s->posX[i], s->posY[i], s->dirX[i], s->dirY[i], s->planeX[i], s->planeY[i] };
+    return c;
+}
+
+SimCamera sim_camera_lerp(const SimCamera *a, const SimCamera *b, double t) {
+    SimCamera c;
+    c.posX = a->posX + (b->posX - a->posX) * t;
+    c.posY = a->posY + (b->posY - a->posY) * t;
+    double dx = a->dirX + (b->dirX - a->dirX) * t;
+    double dy = a->dirY + (b->dirY - a->dirY) * t;
+    double len = sqrt(dx * dx + dy * dy);
+    if (len < 1e-9) return *b; // half-turn in one tick, nothing sensible to blend
+    double planeLen = sqrt(b->planeX * b->planeX + b->planeY * b->planeY);
+    c.dirX = dx / len;
+    c.dirY = dy / len;
+    c.planeX = -c.dirY * planeLen;
+    c.planeY = c.dirX * planeLen;
+    return c;
+}
+
+SimCamera sim_camera_turn(const SimCamera *c, double yaw) {
+    if (yaw == 0.0) return *c;
+    double ct = cos(yaw), st = sin(yaw);
+    SimCamera r = *c;
+    r.dirX = c->dirX * ct - c->dirY * st;
+    r.dirY = c->dirX * st + c->dirY * ct;
+    r.planeX = c->planeX * ct - c->planeY * st;
+    r.planeY = c->planeX * st + c->planeY * ct;
+    return r;
+}
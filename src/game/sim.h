@@ -0,0 +1,49 @@
+#ifndef GAME_SIM_H
+#define GAME_SIM_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Actor simulation shared by the game and the headless server.
+// State is kept as structure-of-arrays and stepped in batches; movement is
+// resolved against mapSolid one axis at a time, like the original player code.
+
+#define SIM_MOVE_SPEED 5.0 // cells per second
+#define SIM_ROT_SPEED 3.0  // radians per second
+#define SIM_TICK_HZ 60     // fixed step used by the game and the server
+#define SIM_MAX_CATCHUP 8  // ticks run per frame at most before time is dropped
+
+// input bits, held for the whole step
+#define SIM_IN_FORWARD    0x01
+#define SIM_IN_BACK       0x02
+#define SIM_IN_LEFT       0x04 // strafe
+#define SIM_IN_RIGHT      0x08
+#define SIM_IN_TURN_LEFT  0x10
+#define SIM_IN_TURN_RIGHT 0x20
+
+typedef struct SimActors {
+    int count, capacity;
+    double *posX, *posY;
+    double *dirX, *dirY;
+    double *planeX, *planeY;
+    Uint8 *input;   // SIM_IN_* bits
+    double *turn;   // extra yaw in radians for the next step (mouse look), cleared by sim_step
+} SimActors;
+
+bool sim_init(SimActors *s, int capacity);
+void sim_free(SimActors *s);
+// facing (dirX, dirY) with a camera plane of planeLen; returns the index, -1 on failure
+int sim_add(SimActors *s, double x, double y, double dirX, double dirY, double planeLen);
+// advance every actor by dt seconds; large batches are split across the job workers
+void sim_step(SimActors *s, double dt);
+
+// one actor's view, for rendering between two ticks
+typedef struct SimCamera { double posX, posY, dirX, dirY, planeX, planeY; } SimCamera;
+
+SimCamera sim_camera(const SimActors *s, int i);
+// t in [0,1]; the direction is renormalized and the plane kept perpendicular to it
+SimCamera sim_camera_lerp(const SimCamera *a, const SimCamera *b, double t);
+// the same view turned by yaw radians, in the direction sim_step applies turn
+SimCamera sim_camera_turn(const SimCamera *c, double yaw);
+
+#endif
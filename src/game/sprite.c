@@ -0,0 +1,464 @@
+#include "sprite.h"
+
+#include "light.h"
+#include "map.h"
+#include "render.h"
+#include "rooms.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPRITE_NEAR 0.1
+#define DEPTH_TILE_SHIFT 4 // zbuffer max is kept per 16 columns
+
+// entity storage is structure-of-arrays; ids stay stable until despawned
+static float *sprX = NULL;
+static float *sprY = NULL;
+static Uint8 *sprTex = NULL;
+static Uint8 *sprAlive = NULL;
+static int *sprBin = NULL;
+static int *sprNext = NULL; // doubly linked list per spatial bin
+static int *sprPrev = NULL;
+static int sprCap = 0;
+static int sprHigh = 0; // one past the highest id ever handed out
+static int sprLive = 0;
+static unsigned sprRevision = 0; // bumped on every add, move and removal
+static int *freeIds = NULL;
+static int freeCount = 0;
+
+// uniform grid over the map, each bin heads a list of sprite ids
+static int *binHead = NULL;
+static int binW = 0;
+static int binH = 0;
+static int binMapW = 0;
+static int binMapH = 0;
+
+// per-frame scratch, grown on demand
+static Uint32 *visKey = NULL;
+static int *visIdx = NULL;
+static Uint32 *sortKey = NULL;
+static int *sortIdx = NULL;
+static int visCap = 0;
+static float *depthTiles = NULL;
+static int depthTileCap = 0;
+// rows sprites already cover: per column a list of disjoint spans sorted
+// top down, kept apart by at least one uncovered row, in a pool reset per frame
+typedef struct CoverSpan { short top, bot; int next; } CoverSpan;
+static int *covHead = NULL;
+static int covCap = 0;
+static CoverSpan *covSpans = NULL;
+static int covSpanCount = 0;
+static int covSpanCap = 0;
+
+static Uint32 spriteShaded[LIGHT_SHADES][SPRITE_TEX_COUNT][SPRITE_TEX_W * SPRITE_TEX_H];
+static Uint8 colTop[SPRITE_TEX_COUNT][SPRITE_TEX_W]; // first/last opaque row per texture column
+static Uint8 colBot[SPRITE_TEX_COUNT][SPRITE_TEX_W];
+static bool texturesReady = false;
+
+static void init_sprite_textures(void) {
+    static Uint32 base[SPRITE_TEX_COUNT][SPRITE_TEX_W * SPRITE_TEX_H];
+    memset(base, 0, sizeof(base));
+    for (int y = 0; y < SPRITE_TEX_H; y++) for (int x = 0; x < SPRITE_TEX_W; x++) {
+        // 0: glowing orb resting low in the cell
+        double dx = x + 0.5 - 32.0, dy = y + 0.5 - 44.0;
+        double d2 = dx * dx + dy * dy;
+        if (d2 <= 18.0 * 18.0) {
+            double k = 1.0 - sqrt(d2) / 18.0 * 0.6;
+            base[0][y * SPRITE_TEX_W + x] = 0xFF000000u | ((Uint32)(240 * k) << 16) | ((Uint32)(200 * k) << 8) | (Uint32)(60 * k);
+        }
+        // 1: striped pillar
+        if (x >= 24 && x < 40 && y >= 4) {
+            Uint8 c = ((y / 8) & 1) ? 120 : 150;
+            base[1][y * SPRITE_TEX_W + x] = 0xFF000000u | ((Uint32)c << 16) | ((Uint32)(c * 3 / 4) << 8) | (Uint32)(c / 2);
+        }
+    }
+    for (int t = 0; t < SPRITE_TEX_COUNT; t++) {
+        for (int x = 0; x < SPRITE_TEX_W; x++) {
+            int top = SPRITE_TEX_H, bot = -1;
+            for (int y = 0; y < SPRITE_TEX_H; y++) if (base[t][y * SPRITE_TEX_W + x]) { if (top > y) top = y; bot = y; }
+            colTop[t][x] = (Uint8)(bot < 0 ? SPRITE_TEX_H - 1 : top);
+            colBot[t][x] = (Uint8)(bot < 0 ? 0 : bot);
+        }
+        for (int s = 0; s < LIGHT_SHADES; s++) {
+            double k = (double)s / (LIGHT_SHADES - 1);
+            for (int i = 0; i < SPRITE_TEX_W * SPRITE_TEX_H; i++) {
+                Uint32 col = base[t][i];
+                if (!col) { spriteShaded[s][t][i] = 0; continue; }
+                Uint8 r = (Uint8)(((col >> 16) & 0xFF) * k);
+                Uint8 g = (Uint8)(((col >> 8) & 0xFF) * k);
+                Uint8 b = (Uint8)((col & 0xFF) * k);
+                spriteShaded[s][t][i] = 0xFF000000u | ((Uint32)r << 16) | ((Uint32)g << 8) | b;
+            }
+        }
+    }
+    texturesReady = true;
+}
+
+static int bin_of(double x, double y) {
+    int bx = (int)floor(x) >> SPRITE_BIN_SHIFT;
+    int by = (int)floor(y) >> SPRITE_BIN_SHIFT;
+    if (bx < 0) bx = 0;
+    if (by < 0) by = 0;
+    if (bx >= binW) bx = binW - 1;
+    if (by >= binH) by = binH - 1;
+    return bx + binW * by;
+}
+
+static void bin_link(int id, int bin) {
+    sprBin[id] = bin;
+    sprPrev[id] = -1;
+    sprNext[id] = binHead[bin];
+    if (binHead[bin] >= 0) sprPrev[binHead[bin]] = id;
+    binHead[bin] = id;
+}
+
+static void bin_unlink(int id) {
+    int b = sprBin[id];
+    if (sprPrev[id] >= 0) sprNext[sprPrev[id]] = sprNext[id];
+    else binHead[b] = sprNext[id];
+    if (sprNext[id] >= 0) sprPrev[sprNext[id]] = sprPrev[id];
+}
+
+// size the grid to the current map, re-binning everything if the map changed
+static bool ensure_bins(void) {
+    if (binHead && binMapW == mapW && binMapH == mapH) return true;
+    int w = ((mapW > 0 ? mapW : 1) + (1 << SPRITE_BIN_SHIFT) - 1) >> SPRITE_BIN_SHIFT;
+    int h = ((mapH > 0 ? mapH : 1) + (1 << SPRITE_BIN_SHIFT) - 1) >> SPRITE_BIN_SHIFT;
+    int *heads = realloc(binHead, sizeof(int) * w * h);
+    if (!heads) return false;
+    binHead = heads;
+    binW = w;
+    binH = h;
+    binMapW = mapW;
+    binMapH = mapH;
+    for (int i = 0; i < w * h; i++) binHead[i] = -1;
+    for (int id = 0; id < sprHigh; id++) if (sprAlive[id]) bin_link(id, bin_of(sprX[id], sprY[id]));
+    return true;
+}
+
+static bool grow_storage(int need) {
+    if (need <= sprCap) return true;
+    int cap = sprCap ? sprCap : 1024;
+    while (cap < need) cap *= 2;
+    float *x = realloc(sprX, sizeof(float) * cap); if (!x) return false; sprX = x;
+    float *y = realloc(sprY, sizeof(float) * cap); if (!y) return false; sprY = y;
+    Uint8 *t = realloc(sprTex, cap); if (!t) return false; sprTex = t;
+    Uint8 *a = realloc(sprAlive, cap); if (!a) return false; sprAlive = a;
+    int *b = realloc(sprBin, sizeof(int) * cap); if (!b) return false; sprBin = b;
+    int *n = realloc(sprNext, sizeof(int) * cap); if (!n) return false; sprNext = n;
+    int *p = realloc(sprPrev, sizeof(int) * cap); if (!p) return false; sprPrev = p;
+    int *f = realloc(freeIds, sizeof(int) * cap); if (!f) return false; freeIds = f;
+    sprCap = cap;
+    return true;
+}
+
+void sprite_reset(void) {
+    sprHigh = 0;
+    sprLive = 0;
+    freeCount = 0;
+    sprRevision++;
+    binMapW = binMapH = 0; // forces an empty grid sized to the current map
+    ensure_bins();
+}
+
+int sprite_spawn(double x, double y, int tex) {
+    if (!ensure_bins()) return -1;
+    int id;
+    if (freeCount > 0) id = freeIds[--freeCount];
+    else {
+        if (!grow_storage(sprHigh + 1)) return -1;
+        id = sprHigh++;
+    }
+    sprX[id] = (float)x;
+    sprY[id] = (float)y;
+    sprTex[id] = (Uint8)((tex >= 0 && tex < SPRITE_TEX_COUNT) ? tex : 0);
+    sprAlive[id] = 1;
+    bin_link(id, bin_of(x, y));
+    sprLive++;
+    sprRevision++;
+    return id;
+}
+
+void sprite_move(int id, double x, double y) {
+    if (id < 0 || id >= sprHigh || !sprAlive[id]) return;
+    sprX[id] = (float)x;
+    sprY[id] = (float)y;
+    sprRevision++;
+    if (!ensure_bins()) return;
+    int b = bin_of(x, y);
+    if (b != sprBin[id]) { bin_unlink(id); bin_link(id, b); }
+}
+
+void sprite_despawn(int id) {
+    if (id < 0 || id >= sprHigh || !sprAlive[id]) return;
+    bin_unlink(id);
+    sprAlive[id] = 0;
+    freeIds[freeCount++] = id;
+    sprLive--;
+    sprRevision++;
+}
+
+void sprite_spawn_map_things(void) {
+    sprite_reset();
+    for (int i = 0; i < mapThingCount; i++) sprite_spawn(mapThings[i].x, mapThings[i].y, mapThings[i].type);
+}
+
+int sprite_count(void) {
+    return sprLive;
+}
+
+unsigned sprite_revision(void) {
+    return sprRevision;
+}
+
+// rows a..b of a sprite column whose texture starts at row top, only where
+// the world's colZ (the column's per-pixel depth, if any) lies behind depth;
+// false when nothing was drawn
+static bool draw_span(Uint32 *pixels, int rw, int x, int a, int b, int top, long long stepY, const Uint32 *tex, int texX,
+    const float *colZ, float depth) {
+    long long texPos = (long long)(a - top) * stepY;
+    if (!colZ) {
+        for (int y = a; y <= b; y++, texPos += stepY) {
+            pixels[y * rw + x] = tex[(int)(texPos >> 16) * SPRITE_TEX_W + texX];
+        }
+        return true;
+    }
+    bool drew = false;
+    for (int y = a; y <= b; y++, texPos += stepY) {
+        if (colZ[y] <= depth) continue;
+        pixels[y * rw + x] = tex[(int)(texPos >> 16) * SPRITE_TEX_W + texX];
+        drew = true;
+    }
+    return drew;
+}
+
+// can the camera's room see any open cell under the billboard spanning
+// (x, y) +- (hx, hy)? true when it covers no room at all
+static bool billboard_room_visible(int camRoom, double x, double y, double hx, double hy) {
+    int x0 = (int)floor(x - fabs(hx)), x1 = (int)floor(x + fabs(hx));
+    int y0 = (int)floor(y - fabs(hy)), y1 = (int)floor(y + fabs(hy));
+    bool any = false;
+    for (int cy = y0; cy <= y1; cy++) for (int cx = x0; cx <= x1; cx++) {
+        int r = room_at(cx + 0.5, cy + 0.5);
+        if (r == (int)ROOM_NONE) continue;
+        if (rooms_visible(camRoom, r)) return true;
+        any = true;
+    }
+    return !any;
+}
+
+static bool grow_scratch(int need) {
+    if (need <= visCap) return true;
+    int cap = visCap ? visCap : 1024;
+    while (cap < need) cap *= 2;
+    Uint32 *k = realloc(visKey, sizeof(Uint32) * cap); if (!k) return false; visKey = k;
+    int *i = realloc(visIdx, sizeof(int) * cap); if (!i) return false; visIdx = i;
+    Uint32 *sk = realloc(sortKey, sizeof(Uint32) * cap); if (!sk) return false; sortKey = sk;
+    int *si = realloc(sortIdx, sizeof(int) * cap); if (!si) return false; sortIdx = si;
+    visCap = cap;
+    return true;
+}
+
+// LSD radix sort on the IEEE bits of positive depths (11/11/10 bit digits)
+static void sort_by_depth(int n) {
+    static int counts[2048];
+    Uint32 *srcK = visKey, *dstK = sortKey;
+    int *srcI = visIdx, *dstI = sortIdx;
+    for (int pass = 0; pass < 3; pass++) {
+        int shift = pass * 11;
+        memset(counts, 0, sizeof(counts));
+        for (int i = 0; i < n; i++) counts[(srcK[i] >> shift) & 2047]++;
+        int sum = 0;
+        for (int d = 0; d < 2048; d++) { int c = counts[d]; counts[d] = sum; sum += c; }
+        for (int i = 0; i < n; i++) {
+            int o = counts[(srcK[i] >> shift) & 2047]++;
+            dstK[o] = srcK[i];
+            dstI[o] = srcI[i];
+        }
+        Uint32 *tk = srcK; srcK = dstK; dstK = tk;
+        int *ti = srcI; srcI = dstI; dstI = ti;
+    }
+    // three passes leave the result in the scratch pair; point vis* at it
+    visKey = srcK; sortKey = dstK;
+    visIdx = srcI; sortIdx = dstI;
+}
+
+static Uint32 depth_key(float d) {
+    Uint32 k;
+    memcpy(&k, &d, sizeof(k));
+    return k;
+}
+
+void sprite_render(
+    Uint32 *pixels,
+    int renderW,
+    int renderH,
+    const float *zbuffer,
+    double posX,
+    double posY,
+    double dirX,
+    double dirY,
+    double planeX,
+    double planeY,
+    SpriteStats *stats) {
+    SpriteStats st = { sprLive, 0, 0, 0, 0 };
+    if (sprLive == 0 || !zbuffer || !ensure_bins() || !grow_scratch(sprLive)) { if (stats) *stats = st; return; }
+    if (!texturesReady) init_sprite_textures();
+    int rw = renderW, rh = renderH;
+    // heights frames show several depths per column; zbuffer is the farthest
+    const float *pixelZ = mapHeights && renderDepthZ == zbuffer && renderDepthW == rw && renderDepthH == rh ? renderDepth : NULL;
+
+    // coarse depth: max zbuffer per tile so whole sprites behind walls drop out early
+    int tiles = (rw + (1 << DEPTH_TILE_SHIFT) - 1) >> DEPTH_TILE_SHIFT;
+    if (tiles > depthTileCap) {
+        float *t = realloc(depthTiles, sizeof(float) * tiles);
+        if (!t) { if (stats) *stats = st; return; }
+        depthTiles = t;
+        depthTileCap = tiles;
+    }
+    if (rw > covCap) {
+        int *a = realloc(covHead, sizeof(int) * rw);
+        if (!a) { if (stats) *stats = st; return; }
+        covHead = a;
+        covCap = rw;
+    }
+    float farZ = 0.0f;
+    for (int t = 0; t < tiles; t++) depthTiles[t] = 0.0f;
+    for (int x = 0; x < rw; x++) {
+        float z = zbuffer[x];
+        if (z > depthTiles[x >> DEPTH_TILE_SHIFT]) depthTiles[x >> DEPTH_TILE_SHIFT] = z;
+        if (z > farZ) farZ = z;
+    }
+
+    double invDet = 1.0 / (planeX * dirY - dirX * planeY);
+
+    // bins overlapping the view triangle out to the farthest visible wall
+    double lx = posX + (dirX - planeX) * farZ, ly = posY + (dirY - planeY) * farZ;
+    double rx = posX + (dirX + planeX) * farZ, ry = posY + (dirY + planeY) * farZ;
+    double minX = fmin(posX, fmin(lx, rx)) - 0.5, maxX = fmax(posX, fmax(lx, rx)) + 0.5;
+    double minY = fmin(posY, fmin(ly, ry)) - 0.5, maxY = fmax(posY, fmax(ly, ry)) + 0.5;
+    int bx0 = (int)floor(minX) >> SPRITE_BIN_SHIFT, bx1 = (int)floor(maxX) >> SPRITE_BIN_SHIFT;
+    int by0 = (int)floor(minY) >> SPRITE_BIN_SHIFT, by1 = (int)floor(maxY) >> SPRITE_BIN_SHIFT;
+    if (bx0 < 0) bx0 = 0;
+    if (by0 < 0) by0 = 0;
+    if (bx1 >= binW) bx1 = binW - 1;
+    if (by1 >= binH) by1 = binH - 1;
+
+    int camRoom = room_at(posX, posY);
+    double planeLen = sqrt(planeX * planeX + planeY * planeY);
+    bool cullRooms = camRoom != (int)ROOM_NONE && planeLen > 0.0;
+    int nvis = 0;
+    const double binSize = (double)(1 << SPRITE_BIN_SHIFT);
+    for (int by = by0; by <= by1; by++) for (int bx = bx0; bx <= bx1; bx++) {
+        int head = binHead[bx + binW * by];
+        if (head < 0) continue;
+        // reject the whole bin if all four corners sit outside the same frustum plane
+        int outL = 0, outR = 0, outN = 0, outF = 0;
+        for (int c = 0; c < 4; c++) {
+            double cx = bx * binSize + ((c & 1) ? binSize + 0.5 : -0.5) - posX;
+            double cy = by * binSize + ((c & 2) ? binSize + 0.5 : -0.5) - posY;
+            double tX = invDet * (dirY * cx - dirX * cy);
+            double tY = invDet * (-planeY * cx + planeX * cy);
+            outL += tX < -tY - 0.5;
+            outR += tX > tY + 0.5;
+            outN += tY < SPRITE_NEAR;
+            outF += tY > farZ + 0.5;
+        }
+        st.binsVisited++;
+        if (outL == 4 || outR == 4 || outN == 4 || outF == 4) continue;
+        for (int id = head; id >= 0; id = sprNext[id]) {
+            st.tested++;
+            double relX = sprX[id] - posX, relY = sprY[id] - posY;
+            double tY = invDet * (-planeY * relX + planeX * relY);
+            if (tY < SPRITE_NEAR || tY >= farZ) continue;
+            int size = (int)(rh / tY);
+            if (cullRooms) {
+                // columns show the billboard where its span along the camera plane is open
+                double half = planeLen * (size + 2) * tY / rw;
+                if (!billboard_room_visible(camRoom, sprX[id], sprY[id], planeX / planeLen * half, planeY / planeLen * half)) {
+                    st.roomCulled++;
+                    continue;
+                }
+            }
+            double tX = invDet * (dirY * relX - dirX * relY);
+            int screenX = (int)((rw / 2) * (1.0 + tX / tY));
+            int x0 = screenX - size / 2, x1 = screenX + size / 2;
+            if (x1 < 0 || x0 >= rw) continue;
+            if (x0 < 0) x0 = 0;
+            if (x1 >= rw) x1 = rw - 1;
+            float maxZ = 0.0f;
+            for (int t = x0 >> DEPTH_TILE_SHIFT; t <= (x1 >> DEPTH_TILE_SHIFT); t++) if (depthTiles[t] > maxZ) maxZ = depthTiles[t];
+            if (tY >= maxZ) continue;
+            visKey[nvis] = depth_key((float)tY);
+            visIdx[nvis] = id;
+            nvis++;
+        }
+    }
+    sort_by_depth(nvis);
+
+    // front to back: each column keeps the rows sprites already cover, so every
+    // pixel is written once and columns behind walls or nearer sprites drop out
+    for (int x = 0; x < rw; x++) covHead[x] = -1;
+    covSpanCount = 0;
+    for (int v = 0; v < nvis; v++) {
+        int id = visIdx[v];
+        double relX = sprX[id] - posX, relY = sprY[id] - posY;
+        double tX = invDet * (dirY * relX - dirX * relY);
+        double tY = invDet * (-planeY * relX + planeX * relY);
+        float depth = (float)tY;
+        int size = (int)(rh / tY);
+        if (size <= 0) continue;
+        int screenX = (int)((rw / 2) * (1.0 + tX / tY));
+        int left = screenX - size / 2, top = rh / 2 - size / 2;
+        int x0 = left < 0 ? 0 : left;
+        int x1 = screenX + size / 2; if (x1 >= rw) x1 = rw - 1;
+        int t = sprTex[id];
+        int level = light_level_at((int)floor(sprX[id]), (int)floor(sprY[id]));
+        const Uint32 *tex = spriteShaded[lightWallShade[0][level][light_fog_bucket(tY)]][t];
+        long long stepY = ((long long)SPRITE_TEX_H << 16) / size;
+        bool any = false;
+        for (int x = x0; x <= x1; x++) {
+            if (depth >= zbuffer[x]) continue;
+            const float *colZ = pixelZ ? pixelZ + (size_t)x * rh : NULL;
+            int texX = (int)((long long)(x - left) * SPRITE_TEX_W / size);
+            if (texX < 0 || texX >= SPRITE_TEX_W || colBot[t][texX] < colTop[t][texX]) continue;
+            // each sprite column is one solid span, but an orb's edge columns sit
+            // well below the horizon, so nearer sprites can leave gaps between them
+            int y0 = top + (int)(((long long)colTop[t][texX] * size) / SPRITE_TEX_H);
+            int y1 = top + (int)((((long long)colBot[t][texX] + 1) * size) / SPRITE_TEX_H) - 1;
+            if (y0 < 0) y0 = 0;
+            if (y1 >= rh) y1 = rh - 1;
+            if (y0 > y1) continue;
+            // spans wholly above this one, then draw the rows between the ones it meets
+            int *link = &covHead[x];
+            while (*link >= 0 && covSpans[*link].bot < y0 - 1) link = &covSpans[*link].next;
+            int span = *link, a = y0, lo = y0, hi = y1;
+            bool drew = false;
+            for (; span >= 0 && covSpans[span].top <= y1 + 1; span = covSpans[span].next) {
+                if (covSpans[span].top < lo) lo = covSpans[span].top;
+                if (covSpans[span].bot > hi) hi = covSpans[span].bot;
+                if (a < covSpans[span].top) drew |= draw_span(pixels, rw, x, a, covSpans[span].top - 1, top, stepY, tex, texX, colZ, depth);
+                a = covSpans[span].bot + 1;
+            }
+            if (a <= y1) drew |= draw_span(pixels, rw, x, a, y1, top, stepY, tex, texX, colZ, depth);
+            if (!drew) continue;
+            // the spans it met and the new rows become one; the old entries stay
+            // unlinked in the pool until the next frame
+            if (covSpanCount == covSpanCap) {
+                int cap = covSpanCap ? covSpanCap * 2 : 1024;
+                CoverSpan *g = realloc(covSpans, sizeof(CoverSpan) * cap);
+                if (!g) continue;
+                covSpans = g;
+                covSpanCap = cap;
+            }
+            covSpans[covSpanCount] = (CoverSpan){ (short)lo, (short)hi, span };
+            *link = covSpanCount++;
+            any = true;
+        }
+        st.drawn += any;
+    }
+    if (stats) *stats = st;
+}
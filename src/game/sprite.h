@@ -0,0 +1,45 @@
+#ifndef GAME_SPRITE_H
+#define GAME_SPRITE_H
+
+#include <SDL2/SDL.h>
+
+#define SPRITE_TEX_W 64
+#define SPRITE_TEX_H 64
+#define SPRITE_TEX_COUNT 2
+#define SPRITE_BIN_SHIFT 2 // spatial bins are 4x4 map cells
+
+typedef struct SpriteStats {
+    int live;
+    int binsVisited;
+    int tested;
+    int roomCulled;  // skipped because the camera's room can't see theirs
+    int drawn;
+} SpriteStats;
+
+void sprite_reset(void);
+int sprite_spawn(double x, double y, int tex);
+void sprite_move(int id, double x, double y);
+void sprite_despawn(int id);
+void sprite_spawn_map_things(void);
+int sprite_count(void);
+// changes whenever a sprite is added, moved or removed
+unsigned sprite_revision(void);
+
+// draw all live sprites over a frame from render_world(), occluded by its zbuffer
+// and, on maps with heights, by that frame's renderDepth pixel by pixel;
+// sprite textures are drawn as one solid span per column.
+// Sprites in rooms outside the camera room's PVS are skipped once rooms_build() ran.
+void sprite_render(
+    Uint32 *pixels,
+    int renderW,
+    int renderH,
+    const float *zbuffer,
+    double posX,
+    double posY,
+    double dirX,
+    double dirY,
+    double planeX,
+    double planeY,
+    SpriteStats *stats);
+
+#endif
@@ -0,0 +1,140 @@
+// Headless simulation server: steps a crowd of wandering bots at a fixed tick
+// rate without a window and reports throughput. Used for bot load testing.
+#include <SDL2/SDL.h>
+#include "jobs.h"
+#include "map.h"
+#include "mem.h"
+#include "sim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BOT_THINK_TICKS 30 // ticks between new random inputs
+
+typedef struct ServerOpts {
+    const char *mapPath;
+    int mapSize;
+    int bots;
+    int ticks;
+    int hz;
+    int threads;
+    bool realtime;
+    unsigned int seed;
+} ServerOpts;
+
+static double now_ms(void) {
+    return (double)SDL_GetPerformanceCounter() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// per-bot xorshift so bot behaviour does not depend on the thread or libc
+static Uint32 bot_rand(Uint32 *state) {
+    Uint32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void usage(const char *argv0) {
+    printf("Usage: %s [--map PATH] [--mapsize N] [--bots N] [--ticks N] [--hz N]\n"
+           "          [--threads N] [--realtime] [--seed N]\n"
+           "Runs flat out unless --realtime is given; --ticks 0 runs until killed.\n", argv0);
+}
+
+int main(int argc, char *argv[]) {
+    ServerOpts o = { NULL, 256, 10000, 600, SIM_TICK_HZ, -1, false, 1 };
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(a, "--map") == 0 && v) { o.mapPath = v; i++; }
+        else if (strcmp(a, "--mapsize") == 0 && v) { o.mapSize = atoi(v); i++; }
+        else if (strcmp(a, "--bots") == 0 && v) { o.bots = atoi(v); i++; }
+        else if (strcmp(a, "--ticks") == 0 && v) { o.ticks = atoi(v); i++; }
+        else if (strcmp(a, "--hz") == 0 && v) { o.hz = atoi(v); i++; }
+        else if (strcmp(a, "--threads") == 0 && v) { o.threads = atoi(v); i++; }
+        else if (strcmp(a, "--realtime") == 0) { o.realtime = true; }
+        else if (strcmp(a, "--seed") == 0 && v) { o.seed = (unsigned int)strtoul(v, NULL, 10); i++; }
+        else { usage(argv[0]); return strcmp(a, "--help") == 0 ? 0 : 1; }
+    }
+    if (o.mapSize < 8 || o.bots <= 0 || o.ticks < 0 || o.hz <= 0) { usage(argv[0]); return 1; }
+
+    srand(o.seed);
+    if (!o.mapPath || !load_map_file(o.mapPath)) {
+        if (o.mapPath) fprintf(stderr, "failed to load %s, using a generated map\n", o.mapPath);
+        mapW = mapH = o.mapSize;
+        load_default_map();
+    }
+    int openCount = 0;
+    for (int i = 0; i < mapW * mapH; i++) openCount += !mapSolid[i];
+    if (openCount == 0) { fprintf(stderr, "map has no open cells\n"); return 1; }
+
+    jobs_init(o.threads);
+    SimActors actors;
+    Uint32 *think = malloc(sizeof(Uint32) * (size_t)o.bots);
+    if (!think || !sim_init(&actors, o.bots)) { fprintf(stderr, "failed to allocate %d bots\n", o.bots); return 1; }
+    Uint32 seedState = o.seed ? o.seed : 1;
+    for (int b = 0; b < o.bots; b++) {
+        int c;
+        do { c = (int)(bot_rand(&seedState) % (Uint32)(mapW * mapH)); } while (mapSolid[c]);
+        double a = (bot_rand(&seedState) % 6283) / 1000.0;
+        sim_add(&actors, c % mapW + 0.5, c / mapW + 0.5, cos(a), sin(a), 0.84);
+        think[b] = bot_rand(&seedState) | 1;
+    }
+
+    const double dt = 1.0 / o.hz;
+    double stepTotal = 0.0, stepMax = 0.0, windowStep = 0.0;
+    int windowTicks = 0;
+    double start = now_ms(), windowStart = start, next = start;
+    printf("server: %d bots on %dx%d, %d Hz, %d thread(s)%s\n", o.bots, mapW, mapH, o.hz,
+        jobs_thread_count(), o.realtime ? ", realtime" : "");
+    for (int tick = 0; o.ticks == 0 || tick < o.ticks; tick++) {
+        // bots hold a random input for a while, then pick another
+        for (int b = 0; b < actors.count; b++) {
+            if ((tick + b) % BOT_THINK_TICKS != 0) continue;
+            Uint32 r = bot_rand(&think[b]);
+            actors.input[b] = (Uint8)((r & (SIM_IN_FORWARD | SIM_IN_LEFT | SIM_IN_RIGHT)) | ((r >> 8) & 1 ? SIM_IN_TURN_LEFT : 0));
+        }
+        double t0 = now_ms();
+        sim_step(&actors, dt);
+        double ms = now_ms() - t0;
+        stepTotal += ms;
+        windowStep += ms;
+        if (ms > stepMax) stepMax = ms;
+        windowTicks++;
+
+        double t = now_ms();
+        if (t - windowStart >= 1000.0) {
+            printf("tick %d: %d ticks in %.0fms, step avg=%.3fms, %.0f actor-steps/ms\n", tick + 1, windowTicks,
+                t - windowStart, windowStep / windowTicks, windowStep > 0.0 ? (double)actors.count * windowTicks / windowStep : 0.0);
+            fflush(stdout);
+            windowStart = t;
+            windowStep = 0.0;
+            windowTicks = 0;
+        }
+        if (o.realtime) {
+            next += dt * 1000.0;
+            double wait = next - now_ms();
+            if (wait > 1.0) SDL_Delay((Uint32)wait);
+            else if (wait < -250.0) next = now_ms(); // fell far behind, don't try to catch up
+        }
+    }
+    int ticks = o.ticks;
+    if (ticks > 0) {
+        printf("done: %d ticks, %d bots, step avg=%.3fms max=%.3fms, %.0f actor-steps/ms, wall %.0fms\n",
+            ticks, actors.count, stepTotal / ticks, stepMax,
+            stepTotal > 0.0 ? (double)actors.count * ticks / stepTotal : 0.0, now_ms() - start);
+    }
+
+    sim_free(&actors);
+    free(think);
+    jobs_shutdown();
+    mem_free(worldMap);
+    mem_free(mapSolid);
+    return 0;
+}
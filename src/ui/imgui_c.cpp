@@ -1,5 +1,9 @@
 #include "imgui_c.h"
 
+#include <float.h>
+#include <stdarg.h>
+#include <stdint.h>
+
 #if defined(GAME90_ENABLE_IMGUI) && GAME90_ENABLE_IMGUI
 #include "imgui.h"
 #include "backends/imgui_impl_sdl2.h"
@@ -12,6 +16,7 @@ struct ImGuiCState {
 };
 
 static ImGuiCState g_state = {nullptr, nullptr, false};
+static ImGuiListClipper g_clipper;
 
 extern "C" {
 
@@ -60,6 +65,9 @@ void imgui_c_process_event(const SDL_Event *event) {
     if (!g_state.initialized || !event) {
         return;
     }
+    if (event->type == SDL_RENDER_TARGETS_RESET || event->type == SDL_RENDER_DEVICE_RESET) {
+        ImGui_ImplSDLRenderer2_InvalidateCache();
+    }
     ImGui_ImplSDL2_ProcessEvent(event);
 }
 
@@ -111,6 +119,187 @@ int imgui_c_button(const char *label) {
     return ImGui::Button(label ? label : "") ? 1 : 0;
 }
 
+void imgui_c_textf(const char *fmt, ...) {
+    if (!g_state.initialized || !fmt) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    ImGui::TextV(fmt, args);
+    va_end(args);
+}
+
+void imgui_c_value_int(const char *label, int value) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::Text("%s: %d", label ? label : "", value);
+}
+
+void imgui_c_value_float(const char *label, float value, int decimals) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::Text("%s: %.*f", label ? label : "", decimals, value);
+}
+
+void imgui_c_same_line(void) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::SameLine();
+}
+
+void imgui_c_separator(void) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::Separator();
+}
+
+// a full ring starts at its oldest value, which is the next slot to write
+static int ring_offset(const ImGuiCRing *ring) {
+    return ring->count == ring->capacity ? ring->next : 0;
+}
+
+void imgui_c_plot_lines(const char *label, const ImGuiCRing *ring, float min, float max, float width, float height) {
+    if (!g_state.initialized || !ring || !ring->values || ring->count <= 0) {
+        return;
+    }
+
+    ImGui::PlotLines(label ? label : "", ring->values, ring->count, ring_offset(ring), NULL,
+                     min == max ? FLT_MAX : min, min == max ? FLT_MAX : max, ImVec2(width, height));
+}
+
+void imgui_c_plot_histogram(const char *label, const ImGuiCRing *ring, float min, float max, float width, float height) {
+    if (!g_state.initialized || !ring || !ring->values || ring->count <= 0) {
+        return;
+    }
+
+    ImGui::PlotHistogram(label ? label : "", ring->values, ring->count, ring_offset(ring), NULL,
+                         min == max ? FLT_MAX : min, min == max ? FLT_MAX : max, ImVec2(width, height));
+}
+
+int imgui_c_begin_table(const char *id, int columns) {
+    if (!g_state.initialized || !id || columns <= 0) {
+        return 0;
+    }
+
+    return ImGui::BeginTable(id, columns, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit) ? 1 : 0;
+}
+
+void imgui_c_table_setup_column(const char *label) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::TableSetupColumn(label ? label : "");
+}
+
+void imgui_c_table_headers_row(void) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::TableHeadersRow();
+}
+
+void imgui_c_table_next_row(void) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::TableNextRow();
+}
+
+void imgui_c_table_next_column(void) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::TableNextColumn();
+}
+
+void imgui_c_end_table(void) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    ImGui::EndTable();
+}
+
+int imgui_c_checkbox(const char *label, bool *value) {
+    if (!g_state.initialized || !value) {
+        return 0;
+    }
+
+    return ImGui::Checkbox(label ? label : "", value) ? 1 : 0;
+}
+
+int imgui_c_slider_int(const char *label, int *value, int min, int max) {
+    if (!g_state.initialized || !value) {
+        return 0;
+    }
+
+    return ImGui::SliderInt(label ? label : "", value, min, max) ? 1 : 0;
+}
+
+int imgui_c_slider_float(const char *label, float *value, float min, float max, const char *fmt) {
+    if (!g_state.initialized || !value) {
+        return 0;
+    }
+
+    return ImGui::SliderFloat(label ? label : "", value, min, max, fmt ? fmt : "%.3f") ? 1 : 0;
+}
+
+int imgui_c_combo(const char *label, int *current, const char *const *items, int count) {
+    if (!g_state.initialized || !current || !items || count <= 0) {
+        return 0;
+    }
+
+    return ImGui::Combo(label ? label : "", current, items, count) ? 1 : 0;
+}
+
+void imgui_c_clip_begin(int count) {
+    if (!g_state.initialized) {
+        return;
+    }
+
+    g_clipper.Begin(count);
+}
+
+int imgui_c_clip_step(int *first, int *last) {
+    if (!g_state.initialized || !first || !last) {
+        return 0;
+    }
+
+    if (!g_clipper.Step()) {
+        return 0;
+    }
+    *first = g_clipper.DisplayStart;
+    *last = g_clipper.DisplayEnd;
+    return 1;
+}
+
+int imgui_c_image_button(const char *id, SDL_Texture *texture, float width, float height) {
+    if (!g_state.initialized || !id) {
+        return 0;
+    }
+
+    if (!texture) {
+        ImGui::PushID(id);
+        bool pressed = ImGui::Button("", ImVec2(width, height));
+        ImGui::PopID();
+        return pressed ? 1 : 0;
+    }
+    return ImGui::ImageButton(id, (ImTextureID)(intptr_t)texture, ImVec2(width, height)) ? 1 : 0;
+}
+
 } // extern "C"
 #else
 extern "C" {
@@ -144,5 +333,120 @@ void imgui_c_text(const char *text) {
     (void)text;
 }
 
+int imgui_c_button(const char *label) {
+    (void)label;
+    return 0;
+}
+
+void imgui_c_textf(const char *fmt, ...) {
+    (void)fmt;
+}
+
+void imgui_c_value_int(const char *label, int value) {
+    (void)label;
+    (void)value;
+}
+
+void imgui_c_value_float(const char *label, float value, int decimals) {
+    (void)label;
+    (void)value;
+    (void)decimals;
+}
+
+void imgui_c_same_line(void) {
+}
+
+void imgui_c_separator(void) {
+}
+
+void imgui_c_plot_lines(const char *label, const ImGuiCRing *ring, float min, float max, float width, float height) {
+    (void)label;
+    (void)ring;
+    (void)min;
+    (void)max;
+    (void)width;
+    (void)height;
+}
+
+void imgui_c_plot_histogram(const char *label, const ImGuiCRing *ring, float min, float max, float width, float height) {
+    (void)label;
+    (void)ring;
+    (void)min;
+    (void)max;
+    (void)width;
+    (void)height;
+}
+
+int imgui_c_begin_table(const char *id, int columns) {
+    (void)id;
+    (void)columns;
+    return 0;
+}
+
+void imgui_c_table_setup_column(const char *label) {
+    (void)label;
+}
+
+void imgui_c_table_headers_row(void) {
+}
+
+void imgui_c_table_next_row(void) {
+}
+
+void imgui_c_table_next_column(void) {
+}
+
+void imgui_c_end_table(void) {
+}
+
+int imgui_c_checkbox(const char *label, bool *value) {
+    (void)label;
+    (void)value;
+    return 0;
+}
+
+int imgui_c_slider_int(const char *label, int *value, int min, int max) {
+    (void)label;
+    (void)value;
+    (void)min;
+    (void)max;
+    return 0;
+}
+
+int imgui_c_slider_float(const char *label, float *value, float min, float max, const char *fmt) {
+    (void)label;
+    (void)value;
+    (void)min;
+    (void)max;
+    (void)fmt;
+    return 0;
+}
+
+int imgui_c_combo(const char *label, int *current, const char *const *items, int count) {
+    (void)label;
+    (void)current;
+    (void)items;
+    (void)count;
+    return 0;
+}
+
+void imgui_c_clip_begin(int count) {
+    (void)count;
+}
+
+int imgui_c_clip_step(int *first, int *last) {
+    (void)first;
+    (void)last;
+    return 0;
+}
+
+int imgui_c_image_button(const char *id, SDL_Texture *texture, float width, float height) {
+    (void)id;
+    (void)texture;
+    (void)width;
+    (void)height;
+    return 0;
+}
+
 } // extern "C"
 #endif
@@ -2,6 +2,7 @@
 #define IMGUI_C_H
 
 #include <SDL2/SDL.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,6 +23,58 @@ void imgui_c_end(void);
 void imgui_c_text(const char *text);
 int imgui_c_button(const char *label);
 
+// printf-style text, formatted by ImGui into its own buffer
+void imgui_c_textf(const char *fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 1, 2)))
+#endif
+    ;
+void imgui_c_value_int(const char *label, int value);
+void imgui_c_value_float(const char *label, float value, int decimals);
+void imgui_c_same_line(void);
+void imgui_c_separator(void);
+
+// Caller-owned history for plots; the plot reads values in place, oldest
+// first. Zero-initialize with a values array of capacity floats.
+typedef struct ImGuiCRing {
+    float *values;
+    int capacity;
+    int count;  // valid values, up to capacity
+    int next;   // slot the next push writes
+} ImGuiCRing;
+
+static inline void imgui_c_ring_push(ImGuiCRing *r, float v) {
+    r->values[r->next] = v;
+    r->next = (r->next + 1) % r->capacity;
+    if (r->count < r->capacity) r->count++;
+}
+
+// min == max scales the plot to the data; width 0 fills the window
+void imgui_c_plot_lines(const char *label, const ImGuiCRing *ring, float min, float max, float width, float height);
+void imgui_c_plot_histogram(const char *label, const ImGuiCRing *ring, float min, float max, float width, float height);
+
+// tables: rows are filled cell by cell with imgui_c_table_next_column()
+int imgui_c_begin_table(const char *id, int columns);
+void imgui_c_table_setup_column(const char *label);
+void imgui_c_table_headers_row(void);
+void imgui_c_table_next_row(void);
+void imgui_c_table_next_column(void);
+void imgui_c_end_table(void);
+
+// controls bound to live values; each returns 1 on the frame the value changes
+int imgui_c_checkbox(const char *label, bool *value);
+int imgui_c_slider_int(const char *label, int *value, int min, int max);
+int imgui_c_slider_float(const char *label, float *value, float min, float max, const char *fmt);
+int imgui_c_combo(const char *label, int *current, const char *const *items, int count);
+
+// long lists: only rows in view are submitted. Call step until it returns 0;
+// each time, submit rows first..last-1, all of the same height.
+void imgui_c_clip_begin(int count);
+int imgui_c_clip_step(int *first, int *last);
+
+// button showing a texture; a NULL texture gives a plain button of that size
+int imgui_c_image_button(const char *id, SDL_Texture *texture, float width, float height);
+
 #ifdef __cplusplus
 }
 #endif
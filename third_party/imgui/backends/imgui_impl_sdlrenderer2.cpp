@@ -1,11 +1,37 @@
 #include "imgui_impl_sdlrenderer2.h"
 
 #include <SDL2/SDL.h>
-#include <vector>
+#include <stddef.h>
+#include <string.h>
 
 static SDL_Renderer *g_Renderer = NULL;
 static SDL_Texture *g_FontTexture = NULL;
 
+// Last frame's draw data, merged into buffers that live across frames and
+// grow geometrically (ImVector). An identical frame is detected by comparing
+// against them; from the second identical frame on only the cached overlay
+// texture is drawn.
+struct CachedCmd {
+    SDL_Rect clip;          // framebuffer coordinates
+    SDL_Texture *tex;
+    int vtxOffset, vtxCount; // into g_Vtx
+    int idxOffset, idxCount; // into g_Idx
+};
+
+static ImVector<ImDrawVert> g_Vtx;
+static ImVector<ImDrawIdx> g_Idx;
+static ImVector<CachedCmd> g_Cmds;
+static ImVector<CachedCmd> g_NewCmds;
+static int g_CacheWidth = 0, g_CacheHeight = 0;
+static bool g_CacheValid = false;
+
+// the cached frame rendered once with premultiplied alpha; NULL when the
+// renderer has no render targets or custom blend modes
+static SDL_Texture *g_Overlay = NULL;
+static SDL_Rect g_OverlayRect;          // bounds of the cached commands' clip rects
+static bool g_OverlayValid = false;
+static bool g_OverlayUnsupported = false;
+
 static bool ImGui_ImplSDLRenderer2_CreateFontsTexture(void) {
     ImGuiIO &io = ImGui::GetIO();
     unsigned char *pixels = NULL;
@@ -44,15 +70,255 @@ void ImGui_ImplSDLRenderer2_Shutdown(void) {
         SDL_DestroyTexture(g_FontTexture);
         g_FontTexture = NULL;
     }
+    if (g_Overlay) {
+        SDL_DestroyTexture(g_Overlay);
+        g_Overlay = NULL;
+    }
+    g_Vtx.clear();
+    g_Idx.clear();
+    g_Cmds.clear();
+    g_NewCmds.clear();
+    g_CacheValid = false;
+    g_OverlayValid = false;
+    g_OverlayUnsupported = false;
     g_Renderer = NULL;
 }
 
+void ImGui_ImplSDLRenderer2_InvalidateCache(void) {
+    g_OverlayValid = false;
+}
+
 void ImGui_ImplSDLRenderer2_NewFrame(void) {
     if (!g_FontTexture) {
         ImGui_ImplSDLRenderer2_CreateFontsTexture();
     }
 }
 
+static bool same_cmd(const CachedCmd &a, const CachedCmd &b) {
+    return a.clip.x == b.clip.x && a.clip.y == b.clip.y && a.clip.w == b.clip.w && a.clip.h == b.clip.h &&
+           a.tex == b.tex && a.vtxOffset == b.vtxOffset && a.vtxCount == b.vtxCount &&
+           a.idxOffset == b.idxOffset && a.idxCount == b.idxCount;
+}
+
+// Fills g_NewCmds from draw_data with offsets into the merged buffers, dropping
+// fully clipped commands. Returns false if a user callback needs the direct path.
+static bool collect_cmds(ImDrawData *draw_data, int fb_width, int fb_height, int *vtx_total, int *idx_total) {
+    ImVec2 clip_off = draw_data->DisplayPos;
+    ImVec2 clip_scale = draw_data->FramebufferScale;
+    int vtx_base = 0, idx_base = 0;
+    g_NewCmds.resize(0);
+    for (int n = 0; n < draw_data->CmdListsCount; n++) {
+        const ImDrawList *cmd_list = draw_data->CmdLists[n];
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
+            const ImDrawCmd *pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback) {
+                return false;
+            }
+            float x1 = (pcmd->ClipRect.x - clip_off.x) * clip_scale.x;
+            float y1 = (pcmd->ClipRect.y - clip_off.y) * clip_scale.y;
+            float x2 = (pcmd->ClipRect.z - clip_off.x) * clip_scale.x;
+            float y2 = (pcmd->ClipRect.w - clip_off.y) * clip_scale.y;
+            if (x1 >= fb_width || y1 >= fb_height || x2 < 0.0f || y2 < 0.0f || pcmd->ElemCount == 0) {
+                continue;
+            }
+            CachedCmd c;
+            c.clip.x = (int)x1;
+            c.clip.y = (int)y1;
+            c.clip.w = (int)(x2 - x1);
+            c.clip.h = (int)(y2 - y1);
+            c.tex = (SDL_Texture *)pcmd->GetTexID();
+            c.vtxOffset = vtx_base + (int)pcmd->VtxOffset;
+            c.vtxCount = cmd_list->VtxBuffer.Size - (int)pcmd->VtxOffset;
+            c.idxOffset = idx_base + (int)pcmd->IdxOffset;
+            c.idxCount = (int)pcmd->ElemCount;
+            g_NewCmds.push_back(c);
+        }
+        vtx_base += cmd_list->VtxBuffer.Size;
+        idx_base += cmd_list->IdxBuffer.Size;
+    }
+    *vtx_total = vtx_base;
+    *idx_total = idx_base;
+    return true;
+}
+
+// true when draw_data matches the cached frame exactly
+static bool matches_cache(ImDrawData *draw_data, int fb_width, int fb_height, int vtx_total, int idx_total) {
+    if (!g_CacheValid || fb_width != g_CacheWidth || fb_height != g_CacheHeight ||
+        vtx_total != g_Vtx.Size || idx_total != g_Idx.Size || g_NewCmds.Size != g_Cmds.Size) {
+        return false;
+    }
+    for (int i = 0; i < g_Cmds.Size; i++) {
+        if (!same_cmd(g_Cmds[i], g_NewCmds[i])) {
+            return false;
+        }
+    }
+    int vtx_base = 0, idx_base = 0;
+    for (int n = 0; n < draw_data->CmdListsCount; n++) {
+        const ImDrawList *cmd_list = draw_data->CmdLists[n];
+        if (memcmp(cmd_list->VtxBuffer.Data, g_Vtx.Data + vtx_base, sizeof(ImDrawVert) * cmd_list->VtxBuffer.Size) != 0 ||
+            memcmp(cmd_list->IdxBuffer.Data, g_Idx.Data + idx_base, sizeof(ImDrawIdx) * cmd_list->IdxBuffer.Size) != 0) {
+            return false;
+        }
+        vtx_base += cmd_list->VtxBuffer.Size;
+        idx_base += cmd_list->IdxBuffer.Size;
+    }
+    return true;
+}
+
+static void store_cache(ImDrawData *draw_data, int fb_width, int fb_height, int vtx_total, int idx_total) {
+    g_Vtx.resize(vtx_total);
+    g_Idx.resize(idx_total);
+    int vtx_base = 0, idx_base = 0;
+    for (int n = 0; n < draw_data->CmdListsCount; n++) {
+        const ImDrawList *cmd_list = draw_data->CmdLists[n];
+        memcpy(g_Vtx.Data + vtx_base, cmd_list->VtxBuffer.Data, sizeof(ImDrawVert) * cmd_list->VtxBuffer.Size);
+        memcpy(g_Idx.Data + idx_base, cmd_list->IdxBuffer.Data, sizeof(ImDrawIdx) * cmd_list->IdxBuffer.Size);
+        vtx_base += cmd_list->VtxBuffer.Size;
+        idx_base += cmd_list->IdxBuffer.Size;
+    }
+    g_Cmds.swap(g_NewCmds);
+    // only this part of the overlay is ever drawn to, so only it is composited:
+    // each command's triangles, clipped
+    SDL_Rect fb = { 0, 0, fb_width, fb_height };
+    g_OverlayRect.w = g_OverlayRect.h = 0;
+    for (int i = 0; i < g_Cmds.Size; i++) {
+        const CachedCmd &c = g_Cmds[i];
+        const ImDrawVert *vtx = g_Vtx.Data + c.vtxOffset;
+        const ImDrawIdx *idx = g_Idx.Data + c.idxOffset;
+        ImVec2 lo = vtx[idx[0]].pos, hi = lo;
+        for (int k = 1; k < c.idxCount; k++) {
+            const ImVec2 &p = vtx[idx[k]].pos;
+            lo.x = p.x < lo.x ? p.x : lo.x;
+            lo.y = p.y < lo.y ? p.y : lo.y;
+            hi.x = p.x > hi.x ? p.x : hi.x;
+            hi.y = p.y > hi.y ? p.y : hi.y;
+        }
+        SDL_Rect tri = { (int)lo.x - 1, (int)lo.y - 1, (int)(hi.x - lo.x) + 3, (int)(hi.y - lo.y) + 3 };
+        SDL_Rect r;
+        if (!SDL_IntersectRect(&c.clip, &fb, &r) || !SDL_IntersectRect(&r, &tri, &r)) {
+            continue;
+        }
+        if (g_OverlayRect.w == 0) {
+            g_OverlayRect = r;
+        } else {
+            SDL_UnionRect(&g_OverlayRect, &r, &g_OverlayRect);
+        }
+    }
+    g_CacheWidth = fb_width;
+    g_CacheHeight = fb_height;
+    g_CacheValid = true;
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+// ImDrawVert is consumed in place: positions, uvs and colours are read with
+// its stride, and ImU32 colours are already SDL_Color's r, g, b, a byte order
+static void draw_geometry(SDL_Texture *tex, const ImDrawVert *vtx, int vtx_count, const ImDrawIdx *idx, int idx_count) {
+    const int stride = (int)sizeof(ImDrawVert);
+    SDL_RenderGeometryRaw(g_Renderer, tex,
+                          (const float *)((const char *)vtx + offsetof(ImDrawVert, pos)), stride,
+                          (const SDL_Color *)((const char *)vtx + offsetof(ImDrawVert, col)), stride,
+                          (const float *)((const char *)vtx + offsetof(ImDrawVert, uv)), stride,
+                          vtx_count, idx, idx_count, (int)sizeof(ImDrawIdx));
+}
+
+static void draw_cache(void) {
+    for (int i = 0; i < g_Cmds.Size; i++) {
+        const CachedCmd &c = g_Cmds[i];
+        SDL_RenderSetClipRect(g_Renderer, &c.clip);
+        draw_geometry(c.tex, g_Vtx.Data + c.vtxOffset, c.vtxCount, g_Idx.Data + c.idxOffset, c.idxCount);
+    }
+    SDL_RenderSetClipRect(g_Renderer, NULL);
+}
+
+// the uncached path, for draw data with user callbacks
+static void draw_direct(ImDrawData *draw_data, int fb_width, int fb_height) {
+    ImVec2 clip_off = draw_data->DisplayPos;
+    ImVec2 clip_scale = draw_data->FramebufferScale;
+    for (int n = 0; n < draw_data->CmdListsCount; n++) {
+        const ImDrawList *cmd_list = draw_data->CmdLists[n];
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
+            const ImDrawCmd *pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback) {
+                if (pcmd->UserCallback == ImDrawCallback_ResetRenderState) {
+                    SDL_SetRenderDrawBlendMode(g_Renderer, SDL_BLENDMODE_BLEND);
+                } else {
+                    pcmd->UserCallback(cmd_list, pcmd);
+                }
+                continue;
+            }
+            ImVec4 clip_rect;
+            clip_rect.x = (pcmd->ClipRect.x - clip_off.x) * clip_scale.x;
+            clip_rect.y = (pcmd->ClipRect.y - clip_off.y) * clip_scale.y;
+            clip_rect.z = (pcmd->ClipRect.z - clip_off.x) * clip_scale.x;
+            clip_rect.w = (pcmd->ClipRect.w - clip_off.y) * clip_scale.y;
+            if (clip_rect.x < fb_width && clip_rect.y < fb_height && clip_rect.z >= 0.0f && clip_rect.w >= 0.0f) {
+                SDL_Rect r;
+                r.x = (int)clip_rect.x;
+                r.y = (int)clip_rect.y;
+                r.w = (int)(clip_rect.z - clip_rect.x);
+                r.h = (int)(clip_rect.w - clip_rect.y);
+                SDL_RenderSetClipRect(g_Renderer, &r);
+                draw_geometry((SDL_Texture *)pcmd->GetTexID(), cmd_list->VtxBuffer.Data + pcmd->VtxOffset,
+                              cmd_list->VtxBuffer.Size - (int)pcmd->VtxOffset,
+                              cmd_list->IdxBuffer.Data + pcmd->IdxOffset, (int)pcmd->ElemCount);
+            }
+        }
+    }
+    SDL_RenderSetClipRect(g_Renderer, NULL);
+}
+
+// (re)creates the overlay texture for the framebuffer size; false when the
+// renderer can't draw into textures or composite premultiplied alpha
+static bool prepare_overlay(int fb_width, int fb_height) {
+    if (g_OverlayUnsupported) {
+        return false;
+    }
+    if (g_Overlay) {
+        int w = 0, h = 0;
+        SDL_QueryTexture(g_Overlay, NULL, NULL, &w, &h);
+        if (w == fb_width && h == fb_height) {
+            return true;
+        }
+        SDL_DestroyTexture(g_Overlay);
+        g_Overlay = NULL;
+    }
+    g_OverlayValid = false;
+    if (!SDL_RenderTargetSupported(g_Renderer)) {
+        g_OverlayUnsupported = true;
+        return false;
+    }
+    g_Overlay = SDL_CreateTexture(g_Renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, fb_width, fb_height);
+    // drawing blended onto transparent black leaves premultiplied colours
+    SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    if (!g_Overlay || SDL_SetTextureBlendMode(g_Overlay, premultiplied) != 0) {
+        if (g_Overlay) {
+            SDL_DestroyTexture(g_Overlay);
+            g_Overlay = NULL;
+        }
+        g_OverlayUnsupported = true;
+        return false;
+    }
+    return true;
+}
+
+static bool refresh_overlay(void) {
+    SDL_Texture *old_target = SDL_GetRenderTarget(g_Renderer);
+    if (SDL_SetRenderTarget(g_Renderer, g_Overlay) != 0) {
+        return false;
+    }
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(g_Renderer, &r, &g, &b, &a);
+    SDL_SetRenderDrawColor(g_Renderer, 0, 0, 0, 0);
+    SDL_RenderClear(g_Renderer);
+    SDL_SetRenderDrawColor(g_Renderer, r, g, b, a);
+    draw_cache();
+    SDL_SetRenderTarget(g_Renderer, old_target);
+    return true;
+}
+#endif
+
 void ImGui_ImplSDLRenderer2_RenderDrawData(ImDrawData *draw_data) {
     if (!g_Renderer || !draw_data) {
         return;
@@ -64,72 +330,42 @@ void ImGui_ImplSDLRenderer2_RenderDrawData(ImDrawData *draw_data) {
         return;
     }
 
+#if SDL_VERSION_ATLEAST(2, 0, 18)
     SDL_BlendMode old_blend = SDL_BLENDMODE_NONE;
     SDL_GetRenderDrawBlendMode(g_Renderer, &old_blend);
     SDL_SetRenderDrawBlendMode(g_Renderer, SDL_BLENDMODE_BLEND);
 
-    ImVec2 clip_off = draw_data->DisplayPos;
-    ImVec2 clip_scale = draw_data->FramebufferScale;
-
-#if SDL_VERSION_ATLEAST(2, 0, 18)
-    for (int n = 0; n < draw_data->CmdListsCount; n++) {
-        const ImDrawList *cmd_list = draw_data->CmdLists[n];
-        const ImDrawVert *vtx_buffer = cmd_list->VtxBuffer.Data;
-        const ImDrawIdx *idx_buffer = cmd_list->IdxBuffer.Data;
-
-        std::vector<SDL_Vertex> vertices;
-        vertices.resize(cmd_list->VtxBuffer.Size);
-        for (int i = 0; i < cmd_list->VtxBuffer.Size; i++) {
-            const ImDrawVert &v = vtx_buffer[i];
-            SDL_Vertex &out = vertices[i];
-            out.position.x = v.pos.x;
-            out.position.y = v.pos.y;
-            out.tex_coord.x = v.uv.x;
-            out.tex_coord.y = v.uv.y;
-            out.color.r = (Uint8)((v.col >> IM_COL32_R_SHIFT) & 0xFF);
-            out.color.g = (Uint8)((v.col >> IM_COL32_G_SHIFT) & 0xFF);
-            out.color.b = (Uint8)((v.col >> IM_COL32_B_SHIFT) & 0xFF);
-            out.color.a = (Uint8)((v.col >> IM_COL32_A_SHIFT) & 0xFF);
-        }
-
-        std::vector<int> indices;
-        indices.resize(cmd_list->IdxBuffer.Size);
-        for (int i = 0; i < cmd_list->IdxBuffer.Size; i++) {
-            indices[i] = (int)idx_buffer[i];
-        }
-
-        int idx_offset = 0;
-        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++) {
-            const ImDrawCmd *pcmd = &cmd_list->CmdBuffer[cmd_i];
-            if (pcmd->UserCallback) {
-                pcmd->UserCallback(cmd_list, pcmd);
-            } else {
-                ImVec4 clip_rect;
-                clip_rect.x = (pcmd->ClipRect.x - clip_off.x) * clip_scale.x;
-                clip_rect.y = (pcmd->ClipRect.y - clip_off.y) * clip_scale.y;
-                clip_rect.z = (pcmd->ClipRect.z - clip_off.x) * clip_scale.x;
-                clip_rect.w = (pcmd->ClipRect.w - clip_off.y) * clip_scale.y;
-
-                if (clip_rect.x < fb_width && clip_rect.y < fb_height && clip_rect.z >= 0.0f && clip_rect.w >= 0.0f) {
-                    SDL_Rect r;
-                    r.x = (int)clip_rect.x;
-                    r.y = (int)clip_rect.y;
-                    r.w = (int)(clip_rect.z - clip_rect.x);
-                    r.h = (int)(clip_rect.w - clip_rect.y);
-                    SDL_RenderSetClipRect(g_Renderer, &r);
-
-                    SDL_Texture *tex = (SDL_Texture *)pcmd->GetTexID();
-                    SDL_RenderGeometry(g_Renderer, tex, vertices.data(), (int)vertices.size(),
-                                       indices.data() + idx_offset, (int)pcmd->ElemCount);
+    int vtx_total = 0, idx_total = 0;
+    if (!collect_cmds(draw_data, fb_width, fb_height, &vtx_total, &idx_total)) {
+        g_CacheValid = false;
+        g_OverlayValid = false;
+        draw_direct(draw_data, fb_width, fb_height);
+    } else {
+        if (!matches_cache(draw_data, fb_width, fb_height, vtx_total, idx_total)) {
+            // changed UI goes straight to the backbuffer; baking it now would
+            // cost a render-to-texture pass that a UI changing every frame
+            // (the overlay's FPS text and plots) never gets back
+            store_cache(draw_data, fb_width, fb_height, vtx_total, idx_total);
+            g_OverlayValid = false;
+            draw_cache();
+        } else {
+            // the same UI twice in a row: bake it once, then one textured
+            // quad instead of every ImGui triangle while it keeps matching
+            if (!g_OverlayValid && prepare_overlay(fb_width, fb_height)) {
+                g_OverlayValid = refresh_overlay();
+            }
+            if (g_OverlayValid) {
+                if (g_OverlayRect.w > 0) {
+                    SDL_RenderCopy(g_Renderer, g_Overlay, &g_OverlayRect, &g_OverlayRect);
                 }
+            } else {
+                draw_cache();
             }
-            idx_offset += pcmd->ElemCount;
         }
     }
-    SDL_RenderSetClipRect(g_Renderer, NULL);
+
+    SDL_SetRenderDrawBlendMode(g_Renderer, old_blend);
 #else
     (void)draw_data;
 #endif
-
-    SDL_SetRenderDrawBlendMode(g_Renderer, old_blend);
 }
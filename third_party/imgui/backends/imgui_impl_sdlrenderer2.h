@@ -7,3 +7,6 @@ IMGUI_IMPL_API bool ImGui_ImplSDLRenderer2_Init(SDL_Renderer *renderer);
 IMGUI_IMPL_API void ImGui_ImplSDLRenderer2_Shutdown(void);
 IMGUI_IMPL_API void ImGui_ImplSDLRenderer2_NewFrame(void);
 IMGUI_IMPL_API void ImGui_ImplSDLRenderer2_RenderDrawData(ImDrawData *draw_data);
+// Unchanged frames reuse an overlay texture; call when render targets were
+// lost (SDL_RENDER_TARGETS_RESET, SDL_RENDER_DEVICE_RESET) to redraw it.
+IMGUI_IMPL_API void ImGui_ImplSDLRenderer2_InvalidateCache(void);